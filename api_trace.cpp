@@ -0,0 +1,540 @@
+#include "api_trace.h"
+#include "fast_hash.h"
+#include "file_io.h"
+
+#include <cstring>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#endif
+
+// ─── helpers ─────────────────────────────────────────────────────────────────
+
+// Raw chunk records are: u8 ApiTraceRecordType, u32 payload size, payload. The
+// payload already has the on-disk layout except for *ConstantsDelta, which the
+// hooks store as u16 start, u16 count, f32 values[count * 4].
+static constexpr size_t kRawRecordHeaderBytes = 1 + sizeof(uint32_t);
+
+static void PutBytes(std::vector<uint8_t>& out, const void* data, size_t size) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    out.insert(out.end(), bytes, bytes + size);
+}
+
+// The writer runs on a Win32 thread like the proxy's other workers; std::thread
+// is only used where there is no loader lock to worry about.
+struct ApiTraceWriterThread {
+#ifdef _WIN32
+    static DWORD WINAPI Run(LPVOID param) {
+        static_cast<ApiTraceRecorder*>(param)->WriterLoop();
+        return 0;
+    }
+#endif
+    static bool Start(ApiTraceRecorder* recorder) {
+#ifdef _WIN32
+        recorder->m_writer = CreateThread(nullptr, 0, Run, recorder, 0, nullptr);
+        return recorder->m_writer != nullptr;
+#else
+        recorder->m_writer = std::thread(&ApiTraceRecorder::WriterLoop, recorder);
+        return true;
+#endif
+    }
+    static void Join(ApiTraceRecorder* recorder) {
+#ifdef _WIN32
+        if (recorder->m_writer) {
+            WaitForSingleObject(static_cast<HANDLE>(recorder->m_writer), INFINITE);
+            CloseHandle(static_cast<HANDLE>(recorder->m_writer));
+            recorder->m_writer = nullptr;
+        }
+#else
+        if (recorder->m_writer.joinable()) {
+            recorder->m_writer.join();
+        }
+#endif
+    }
+};
+
+// ─── public ──────────────────────────────────────────────────────────────────
+
+ApiTraceRecorder::~ApiTraceRecorder() {
+#ifdef _WIN32
+    // By process exit the writer has already been terminated; only the handle is left.
+    if (m_writer) {
+        CloseHandle(static_cast<HANDLE>(m_writer));
+    }
+#else
+    Stop();
+#endif
+}
+
+bool ApiTraceRecorder::Start(const char* path) {
+    if (IsRecording() || !path) {
+        return false;
+    }
+    m_file = OpenBinaryFile(path, "wb");
+    if (!m_file) {
+        return false;
+    }
+    const ApiTraceFileHeader header;
+    std::fwrite(&header, sizeof(header), 1, m_file);
+
+    m_freeChunks.clear();
+    m_freeChunks.reserve(kChunkCount);
+    m_pendingChunks.clear();
+    m_pendingChunks.reserve(kChunkCount);
+    for (Chunk& chunk : m_chunks) {
+        if (chunk.data.size() != kChunkBytes) {
+            chunk.data.resize(kChunkBytes);
+        }
+        chunk.used = 0;
+        m_freeChunks.push_back(&chunk);
+    }
+    m_active = m_freeChunks.back();
+    m_freeChunks.pop_back();
+
+    for (StageEncoder& encoder : m_encoders) {
+        std::memset(encoder.shadow, 0, sizeof(encoder.shadow));
+        for (DictionaryEntry& entry : encoder.dictionary) {
+            entry.valid = false;
+        }
+        encoder.slotByHash.clear();
+        encoder.nextSlot = 0;
+    }
+    m_encoded.reserve(kChunkBytes * 2);
+
+    m_stats = ApiTraceStats{};
+    m_stats.fileBytes = sizeof(header);
+    m_stopRequested = false;
+    m_recording.store(true);
+    if (!ApiTraceWriterThread::Start(this)) {
+        m_recording.store(false);
+        std::fclose(m_file);
+        m_file = nullptr;
+        m_active = nullptr;
+        return false;
+    }
+    return true;
+}
+
+void ApiTraceRecorder::Stop() {
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (!IsRecording()) {
+            return;
+        }
+        m_recording.store(false);
+        if (m_active && m_active->used > 0) {
+            m_pendingChunks.push_back(m_active);
+            m_active = nullptr;
+        }
+        m_stopRequested = true;
+    }
+    m_chunkSubmitted.notify_one();
+    ApiTraceWriterThread::Join(this);
+    if (m_file) {
+        std::fclose(m_file);
+        m_file = nullptr;
+    }
+    m_active = nullptr;
+}
+
+ApiTraceStats ApiTraceRecorder::GetStats() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+void ApiTraceRecorder::RecordCreateVertexShader(uint32_t shaderId, const uint32_t* tokens, uint32_t tokenCount) {
+    const uint32_t header[2] = { shaderId, tokenCount };
+    Append(ApiTraceRecordType::CreateVertexShader, header, sizeof(header), tokens, tokenCount * sizeof(uint32_t));
+}
+
+void ApiTraceRecorder::RecordSetShader(ApiTraceStage stage, uint32_t shaderId) {
+    Append(stage == ApiTraceStage::Vertex ? ApiTraceRecordType::SetVertexShader : ApiTraceRecordType::SetPixelShader,
+           &shaderId, sizeof(shaderId));
+}
+
+void ApiTraceRecorder::RecordShaderConstantsF(ApiTraceStage stage, uint32_t startRegister,
+                                              const float* data, uint32_t vectorCount) {
+    if (!data || startRegister >= kApiTraceMaxRegisters) {
+        return;
+    }
+    if (vectorCount > kApiTraceMaxRegisters - startRegister) {
+        vectorCount = kApiTraceMaxRegisters - startRegister;
+    }
+    const uint16_t header[2] = { static_cast<uint16_t>(startRegister), static_cast<uint16_t>(vectorCount) };
+    Append(stage == ApiTraceStage::Vertex ? ApiTraceRecordType::VertexConstantsDelta : ApiTraceRecordType::PixelConstantsDelta,
+           header, sizeof(header), data, vectorCount * 4 * sizeof(float));
+}
+
+void ApiTraceRecorder::RecordSetTransform(uint32_t state, const float matrix[16]) {
+    Append(ApiTraceRecordType::SetTransform, &state, sizeof(state), matrix, 16 * sizeof(float));
+}
+
+void ApiTraceRecorder::RecordVertexDeclaration(const ApiTraceVertexElement* elements, uint32_t count) {
+    const uint16_t elementCount = static_cast<uint16_t>(count);
+    Append(ApiTraceRecordType::VertexDeclaration, &elementCount, sizeof(elementCount),
+           elements, count * sizeof(ApiTraceVertexElement));
+}
+
+void ApiTraceRecorder::RecordDraw(ApiTraceDrawKind kind, uint32_t primitiveType, uint32_t primitiveCount) {
+    uint8_t payload[6] = { static_cast<uint8_t>(kind), static_cast<uint8_t>(primitiveType) };
+    std::memcpy(&payload[2], &primitiveCount, sizeof(primitiveCount));
+    Append(ApiTraceRecordType::Draw, payload, sizeof(payload));
+}
+
+void ApiTraceRecorder::RecordPresent(uint32_t frame) {
+    Append(ApiTraceRecordType::Present, &frame, sizeof(frame));
+    // Hand the finished frame to the writer so an exit without Stop() loses at most the
+    // frame in progress.
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (IsRecording() && m_active && m_active->used > 0) {
+        SubmitActiveChunk(lock);
+    }
+}
+
+void ApiTraceRecorder::RecordBeginScene() {
+    Append(ApiTraceRecordType::BeginScene, nullptr, 0);
+}
+
+// ─── producer ────────────────────────────────────────────────────────────────
+
+void ApiTraceRecorder::Append(ApiTraceRecordType type, const void* a, size_t aSize, const void* b, size_t bSize) {
+    const size_t payloadSize = aSize + bSize;
+    const size_t recordSize = kRawRecordHeaderBytes + payloadSize;
+    if (recordSize > kChunkBytes) {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (!IsRecording()) {
+        return;
+    }
+    if (!m_active || m_active->used + recordSize > kChunkBytes) {
+        SubmitActiveChunk(lock);
+    }
+    uint8_t* out = m_active->data.data() + m_active->used;
+    const uint32_t size32 = static_cast<uint32_t>(payloadSize);
+    out[0] = static_cast<uint8_t>(type);
+    std::memcpy(out + 1, &size32, sizeof(size32));
+    if (aSize) std::memcpy(out + kRawRecordHeaderBytes, a, aSize);
+    if (bSize) std::memcpy(out + kRawRecordHeaderBytes + aSize, b, bSize);
+    m_active->used += recordSize;
+    m_stats.records++;
+    m_stats.rawBytes += recordSize;
+}
+
+void ApiTraceRecorder::SubmitActiveChunk(std::unique_lock<std::mutex>& lock) {
+    if (m_active) {
+        m_pendingChunks.push_back(m_active);
+        m_active = nullptr;
+        m_chunkSubmitted.notify_one();
+    }
+    if (m_freeChunks.empty()) {
+        m_stats.producerStalls++;
+        m_chunkReleased.wait(lock, [this]() { return !m_freeChunks.empty(); });
+    }
+    m_active = m_freeChunks.back();
+    m_freeChunks.pop_back();
+}
+
+// ─── writer thread ───────────────────────────────────────────────────────────
+
+void ApiTraceRecorder::WriterLoop() {
+    for (;;) {
+        Chunk* chunk = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_chunkSubmitted.wait(lock, [this]() { return m_stopRequested || !m_pendingChunks.empty(); });
+            if (m_pendingChunks.empty()) {
+                return;
+            }
+            chunk = m_pendingChunks.front();
+            m_pendingChunks.erase(m_pendingChunks.begin());
+        }
+
+        // Encoding touches only writer-thread state; the lock is retaken just to
+        // publish stats and hand the chunk back.
+        m_encoded.clear();
+        const uint64_t dictionaryHits = EncodeChunk(*chunk);
+        if (!m_encoded.empty()) {
+            std::fwrite(m_encoded.data(), 1, m_encoded.size(), m_file);
+            std::fflush(m_file);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stats.dictionaryHits += dictionaryHits;
+            m_stats.fileBytes += m_encoded.size();
+            chunk->used = 0;
+            m_freeChunks.push_back(chunk);
+        }
+        m_chunkReleased.notify_one();
+    }
+}
+
+uint64_t ApiTraceRecorder::EncodeChunk(const Chunk& chunk) {
+    uint64_t dictionaryHits = 0;
+    size_t offset = 0;
+    while (offset + kRawRecordHeaderBytes <= chunk.used) {
+        const uint8_t* record = chunk.data.data() + offset;
+        const ApiTraceRecordType type = static_cast<ApiTraceRecordType>(record[0]);
+        uint32_t payloadSize = 0;
+        std::memcpy(&payloadSize, record + 1, sizeof(payloadSize));
+        const uint8_t* payload = record + kRawRecordHeaderBytes;
+
+        if (type == ApiTraceRecordType::VertexConstantsDelta) {
+            dictionaryHits += EncodeConstants(ApiTraceStage::Vertex, payload) ? 1 : 0;
+        } else if (type == ApiTraceRecordType::PixelConstantsDelta) {
+            dictionaryHits += EncodeConstants(ApiTraceStage::Pixel, payload) ? 1 : 0;
+        } else {
+            m_encoded.push_back(static_cast<uint8_t>(type));
+            PutBytes(m_encoded, payload, payloadSize);
+        }
+        offset += kRawRecordHeaderBytes + payloadSize;
+    }
+    return dictionaryHits;
+}
+
+// Returns true when the upload was emitted as a dictionary reference.
+bool ApiTraceRecorder::EncodeConstants(ApiTraceStage stage, const uint8_t* payload) {
+    StageEncoder& encoder = m_encoders[static_cast<int>(stage)];
+    uint16_t startRegister = 0;
+    uint16_t count = 0;
+    std::memcpy(&startRegister, payload, sizeof(startRegister));
+    std::memcpy(&count, payload + 2, sizeof(count));
+    const uint8_t* valueBytes = payload + 4;
+    const size_t valueSize = static_cast<size_t>(count) * 4 * sizeof(float);
+    const uint64_t hash = FastHash64(payload, 4 + valueSize);
+
+    auto hit = encoder.slotByHash.find(hash);
+    if (hit != encoder.slotByHash.end()) {
+        const DictionaryEntry& entry = encoder.dictionary[hit->second];
+        if (entry.valid && entry.startRegister == startRegister && entry.count == count &&
+            std::memcmp(entry.values.data(), valueBytes, valueSize) == 0) {
+            const uint16_t slot = static_cast<uint16_t>(hit->second);
+            m_encoded.push_back(static_cast<uint8_t>(stage == ApiTraceStage::Vertex
+                                                         ? ApiTraceRecordType::VertexConstantsRef
+                                                         : ApiTraceRecordType::PixelConstantsRef));
+            PutBytes(m_encoded, &slot, sizeof(slot));
+            std::memcpy(encoder.shadow[startRegister], valueBytes, valueSize);
+            return true;
+        }
+    }
+
+    m_encoded.push_back(static_cast<uint8_t>(stage == ApiTraceStage::Vertex
+                                                 ? ApiTraceRecordType::VertexConstantsDelta
+                                                 : ApiTraceRecordType::PixelConstantsDelta));
+    PutBytes(m_encoded, &startRegister, sizeof(startRegister));
+    PutBytes(m_encoded, &count, sizeof(count));
+    for (uint16_t i = 0; i < count; ++i) {
+        float values[4];
+        std::memcpy(values, valueBytes + i * 4 * sizeof(float), sizeof(values));
+        float* shadow = encoder.shadow[startRegister + i];
+        uint8_t mask = 0;
+        for (int c = 0; c < 4; ++c) {
+            if (std::memcmp(&shadow[c], &values[c], sizeof(float)) != 0) {
+                mask |= static_cast<uint8_t>(1u << c);
+            }
+        }
+        m_encoded.push_back(mask);
+        for (int c = 0; c < 4; ++c) {
+            if (mask & (1u << c)) {
+                PutBytes(m_encoded, &values[c], sizeof(float));
+                shadow[c] = values[c];
+            }
+        }
+    }
+
+    const uint32_t slot = encoder.nextSlot++ % kApiTraceDictionarySize;
+    DictionaryEntry& entry = encoder.dictionary[slot];
+    if (entry.valid) {
+        auto previous = encoder.slotByHash.find(entry.hash);
+        if (previous != encoder.slotByHash.end() && previous->second == slot) {
+            encoder.slotByHash.erase(previous);
+        }
+    }
+    entry.valid = true;
+    entry.hash = hash;
+    entry.startRegister = startRegister;
+    entry.count = count;
+    entry.values.resize(static_cast<size_t>(count) * 4);
+    std::memcpy(entry.values.data(), valueBytes, valueSize);
+    encoder.slotByHash[hash] = slot;
+    return false;
+}
+
+// ─── reader ──────────────────────────────────────────────────────────────────
+
+ApiTraceReader::~ApiTraceReader() {
+    Close();
+}
+
+bool ApiTraceReader::Open(const char* path) {
+    Close();
+    if (!path) {
+        return false;
+    }
+    m_file = OpenBinaryFile(path, "rb");
+    if (!m_file) {
+        return false;
+    }
+    ApiTraceFileHeader header;
+    if (!Read(&header, sizeof(header)) || header.magic != kApiTraceMagic ||
+        header.version < 1 || header.version > kApiTraceVersion || header.dictionarySize != kApiTraceDictionarySize) {
+        Close();
+        return false;
+    }
+    for (StageDecoder& decoder : m_decoders) {
+        std::memset(decoder.shadow, 0, sizeof(decoder.shadow));
+        for (uint32_t slot = 0; slot < kApiTraceDictionarySize; ++slot) {
+            decoder.slotStart[slot] = 0;
+            decoder.slotCount[slot] = 0;
+            decoder.slotValues[slot].clear();
+        }
+        decoder.nextSlot = 0;
+    }
+    m_constants.reserve(kApiTraceMaxRegisters * 4);
+    m_error = false;
+    return true;
+}
+
+void ApiTraceReader::Close() {
+    if (m_file) {
+        std::fclose(m_file);
+        m_file = nullptr;
+    }
+}
+
+bool ApiTraceReader::Read(void* dst, size_t size) {
+    return size == 0 || (m_file && std::fread(dst, 1, size, m_file) == size);
+}
+
+bool ApiTraceReader::Next(ApiTraceEvent* out) {
+    if (!m_file || m_error || !out) {
+        return false;
+    }
+    uint8_t typeByte = 0;
+    if (!Read(&typeByte, sizeof(typeByte))) {
+        return false;
+    }
+    *out = ApiTraceEvent();
+    out->type = static_cast<ApiTraceRecordType>(typeByte);
+
+    bool ok = false;
+    switch (out->type) {
+    case ApiTraceRecordType::CreateVertexShader:
+        if (Read(&out->shaderId, sizeof(uint32_t)) && Read(&out->tokenCount, sizeof(uint32_t))) {
+            m_tokens.resize(out->tokenCount);
+            ok = Read(m_tokens.data(), out->tokenCount * sizeof(uint32_t));
+            out->tokens = m_tokens.data();
+        }
+        break;
+    case ApiTraceRecordType::SetVertexShader:
+    case ApiTraceRecordType::SetPixelShader:
+        out->stage = out->type == ApiTraceRecordType::SetVertexShader ? ApiTraceStage::Vertex : ApiTraceStage::Pixel;
+        ok = Read(&out->shaderId, sizeof(uint32_t));
+        break;
+    case ApiTraceRecordType::VertexConstantsDelta:
+        ok = DecodeConstantsDelta(ApiTraceStage::Vertex, out);
+        break;
+    case ApiTraceRecordType::PixelConstantsDelta:
+        ok = DecodeConstantsDelta(ApiTraceStage::Pixel, out);
+        break;
+    case ApiTraceRecordType::VertexConstantsRef:
+        ok = DecodeConstantsRef(ApiTraceStage::Vertex, out);
+        break;
+    case ApiTraceRecordType::PixelConstantsRef:
+        ok = DecodeConstantsRef(ApiTraceStage::Pixel, out);
+        break;
+    case ApiTraceRecordType::SetTransform:
+        ok = Read(&out->transformState, sizeof(uint32_t)) && Read(out->matrix, sizeof(out->matrix));
+        break;
+    case ApiTraceRecordType::VertexDeclaration: {
+        uint16_t count = 0;
+        if (Read(&count, sizeof(count))) {
+            m_elements.resize(count);
+            ok = Read(m_elements.data(), count * sizeof(ApiTraceVertexElement));
+            out->elements = m_elements.data();
+            out->elementCount = count;
+        }
+        break;
+    }
+    case ApiTraceRecordType::Draw: {
+        uint8_t header[2] = {};
+        if (Read(header, sizeof(header)) && Read(&out->primitiveCount, sizeof(uint32_t))) {
+            out->drawKind = static_cast<ApiTraceDrawKind>(header[0]);
+            out->primitiveType = header[1];
+            ok = true;
+        }
+        break;
+    }
+    case ApiTraceRecordType::Present:
+        ok = Read(&out->frame, sizeof(uint32_t));
+        break;
+    case ApiTraceRecordType::BeginScene:
+        ok = true;
+        break;
+    default:
+        break;
+    }
+    if (!ok) {
+        m_error = true;
+    }
+    return ok;
+}
+
+bool ApiTraceReader::DecodeConstantsDelta(ApiTraceStage stage, ApiTraceEvent* out) {
+    StageDecoder& decoder = m_decoders[static_cast<int>(stage)];
+    uint16_t startRegister = 0;
+    uint16_t count = 0;
+    if (!Read(&startRegister, sizeof(startRegister)) || !Read(&count, sizeof(count)) ||
+        static_cast<uint32_t>(startRegister) + count > kApiTraceMaxRegisters) {
+        return false;
+    }
+    for (uint16_t i = 0; i < count; ++i) {
+        uint8_t mask = 0;
+        if (!Read(&mask, sizeof(mask))) {
+            return false;
+        }
+        float* shadow = decoder.shadow[startRegister + i];
+        for (int c = 0; c < 4; ++c) {
+            if ((mask & (1u << c)) && !Read(&shadow[c], sizeof(float))) {
+                return false;
+            }
+        }
+    }
+
+    const uint32_t slot = decoder.nextSlot++ % kApiTraceDictionarySize;
+    decoder.slotStart[slot] = startRegister;
+    decoder.slotCount[slot] = count;
+    decoder.slotValues[slot].assign(&decoder.shadow[startRegister][0], &decoder.shadow[startRegister][0] + count * 4);
+
+    m_constants.assign(decoder.slotValues[slot].begin(), decoder.slotValues[slot].end());
+    out->stage = stage;
+    out->startRegister = startRegister;
+    out->vectorCount = count;
+    out->constants = m_constants.data();
+    return true;
+}
+
+bool ApiTraceReader::DecodeConstantsRef(ApiTraceStage stage, ApiTraceEvent* out) {
+    StageDecoder& decoder = m_decoders[static_cast<int>(stage)];
+    uint16_t slot = 0;
+    if (!Read(&slot, sizeof(slot)) || slot >= kApiTraceDictionarySize) {
+        return false;
+    }
+    const uint16_t startRegister = decoder.slotStart[slot];
+    const uint16_t count = decoder.slotCount[slot];
+    if (decoder.slotValues[slot].size() != static_cast<size_t>(count) * 4) {
+        return false;
+    }
+    std::memcpy(decoder.shadow[startRegister], decoder.slotValues[slot].data(), count * 4 * sizeof(float));
+
+    m_constants.assign(decoder.slotValues[slot].begin(), decoder.slotValues[slot].end());
+    out->stage = stage;
+    out->startRegister = startRegister;
+    out->vectorCount = count;
+    out->constants = m_constants.data();
+    return true;
+}
@@ -0,0 +1,233 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#ifndef _WIN32
+#include <thread>
+#endif
+#include <unordered_map>
+#include <vector>
+
+// ─── File format ─────────────────────────────────────────────────────────────
+//
+// A .cpat file is an ApiTraceFileHeader followed by a stream of records. Every
+// record starts with one ApiTraceRecordType byte; all integers and floats are
+// little-endian. This header has no Windows/D3D dependencies so offline tools
+// can share it.
+//
+//   CreateVertexShader   u32 shaderId, u32 dwordCount, u32 tokens[dwordCount]
+//   SetVertexShader      u32 shaderId (0 = none)
+//   SetPixelShader       u32 shaderId (0 = none)
+//   *ConstantsDelta      u16 startRegister, u16 count, then per register one
+//                        change mask byte (bit i = component i differs from the
+//                        previous value of that register) followed by the
+//                        changed components as f32.
+//   *ConstantsRef        u16 dictionary slot; replays the payload stored there.
+//   SetTransform         u32 D3DTRANSFORMSTATETYPE, f32 matrix[16]
+//   VertexDeclaration    u16 elementCount, ApiTraceVertexElement[elementCount]
+//   Draw                 u8 ApiTraceDrawKind, u8 primitiveType, u32 primitiveCount
+//   Present              u32 frame
+//   BeginScene           no payload (version 2)
+//
+// Constant dictionary: every *ConstantsDelta record stores its decoded payload
+// (start, count, values) in slot (deltaRecordIndex % dictionarySize) of its
+// stage's dictionary. Writers and readers advance that index identically, so a
+// repeated upload (skinning palettes, per-object blocks) costs three bytes.
+
+static constexpr uint32_t kApiTraceMagic = 0x54415043u; // "CPAT"
+// Version 1 files (no BeginScene records) are still read.
+static constexpr uint32_t kApiTraceVersion = 2;
+static constexpr uint32_t kApiTraceDictionarySize = 256;
+static constexpr uint32_t kApiTraceMaxRegisters = 256;
+
+struct ApiTraceFileHeader {
+    uint32_t magic          = kApiTraceMagic;
+    uint32_t version        = kApiTraceVersion;
+    uint32_t dictionarySize = kApiTraceDictionarySize;
+    uint32_t reserved       = 0;
+};
+
+enum class ApiTraceRecordType : uint8_t {
+    CreateVertexShader = 1,
+    SetVertexShader,
+    SetPixelShader,
+    VertexConstantsDelta,
+    PixelConstantsDelta,
+    VertexConstantsRef,
+    PixelConstantsRef,
+    SetTransform,
+    VertexDeclaration,
+    Draw,
+    Present,
+    BeginScene
+};
+
+enum class ApiTraceStage : uint8_t { Vertex = 0, Pixel = 1 };
+
+enum class ApiTraceDrawKind : uint8_t {
+    DrawPrimitive = 0,
+    DrawIndexedPrimitive,
+    DrawPrimitiveUP,
+    DrawIndexedPrimitiveUP
+};
+
+// Same field order and widths as D3DVERTEXELEMENT9.
+#pragma pack(push, 1)
+struct ApiTraceVertexElement {
+    uint16_t stream;
+    uint16_t offset;
+    uint8_t  type;
+    uint8_t  method;
+    uint8_t  usage;
+    uint8_t  usageIndex;
+};
+#pragma pack(pop)
+
+// ─── Recorder ────────────────────────────────────────────────────────────────
+
+struct ApiTraceStats {
+    uint64_t records       = 0;
+    uint64_t rawBytes      = 0;   // bytes handed over by the device hooks
+    uint64_t fileBytes     = 0;   // encoded bytes written to disk
+    uint64_t dictionaryHits = 0;
+    uint64_t producerStalls = 0;  // hook calls that waited for a free chunk
+};
+
+// Device hooks append raw records into preallocated chunks; a background thread
+// delta/dictionary-encodes them and writes the file. Chunks are only allocated
+// in Start(), so recording adds no heap traffic to the hooked calls. Every
+// Present hands its frame to the writer, so the file on disk always ends at a
+// completed frame.
+class ApiTraceRecorder {
+public:
+    // On Windows this does not stop the writer: a static recorder is destroyed
+    // under the loader lock, where joining a thread deadlocks. Call Stop() first.
+    ~ApiTraceRecorder();
+
+    bool Start(const char* path);
+    // Flushes everything recorded so far and closes the file.
+    void Stop();
+    bool IsRecording() const { return m_recording.load(std::memory_order_relaxed); }
+    ApiTraceStats GetStats();
+
+    void RecordCreateVertexShader(uint32_t shaderId, const uint32_t* tokens, uint32_t tokenCount);
+    void RecordSetShader(ApiTraceStage stage, uint32_t shaderId);
+    void RecordShaderConstantsF(ApiTraceStage stage, uint32_t startRegister,
+                                const float* data, uint32_t vectorCount);
+    void RecordSetTransform(uint32_t state, const float matrix[16]);
+    void RecordVertexDeclaration(const ApiTraceVertexElement* elements, uint32_t count);
+    void RecordDraw(ApiTraceDrawKind kind, uint32_t primitiveType, uint32_t primitiveCount);
+    void RecordPresent(uint32_t frame);
+    void RecordBeginScene();
+
+private:
+    struct Chunk {
+        std::vector<uint8_t> data;
+        size_t used = 0;
+    };
+
+    struct DictionaryEntry {
+        bool     valid = false;
+        uint64_t hash  = 0;
+        uint16_t startRegister = 0;
+        uint16_t count = 0;
+        std::vector<float> values;
+    };
+
+    struct StageEncoder {
+        float shadow[kApiTraceMaxRegisters][4] = {};
+        DictionaryEntry dictionary[kApiTraceDictionarySize];
+        std::unordered_map<uint64_t, uint32_t> slotByHash;
+        uint32_t nextSlot = 0;
+    };
+
+    friend struct ApiTraceWriterThread;
+
+    void Append(ApiTraceRecordType type, const void* a, size_t aSize, const void* b = nullptr, size_t bSize = 0);
+    void SubmitActiveChunk(std::unique_lock<std::mutex>& lock);
+    void WriterLoop();
+    uint64_t EncodeChunk(const Chunk& chunk);
+    bool EncodeConstants(ApiTraceStage stage, const uint8_t* payload);
+
+    static constexpr size_t kChunkBytes = 1u << 20;
+    static constexpr size_t kChunkCount = 8;
+
+    std::mutex m_mutex;
+    std::condition_variable m_chunkSubmitted;
+    std::condition_variable m_chunkReleased;
+    Chunk m_chunks[kChunkCount];
+    std::vector<Chunk*> m_freeChunks;
+    std::vector<Chunk*> m_pendingChunks;
+    Chunk* m_active = nullptr;
+#ifdef _WIN32
+    void* m_writer = nullptr; // thread HANDLE; windows.h stays out of this header
+#else
+    std::thread m_writer;
+#endif
+    bool m_stopRequested = false;
+    std::atomic<bool> m_recording{false};
+    FILE* m_file = nullptr;
+    ApiTraceStats m_stats;
+
+    // Writer-thread state.
+    StageEncoder m_encoders[2];
+    std::vector<uint8_t> m_encoded;
+};
+
+// ─── Reader ──────────────────────────────────────────────────────────────────
+
+// One decoded record. Pointers stay valid until the next ApiTraceReader::Next().
+// Constant records (delta or dictionary reference) always carry the full values
+// of every uploaded register.
+struct ApiTraceEvent {
+    ApiTraceRecordType type = ApiTraceRecordType::Present;
+    ApiTraceStage stage = ApiTraceStage::Vertex;
+    uint32_t shaderId = 0;
+    uint32_t startRegister = 0;
+    uint32_t vectorCount = 0;
+    const float* constants = nullptr;
+    const uint32_t* tokens = nullptr;
+    uint32_t tokenCount = 0;
+    uint32_t transformState = 0;
+    float matrix[16] = {};
+    const ApiTraceVertexElement* elements = nullptr;
+    uint32_t elementCount = 0;
+    ApiTraceDrawKind drawKind = ApiTraceDrawKind::DrawPrimitive;
+    uint32_t primitiveType = 0;
+    uint32_t primitiveCount = 0;
+    uint32_t frame = 0;
+};
+
+class ApiTraceReader {
+public:
+    ~ApiTraceReader();
+
+    bool Open(const char* path);
+    void Close();
+    // Returns false at end of file or on a malformed record; HadError() tells which.
+    bool Next(ApiTraceEvent* out);
+    bool HadError() const { return m_error; }
+
+private:
+    struct StageDecoder {
+        float shadow[kApiTraceMaxRegisters][4] = {};
+        uint16_t slotStart[kApiTraceDictionarySize] = {};
+        uint16_t slotCount[kApiTraceDictionarySize] = {};
+        std::vector<float> slotValues[kApiTraceDictionarySize];
+        uint32_t nextSlot = 0;
+    };
+
+    bool Read(void* dst, size_t size);
+    bool DecodeConstantsDelta(ApiTraceStage stage, ApiTraceEvent* out);
+    bool DecodeConstantsRef(ApiTraceStage stage, ApiTraceEvent* out);
+
+    FILE* m_file = nullptr;
+    bool m_error = false;
+    StageDecoder m_decoders[2];
+    std::vector<float> m_constants;
+    std::vector<uint32_t> m_tokens;
+    std::vector<ApiTraceVertexElement> m_elements;
+};
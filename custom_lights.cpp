@@ -1,4 +1,6 @@
 #include "custom_lights.h"
+#include "fast_hash.h"
+#include "matrix_kernels.h"
 #include "remix_api.h"
 #include "remix_logger.h"
 
@@ -9,25 +11,15 @@
 // ─── internal helpers ─────────────────────────────────────────────────────────
 
 void CustomLightsManager::NormalizeInPlace(float v[3]) {
-    float len = sqrtf(v[0]*v[0] + v[1]*v[1] + v[2]*v[2]);
-    if (len > 1e-6f) { v[0] /= len; v[1] /= len; v[2] /= len; }
+    matrix_kernels::Normalize3(v);
 }
 
 void CustomLightsManager::Cross3(const float a[3], const float b[3], float out[3]) {
-    out[0] = a[1]*b[2] - a[2]*b[1];
-    out[1] = a[2]*b[0] - a[0]*b[2];
-    out[2] = a[0]*b[1] - a[1]*b[0];
+    matrix_kernels::Cross3(a, b, out);
 }
 
 uint64_t CustomLightsManager::ComputeStableHash(uint32_t id) {
-    // FNV-1a over the 4 bytes of id
-    uint64_t h = 14695981039346656037ull;
-    const uint8_t* p = reinterpret_cast<const uint8_t*>(&id);
-    for (int i = 0; i < 4; ++i) {
-        h ^= static_cast<uint64_t>(p[i]);
-        h *= 1099511628211ull;
-    }
-    return h;
+    return FastHash64(&id, sizeof(id));
 }
 
 // ─── public ───────────────────────────────────────────────────────────────────
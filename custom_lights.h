@@ -99,7 +99,7 @@ struct CustomLight {
 
     // ── Runtime (not saved) ───────────────────────────────────────────────────
     remixapi_LightHandle nativeHandle = nullptr;
-    uint64_t             stableHash   = 0; // FNV-1a over id, set once at creation
+    uint64_t             stableHash   = 0; // FastHash64 of id, set once at creation
 };
 
 struct CameraState {
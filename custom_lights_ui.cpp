@@ -1,5 +1,6 @@
 #include "custom_lights_ui.h"
 #include "custom_lights.h"
+#include "matrix_kernels.h"
 #include "remix_api.h"
 #include "imgui/imgui.h"
 
@@ -18,11 +19,6 @@ static const char* TypeLabel(CustomLightType t) {
     return "Sphere";
 }
 
-static void NormalizeUI(float v[3]) {
-    float len = sqrtf(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
-    if (len > 1e-6f) { v[0] /= len; v[1] /= len; v[2] /= len; }
-}
-
 void DrawCustomLightsTab(CustomLightsManager& manager) {
     static uint32_t selectedId = 0;
     static char filePath[MAX_PATH] = "custom_lights.cltx";
@@ -118,13 +114,13 @@ void DrawCustomLightsTab(CustomLightsManager& manager) {
             PopOverlayBoldFont();
             if (t == 0 || t == 3) if (ImGui::SliderFloat("Radius", &l.radius, 0.001f, 100000.0f, "%.3f", ImGuiSliderFlags_Logarithmic)) l.dirty = true;
             if (t == 1 || t == 2) {
-                if (ImGui::InputFloat3("X Axis", l.xAxis, "%.3f")) { NormalizeUI(l.xAxis); l.dirty = true; }
-                if (ImGui::InputFloat3("Y Axis", l.yAxis, "%.3f")) { NormalizeUI(l.yAxis); l.dirty = true; }
+                if (ImGui::InputFloat3("X Axis", l.xAxis, "%.3f")) { matrix_kernels::Normalize3(l.xAxis); l.dirty = true; }
+                if (ImGui::InputFloat3("Y Axis", l.yAxis, "%.3f")) { matrix_kernels::Normalize3(l.yAxis); l.dirty = true; }
             }
             if (t == 1) { if (ImGui::SliderFloat("X Size", &l.xSize, 0.001f, 100000.0f, "%.3f", ImGuiSliderFlags_Logarithmic)) l.dirty = true; if (ImGui::SliderFloat("Y Size", &l.ySize, 0.001f, 100000.0f, "%.3f", ImGuiSliderFlags_Logarithmic)) l.dirty = true; }
             if (t == 2) { if (ImGui::SliderFloat("X Radius", &l.xRadius, 0.001f, 100000.0f, "%.3f", ImGuiSliderFlags_Logarithmic)) l.dirty = true; if (ImGui::SliderFloat("Y Radius", &l.yRadius, 0.001f, 100000.0f, "%.3f", ImGuiSliderFlags_Logarithmic)) l.dirty = true; }
-            if (t == 3) { if (ImGui::InputFloat3("Axis", l.axis, "%.3f")) { NormalizeUI(l.axis); l.dirty = true; } if (ImGui::SliderFloat("Axis Length", &l.axisLength, 0.001f, 100000.0f, "%.3f", ImGuiSliderFlags_Logarithmic)) l.dirty = true; }
-            if (t == 4) { if (ImGui::InputFloat3("Direction", l.direction, "%.3f")) { NormalizeUI(l.direction); l.dirty = true; } if (ImGui::SliderFloat("Angular Diameter", &l.angularDiameterDegrees, 0.1f, 90.0f, "%.3f")) l.dirty = true; }
+            if (t == 3) { if (ImGui::InputFloat3("Axis", l.axis, "%.3f")) { matrix_kernels::Normalize3(l.axis); l.dirty = true; } if (ImGui::SliderFloat("Axis Length", &l.axisLength, 0.001f, 100000.0f, "%.3f", ImGuiSliderFlags_Logarithmic)) l.dirty = true; }
+            if (t == 4) { if (ImGui::InputFloat3("Direction", l.direction, "%.3f")) { matrix_kernels::Normalize3(l.direction); l.dirty = true; } if (ImGui::SliderFloat("Angular Diameter", &l.angularDiameterDegrees, 0.1f, 90.0f, "%.3f")) l.dirty = true; }
             if (t == 5) { if (ImGui::InputText("Texture Path", l.domeTexturePath, MAX_PATH)) l.dirty = true; }
         } else { PopOverlayBoldFont(); }
 
@@ -134,7 +130,7 @@ void DrawCustomLightsTab(CustomLightsManager& manager) {
             PopOverlayBoldFont();
             if (ImGui::Checkbox("Enable", &l.shaping.enabled)) l.dirty = true;
             if (l.shaping.enabled) {
-                if (ImGui::InputFloat3("Direction", l.shaping.direction, "%.3f")) { NormalizeUI(l.shaping.direction); l.dirty = true; }
+                if (ImGui::InputFloat3("Direction", l.shaping.direction, "%.3f")) { matrix_kernels::Normalize3(l.shaping.direction); l.dirty = true; }
                 if (ImGui::SliderFloat("Cone Angle", &l.shaping.coneAngleDegrees, 1.0f, 179.0f, "%.2f")) l.dirty = true;
             }
         } else { PopOverlayBoldFont(); }
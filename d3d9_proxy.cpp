@@ -25,18 +25,33 @@
 #include <string>
 #include <algorithm>
 #include <cstdlib>
-#include <deque>
+#include <memory>
 #include <limits>
 #include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <atomic>
+#include <new>
 #include <cassert>
-#include <sstream>
 #include <fstream>
 #include <filesystem>
 #include <array>
 #include <cctype>
 #include <cstdint>
 #include <cstring>
-
+#include <cfloat>
+#include <intrin.h>
+
+// Build with /DCAMERA_PROXY_METHOD_TIMING=0 to compile the per-method timing and
+// frame trace scopes out.
+#ifndef CAMERA_PROXY_METHOD_TIMING
+#define CAMERA_PROXY_METHOD_TIMING 1
+#endif
+// Build with /DCAMERA_PROXY_ALLOCATION_PROBE=1 to replace the global operator new and
+// count heap allocations on the constant upload path (diagnostic builds only).
+#ifndef CAMERA_PROXY_ALLOCATION_PROBE
+#define CAMERA_PROXY_ALLOCATION_PROBE 0
+#endif
 #define IMGUI_IMPL_WIN32_DISABLE_GAMEPAD
 #define IMGUI_DEFINE_MATH_OPERATORS
 
@@ -48,6 +63,14 @@
 #include "custom_lights.h"
 #include "custom_lights_ui.h"
 #include "remix_api.h"
+#include "api_trace.h"
+#include "fast_hash.h"
+#include "golden_output.h"
+#include "seqlock.h"
+#include "matrix_engine.h"
+#include "shader_bytecode.h"
+#include "shader_cache.h"
+#include "shader_dataflow.h"
 
 extern IMGUI_IMPL_API LRESULT ImGui_ImplWin32_WndProcHandler(HWND hWnd,
                                                              UINT msg,
@@ -60,27 +83,39 @@ static bool LooksLikeViewStrict(const D3DMATRIX& m);
 static bool LooksLikeProjectionStrict(const D3DMATRIX& m);
 float ExtractFOV(const D3DMATRIX& proj);
 
-static float Dot3(float ax, float ay, float az, float bx, float by, float bz);
 static void CopyFilenameFromPath(const char* fullPath, char* outName, size_t outNameSize);
 static bool TryReadFileDescription(const char* exePath, char* outDescription, size_t outDescriptionSize);
 
-enum ProjectionHandedness {
-    ProjectionHandedness_Unknown = 0,
-    ProjectionHandedness_Left,
-    ProjectionHandedness_Right
-};
+// The extraction math lives in matrix_engine.cpp; EngineMatrix has D3DMATRIX's layout.
+static_assert(sizeof(EngineMatrix) == sizeof(D3DMATRIX), "EngineMatrix must alias D3DMATRIX");
+
+static inline const EngineMatrix& AsEngineMatrix(const D3DMATRIX& m) {
+    return *reinterpret_cast<const EngineMatrix*>(&m);
+}
+
+static inline const EngineMatrix* AsEngineMatrix(const D3DMATRIX* m) {
+    return reinterpret_cast<const EngineMatrix*>(m);
+}
+
+static inline EngineMatrix* AsEngineMatrix(D3DMATRIX* m) {
+    return reinterpret_cast<EngineMatrix*>(m);
+}
+
+static inline const D3DMATRIX* AsD3DMatrix(const EngineMatrix* m) {
+    return reinterpret_cast<const D3DMATRIX*>(m);
+}
+
+static inline D3DMATRIX ToD3DMatrix(const EngineMatrix& m) {
+    D3DMATRIX out;
+    memcpy(&out, &m, sizeof(out));
+    return out;
+}
 
 enum CustomProjectionMode {
     CustomProjectionMode_Manual = 1,
     CustomProjectionMode_Auto = 2
 };
 
-struct ProjectionAnalysis {
-    bool valid = false;
-    float fovRadians = 0.0f;
-    ProjectionHandedness handedness = ProjectionHandedness_Unknown;
-};
-
 static bool AnalyzeProjectionMatrixNumeric(const D3DMATRIX& m, ProjectionAnalysis* out);
 static const char* ProjectionHandednessLabel(ProjectionHandedness handedness);
 static bool InvertMatrix4x4Deterministic(const D3DMATRIX& in, D3DMATRIX* out, float* outDeterminant = nullptr);
@@ -127,10 +162,22 @@ struct ProxyConfig {
     int hotkeyTogglePauseVk = VK_F9;
     int hotkeyEmitMatricesVk = VK_F8;
     int hotkeyResetMatrixOverridesVk = VK_F7;
+    int hotkeyCaptureTraceVk = VK_F6;
+    int traceCaptureFrames = 3;
+    bool apiTraceRecordGolden = true;
 
     bool enableCombinedDecomposition = true;
     bool combinedDecompositionLog = false;
     bool allowGeneratedProjectionForVPDecomposition = false;
+    bool enableLayoutFastPath = true;
+    int layoutLearnFrames = 30;
+    bool enableSimdWindowPrefilter = true;
+    bool deferConstantClassification = false;
+    bool shaderTransformMap = true;
+    int shaderAnalysisThreads = 2;
+    bool shaderCache = true;
+    bool suppressRedundantTransforms = true;
+    bool trackConstantVariance = false;
 
     bool experimentalCustomProjectionEnabled = false;
     CustomProjectionMode experimentalCustomProjectionMode = CustomProjectionMode_Auto;
@@ -173,43 +220,10 @@ struct RasterBlendVertex {
 
 static constexpr DWORD kRasterBlendFVF = D3DFVF_XYZRHW | D3DFVF_TEX2;
 
-struct CombinedDecompositionDebugState {
-    bool attempted = false;
-    bool solvedWorld = false;
-    bool solvedView = false;
-    bool solvedProjection = false;
-    char worldFormula[160] = {};
-    char viewFormula[160] = {};
-    char projectionFormula[160] = {};
-};
-
-enum GameProfileKind {
-    GameProfile_None = 0,
-    GameProfile_MetalGearRising,
-    GameProfile_DevilMayCry4,
-    GameProfile_Barnyard
-};
-
-struct RegisterLayoutProfile {
-    int combinedMvpBase = -1;
-    int projectionBase = -1;
-    int viewInverseBase = -1;
-    int worldBase = -1;
-    int viewProjectionBase = -1;
-    int worldViewBase = -1;
-};
-
 static GameProfileKind g_activeGameProfile = GameProfile_None;
-static RegisterLayoutProfile g_profileLayout = {};
-static bool g_profileViewDerivedFromInverse = false;
-static bool g_profileCoreRegistersSeen[3] = { false, false, false }; // proj, viewInv, world
-static bool g_profileOptionalRegistersSeen[2] = { false, false }; // VP, WV
+// The device engine's profile progress, copied once per frame for the overlay.
+static EngineProfileState g_profileState = {};
 static char g_profileStatusMessage[256] = "";
-static bool g_profileDisableStructuralDetection = false;
-static bool g_mgrProjCapturedThisFrame = false;
-static bool g_mgrViewCapturedThisFrame = false;
-static bool g_mgrWorldCapturedForDraw = false;
-static bool g_mgrProjectionRegisterValid = false;
 static bool g_barnyardForceWorldFromC0 = false;
 
 static ProxyConfig g_config;
@@ -270,16 +284,42 @@ struct MatrixSourceInfo {
 
 static CameraMatrices g_cameraMatrices = {};
 static MatrixSourceInfo g_matrixSources[MatrixSlot_Count] = {};
-static std::mutex g_cameraMatricesMutex;
+// Bumped by every Store*Matrix so consumers can tell whether a slot changed.
+static uint32_t g_matrixSlotGenerations[MatrixSlot_Count] = {};
+// g_cameraMatrices, g_matrixSources and g_matrixSlotGenerations are published through a
+// seqlock (seqlock.h); readers never block the render thread. Every write to them goes
+// through WriteCameraMatrices, and a slot's matrix, generation and source change together.
+static SeqLock g_cameraMatricesLock;
+
+template <typename WriteFn>
+static void WriteCameraMatrices(WriteFn&& write) {
+    g_cameraMatricesLock.Write(write);
+}
+
+template <typename ReadFn>
+static void ReadCameraMatrices(ReadFn&& read) {
+    g_cameraMatricesLock.Read(read);
+}
+
+static CameraMatrices SnapshotCameraMatrices() {
+    CameraMatrices snapshot = {};
+    ReadCameraMatrices([&]() { snapshot = g_cameraMatrices; });
+    return snapshot;
+}
+
+static MatrixSourceInfo SnapshotMatrixSource(MatrixSlot slot) {
+    MatrixSourceInfo source = {};
+    ReadCameraMatrices([&]() { source = g_matrixSources[slot]; });
+    return source;
+}
 static ManualMatrixBinding g_manualBindings[MatrixSlot_Count] = {};
-static void UpdateMatrixSource(MatrixSlot slot,
-                               uintptr_t shaderKey,
-                               int baseRegister,
-                               int rows,
-                               bool transposed,
-                               bool manual,
-                               const char* sourceLabel = nullptr,
-                               int extractedFromRegister = -1);
+static MatrixSourceInfo BuildMatrixSource(uintptr_t shaderKey,
+                                          int baseRegister,
+                                          int rows,
+                                          bool transposed,
+                                          bool manual,
+                                          const char* sourceLabel,
+                                          int extractedFromRegister);
 
 static bool g_imguiInitialized = false;
 static HWND g_imguiHwnd = nullptr;
@@ -327,6 +367,58 @@ static float g_projectionDetectedFovRadians = 0.0f;
 static int g_projectionDetectedRegister = -1;
 static ProjectionHandedness g_projectionDetectedHandedness = ProjectionHandedness_Unknown;
 static CombinedDecompositionDebugState g_combinedDecompDebug = {};
+#if CAMERA_PROXY_ALLOCATION_PROBE
+// Heap allocations made by this module on the calling thread. The replacement global
+// operator new below only affects code linked into the proxy DLL.
+static thread_local unsigned long long t_heapAllocations = 0;
+static unsigned long long g_uploadPathCallsThisFrame = 0;
+static unsigned long long g_uploadPathAllocatingCallsThisFrame = 0;
+static unsigned long long g_uploadPathAllocationsThisFrame = 0;
+static unsigned long long g_uploadPathCallsLastFrame = 0;
+static unsigned long long g_uploadPathAllocatingCallsLastFrame = 0;
+static unsigned long long g_uploadPathAllocationsLastFrame = 0;
+
+void* operator new(std::size_t size) {
+    ++t_heapAllocations;
+    if (void* p = malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    free(p);
+}
+
+// Scoped around the upload -> classify -> forward path; any heap allocation inside it is
+// reported in the overlay so steady-state regressions are visible.
+struct UploadAllocationProbe {
+    unsigned long long startAllocations = t_heapAllocations;
+    ~UploadAllocationProbe() {
+        const unsigned long long allocations = t_heapAllocations - startAllocations;
+        g_uploadPathCallsThisFrame++;
+        if (allocations > 0) {
+            g_uploadPathAllocatingCallsThisFrame++;
+            g_uploadPathAllocationsThisFrame += allocations;
+        }
+    }
+};
+#define UPLOAD_ALLOCATION_PROBE() const UploadAllocationProbe allocationProbe
+#else
+#define UPLOAD_ALLOCATION_PROBE() ((void)0)
+#endif
+
+// Bumped whenever device transform state may have changed behind the proxy's back
+// (state block Apply/record, Reset); drops the draw-time redundant SetTransform cache.
+static uint32_t g_fixedFunctionTransformEpoch = 0;
+static unsigned long long g_setTransformEmittedThisFrame = 0;
+static unsigned long long g_setTransformSuppressedThisFrame = 0;
+static unsigned long long g_setTransformEmittedLastFrame = 0;
+static unsigned long long g_setTransformSuppressedLastFrame = 0;
+static int g_combinedDecompRunsThisFrame = 0;
+static int g_combinedDecompSkipsThisFrame = 0;
+static int g_combinedDecompRunsLastFrame = 0;
+static int g_combinedDecompSkipsLastFrame = 0;
 static char g_customProjectionStatus[256] = "";
 static bool g_gameSetTransformSeen[3] = { false, false, false }; // world, view, projection
 static bool g_gameSetTransformAnySeen = false;
@@ -340,6 +432,7 @@ enum HotkeyAction {
     HotkeyAction_TogglePause,
     HotkeyAction_EmitMatrices,
     HotkeyAction_ResetMatrixOverrides,
+    HotkeyAction_CaptureTrace,
     HotkeyAction_Count
 };
 
@@ -372,7 +465,7 @@ static bool g_constantUploadRecordingEnabled = false;
 static bool g_probeInverseView = true;
 static int g_overrideScopeMode = Override_Sticky;
 static int g_overrideNFrames = 3;
-static std::unordered_map<uintptr_t, uint32_t> g_shaderBytecodeHashes = {};
+static std::unordered_map<uintptr_t, uint64_t> g_shaderBytecodeHashes = {};
 
 enum ShaderStageType {
     ShaderStage_Vertex = 0,
@@ -387,27 +480,33 @@ struct VertexDeclSemanticInfo {
     int texcoordCount = 0;
 };
 
-struct ShaderIrInstruction {
-    std::string opcode;
-    std::string dst;
-    std::vector<std::string> src;
-    int dstWriteMask = 0;
-};
-
 struct ShaderRecord {
     uintptr_t shaderKey = 0;
     ShaderStageType stage = ShaderStage_Vertex;
     std::vector<uint32_t> originalBytecode = {};
     std::vector<uint32_t> modifiedBytecode = {};
-    uint32_t hash = 0;
+    uint64_t hash = 0;
     std::string shaderModel = "unknown";
-    std::vector<ShaderIrInstruction> ir = {};
+    // Decoded from originalBytecode; empty when decoding failed or the analysis came
+    // from the shader cache.
+    std::vector<ShaderInstruction> ir = {};
+    int instructionCount = 0;
+    // Position dataflow: which constant matrices feed oPos, in which role.
+    ShaderTransformMap transformMap = {};
+    // Set once the analysis below has been applied. Until then every field keeps its
+    // default, which the draw path already treats as "unknown shader".
+    bool analysed = false;
+    // Matches the queued analysis job, so a result never lands on a record that was
+    // released and re-created under the same key.
+    uint64_t analysisTicket = 0;
     bool isFFPTransform = false;
     bool isFFPLighting = false;
     bool usesSkinning = false;
     bool usesFlowControl = false;
     bool isRemixSafe = false;
     int transformConstantBase = -1;
+    // The transform matrix is read by a mul/mad column chain (see ShaderMatrixUse).
+    bool transformTransposed = false;
     int lightingConstantBase = -1;
     int lightDirectionRegister = -1;
     int lightColorRegister = -1;
@@ -427,16 +526,21 @@ struct ShaderRecord {
     LightingSpace lightSpaceOverride = LightingSpace::Auto;
 
     bool constantUsage[kMaxConstantRegisters] = {};
+    // Registers read by the bytecode only; constantUsage also accumulates uploads.
+    bool constantReads[kMaxConstantRegisters] = {};
+    bool constantReadsKnown = false;
     unsigned long long usageCount = 0;
     IUnknown* replacementShader = nullptr;
     bool replacementEnabled = false;
+    // D3DDisassemble text, built on first use by the shader browser.
     std::string cachedDisassembly = {};
+    bool disassemblyBuilt = false;
     std::string editableAssembly = {};
     std::string replacementStatus = {};
 };
 
 static std::unordered_map<uintptr_t, ShaderRecord> g_shaderRecords = {};
-static std::unordered_map<uint32_t, uintptr_t> g_shaderHashToKey = {};
+static std::unordered_map<uint64_t, uintptr_t> g_shaderHashToKey = {};
 static std::vector<ShaderRecord*> g_stableShaderList = {};
 enum ShaderListOrderMode {
     ShaderListOrder_Insertion = 0,
@@ -452,20 +556,16 @@ static int g_shaderSearchScopeMode = ShaderSearchScope_LabelOnly;
 static uintptr_t g_activeVertexShaderKey = 0;
 static uintptr_t g_activePixelShaderKey = 0;
 static VertexDeclSemanticInfo g_activeVertexDeclInfo = {};
+// Elements of the bound declaration in trace form, so a recording started mid-session can
+// open with it. Empty when no declaration is bound.
+static ApiTraceVertexElement g_activeVertexDeclElements[MAXD3DDECLLENGTH] = {};
+static uint32_t g_activeVertexDeclElementCount = 0;
 static bool g_forceFfpTransform = false;
 static int g_manualTransformBaseOverride = -1;
 static int g_manualLightingBaseOverride = -1;
 static uintptr_t g_shaderEditorKey = 0;
 static std::vector<char> g_shaderEditorBuffer(65536, 0);
 
-static std::string TrimCopy(const std::string& s) {
-    size_t b = 0;
-    while (b < s.size() && std::isspace(static_cast<unsigned char>(s[b]))) ++b;
-    size_t e = s.size();
-    while (e > b && std::isspace(static_cast<unsigned char>(s[e - 1]))) --e;
-    return s.substr(b, e - b);
-}
-
 static bool ContainsCaseInsensitive(const std::string& haystack, const char* needle) {
     if (!needle || needle[0] == '\0') return true;
     if (haystack.empty()) return false;
@@ -478,100 +578,6 @@ static bool ContainsCaseInsensitive(const std::string& haystack, const char* nee
                        }) != haystack.end();
 }
 
-static int ParseWriteMaskBits(const std::string& reg) {
-    size_t dot = reg.find('.');
-    if (dot == std::string::npos || dot + 1 >= reg.size()) return 0xF;
-    int mask = 0;
-    for (size_t i = dot + 1; i < reg.size(); ++i) {
-        if (reg[i] == 'x') mask |= 1;
-        if (reg[i] == 'y') mask |= 2;
-        if (reg[i] == 'z') mask |= 4;
-        if (reg[i] == 'w') mask |= 8;
-    }
-    return mask == 0 ? 0xF : mask;
-}
-
-static bool ExtractConstRegister(const std::string& operand, int* outReg) {
-    if (!outReg) return false;
-    size_t cpos = operand.find('c');
-    if (cpos == std::string::npos || cpos + 1 >= operand.size()) return false;
-    if (!std::isdigit(static_cast<unsigned char>(operand[cpos + 1]))) return false;
-    int v = 0;
-    size_t i = cpos + 1;
-    while (i < operand.size() && std::isdigit(static_cast<unsigned char>(operand[i]))) {
-        v = (v * 10) + (operand[i] - '0');
-        ++i;
-    }
-    *outReg = v;
-    return true;
-}
-
-struct ParsedAsmInstruction {
-    std::string raw;
-    std::string opcode;
-    std::vector<std::string> operands;
-    bool isInstruction = false;
-};
-
-static std::vector<std::string> SplitAsmOperands(const std::string& text) {
-    std::vector<std::string> out;
-    std::string current;
-    int depth = 0;
-    for (char ch : text) {
-        if (ch == '[') ++depth;
-        if (ch == ']') depth = (depth > 0) ? (depth - 1) : 0;
-        if (ch == ',' && depth == 0) {
-            std::string token = TrimCopy(current);
-            if (!token.empty()) out.push_back(token);
-            current.clear();
-            continue;
-        }
-        current.push_back(ch);
-    }
-    std::string token = TrimCopy(current);
-    if (!token.empty()) out.push_back(token);
-    return out;
-}
-
-static bool IsOpcodeModifierChar(char c) {
-    return c == '_' || c == 'x' || c == 'y' || c == 'z' || c == 'w' || c == 'p' || c == 's' || c == 't';
-}
-
-static std::string NormalizeOpcodeRoot(const std::string& opcode) {
-    size_t p = opcode.find('_');
-    if (p == std::string::npos) return opcode;
-    if (p + 1 < opcode.size() && std::isdigit(static_cast<unsigned char>(opcode[p + 1]))) {
-        return opcode;
-    }
-    size_t i = p + 1;
-    while (i < opcode.size() && IsOpcodeModifierChar(opcode[i])) ++i;
-    if (i < opcode.size() && opcode[i] == '_') return opcode.substr(0, i);
-    return opcode.substr(0, p);
-}
-
-static ParsedAsmInstruction ParseAsmInstructionLine(const std::string& line) {
-    ParsedAsmInstruction parsed = {};
-    parsed.raw = line;
-    std::string t = TrimCopy(line);
-    if (t.empty() || t[0] == '/' || t[0] == ';') {
-        return parsed;
-    }
-    if (t.size() > 4 && t[0] == '0' && t[1] == 'x') {
-        return parsed;
-    }
-    if ((t.rfind("vs_", 0) == 0 || t.rfind("ps_", 0) == 0) && t.find(' ') == std::string::npos) {
-        return parsed;
-    }
-    size_t sp = t.find(' ');
-    parsed.opcode = NormalizeOpcodeRoot(TrimCopy(sp == std::string::npos ? t : t.substr(0, sp)));
-    std::string rest = sp == std::string::npos ? "" : TrimCopy(t.substr(sp + 1));
-    if (!rest.empty()) {
-        parsed.operands = SplitAsmOperands(rest);
-    }
-    parsed.isInstruction = !parsed.opcode.empty();
-    return parsed;
-}
-
 static HMODULE LoadD3DCompilerModule() {
     HMODULE compiler = LoadLibraryA("d3dcompiler_47.dll");
     if (!compiler) compiler = LoadLibraryA("d3dcompiler_43.dll");
@@ -683,39 +689,26 @@ static std::string BuildD3DDisassembly(const std::vector<uint32_t>& bytecode) {
     return text;
 }
 
-static std::vector<ShaderIrInstruction> BuildIrFromDisassembly(const std::string& disasm) {
-    std::vector<ShaderIrInstruction> ir;
-    std::istringstream in(disasm);
-    std::string line;
-    while (std::getline(in, line)) {
-        std::string t = TrimCopy(line);
-        if (t.empty() || t[0] == '/' || t[0] == ';') continue;
-        size_t sp = t.find(' ');
-        ShaderIrInstruction inst;
-        inst.opcode = TrimCopy(sp == std::string::npos ? t : t.substr(0, sp));
-        if (inst.opcode.empty()) continue;
-        std::string rest = sp == std::string::npos ? "" : TrimCopy(t.substr(sp + 1));
-        if (!rest.empty()) {
-            std::vector<std::string> ops;
-            size_t start = 0;
-            while (start < rest.size()) {
-                size_t comma = rest.find(',', start);
-                std::string token = TrimCopy(rest.substr(start, comma == std::string::npos ? std::string::npos : comma - start));
-                if (!token.empty()) ops.push_back(token);
-                if (comma == std::string::npos) break;
-                start = comma + 1;
-            }
-            if (!ops.empty()) {
-                inst.dst = ops[0];
-                inst.dstWriteMask = ParseWriteMaskBits(inst.dst);
-                for (size_t i = 1; i < ops.size(); ++i) inst.src.push_back(ops[i]);
-            }
-        }
-        ir.push_back(inst);
+static void EnsureShaderDisassembly(ShaderRecord* rec) {
+    if (!rec || rec->disassemblyBuilt) return;
+    rec->disassemblyBuilt = true;
+    rec->cachedDisassembly = BuildD3DDisassembly(rec->originalBytecode);
+    if (rec->editableAssembly.empty()) {
+        rec->editableAssembly = rec->cachedDisassembly;
     }
-    return ir;
 }
 
+// Constant register read by a source operand, or -1.
+static int SourceConstRegister(const ShaderOperand& src) {
+    return src.file == ShaderReg_Const ? static_cast<int>(src.index) : -1;
+}
+
+// Bump when ClassifyShaderRecord changes what it derives; the shader cache drops
+// results stored under another version.
+static constexpr uint32_t kShaderAnalysisVersion = 3;
+static_assert(kMaxConstantRegisters == kShaderCacheRegisters, "shader cache register bitmasks");
+static_assert(kShaderMaxMatrixUses == kShaderCacheMatrixUses, "shader cache transform map");
+
 static void ClassifyShaderRecord(ShaderRecord* rec) {
     if (!rec) return;
     rec->isFFPTransform = false;
@@ -723,6 +716,7 @@ static void ClassifyShaderRecord(ShaderRecord* rec) {
     rec->usesSkinning = false;
     rec->usesFlowControl = false;
     rec->transformConstantBase = -1;
+    rec->transformTransposed = false;
     rec->lightingConstantBase = -1;
     rec->lightDirectionRegister = -1;
     rec->lightColorRegister = -1;
@@ -731,49 +725,71 @@ static void ClassifyShaderRecord(ShaderRecord* rec) {
     rec->positionRegister = -1;
     rec->coneAngleRegister = -1;
     rec->lightSpace = LightingSpace::World;
+    memset(rec->constantReads, 0, sizeof(rec->constantReads));
     int minConstReg = kMaxConstantRegisters;
 
-    for (size_t i = 0; i < rec->ir.size(); ++i) {
-        const ShaderIrInstruction& inst = rec->ir[i];
-        if (inst.opcode == "if" || inst.opcode == "loop" || inst.opcode == "rep" || inst.opcode == "call" || inst.opcode == "callnz") {
+    const bool vertexStage = rec->stage == ShaderStage_Vertex;
+    bool relativeConstRead = false;
+    for (const ShaderInstruction& inst : rec->ir) {
+        switch (inst.opcode) {
+        case ShaderOp_If:
+        case ShaderOp_IfC:
+        case ShaderOp_Loop:
+        case ShaderOp_Rep:
+        case ShaderOp_Call:
+        case ShaderOp_CallNz:
             rec->usesFlowControl = true;
+            break;
+        default:
+            break;
         }
-        if (inst.dst.find("a0") != std::string::npos || (inst.dst.find('[') != std::string::npos && inst.dst.find('c') != std::string::npos)) {
+        // Writing a0 or indexing through it is the bone-palette pattern.
+        if (inst.hasDst && ((vertexStage && inst.dst.file == ShaderReg_Addr) || inst.dst.relative)) {
             rec->usesSkinning = true;
         }
-        for (const std::string& src : inst.src) {
-            int c = -1;
-            if (ExtractConstRegister(src, &c) && c >= 0 && c < kMaxConstantRegisters) { rec->constantUsage[c] = true; if (c < minConstReg) minConstReg = c; }
-            if (src.find("a0") != std::string::npos || src.find("[a0") != std::string::npos) rec->usesSkinning = true;
-        }
-    }
-
-    for (size_t i = 0; i + 3 < rec->ir.size(); ++i) {
-        const ShaderIrInstruction& a = rec->ir[i + 0];
-        const ShaderIrInstruction& b = rec->ir[i + 1];
-        const ShaderIrInstruction& c = rec->ir[i + 2];
-        const ShaderIrInstruction& d = rec->ir[i + 3];
-        if (a.opcode == "dp4" && b.opcode == "dp4" && c.opcode == "dp4" && d.opcode == "dp4" &&
-            a.dst.find("oPos") != std::string::npos && b.dst.find("oPos") != std::string::npos &&
-            c.dst.find("oPos") != std::string::npos && d.dst.find("oPos") != std::string::npos &&
-            a.src.size() >= 2 && b.src.size() >= 2 && c.src.size() >= 2 && d.src.size() >= 2 &&
-            a.src[0] == b.src[0] && b.src[0] == c.src[0] && c.src[0] == d.src[0]) {
-            int c0 = -1, c1 = -1, c2 = -1, c3 = -1;
-            if (ExtractConstRegister(a.src[1], &c0) && ExtractConstRegister(b.src[1], &c1) &&
-                ExtractConstRegister(c.src[1], &c2) && ExtractConstRegister(d.src[1], &c3) &&
-                c1 == c0 + 1 && c2 == c0 + 2 && c3 == c0 + 3) {
-                rec->isFFPTransform = true;
-                rec->transformConstantBase = c0;
-                break;
+        for (int s = 0; s < inst.srcCount; ++s) {
+            const ShaderOperand& src = inst.src[s];
+            const int c = SourceConstRegister(src);
+            if (c >= 0 && c < kMaxConstantRegisters) { rec->constantUsage[c] = true; rec->constantReads[c] = true; if (c < minConstReg) minConstReg = c; }
+            if (src.relative) {
+                if (vertexStage && src.relativeFile == ShaderReg_Addr) rec->usesSkinning = true;
+                if (src.file == ShaderReg_Const) relativeConstRead = true;
             }
         }
     }
+    // Relative addressing can read any register past the base, so only trust the read set without it.
+    rec->constantReadsKnown = !rec->ir.empty() && !rec->usesSkinning && !relativeConstRead;
+
+    // One fixed 4-row matrix writing oPos, with nothing but the bone palette before it, is
+    // the FFP-style transform, whether it is written as dp4s, m4x4 or a mul/mad chain.
+    // Skinned shaders qualify as they did under the dp4-quad detector.
+    const ShaderTransformMap& map = rec->transformMap;
+    const ShaderMatrixUse* finalStage = nullptr;
+    int fixedStages = 0;
+    for (int i = 0; i < map.useCount; ++i) {
+        const ShaderMatrixUse& use = map.uses[i];
+        if (use.stage < 0) continue;
+        if (!use.relative) fixedStages++;
+        if (use.stage == map.stageCount - 1) finalStage = &use;
+    }
+    if (vertexStage && fixedStages == 1 && finalStage && !finalStage->relative && finalStage->rows == 4) {
+        rec->isFFPTransform = true;
+        rec->transformConstantBase = finalStage->baseRegister;
+        rec->transformTransposed = finalStage->transposed;
+    }
 
     bool sawDot = false, sawMaxZero = false, sawMul = false;
-    for (const ShaderIrInstruction& inst : rec->ir) {
-        sawDot |= (inst.opcode == "dp3" || inst.opcode == "dp4");
-        if (inst.opcode == "max" && inst.src.size() >= 2 && (inst.src[1] == "c0.x" || inst.src[1] == "0")) sawMaxZero = true;
-        sawMul |= (inst.opcode == "mul");
+    for (const ShaderInstruction& inst : rec->ir) {
+        sawDot |= (inst.opcode == ShaderOp_Dp3 || inst.opcode == ShaderOp_Dp4);
+        // max x, c0.x: the N.L clamp against a zero constant.
+        if (inst.opcode == ShaderOp_Max && inst.srcCount >= 2) {
+            const ShaderOperand& clamp = inst.src[1];
+            if (clamp.file == ShaderReg_Const && clamp.index == 0 && clamp.mask == 0x00 &&
+                clamp.modifier == 0 && !clamp.relative) {
+                sawMaxZero = true;
+            }
+        }
+        sawMul |= (inst.opcode == ShaderOp_Mul);
     }
     rec->isFFPLighting = sawDot && sawMaxZero && sawMul;
     if (rec->isFFPLighting && minConstReg < kMaxConstantRegisters) {
@@ -789,7 +805,7 @@ static void ClassifyShaderRecord(ShaderRecord* rec) {
     rec->isRemixSafe = !rec->usesFlowControl;
 }
 
-static bool TryGetShaderBytecodeHash(uintptr_t shaderKey, uint32_t* outHash) {
+static bool TryGetShaderBytecodeHash(uintptr_t shaderKey, uint64_t* outHash) {
     if (!outHash || shaderKey == 0) {
         return false;
     }
@@ -801,17 +817,124 @@ static bool TryGetShaderBytecodeHash(uintptr_t shaderKey, uint32_t* outHash) {
     return true;
 }
 
+// Per-shader constants are stored in 16-register pages allocated on first write, so a
+// shader that only touches c0-c15 costs one page instead of the full 256-register file.
+// Overrides and variance live in separate side tables that stay empty unless used.
+static constexpr int kConstantPageRegisters = 16;
+static constexpr int kConstantPageCount = kMaxConstantRegisters / kConstantPageRegisters;
+
+struct ConstantValuePage {
+    float constants[kConstantPageRegisters][4] = {};
+    bool valid[kConstantPageRegisters] = {};
+};
+
+struct ConstantOverridePage {
+    float constants[kConstantPageRegisters][4] = {};
+    bool valid[kConstantPageRegisters] = {};
+    int expiresAtFrame[kConstantPageRegisters];
+
+    ConstantOverridePage() {
+        for (int i = 0; i < kConstantPageRegisters; ++i) expiresAtFrame[i] = -1;
+    }
+};
+
+struct ConstantVariancePage {
+    unsigned long long sampleCounts[kConstantPageRegisters] = {};
+    double mean[kConstantPageRegisters][4] = {};
+    double m2[kConstantPageRegisters][4] = {};
+};
+
 struct ShaderConstantState {
-    float constants[kMaxConstantRegisters][4] = {};
-    bool valid[kMaxConstantRegisters] = {};
-    float overrideConstants[kMaxConstantRegisters][4] = {};
-    bool overrideValid[kMaxConstantRegisters] = {};
-    int overrideExpiresAtFrame[kMaxConstantRegisters];
+    std::unique_ptr<ConstantValuePage> valuePages[kConstantPageCount];
+    std::unique_ptr<ConstantOverridePage> overridePages[kConstantPageCount];
+    std::unique_ptr<ConstantVariancePage> variancePages[kConstantPageCount];
     bool snapshotReady = false;
-    unsigned long long sampleCounts[kMaxConstantRegisters] = {};
-    double mean[kMaxConstantRegisters][4] = {};
-    double m2[kMaxConstantRegisters][4] = {};
     unsigned long long lastChangeSerial = 0;
+
+    bool IsValid(int reg) const {
+        const ConstantValuePage* page = valuePages[reg / kConstantPageRegisters].get();
+        return page && page->valid[reg % kConstantPageRegisters];
+    }
+    // Only meaningful when IsValid(reg); unallocated pages return nullptr.
+    const float* GetConstant(int reg) const {
+        const ConstantValuePage* page = valuePages[reg / kConstantPageRegisters].get();
+        return page ? page->constants[reg % kConstantPageRegisters] : nullptr;
+    }
+    // Stores one register and reports whether its contents changed.
+    bool StoreConstant(int reg, const float* values) {
+        std::unique_ptr<ConstantValuePage>& page = valuePages[reg / kConstantPageRegisters];
+        if (!page) {
+            page.reset(new ConstantValuePage());
+        }
+        const int index = reg % kConstantPageRegisters;
+        const bool changed = !page->valid[index] ||
+                             memcmp(page->constants[index], values, sizeof(page->constants[index])) != 0;
+        memcpy(page->constants[index], values, sizeof(page->constants[index]));
+        page->valid[index] = true;
+        return changed;
+    }
+
+    bool HasOverride(int reg) const {
+        const ConstantOverridePage* page = overridePages[reg / kConstantPageRegisters].get();
+        return page && page->valid[reg % kConstantPageRegisters];
+    }
+    const float* GetOverride(int reg) const {
+        const ConstantOverridePage* page = overridePages[reg / kConstantPageRegisters].get();
+        return page ? page->constants[reg % kConstantPageRegisters] : nullptr;
+    }
+    int GetOverrideExpiry(int reg) const {
+        const ConstantOverridePage* page = overridePages[reg / kConstantPageRegisters].get();
+        return page ? page->expiresAtFrame[reg % kConstantPageRegisters] : -1;
+    }
+    void SetOverride(int reg, const float* values, int expiresAtFrame) {
+        std::unique_ptr<ConstantOverridePage>& page = overridePages[reg / kConstantPageRegisters];
+        if (!page) {
+            page.reset(new ConstantOverridePage());
+        }
+        const int index = reg % kConstantPageRegisters;
+        memcpy(page->constants[index], values, sizeof(page->constants[index]));
+        page->valid[index] = true;
+        page->expiresAtFrame[index] = expiresAtFrame;
+    }
+    void ClearOverride(int reg) {
+        ConstantOverridePage* page = overridePages[reg / kConstantPageRegisters].get();
+        if (!page) {
+            return;
+        }
+        const int index = reg % kConstantPageRegisters;
+        memset(page->constants[index], 0, sizeof(page->constants[index]));
+        page->valid[index] = false;
+        page->expiresAtFrame[index] = -1;
+    }
+    void ClearAllOverrides() {
+        for (int i = 0; i < kConstantPageCount; ++i) overridePages[i].reset();
+    }
+
+    ConstantVariancePage* GetVariancePage(int reg, bool createIfMissing) {
+        std::unique_ptr<ConstantVariancePage>& page = variancePages[reg / kConstantPageRegisters];
+        if (!page && createIfMissing) {
+            page.reset(new ConstantVariancePage());
+        }
+        return page.get();
+    }
+    const ConstantVariancePage* GetVariancePage(int reg) const {
+        return variancePages[reg / kConstantPageRegisters].get();
+    }
+};
+
+// Layout before paging: every table held all 256 registers for every shader.
+static constexpr size_t kDenseShaderConstantStateBytes =
+    kMaxConstantRegisters * (sizeof(float) * 4 * 2 + sizeof(bool) * 2 + sizeof(int) +
+                             sizeof(unsigned long long) + sizeof(double) * 4 * 2) +
+    sizeof(bool) + sizeof(unsigned long long);
+
+struct ShaderConstantMemoryReport {
+    int shaders = 0;
+    int valuePages = 0;
+    int overridePages = 0;
+    int variancePages = 0;
+    size_t bytes = 0;
+    size_t denseBytes = 0;
 };
 
 enum ConstantUploadStage {
@@ -838,15 +961,51 @@ struct GlobalVertexRegisterState {
 };
 
 static ShaderConstantState* GetShaderState(uintptr_t shaderKey, bool createIfMissing);
+static const char* GameProfileLabel(GameProfileKind profile);
 
 static std::unordered_map<uintptr_t, ShaderConstantState> g_shaderConstants = {};
 static std::vector<uintptr_t> g_shaderOrder = {};
 static std::unordered_map<uintptr_t, bool> g_disabledShaders = {};
 static unsigned long long g_constantChangeSerial = 0;
 static unsigned long long g_constantUploadSerial = 0;
-static std::deque<ConstantUploadEvent> g_constantUploadEvents = {};
 static constexpr size_t kMaxConstantUploadEvents = 2000;
+static ConstantUploadEvent g_constantUploadEvents[kMaxConstantUploadEvents] = {};
+static size_t g_constantUploadEventsHead = 0;
+static size_t g_constantUploadEventsCount = 0;
+static ApiTraceRecorder g_apiTraceRecorder;
+static char g_apiTraceStatus[MAX_PATH + 64] = "";
+// Per-draw World/View/Projection written next to the API trace, for golden_diff.
+static GoldenWriter g_goldenWriter;
+static int g_goldenFrameBase = 0;
+// Bumped when a golden run starts or stops; each device engine follows it at its next
+// Present (WrappedD3D9Device::SyncGoldenRun).
+static uint32_t g_goldenRunSerial = 0;
 static GlobalVertexRegisterState g_allVertexRegisters[kMaxConstantRegisters] = {};
+
+// Shared by every device engine; the layouts are persisted in the shader cache.
+static LearnedLayoutMap g_learnedUploadLayouts = {};
+static StructuralWindowCache g_matrixClassCache;
+// Used instead during a golden run, cleared at its start like the replay's.
+static LearnedLayoutMap g_goldenRunLayouts = {};
+static StructuralWindowCache g_goldenRunWindowCache;
+
+// Totals of the device engines' MatrixEngineStats, for the overlay.
+static unsigned long long g_layoutFastPathHits = 0;
+static unsigned long long g_layoutFullScans = 0;
+static unsigned long long g_layoutDriftFallbacks = 0;
+
+static unsigned long long g_paletteUploads = 0;
+static unsigned long long g_paletteWindowsSkipped = 0;
+static unsigned long long g_transformMapUploads = 0;
+static unsigned long long g_transformMapWindowsSkipped = 0;
+
+static unsigned long long g_deferredRegistersClassified = 0;
+static unsigned long long g_deferredRegistersSkipped = 0;
+static unsigned long long g_deferredRangesClassified = 0;
+static unsigned long long g_deferredQueueFull = 0;
+
+static unsigned long long g_simdWindowsTested = 0;
+static unsigned long long g_simdWindowsRejected = 0;
 static HANDLE g_memoryScannerThread = nullptr;
 static DWORD g_memoryScannerThreadId = 0;
 static DWORD g_memoryScannerLastTick = 0;
@@ -864,7 +1023,277 @@ static LARGE_INTEGER g_prevCounter = {};
 static bool g_perfInitialized = false;
 static float g_lastDeltaSec = 0.016f;
 
-static std::deque<std::string> g_logLines = {};
+// Per-method cost of the proxy itself, in rdtsc cycles. Independent of the frame-time
+// stats above; scopes nest, so Draw* totals include the emit/lighting work they call.
+enum TimedMethod {
+    TimedMethod_SetVertexShaderConstantF = 0,
+    TimedMethod_SetVertexShader,
+    TimedMethod_SetPixelShader,
+    TimedMethod_SetVertexDeclaration,
+    TimedMethod_DrawPrimitive,
+    TimedMethod_DrawIndexedPrimitive,
+    TimedMethod_DrawPrimitiveUP,
+    TimedMethod_DrawIndexedPrimitiveUP,
+    TimedMethod_EmitFixedFunctionTransforms,
+    TimedMethod_SubmitLighting,
+    TimedMethod_Present,
+    TimedMethod_Count
+};
+
+static const char* kTimedMethodNames[TimedMethod_Count] = {
+    "SetVertexShaderConstantF",
+    "SetVertexShader",
+    "SetPixelShader",
+    "SetVertexDeclaration",
+    "DrawPrimitive",
+    "DrawIndexedPrimitive",
+    "DrawPrimitiveUP",
+    "DrawIndexedPrimitiveUP",
+    "EmitFixedFunctionTransforms",
+    "SubmitLightingFromCurrentDraw",
+    "Present",
+};
+
+// Bucket i holds samples in [2^i, 2^(i+1)) cycles; p99 is reported as the bucket's upper bound.
+static constexpr int kMethodTimingBuckets = 32;
+
+struct MethodTimingStats {
+    unsigned long long calls = 0;
+    unsigned long long totalCycles = 0;
+    unsigned long long minCycles = 0;
+    unsigned long long maxCycles = 0;
+    unsigned long long p99Cycles = 0;
+    unsigned int histogram[kMethodTimingBuckets] = {};
+};
+
+static bool g_methodTimingEnabled = false;
+static int g_methodTimingSelected = TimedMethod_SetVertexShaderConstantF;
+static MethodTimingStats g_methodTimingThisFrame[TimedMethod_Count] = {};
+static MethodTimingStats g_methodTimingLastFrame[TimedMethod_Count] = {};
+
+static void RecordMethodTiming(TimedMethod method, unsigned long long cycles) {
+    MethodTimingStats& stats = g_methodTimingThisFrame[method];
+    if (stats.calls == 0 || cycles < stats.minCycles) stats.minCycles = cycles;
+    if (cycles > stats.maxCycles) stats.maxCycles = cycles;
+    stats.calls++;
+    stats.totalCycles += cycles;
+    int bucket = 0;
+    while (bucket < kMethodTimingBuckets - 1 && (cycles >> (bucket + 1)) != 0) {
+        bucket++;
+    }
+    stats.histogram[bucket]++;
+}
+
+static void RollMethodTimingFrame() {
+    for (int i = 0; i < TimedMethod_Count; ++i) {
+        MethodTimingStats& stats = g_methodTimingThisFrame[i];
+        const unsigned long long threshold = stats.calls - stats.calls / 100;
+        unsigned long long seen = 0;
+        for (int bucket = 0; bucket < kMethodTimingBuckets && stats.calls > 0; ++bucket) {
+            seen += stats.histogram[bucket];
+            if (seen >= threshold) {
+                stats.p99Cycles = (std::min)((2ull << bucket) - 1ull, stats.maxCycles);
+                break;
+            }
+        }
+        g_methodTimingLastFrame[i] = stats;
+        stats = MethodTimingStats{};
+    }
+}
+
+struct MethodTimingScope {
+    TimedMethod method;
+    bool active;
+    unsigned long long start;
+    explicit MethodTimingScope(TimedMethod m)
+        : method(m), active(g_methodTimingEnabled), start(active ? __rdtsc() : 0) {}
+    ~MethodTimingScope() { End(); }
+    // Records the sample now, so the call forwarded to the real device is not timed.
+    void End() {
+        if (active) {
+            RecordMethodTiming(method, __rdtsc() - start);
+            active = false;
+        }
+    }
+};
+
+// Frame trace capture: complete ("X") events for a few frames, written as Chrome
+// trace-event JSON that loads in Perfetto or chrome://tracing. Writers only claim a
+// slot with an atomic increment; the ring is read once capture has stopped.
+struct TraceEvent {
+    const char* name;
+    long long beginTicks;
+    long long endTicks;
+    DWORD threadId;
+    int frame;
+};
+
+static constexpr uint32_t kTraceEventCapacity = 1u << 16;
+static TraceEvent g_traceEvents[kTraceEventCapacity];
+static std::atomic<uint32_t> g_traceEventHead{0};
+static bool g_traceCaptureActive = false;
+static bool g_traceCaptureRequested = false;
+static int g_traceFramesRemaining = 0;
+static long long g_traceStartTicks = 0;
+static char g_traceCaptureStatus[MAX_PATH + 96] = "";
+
+static void RecordTraceEvent(const char* name, long long beginTicks, long long endTicks) {
+    const uint32_t slot = g_traceEventHead.fetch_add(1, std::memory_order_relaxed) & (kTraceEventCapacity - 1);
+    TraceEvent& event = g_traceEvents[slot];
+    event.name = name;
+    event.beginTicks = beginTicks;
+    event.endTicks = endTicks;
+    event.threadId = GetCurrentThreadId();
+    event.frame = g_frameCount;
+}
+
+struct TraceScope {
+    const char* name;
+    bool active;
+    long long beginTicks = 0;
+    explicit TraceScope(const char* eventName) : name(eventName), active(g_traceCaptureActive) {
+        if (active) {
+            LARGE_INTEGER now = {};
+            QueryPerformanceCounter(&now);
+            beginTicks = now.QuadPart;
+        }
+    }
+    ~TraceScope() {
+        if (active) {
+            LARGE_INTEGER now = {};
+            QueryPerformanceCounter(&now);
+            RecordTraceEvent(name, beginTicks, now.QuadPart);
+        }
+    }
+};
+
+// Capture files go next to camera_proxy.ini, suffixed with the current frame number.
+static void BuildCapturePath(const char* prefix, const char* extension, char* outPath, size_t outPathSize) {
+    snprintf(outPath, outPathSize, "%s", g_iniPath[0] ? g_iniPath : "camera_proxy.ini");
+    char* lastSlash = strrchr(outPath, '\\');
+    char* fileName = lastSlash ? lastSlash + 1 : outPath;
+    const size_t fileNameRoom = outPathSize - static_cast<size_t>(fileName - outPath);
+    snprintf(fileName, fileNameRoom, "%s_%d.%s", prefix, g_frameCount, extension);
+}
+
+// The finished capture is written by a one-shot thread; the ring is not touched again
+// until it is reaped, so a new capture waits for the previous file.
+struct TraceWriteJob {
+    char path[MAX_PATH] = {};
+    uint32_t head = 0;
+    bool written = false;
+};
+
+static TraceWriteJob g_traceWriteJob;
+static HANDLE g_traceWriterThread = nullptr;
+
+static bool WriteTraceCapture(const char* path, uint32_t head) {
+    FILE* file = nullptr;
+    if (fopen_s(&file, path, "w") != 0 || !file) {
+        return false;
+    }
+    LARGE_INTEGER frequency = {};
+    QueryPerformanceFrequency(&frequency);
+    const double microsecondsPerTick = 1000000.0 / static_cast<double>(frequency.QuadPart);
+    const uint32_t count = (std::min)(head, kTraceEventCapacity);
+
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"%s\"}}",
+            kCameraProxyVersion);
+    for (uint32_t i = head - count; i != head; ++i) {
+        const TraceEvent& event = g_traceEvents[i & (kTraceEventCapacity - 1)];
+        fprintf(file, ",\n{\"name\":\"%s\",\"cat\":\"proxy\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+                      "\"pid\":1,\"tid\":%lu,\"args\":{\"frame\":%d}}",
+                event.name,
+                static_cast<double>(event.beginTicks - g_traceStartTicks) * microsecondsPerTick,
+                static_cast<double>(event.endTicks - event.beginTicks) * microsecondsPerTick,
+                static_cast<unsigned long>(event.threadId), event.frame);
+    }
+    fprintf(file, "\n]}\n");
+    fclose(file);
+    return true;
+}
+
+static DWORD WINAPI TraceWriterThread(LPVOID) {
+    g_traceWriteJob.written = WriteTraceCapture(g_traceWriteJob.path, g_traceWriteJob.head);
+    return 0;
+}
+
+static void ReportTraceWrite() {
+    const char* path = g_traceWriteJob.path;
+    if (g_traceWriteJob.written) {
+        snprintf(g_traceCaptureStatus, sizeof(g_traceCaptureStatus), "Trace written: %s", path);
+        LogMsg("Trace capture written to %s", path);
+    } else {
+        snprintf(g_traceCaptureStatus, sizeof(g_traceCaptureStatus), "Trace capture failed: could not open %s", path);
+        LogMsg("Trace capture failed: could not open %s", path);
+    }
+    if (g_traceWriteJob.head > kTraceEventCapacity) {
+        LogMsg("Trace capture overflowed: %u of %u events kept", kTraceEventCapacity, g_traceWriteJob.head);
+    }
+}
+
+// Reports a finished write. With `wait` it blocks until the writer is done; otherwise it
+// returns false while the file is still being written.
+static bool ReapTraceCapture(bool wait) {
+    if (!g_traceWriterThread) {
+        return true;
+    }
+    if (WaitForSingleObject(g_traceWriterThread, wait ? INFINITE : 0) == WAIT_TIMEOUT) {
+        return false;
+    }
+    CloseHandle(g_traceWriterThread);
+    g_traceWriterThread = nullptr;
+    ReportTraceWrite();
+    return true;
+}
+
+// Called once per Present, after the Present scope has closed: starts a pending capture,
+// or counts down and hands the finished one to the writer thread.
+static void AdvanceTraceCapture() {
+    if (!ReapTraceCapture(false)) {
+        return;
+    }
+    if (g_traceCaptureActive) {
+        if (--g_traceFramesRemaining > 0) {
+            return;
+        }
+        g_traceCaptureActive = false;
+        BuildCapturePath("camera_proxy_trace", "json", g_traceWriteJob.path, sizeof(g_traceWriteJob.path));
+        g_traceWriteJob.head = g_traceEventHead.load(std::memory_order_acquire);
+        g_traceWriteJob.written = false;
+        g_traceWriterThread = CreateThread(nullptr, 0, TraceWriterThread, nullptr, 0, nullptr);
+        if (!g_traceWriterThread) {
+            TraceWriterThread(nullptr);
+            ReportTraceWrite();
+            return;
+        }
+        snprintf(g_traceCaptureStatus, sizeof(g_traceCaptureStatus), "Writing trace...");
+        return;
+    }
+    if (g_traceCaptureRequested) {
+        g_traceCaptureRequested = false;
+        LARGE_INTEGER now = {};
+        QueryPerformanceCounter(&now);
+        g_traceStartTicks = now.QuadPart;
+        g_traceEventHead.store(0, std::memory_order_relaxed);
+        g_traceFramesRemaining = g_config.traceCaptureFrames;
+        g_traceCaptureActive = true;
+        snprintf(g_traceCaptureStatus, sizeof(g_traceCaptureStatus), "Capturing %d frame(s)...",
+                 g_config.traceCaptureFrames);
+    }
+}
+
+#if CAMERA_PROXY_METHOD_TIMING
+#define METHOD_TIMING_SCOPE(method) MethodTimingScope methodTimingScope(method)
+#define METHOD_TIMING_END() methodTimingScope.End()
+#define TRACE_SCOPE(name) TraceScope traceScope(name)
+#else
+#define METHOD_TIMING_SCOPE(method) ((void)0)
+#define METHOD_TIMING_END() ((void)0)
+#define TRACE_SCOPE(name) ((void)0)
+#endif
+
 static std::vector<std::string> g_logSnapshot = {};
 static std::vector<std::string> g_memoryScanResults = {};
 static RemixLightingManager g_remixLightingManager = {};
@@ -909,12 +1338,17 @@ struct MemoryScanHit {
     D3DMATRIX matrix = {};
     MatrixSlot slot = MatrixSlot_View;
     uintptr_t address = 0;
-    uint32_t hash = 0;
+    uint64_t hash = 0;
 };
 
 static std::vector<MemoryScanHit> g_memoryScanHits = {};
 static std::mutex g_uiDataMutex;
 static constexpr size_t kMaxUiLogLines = 600;
+static constexpr size_t kUiLogLineLength = 512;
+// Fixed ring so LogMsg never allocates on the render thread; the UI snapshot copies out of it.
+static char g_logLines[kMaxUiLogLines][kUiLogLineLength] = {};
+static size_t g_logLinesHead = 0;
+static size_t g_logLinesCount = 0;
 static bool g_logsLiveUpdate = false;
 static bool g_logSnapshotDirty = true;
 
@@ -950,7 +1384,8 @@ static bool IsProxyHotkeyVk(DWORD vkCode) {
     return vkCode == static_cast<DWORD>(g_config.hotkeyToggleMenuVk) ||
            vkCode == static_cast<DWORD>(g_config.hotkeyTogglePauseVk) ||
            vkCode == static_cast<DWORD>(g_config.hotkeyEmitMatricesVk) ||
-           vkCode == static_cast<DWORD>(g_config.hotkeyResetMatrixOverridesVk);
+           vkCode == static_cast<DWORD>(g_config.hotkeyResetMatrixOverridesVk) ||
+           vkCode == static_cast<DWORD>(g_config.hotkeyCaptureTraceVk);
 }
 
 static LRESULT CALLBACK LowLevelKeyboardBlockHook(int nCode, WPARAM wParam, LPARAM lParam) {
@@ -1121,13 +1556,14 @@ static void StoreViewMatrix(const D3DMATRIX& view,
                             bool manual = false,
                             const char* sourceLabel = nullptr,
                             int extractedFromRegister = -1) {
-    {
-        std::lock_guard<std::mutex> lock(g_cameraMatricesMutex);
+    const MatrixSourceInfo source = BuildMatrixSource(shaderKey, baseRegister, rows, transposed, manual,
+                                                      sourceLabel, extractedFromRegister);
+    WriteCameraMatrices([&]() {
         g_cameraMatrices.view = view;
         g_cameraMatrices.hasView = true;
-    }
-    UpdateMatrixSource(MatrixSlot_View, shaderKey, baseRegister, rows, transposed, manual,
-                       sourceLabel, extractedFromRegister);
+        g_matrixSlotGenerations[MatrixSlot_View]++;
+        g_matrixSources[MatrixSlot_View] = source;
+    });
 }
 
 static void StoreProjectionMatrix(const D3DMATRIX& projection,
@@ -1138,13 +1574,14 @@ static void StoreProjectionMatrix(const D3DMATRIX& projection,
                                   bool manual = false,
                                   const char* sourceLabel = nullptr,
                                   int extractedFromRegister = -1) {
-    {
-        std::lock_guard<std::mutex> lock(g_cameraMatricesMutex);
+    const MatrixSourceInfo source = BuildMatrixSource(shaderKey, baseRegister, rows, transposed, manual,
+                                                      sourceLabel, extractedFromRegister);
+    WriteCameraMatrices([&]() {
         g_cameraMatrices.projection = projection;
         g_cameraMatrices.hasProjection = true;
-    }
-    UpdateMatrixSource(MatrixSlot_Projection, shaderKey, baseRegister, rows, transposed, manual,
-                       sourceLabel, extractedFromRegister);
+        g_matrixSlotGenerations[MatrixSlot_Projection]++;
+        g_matrixSources[MatrixSlot_Projection] = source;
+    });
 }
 
 static void StoreWorldMatrix(const D3DMATRIX& world,
@@ -1155,13 +1592,14 @@ static void StoreWorldMatrix(const D3DMATRIX& world,
                              bool manual = false,
                              const char* sourceLabel = nullptr,
                              int extractedFromRegister = -1) {
-    {
-        std::lock_guard<std::mutex> lock(g_cameraMatricesMutex);
+    const MatrixSourceInfo source = BuildMatrixSource(shaderKey, baseRegister, rows, transposed, manual,
+                                                      sourceLabel, extractedFromRegister);
+    WriteCameraMatrices([&]() {
         g_cameraMatrices.world = world;
         g_cameraMatrices.hasWorld = true;
-    }
-    UpdateMatrixSource(MatrixSlot_World, shaderKey, baseRegister, rows, transposed, manual,
-                       sourceLabel, extractedFromRegister);
+        g_matrixSlotGenerations[MatrixSlot_World]++;
+        g_matrixSources[MatrixSlot_World] = source;
+    });
 }
 
 static void StoreMVPMatrix(const D3DMATRIX& mvp,
@@ -1172,13 +1610,14 @@ static void StoreMVPMatrix(const D3DMATRIX& mvp,
                            bool manual = false,
                            const char* sourceLabel = nullptr,
                            int extractedFromRegister = -1) {
-    {
-        std::lock_guard<std::mutex> lock(g_cameraMatricesMutex);
+    const MatrixSourceInfo source = BuildMatrixSource(shaderKey, baseRegister, rows, transposed, manual,
+                                                      sourceLabel, extractedFromRegister);
+    WriteCameraMatrices([&]() {
         g_cameraMatrices.mvp = mvp;
         g_cameraMatrices.hasMVP = true;
-    }
-    UpdateMatrixSource(MatrixSlot_MVP, shaderKey, baseRegister, rows, transposed, manual,
-                       sourceLabel, extractedFromRegister);
+        g_matrixSlotGenerations[MatrixSlot_MVP]++;
+        g_matrixSources[MatrixSlot_MVP] = source;
+    });
 }
 
 
@@ -1190,13 +1629,14 @@ static void StoreVPMatrix(const D3DMATRIX& vp,
                           bool manual = false,
                           const char* sourceLabel = nullptr,
                           int extractedFromRegister = -1) {
-    {
-        std::lock_guard<std::mutex> lock(g_cameraMatricesMutex);
+    const MatrixSourceInfo source = BuildMatrixSource(shaderKey, baseRegister, rows, transposed, manual,
+                                                      sourceLabel, extractedFromRegister);
+    WriteCameraMatrices([&]() {
         g_cameraMatrices.vp = vp;
         g_cameraMatrices.hasVP = true;
-    }
-    UpdateMatrixSource(MatrixSlot_VP, shaderKey, baseRegister, rows, transposed, manual,
-                       sourceLabel, extractedFromRegister);
+        g_matrixSlotGenerations[MatrixSlot_VP]++;
+        g_matrixSources[MatrixSlot_VP] = source;
+    });
 }
 
 static void StoreWVMatrix(const D3DMATRIX& wv,
@@ -1207,13 +1647,14 @@ static void StoreWVMatrix(const D3DMATRIX& wv,
                           bool manual = false,
                           const char* sourceLabel = nullptr,
                           int extractedFromRegister = -1) {
-    {
-        std::lock_guard<std::mutex> lock(g_cameraMatricesMutex);
+    const MatrixSourceInfo source = BuildMatrixSource(shaderKey, baseRegister, rows, transposed, manual,
+                                                      sourceLabel, extractedFromRegister);
+    WriteCameraMatrices([&]() {
         g_cameraMatrices.wv = wv;
         g_cameraMatrices.hasWV = true;
-    }
-    UpdateMatrixSource(MatrixSlot_WV, shaderKey, baseRegister, rows, transposed, manual,
-                       sourceLabel, extractedFromRegister);
+        g_matrixSlotGenerations[MatrixSlot_WV]++;
+        g_matrixSources[MatrixSlot_WV] = source;
+    });
 }
 
 static HMODULE LoadSystemD3D9() {
@@ -1512,28 +1953,21 @@ static void DrawMatrix(const char* label, const D3DMATRIX& mat, bool available)
     ImGui::Text("[%.3f %.3f %.3f %.3f]", mat._41, mat._42, mat._43, mat._44);
 }
 
-static uint32_t HashBytesFNV1a(const uint8_t* data, size_t size) {
-    uint32_t hash = 2166136261u;
-    for (size_t i = 0; i < size; i++) {
-        hash ^= data[i];
-        hash *= 16777619u;
-    }
-    return hash;
-}
-
-static uint32_t HashMatrix(const D3DMATRIX& mat) {
-    return HashBytesFNV1a(reinterpret_cast<const uint8_t*>(&mat), sizeof(D3DMATRIX));
+static uint64_t HashMatrix(const D3DMATRIX& mat) {
+    return FastHash64(&mat, sizeof(D3DMATRIX));
 }
 
+// 32-bit form of the bytecode hash for traces, golden files and layout keys; it
+// matches GoldenShaderHash.
 static uint32_t GetShaderHashForKey(uintptr_t shaderKey) {
     if (shaderKey == 0) {
         return 0;
     }
-    uint32_t hash = 0;
+    uint64_t hash = 0;
     if (TryGetShaderBytecodeHash(shaderKey, &hash)) {
-        return hash;
+        return FastHashFold32(hash);
     }
-    return HashBytesFNV1a(reinterpret_cast<const uint8_t*>(&shaderKey), sizeof(shaderKey));
+    return FastHashFold32(FastHash64(&shaderKey, sizeof(shaderKey)));
 }
 
 
@@ -1550,9 +1984,117 @@ static void RecordConstantUpload(ConstantUploadStage stage,
     ev.changeSerial = ++g_constantUploadSerial;
 
     std::lock_guard<std::mutex> lock(g_uiDataMutex);
-    g_constantUploadEvents.emplace_back(ev);
-    while (g_constantUploadEvents.size() > kMaxConstantUploadEvents) {
-        g_constantUploadEvents.pop_front();
+    g_constantUploadEvents[g_constantUploadEventsHead] = ev;
+    g_constantUploadEventsHead = (g_constantUploadEventsHead + 1) % kMaxConstantUploadEvents;
+    if (g_constantUploadEventsCount < kMaxConstantUploadEvents) {
+        g_constantUploadEventsCount++;
+    }
+}
+
+// Shader ids in the API trace are the wrapper keys; a 32-bit build keeps them exact.
+static uint32_t ApiTraceShaderId(uintptr_t shaderKey) {
+    return static_cast<uint32_t>(shaderKey);
+}
+
+// Logs the trace_replay command that checks the golden against the trace, and the
+// proxy-only inputs that would make the two differ: the trace does not carry them.
+static void LogGoldenCheckCommand(const char* tracePath, const char* goldenPath) {
+    LogMsg("Golden check: trace_replay \"%s\" --profile %s%s%s%s --check-golden \"%s\"",
+           tracePath, GameProfileLabel(g_activeGameProfile),
+           g_config.enableCombinedDecomposition ? "" : " --no-decomposition",
+           g_config.suppressRedundantTransforms ? "" : " --no-suppress-redundant",
+           g_barnyardForceWorldFromC0 ? " --barnyard-world-c0" : "", goldenPath);
+
+    bool manualBindings = false;
+    for (int slot = 0; slot < MatrixSlot_Count; slot++) {
+        manualBindings = manualBindings || g_manualBindings[slot].enabled;
+    }
+    bool disabledShaders = false;
+    for (const auto& entry : g_disabledShaders) {
+        disabledShaders = disabledShaders || entry.second;
+    }
+    const bool registerOverrides = g_config.worldMatrixRegister >= 0 || g_config.viewMatrixRegister >= 0 ||
+                                   g_config.projMatrixRegister >= 0 || g_config.mvpMatrixRegister >= 0 ||
+                                   g_config.vpMatrixRegister >= 0 || g_config.mvMatrixRegister >= 0;
+    char inputs[256] = "";
+    if (manualBindings) strncat(inputs, " manual bindings,", sizeof(inputs) - strlen(inputs) - 1);
+    if (registerOverrides) strncat(inputs, " register overrides,", sizeof(inputs) - strlen(inputs) - 1);
+    if (g_forceFfpTransform) strncat(inputs, " forced FFP transform,", sizeof(inputs) - strlen(inputs) - 1);
+    if (g_config.experimentalCustomProjectionEnabled) strncat(inputs, " custom projection,", sizeof(inputs) - strlen(inputs) - 1);
+    if (g_enableShaderEditing) strncat(inputs, " constant overrides,", sizeof(inputs) - strlen(inputs) - 1);
+    if (disabledShaders || g_pauseRendering) strncat(inputs, " skipped draws,", sizeof(inputs) - strlen(inputs) - 1);
+    if (g_config.deferConstantClassification) strncat(inputs, " deferred classification,", sizeof(inputs) - strlen(inputs) - 1);
+    if (inputs[0] != '\0') {
+        inputs[strlen(inputs) - 1] = '\0';
+        LogMsg("Golden check: the replay will not match while these are active:%s", inputs);
+    }
+}
+
+static void StartApiTraceRecording() {
+    char path[MAX_PATH] = {};
+    BuildCapturePath("camera_proxy_api", "cpat", path, sizeof(path));
+    if (!g_apiTraceRecorder.Start(path)) {
+        snprintf(g_apiTraceStatus, sizeof(g_apiTraceStatus), "API trace failed: could not open %s", path);
+        LogMsg("API trace failed: could not open %s", path);
+        return;
+    }
+    // Shaders created before recording started still need their bytecode in the file.
+    for (const auto& entry : g_shaderRecords) {
+        const ShaderRecord& record = entry.second;
+        if (record.stage == ShaderStage_Vertex && !record.originalBytecode.empty()) {
+            g_apiTraceRecorder.RecordCreateVertexShader(ApiTraceShaderId(record.shaderKey),
+                                                        record.originalBytecode.data(),
+                                                        static_cast<uint32_t>(record.originalBytecode.size()));
+        }
+    }
+    g_apiTraceRecorder.RecordSetShader(ApiTraceStage::Vertex, ApiTraceShaderId(g_activeVertexShaderKey));
+    g_apiTraceRecorder.RecordSetShader(ApiTraceStage::Pixel, ApiTraceShaderId(g_activePixelShaderKey));
+    // Constants and the declaration are device state: open with the full register files
+    // so a replay starts from what the device holds, not from zeros.
+    float vertexRegisters[kMaxConstantRegisters][4] = {};
+    for (int reg = 0; reg < kMaxConstantRegisters; ++reg) {
+        memcpy(vertexRegisters[reg], g_allVertexRegisters[reg].value, sizeof(vertexRegisters[reg]));
+    }
+    g_apiTraceRecorder.RecordShaderConstantsF(ApiTraceStage::Vertex, 0, &vertexRegisters[0][0], kMaxConstantRegisters);
+    g_apiTraceRecorder.RecordShaderConstantsF(ApiTraceStage::Pixel, 0, &g_psConstants[0][0], kMaxConstantRegisters);
+    g_apiTraceRecorder.RecordVertexDeclaration(g_activeVertexDeclElementCount ? g_activeVertexDeclElements : nullptr,
+                                               g_activeVertexDeclElementCount);
+    snprintf(g_apiTraceStatus, sizeof(g_apiTraceStatus), "Recording API trace: %s", path);
+    LogMsg("API trace recording started: %s", path);
+
+    if (g_config.apiTraceRecordGolden) {
+        char goldenPath[MAX_PATH] = {};
+        BuildCapturePath("camera_proxy_golden", "cpgd", goldenPath, sizeof(goldenPath));
+        if (g_goldenWriter.Open(goldenPath)) {
+            g_goldenFrameBase = g_frameCount;
+            g_goldenRunSerial++;
+            LogMsg("Golden transform recording started: %s", goldenPath);
+            LogGoldenCheckCommand(path, goldenPath);
+        } else {
+            LogMsg("Golden transform recording failed: could not open %s", goldenPath);
+        }
+    }
+}
+
+static void StopApiTraceRecording() {
+    if (!g_apiTraceRecorder.IsRecording()) {
+        return;
+    }
+    g_apiTraceRecorder.Stop();
+    const ApiTraceStats stats = g_apiTraceRecorder.GetStats();
+    snprintf(g_apiTraceStatus, sizeof(g_apiTraceStatus),
+             "API trace stopped: %llu records, %.2f MB written",
+             static_cast<unsigned long long>(stats.records),
+             static_cast<double>(stats.fileBytes) / (1024.0 * 1024.0));
+    LogMsg("%s", g_apiTraceStatus);
+    if (g_goldenWriter.IsOpen()) {
+        g_goldenRunSerial++;
+        const unsigned long long goldenDraws = g_goldenWriter.GetDrawCount();
+        if (g_goldenWriter.Close()) {
+            LogMsg("Golden transform recording stopped: %llu draws", goldenDraws);
+        } else {
+            LogMsg("Golden transform recording failed while writing %llu draws", goldenDraws);
+        }
     }
 }
 
@@ -1601,18 +2143,21 @@ static void BuildShaderComboLabel(uintptr_t shaderKey, char* outLabel, size_t ou
 
 static void RefreshLogSnapshot() {
     std::lock_guard<std::mutex> lock(g_uiDataMutex);
-    g_logSnapshot.assign(g_logLines.begin(), g_logLines.end());
+    g_logSnapshot.resize(g_logLinesCount);
+    const size_t oldest = (g_logLinesHead + kMaxUiLogLines - g_logLinesCount) % kMaxUiLogLines;
+    for (size_t i = 0; i < g_logLinesCount; ++i) {
+        g_logSnapshot[i].assign(g_logLines[(oldest + i) % kMaxUiLogLines]);
+    }
     g_logSnapshotDirty = false;
 }
 
-static void UpdateMatrixSource(MatrixSlot slot,
-                               uintptr_t shaderKey,
-                               int baseRegister,
-                               int rows,
-                               bool transposed,
-                               bool manual,
-                               const char* sourceLabel,
-                               int extractedFromRegister) {
+static MatrixSourceInfo BuildMatrixSource(uintptr_t shaderKey,
+                                          int baseRegister,
+                                          int rows,
+                                          bool transposed,
+                                          bool manual,
+                                          const char* sourceLabel,
+                                          int extractedFromRegister) {
     MatrixSourceInfo info = {};
     info.valid = true;
     info.manual = manual;
@@ -1623,8 +2168,7 @@ static void UpdateMatrixSource(MatrixSlot slot,
     info.transposed = transposed;
     info.sourceLabel = sourceLabel ? sourceLabel : (manual ? "manual constants selection" : "auto/config detection");
     info.extractedFromRegister = extractedFromRegister >= 0 ? extractedFromRegister : baseRegister;
-    std::lock_guard<std::mutex> lock(g_cameraMatricesMutex);
-    g_matrixSources[slot] = info;
+    return info;
 }
 
 static void DrawMatrixSourceInfo(MatrixSlot slot, bool available) {
@@ -1632,24 +2176,20 @@ static void DrawMatrixSourceInfo(MatrixSlot slot, bool available) {
         return;
     }
 
-    MatrixSourceInfo source = {};
-    {
-        std::lock_guard<std::mutex> lock(g_cameraMatricesMutex);
-        source = g_matrixSources[slot];
-    }
+    const MatrixSourceInfo source = SnapshotMatrixSource(slot);
     if (!source.valid) {
         ImGui::Text("Source: <unknown>");
         return;
     }
 
-    uint32_t shaderHash = 0;
+    uint64_t shaderHash = 0;
     bool hasBytecodeHash = TryGetShaderBytecodeHash(source.shaderKey, &shaderHash);
     if (source.shaderKey == 0) {
         ImGui::Text("Source shader: <none/runtime>");
     } else {
         ImGui::Text("Source shader: %p", reinterpret_cast<void*>(source.shaderKey));
         if (hasBytecodeHash) {
-            ImGui::Text("Shader hash: 0x%08X", shaderHash);
+            ImGui::Text("Shader hash: %016llX", static_cast<unsigned long long>(shaderHash));
         } else if (source.shaderHash != 0) {
             ImGui::Text("Shader hash: 0x%08X (fallback)", source.shaderHash);
         } else {
@@ -1798,11 +2338,7 @@ static void ResetMatrixRegisterOverridesToAuto() {
 }
 
 static void PinRegisterFromSource(MatrixSlot slot) {
-    MatrixSourceInfo source = {};
-    {
-        std::lock_guard<std::mutex> lock(g_cameraMatricesMutex);
-        source = g_matrixSources[slot];
-    }
+    const MatrixSourceInfo source = SnapshotMatrixSource(slot);
     if (!source.valid || source.baseRegister < 0) {
         snprintf(g_matrixAssignStatus, sizeof(g_matrixAssignStatus),
                  "Cannot pin %s: no register-backed source available.", MatrixSlotLabel(slot));
@@ -1890,12 +2426,7 @@ static void TryAssignManualMatrixFromSelection(MatrixSlot slot,
 }
 
 static D3DMATRIX TransposeMatrix(const D3DMATRIX& mat) {
-    D3DMATRIX out = {};
-    out._11 = mat._11; out._12 = mat._21; out._13 = mat._31; out._14 = mat._41;
-    out._21 = mat._12; out._22 = mat._22; out._23 = mat._32; out._24 = mat._42;
-    out._31 = mat._13; out._32 = mat._23; out._33 = mat._33; out._34 = mat._43;
-    out._41 = mat._14; out._42 = mat._24; out._43 = mat._34; out._44 = mat._44;
-    return out;
+    return ToD3DMatrix(matrix_engine::TransposeMatrix(AsEngineMatrix(mat)));
 }
 
 static void DrawMatrixWithTranspose(const char* label, const D3DMATRIX& mat, bool available,
@@ -1936,10 +2467,11 @@ static ShaderConstantState* GetShaderState(uintptr_t shaderKey, bool createIfMis
     }
     g_shaderOrder.push_back(shaderKey);
     auto inserted = g_shaderConstants.emplace(shaderKey, ShaderConstantState{});
-    for (int i = 0; i < kMaxConstantRegisters; ++i) inserted.first->second.overrideExpiresAtFrame[i] = -1;
     return &inserted.first->second;
 }
 
+// Defined after WrappedD3D9Device: drops a device's cached pointers to a record about to be erased.
+static void ForgetShaderRecordOnDevices(const ShaderRecord* record);
 
 static void OnVertexShaderReleased(uintptr_t shaderKey) {
     if (shaderKey == 0) {
@@ -1956,7 +2488,8 @@ static void OnVertexShaderReleased(uintptr_t shaderKey) {
     ShaderRecord* removedRecordPtr = nullptr;
     if (recIt != g_shaderRecords.end()) {
         removedRecordPtr = &recIt->second;
-        if (g_selectedShaderHash == static_cast<uint64_t>(recIt->second.hash)) {
+        ForgetShaderRecordOnDevices(removedRecordPtr);
+        if (g_selectedShaderHash == recIt->second.hash) {
             g_selectedShaderHash = 0;
         }
         if (recIt->second.replacementShader) {
@@ -1972,108 +2505,479 @@ static void OnVertexShaderReleased(uintptr_t shaderKey) {
     }
 }
 
-static void RegisterShaderBytecode(uintptr_t shaderKey, ShaderStageType stage, const std::vector<uint32_t>& tokens) {
-    if (shaderKey == 0 || tokens.empty()) return;
-    if (g_shaderRecords.empty()) {
-        g_shaderRecords.reserve(1024);
-        g_shaderHashToKey.reserve(1024);
-        g_shaderBytecodeHashes.reserve(1024);
-        g_stableShaderList.reserve(1024);
-    }
-    auto existing = g_shaderRecords.find(shaderKey);
-    if (existing != g_shaderRecords.end()) {
-        return;
+// Decodes originalBytecode and fills every analysis field of `rec`. Touches nothing
+// but `rec`, so it runs on the analysis workers.
+static ShaderDecodeStatus AnalyseShaderRecord(ShaderRecord* rec, size_t* outErrorToken) {
+    ShaderProgram program;
+    const ShaderDecodeStatus status = DecodeShaderBytecode(rec->originalBytecode.data(), rec->originalBytecode.size(),
+                                                           &program, outErrorToken);
+    if (program.major != 0) {
+        char profile[32] = {};
+        FormatShaderModel(program, profile, sizeof(profile));
+        rec->shaderModel = profile;
     }
-    ShaderRecord rec = {};
-    rec.shaderKey = shaderKey;
-    rec.stage = stage;
-    rec.originalBytecode = tokens;
-    rec.hash = HashBytesFNV1a(reinterpret_cast<const uint8_t*>(tokens.data()), tokens.size() * sizeof(uint32_t));
-    uint32_t version = tokens[0];
-    char profile[32] = {};
-    const UINT major = (version >> 8) & 0xFF;
-    const UINT minor = version & 0xFF;
-    snprintf(profile, sizeof(profile), "%s_%u_%u", stage == ShaderStage_Vertex ? "vs" : "ps", major, minor);
-    rec.shaderModel = profile;
-    rec.cachedDisassembly = BuildD3DDisassembly(tokens);
-    {
-        std::istringstream disIn(rec.cachedDisassembly);
-        std::string disLine;
-        while (std::getline(disIn, disLine)) {
-            std::string trimmed = TrimCopy(disLine);
-            if (trimmed.empty() || trimmed[0] == '/' || trimmed[0] == ';') {
-                continue;
-            }
-            if (trimmed.rfind("vs_", 0) == 0 || trimmed.rfind("ps_", 0) == 0) {
-                rec.shaderModel = trimmed;
-            }
-            break;
+    rec->transformMap = ShaderTransformMap();
+    if (status == ShaderDecode_Ok) {
+        if (!program.isPixelShader) {
+            AnalyseShaderTransforms(program, &rec->transformMap);
         }
+        rec->ir = std::move(program.instructions);
     }
-    rec.ir = BuildIrFromDisassembly(rec.cachedDisassembly);
-    rec.editableAssembly = rec.cachedDisassembly;
-    ClassifyShaderRecord(&rec);
-    g_shaderBytecodeHashes[shaderKey] = rec.hash;
-    g_shaderHashToKey[rec.hash] = shaderKey;
-    auto inserted = g_shaderRecords.emplace(shaderKey, std::move(rec));
-    g_stableShaderList.push_back(&inserted.first->second);
-    if (g_selectedShaderHash == 0) {
-        g_selectedShaderHash = static_cast<uint64_t>(inserted.first->second.hash);
-    }
+    rec->instructionCount = static_cast<int>(rec->ir.size());
+    ClassifyShaderRecord(rec);
+    return status;
 }
 
-static uint32_t ComputeShaderBytecodeHash(IDirect3DVertexShader9* shader) {
-    if (!shader) {
-        return 0;
-    }
-    UINT size = 0;
-    if (FAILED(shader->GetFunction(nullptr, &size)) || size == 0) {
-        return 0;
-    }
-    std::vector<uint8_t> data(size);
-    if (FAILED(shader->GetFunction(data.data(), &size)) || size == 0) {
-        return 0;
-    }
-    return HashBytesFNV1a(data.data(), size);
+static void LogShaderDecodeFailure(const ShaderRecord& rec, ShaderDecodeStatus status, size_t errorToken) {
+    if (status == ShaderDecode_Ok) return;
+    LogMsg("Shader %016llX: bytecode decode failed (%s at token %zu); classification skipped.",
+           static_cast<unsigned long long>(rec.hash), ShaderDecodeStatusName(status), errorToken);
 }
 
-static bool TryBuildMatrix4x3FromSnapshot(const ShaderConstantState& state, int baseRegister,
-                                          bool transposed, D3DMATRIX* outMatrix) {
-    if (!outMatrix || !state.snapshotReady || baseRegister < 0 || baseRegister + 2 >= kMaxConstantRegisters) {
-        return false;
-    }
-    for (int i = 0; i < 3; i++) {
-        if (!state.valid[baseRegister + i]) {
-            return false;
-        }
+// Shader analysis worker pool. Create*Shader only copies the bytecode into a job; the
+// workers analyse a detached ShaderRecord and ApplyCompletedShaderAnalyses copies the
+// results onto the live record on the render thread, all fields at once.
+struct ShaderAnalysisJob {
+    uintptr_t shaderKey = 0;
+    uint64_t ticket = 0;
+    ShaderRecord analysed = {};
+    ShaderDecodeStatus status = ShaderDecode_Ok;
+    size_t errorToken = 0;
+};
+
+static std::mutex g_shaderAnalysisMutex;
+static std::condition_variable g_shaderAnalysisWake;
+static std::deque<ShaderAnalysisJob> g_shaderAnalysisQueue = {};
+static std::vector<ShaderAnalysisJob> g_shaderAnalysisDone = {};
+static std::vector<HANDLE> g_shaderAnalysisThreads = {};
+static bool g_shaderAnalysisStopping = false;
+static std::atomic<bool> g_shaderAnalysisResultsPending{false};
+static uint64_t g_nextShaderAnalysisTicket = 0;
+// Bumped whenever a queued analysis lands, so devices re-read the bound shader's record.
+static uint32_t g_shaderAnalysisEpoch = 0;
+
+// Analysis results and locked layouts persisted next to camera_proxy.ini. Periodic saves
+// run on a one-shot writer thread, which remaps g_shaderCache; g_shaderCacheMutex guards
+// every use of it after LoadShaderCache.
+static ShaderCache g_shaderCache;
+static std::mutex g_shaderCacheMutex;
+static bool g_shaderCacheDirty = false;
+static int g_shaderCacheSavedFrame = 0;
+static constexpr int kShaderCacheSaveIntervalFrames = 600;
+static HANDLE g_shaderCacheSaveThread = nullptr;
+static std::atomic<bool> g_shaderCacheSaveFailed{false};
+
+struct ShaderCacheSaveJob {
+    std::vector<ShaderCacheEntry> entries;
+    std::vector<ShaderCacheLayout> layouts;
+};
+
+static DWORD WINAPI ShaderAnalysisThread(LPVOID) {
+    for (;;) {
+        ShaderAnalysisJob job;
+        {
+            std::unique_lock<std::mutex> lock(g_shaderAnalysisMutex);
+            g_shaderAnalysisWake.wait(lock, [] { return g_shaderAnalysisStopping || !g_shaderAnalysisQueue.empty(); });
+            // Drain the queue before stopping so no record is left unanalysed.
+            if (g_shaderAnalysisQueue.empty()) {
+                return 0;
+            }
+            job = std::move(g_shaderAnalysisQueue.front());
+            g_shaderAnalysisQueue.pop_front();
+        }
+        job.status = AnalyseShaderRecord(&job.analysed, &job.errorToken);
+        // The live record keeps its own copy of the bytecode.
+        job.analysed.originalBytecode.clear();
+        job.analysed.originalBytecode.shrink_to_fit();
+        std::lock_guard<std::mutex> lock(g_shaderAnalysisMutex);
+        g_shaderAnalysisDone.push_back(std::move(job));
+        g_shaderAnalysisResultsPending.store(true, std::memory_order_release);
     }
+}
+
+static void StartShaderAnalysisThreads() {
+    const int count = g_config.shaderAnalysisThreads;
+    for (int i = 0; i < count; ++i) {
+        HANDLE thread = CreateThread(nullptr, 0, ShaderAnalysisThread, nullptr, 0, nullptr);
+        if (!thread) {
+            LogMsg("WARNING: Failed to create shader analysis thread %d.", i);
+            break;
+        }
+        g_shaderAnalysisThreads.push_back(thread);
+    }
+}
 
-    D3DMATRIX m = {};
-    if (!transposed) {
-        m._11 = state.constants[baseRegister + 0][0]; m._12 = state.constants[baseRegister + 0][1]; m._13 = state.constants[baseRegister + 0][2]; m._14 = state.constants[baseRegister + 0][3];
-        m._21 = state.constants[baseRegister + 1][0]; m._22 = state.constants[baseRegister + 1][1]; m._23 = state.constants[baseRegister + 1][2]; m._24 = state.constants[baseRegister + 1][3];
-        m._31 = state.constants[baseRegister + 2][0]; m._32 = state.constants[baseRegister + 2][1]; m._33 = state.constants[baseRegister + 2][2]; m._34 = state.constants[baseRegister + 2][3];
-        m._41 = 0.0f; m._42 = 0.0f; m._43 = 0.0f; m._44 = 1.0f;
+// Blocks until every queued shader is analysed. Results stay in g_shaderAnalysisDone.
+static void StopShaderAnalysisThreads() {
+    if (g_shaderAnalysisThreads.empty()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(g_shaderAnalysisMutex);
+        g_shaderAnalysisStopping = true;
+    }
+    g_shaderAnalysisWake.notify_all();
+    WaitForMultipleObjects(static_cast<DWORD>(g_shaderAnalysisThreads.size()), g_shaderAnalysisThreads.data(),
+                           TRUE, INFINITE);
+    for (HANDLE thread : g_shaderAnalysisThreads) {
+        CloseHandle(thread);
+    }
+    g_shaderAnalysisThreads.clear();
+    std::lock_guard<std::mutex> lock(g_shaderAnalysisMutex);
+    g_shaderAnalysisStopping = false;
+}
+
+static void QueueShaderAnalysis(ShaderRecord* rec) {
+    ShaderAnalysisJob job;
+    job.shaderKey = rec->shaderKey;
+    job.ticket = ++g_nextShaderAnalysisTicket;
+    job.analysed.stage = rec->stage;
+    job.analysed.hash = rec->hash;
+    job.analysed.originalBytecode = rec->originalBytecode;
+    rec->analysisTicket = job.ticket;
+    if (g_shaderAnalysisThreads.empty()) {
+        StartShaderAnalysisThreads();
+    }
+    if (g_shaderAnalysisThreads.empty()) {
+        job.status = AnalyseShaderRecord(&job.analysed, &job.errorToken);
+        std::lock_guard<std::mutex> lock(g_shaderAnalysisMutex);
+        g_shaderAnalysisDone.push_back(std::move(job));
+        g_shaderAnalysisResultsPending.store(true, std::memory_order_release);
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(g_shaderAnalysisMutex);
+        g_shaderAnalysisQueue.push_back(std::move(job));
+    }
+    g_shaderAnalysisWake.notify_one();
+}
+
+static void ApplyShaderAnalysis(ShaderRecord* rec, ShaderRecord& analysed) {
+    rec->shaderModel = std::move(analysed.shaderModel);
+    rec->ir = std::move(analysed.ir);
+    rec->instructionCount = analysed.instructionCount;
+    rec->transformMap = analysed.transformMap;
+    rec->isFFPTransform = analysed.isFFPTransform;
+    rec->isFFPLighting = analysed.isFFPLighting;
+    rec->usesSkinning = analysed.usesSkinning;
+    rec->usesFlowControl = analysed.usesFlowControl;
+    rec->isRemixSafe = analysed.isRemixSafe;
+    rec->transformConstantBase = analysed.transformConstantBase;
+    rec->transformTransposed = analysed.transformTransposed;
+    rec->lightingConstantBase = analysed.lightingConstantBase;
+    rec->lightDirectionRegister = analysed.lightDirectionRegister;
+    rec->lightColorRegister = analysed.lightColorRegister;
+    rec->materialColorRegister = analysed.materialColorRegister;
+    rec->attenuationRegister = analysed.attenuationRegister;
+    rec->positionRegister = analysed.positionRegister;
+    rec->coneAngleRegister = analysed.coneAngleRegister;
+    rec->lightSpace = analysed.lightSpace;
+    // Uploads seen while the shader was queued stay marked.
+    for (int i = 0; i < kMaxConstantRegisters; ++i) {
+        rec->constantUsage[i] = rec->constantUsage[i] || analysed.constantUsage[i];
+    }
+    memcpy(rec->constantReads, analysed.constantReads, sizeof(rec->constantReads));
+    rec->constantReadsKnown = analysed.constantReadsKnown;
+    rec->analysed = true;
+}
+
+// Render thread only. Cheap when nothing finished since the last call.
+static void ApplyCompletedShaderAnalyses() {
+    if (!g_shaderAnalysisResultsPending.load(std::memory_order_acquire)) {
+        return;
+    }
+    std::vector<ShaderAnalysisJob> done;
+    {
+        std::lock_guard<std::mutex> lock(g_shaderAnalysisMutex);
+        done.swap(g_shaderAnalysisDone);
+        g_shaderAnalysisResultsPending.store(false, std::memory_order_relaxed);
+    }
+    for (ShaderAnalysisJob& job : done) {
+        auto it = g_shaderRecords.find(job.shaderKey);
+        if (it == g_shaderRecords.end() || it->second.analysisTicket != job.ticket) {
+            continue;
+        }
+        LogShaderDecodeFailure(it->second, job.status, job.errorToken);
+        ApplyShaderAnalysis(&it->second, job.analysed);
+        g_shaderCacheDirty = true;
+        g_shaderAnalysisEpoch++;
+    }
+}
+
+static void PackRegisterBits(const bool* registers, uint32_t* outBits) {
+    for (int r = 0; r < kMaxConstantRegisters; ++r) {
+        if (registers[r]) outBits[r >> 5] |= 1u << (r & 31);
+    }
+}
+
+static void UnpackRegisterBits(const uint32_t* bits, bool* outRegisters) {
+    for (int r = 0; r < kMaxConstantRegisters; ++r) {
+        outRegisters[r] = outRegisters[r] || (bits[r >> 5] & (1u << (r & 31))) != 0;
+    }
+}
+
+static ShaderCacheEntry BuildShaderCacheEntry(const ShaderRecord& rec) {
+    ShaderCacheEntry entry;
+    entry.hash = rec.hash;
+    entry.tokenCount = static_cast<uint32_t>(rec.originalBytecode.size());
+    entry.instructionCount = static_cast<uint32_t>(rec.instructionCount);
+    if (rec.stage == ShaderStage_Pixel) entry.flags |= ShaderCacheFlag_PixelShader;
+    if (rec.isFFPTransform) entry.flags |= ShaderCacheFlag_FFPTransform;
+    if (rec.isFFPLighting) entry.flags |= ShaderCacheFlag_FFPLighting;
+    if (rec.usesSkinning) entry.flags |= ShaderCacheFlag_Skinning;
+    if (rec.usesFlowControl) entry.flags |= ShaderCacheFlag_FlowControl;
+    if (rec.isRemixSafe) entry.flags |= ShaderCacheFlag_RemixSafe;
+    if (rec.constantReadsKnown) entry.flags |= ShaderCacheFlag_ConstantReadsKnown;
+    entry.roles[ShaderCacheRole_TransformBase] = static_cast<int16_t>(rec.transformConstantBase);
+    entry.roles[ShaderCacheRole_LightingBase] = static_cast<int16_t>(rec.lightingConstantBase);
+    entry.roles[ShaderCacheRole_LightDirection] = static_cast<int16_t>(rec.lightDirectionRegister);
+    entry.roles[ShaderCacheRole_LightColor] = static_cast<int16_t>(rec.lightColorRegister);
+    entry.roles[ShaderCacheRole_MaterialColor] = static_cast<int16_t>(rec.materialColorRegister);
+    entry.roles[ShaderCacheRole_Attenuation] = static_cast<int16_t>(rec.attenuationRegister);
+    entry.roles[ShaderCacheRole_Position] = static_cast<int16_t>(rec.positionRegister);
+    entry.roles[ShaderCacheRole_ConeAngle] = static_cast<int16_t>(rec.coneAngleRegister);
+    entry.overrides[ShaderCacheOverride_LightDirection] = static_cast<int16_t>(rec.lightDirectionRegisterOverride);
+    entry.overrides[ShaderCacheOverride_LightColor] = static_cast<int16_t>(rec.lightColorRegisterOverride);
+    entry.overrides[ShaderCacheOverride_MaterialColor] = static_cast<int16_t>(rec.materialColorRegisterOverride);
+    entry.overrides[ShaderCacheOverride_Position] = static_cast<int16_t>(rec.positionRegisterOverride);
+    entry.overrides[ShaderCacheOverride_Attenuation] = static_cast<int16_t>(rec.attenuationRegisterOverride);
+    entry.overrides[ShaderCacheOverride_ConeAngle] = static_cast<int16_t>(rec.coneAngleRegisterOverride);
+    entry.overrides[ShaderCacheOverride_LightCount] = static_cast<int16_t>(rec.lightCountOverride);
+    entry.lightSpace = static_cast<int8_t>(rec.lightSpace);
+    entry.lightSpaceOverride = static_cast<int8_t>(rec.lightSpaceOverride);
+    snprintf(entry.shaderModel, sizeof(entry.shaderModel), "%s", rec.shaderModel.c_str());
+    PackRegisterBits(rec.constantUsage, entry.constantUsage);
+    PackRegisterBits(rec.constantReads, entry.constantReads);
+    const ShaderTransformMap& map = rec.transformMap;
+    if (map.complete) entry.transformFlags |= ShaderCacheTransform_Complete;
+    if (map.ambiguousSplit) entry.transformFlags |= ShaderCacheTransform_AmbiguousSplit;
+    if (map.skinned) entry.transformFlags |= ShaderCacheTransform_Skinned;
+    entry.matrixUseCount = map.useCount;
+    entry.stageCount = map.stageCount;
+    entry.positionInput = map.positionInput;
+    entry.worldTemp = map.worldTemp;
+    entry.viewTemp = map.viewTemp;
+    for (int i = 0; i < map.useCount; ++i) {
+        entry.matrixUses[i].baseRegister = map.uses[i].baseRegister;
+        entry.matrixUses[i].rows = map.uses[i].rows;
+        entry.matrixUses[i].role = map.uses[i].role;
+        entry.matrixUses[i].stage = map.uses[i].stage;
+        entry.matrixUses[i].relative = map.uses[i].relative ? 1 : 0;
+        entry.matrixUses[i].transposed = map.uses[i].transposed ? 1 : 0;
+    }
+    return entry;
+}
+
+static void ApplyShaderCacheEntry(ShaderRecord* rec, const ShaderCacheEntry& entry) {
+    char model[sizeof(entry.shaderModel) + 1] = {};
+    memcpy(model, entry.shaderModel, sizeof(entry.shaderModel));
+    rec->shaderModel = model;
+    rec->instructionCount = static_cast<int>(entry.instructionCount);
+    rec->isFFPTransform = (entry.flags & ShaderCacheFlag_FFPTransform) != 0;
+    rec->isFFPLighting = (entry.flags & ShaderCacheFlag_FFPLighting) != 0;
+    rec->usesSkinning = (entry.flags & ShaderCacheFlag_Skinning) != 0;
+    rec->usesFlowControl = (entry.flags & ShaderCacheFlag_FlowControl) != 0;
+    rec->isRemixSafe = (entry.flags & ShaderCacheFlag_RemixSafe) != 0;
+    rec->constantReadsKnown = (entry.flags & ShaderCacheFlag_ConstantReadsKnown) != 0;
+    rec->transformConstantBase = entry.roles[ShaderCacheRole_TransformBase];
+    rec->lightingConstantBase = entry.roles[ShaderCacheRole_LightingBase];
+    rec->lightDirectionRegister = entry.roles[ShaderCacheRole_LightDirection];
+    rec->lightColorRegister = entry.roles[ShaderCacheRole_LightColor];
+    rec->materialColorRegister = entry.roles[ShaderCacheRole_MaterialColor];
+    rec->attenuationRegister = entry.roles[ShaderCacheRole_Attenuation];
+    rec->positionRegister = entry.roles[ShaderCacheRole_Position];
+    rec->coneAngleRegister = entry.roles[ShaderCacheRole_ConeAngle];
+    rec->lightDirectionRegisterOverride = entry.overrides[ShaderCacheOverride_LightDirection];
+    rec->lightColorRegisterOverride = entry.overrides[ShaderCacheOverride_LightColor];
+    rec->materialColorRegisterOverride = entry.overrides[ShaderCacheOverride_MaterialColor];
+    rec->positionRegisterOverride = entry.overrides[ShaderCacheOverride_Position];
+    rec->attenuationRegisterOverride = entry.overrides[ShaderCacheOverride_Attenuation];
+    rec->coneAngleRegisterOverride = entry.overrides[ShaderCacheOverride_ConeAngle];
+    rec->lightCountOverride = entry.overrides[ShaderCacheOverride_LightCount];
+    rec->lightSpace = static_cast<LightingSpace>(entry.lightSpace);
+    rec->lightSpaceOverride = static_cast<LightingSpace>(entry.lightSpaceOverride);
+    UnpackRegisterBits(entry.constantUsage, rec->constantUsage);
+    memset(rec->constantReads, 0, sizeof(rec->constantReads));
+    UnpackRegisterBits(entry.constantReads, rec->constantReads);
+    ShaderTransformMap& map = rec->transformMap;
+    map = ShaderTransformMap();
+    map.complete = (entry.transformFlags & ShaderCacheTransform_Complete) != 0;
+    map.ambiguousSplit = (entry.transformFlags & ShaderCacheTransform_AmbiguousSplit) != 0;
+    map.skinned = (entry.transformFlags & ShaderCacheTransform_Skinned) != 0;
+    map.useCount = (std::min)(entry.matrixUseCount, static_cast<uint8_t>(kShaderMaxMatrixUses));
+    map.stageCount = entry.stageCount;
+    map.positionInput = entry.positionInput;
+    map.worldTemp = entry.worldTemp;
+    map.viewTemp = entry.viewTemp;
+    for (int i = 0; i < map.useCount; ++i) {
+        map.uses[i].baseRegister = entry.matrixUses[i].baseRegister;
+        map.uses[i].rows = entry.matrixUses[i].rows;
+        map.uses[i].role = entry.matrixUses[i].role;
+        map.uses[i].stage = entry.matrixUses[i].stage;
+        map.uses[i].relative = entry.matrixUses[i].relative != 0;
+        map.uses[i].transposed = entry.matrixUses[i].transposed != 0;
+    }
+    const ShaderMatrixUse* transformUse = FindShaderMatrixUse(map, rec->transformConstantBase);
+    rec->transformTransposed = rec->isFFPTransform && transformUse && transformUse->transposed;
+    rec->analysed = true;
+}
+
+// Cached layouts start locked; the drift check still sends a stale one back to scanning.
+static void SeedLearnedLayoutsFromShaderCache() {
+    size_t count = 0;
+    const ShaderCacheLayout* layouts = g_shaderCache.GetLayouts(&count);
+    for (size_t i = 0; i < count; ++i) {
+        LearnedUploadLayout& layout = g_learnedUploadLayouts[layouts[i].key];
+        for (int slot = 0; slot < 3; ++slot) {
+            const ShaderCacheLayoutSlot& cached = layouts[i].slots[slot];
+            layout.slots[slot].valid = (cached.flags & ShaderCacheSlot_Valid) != 0;
+            layout.slots[slot].baseRegister = cached.baseRegister;
+            layout.slots[slot].rows = cached.rows;
+            layout.slots[slot].transposed = (cached.flags & ShaderCacheSlot_Transposed) != 0;
+            layout.slots[slot].inverted = (cached.flags & ShaderCacheSlot_Inverted) != 0;
+        }
+        layout.consistentFrames = (std::max)(1, g_config.layoutLearnFrames);
+        layout.locked = true;
+    }
+}
+
+static void LoadShaderCache() {
+    if (!g_config.shaderCache) {
+        return;
+    }
+    char path[MAX_PATH] = {};
+    snprintf(path, sizeof(path), "%s", g_iniPath[0] ? g_iniPath : "camera_proxy.ini");
+    char* lastSlash = strrchr(path, '\\');
+    char* fileName = lastSlash ? lastSlash + 1 : path;
+    snprintf(fileName, sizeof(path) - static_cast<size_t>(fileName - path), "%s", "camera_proxy_shaders.cache");
+    if (g_shaderCache.Open(path, kShaderAnalysisVersion)) {
+        size_t layoutCount = 0;
+        g_shaderCache.GetLayouts(&layoutCount);
+        SeedLearnedLayoutsFromShaderCache();
+        LogMsg("Shader cache: %zu shaders, %zu locked layouts from %s", g_shaderCache.GetEntryCount(), layoutCount, path);
     } else {
-        m._11 = state.constants[baseRegister + 0][0]; m._21 = state.constants[baseRegister + 0][1]; m._31 = state.constants[baseRegister + 0][2]; m._41 = state.constants[baseRegister + 0][3];
-        m._12 = state.constants[baseRegister + 1][0]; m._22 = state.constants[baseRegister + 1][1]; m._32 = state.constants[baseRegister + 1][2]; m._42 = state.constants[baseRegister + 1][3];
-        m._13 = state.constants[baseRegister + 2][0]; m._23 = state.constants[baseRegister + 2][1]; m._33 = state.constants[baseRegister + 2][2]; m._43 = state.constants[baseRegister + 2][3];
-        m._14 = 0.0f; m._24 = 0.0f; m._34 = 0.0f; m._44 = 1.0f;
+        LogMsg("Shader cache: starting empty (%s)", path);
+    }
+}
+
+static DWORD WINAPI ShaderCacheSaveThread(LPVOID param) {
+    std::unique_ptr<ShaderCacheSaveJob> job(static_cast<ShaderCacheSaveJob*>(param));
+    std::lock_guard<std::mutex> lock(g_shaderCacheMutex);
+    if (!g_shaderCache.Save(&job->entries, &job->layouts)) {
+        g_shaderCacheSaveFailed.store(true, std::memory_order_relaxed);
+    }
+    return 0;
+}
+
+// Reaps a finished writer thread; with `wait` it blocks until the writer is done. Returns
+// false while a write is still in flight.
+static bool ReapShaderCacheSave(bool wait) {
+    if (g_shaderCacheSaveThread) {
+        if (WaitForSingleObject(g_shaderCacheSaveThread, wait ? INFINITE : 0) == WAIT_TIMEOUT) {
+            return false;
+        }
+        CloseHandle(g_shaderCacheSaveThread);
+        g_shaderCacheSaveThread = nullptr;
+    }
+    if (g_shaderCacheSaveFailed.exchange(false, std::memory_order_relaxed)) {
+        LogMsg("Shader cache: failed to save");
     }
-    *outMatrix = m;
     return true;
 }
 
+// Writes every analysed live shader and every locked layout. Shaders cached by an
+// earlier run but not created in this one are carried over by ShaderCache::Save. The
+// render thread only snapshots the records; `background` hands the file write to a
+// writer thread and skips the save while the previous one is still running.
+static void SaveShaderCache(bool background) {
+    if (!ReapShaderCacheSave(!background)) {
+        return;
+    }
+    g_shaderCacheDirty = false;
+    g_shaderCacheSavedFrame = g_frameCount;
+    if (!g_config.shaderCache) {
+        return;
+    }
+    std::unique_ptr<ShaderCacheSaveJob> job(new ShaderCacheSaveJob());
+    job->entries.reserve(g_shaderRecords.size());
+    for (const auto& entry : g_shaderRecords) {
+        if (entry.second.analysed) {
+            job->entries.push_back(BuildShaderCacheEntry(entry.second));
+        }
+    }
+    for (const auto& entry : g_learnedUploadLayouts) {
+        if (!entry.second.locked) continue;
+        ShaderCacheLayout cached;
+        cached.key = entry.first;
+        for (int slot = 0; slot < 3; ++slot) {
+            const LearnedMatrixSlot& learned = entry.second.slots[slot];
+            cached.slots[slot].baseRegister = static_cast<int16_t>(learned.baseRegister);
+            cached.slots[slot].rows = static_cast<uint8_t>(learned.rows);
+            cached.slots[slot].flags = static_cast<uint8_t>((learned.valid ? ShaderCacheSlot_Valid : 0) |
+                                                            (learned.transposed ? ShaderCacheSlot_Transposed : 0) |
+                                                            (learned.inverted ? ShaderCacheSlot_Inverted : 0));
+        }
+        job->layouts.push_back(cached);
+    }
+    if (background) {
+        g_shaderCacheSaveThread = CreateThread(nullptr, 0, ShaderCacheSaveThread, job.get(), 0, nullptr);
+        if (g_shaderCacheSaveThread) {
+            job.release();
+            return;
+        }
+    }
+    ShaderCacheSaveThread(job.release());
+    ReapShaderCacheSave(true);
+}
+
+static void RegisterShaderBytecode(uintptr_t shaderKey, ShaderStageType stage, const std::vector<uint32_t>& tokens) {
+    if (shaderKey == 0 || tokens.empty()) return;
+    if (g_shaderRecords.empty()) {
+        g_shaderRecords.reserve(1024);
+        g_shaderHashToKey.reserve(1024);
+        g_shaderBytecodeHashes.reserve(1024);
+        g_stableShaderList.reserve(1024);
+    }
+    auto existing = g_shaderRecords.find(shaderKey);
+    if (existing != g_shaderRecords.end()) {
+        return;
+    }
+    ShaderRecord rec = {};
+    rec.shaderKey = shaderKey;
+    rec.stage = stage;
+    rec.originalBytecode = tokens;
+    rec.hash = FastHash64(tokens.data(), tokens.size() * sizeof(uint32_t));
+    bool cached = false;
+    {
+        std::lock_guard<std::mutex> lock(g_shaderCacheMutex);
+        const ShaderCacheEntry* entry = g_shaderCache.Find(rec.hash, static_cast<uint32_t>(tokens.size()));
+        if (entry) {
+            ApplyShaderCacheEntry(&rec, *entry);
+            cached = true;
+        }
+    }
+    if (cached) {
+        // Analysis restored from the cache.
+    } else if (g_config.shaderAnalysisThreads > 0) {
+        QueueShaderAnalysis(&rec);
+    } else {
+        size_t errorToken = 0;
+        const ShaderDecodeStatus status = AnalyseShaderRecord(&rec, &errorToken);
+        LogShaderDecodeFailure(rec, status, errorToken);
+        rec.analysed = true;
+        g_shaderCacheDirty = true;
+    }
+    g_shaderBytecodeHashes[shaderKey] = rec.hash;
+    g_shaderHashToKey[rec.hash] = shaderKey;
+    auto inserted = g_shaderRecords.emplace(shaderKey, std::move(rec));
+    g_stableShaderList.push_back(&inserted.first->second);
+    if (g_selectedShaderHash == 0) {
+        g_selectedShaderHash = inserted.first->second.hash;
+    }
+}
+
 static D3DMATRIX InvertSimpleRigidView(const D3DMATRIX& view) {
-    D3DMATRIX out = {};
-    out._11 = view._11; out._12 = view._21; out._13 = view._31;
-    out._21 = view._12; out._22 = view._22; out._23 = view._32;
-    out._31 = view._13; out._32 = view._23; out._33 = view._33;
-    out._44 = 1.0f;
-    out._41 = -(view._41 * out._11 + view._42 * out._21 + view._43 * out._31);
-    out._42 = -(view._41 * out._12 + view._42 * out._22 + view._43 * out._32);
-    out._43 = -(view._41 * out._13 + view._42 * out._23 + view._43 * out._33);
-    return out;
+    return ToD3DMatrix(matrix_engine::InvertSimpleRigidView(AsEngineMatrix(view)));
 }
 
 static const char* GameProfileLabel(GameProfileKind profile) {
@@ -2108,165 +3012,13 @@ static GameProfileKind ParseGameProfile(const char* profileName) {
     return GameProfile_None;
 }
 
-static void ConfigureActiveProfileLayout() {
-    g_profileLayout = {};
-    if (g_activeGameProfile == GameProfile_MetalGearRising) {
-        g_profileLayout.projectionBase = 4;
-        g_profileLayout.viewProjectionBase = 8;
-        g_profileLayout.viewInverseBase = 12;
-        g_profileLayout.worldBase = 16;
-        g_profileLayout.worldViewBase = 20;
-    } else if (g_activeGameProfile == GameProfile_DevilMayCry4) {
-        // Original DMC4 fixed layout.
-        g_profileLayout.combinedMvpBase = 0;
-        g_profileLayout.worldBase = 0;
-        g_profileLayout.viewInverseBase = 4;
-        g_profileLayout.projectionBase = 8;
-    }
-}
-
 static bool InvertMatrix4x4Deterministic(const D3DMATRIX& in, D3DMATRIX* out, float* outDeterminant) {
-    if (!out) {
-        return false;
-    }
-
-    const float* m = reinterpret_cast<const float*>(&in);
-    float inv[16] = {};
-
-    inv[0] = m[5]  * m[10] * m[15] -
-             m[5]  * m[11] * m[14] -
-             m[9]  * m[6]  * m[15] +
-             m[9]  * m[7]  * m[14] +
-             m[13] * m[6]  * m[11] -
-             m[13] * m[7]  * m[10];
-
-    inv[4] = -m[4]  * m[10] * m[15] +
-              m[4]  * m[11] * m[14] +
-              m[8]  * m[6]  * m[15] -
-              m[8]  * m[7]  * m[14] -
-              m[12] * m[6]  * m[11] +
-              m[12] * m[7]  * m[10];
-
-    inv[8] = m[4]  * m[9] * m[15] -
-             m[4]  * m[11] * m[13] -
-             m[8]  * m[5] * m[15] +
-             m[8]  * m[7] * m[13] +
-             m[12] * m[5] * m[11] -
-             m[12] * m[7] * m[9];
-
-    inv[12] = -m[4]  * m[9] * m[14] +
-               m[4]  * m[10] * m[13] +
-               m[8]  * m[5] * m[14] -
-               m[8]  * m[6] * m[13] -
-               m[12] * m[5] * m[10] +
-               m[12] * m[6] * m[9];
-
-    inv[1] = -m[1]  * m[10] * m[15] +
-              m[1]  * m[11] * m[14] +
-              m[9]  * m[2] * m[15] -
-              m[9]  * m[3] * m[14] -
-              m[13] * m[2] * m[11] +
-              m[13] * m[3] * m[10];
-
-    inv[5] = m[0]  * m[10] * m[15] -
-             m[0]  * m[11] * m[14] -
-             m[8]  * m[2] * m[15] +
-             m[8]  * m[3] * m[14] +
-             m[12] * m[2] * m[11] -
-             m[12] * m[3] * m[10];
-
-    inv[9] = -m[0]  * m[9] * m[15] +
-              m[0]  * m[11] * m[13] +
-              m[8]  * m[1] * m[15] -
-              m[8]  * m[3] * m[13] -
-              m[12] * m[1] * m[11] +
-              m[12] * m[3] * m[9];
-
-    inv[13] = m[0]  * m[9] * m[14] -
-              m[0]  * m[10] * m[13] -
-              m[8]  * m[1] * m[14] +
-              m[8]  * m[2] * m[13] +
-              m[12] * m[1] * m[10] -
-              m[12] * m[2] * m[9];
-
-    inv[2] = m[1]  * m[6] * m[15] -
-             m[1]  * m[7] * m[14] -
-             m[5]  * m[2] * m[15] +
-             m[5]  * m[3] * m[14] +
-             m[13] * m[2] * m[7] -
-             m[13] * m[3] * m[6];
-
-    inv[6] = -m[0]  * m[6] * m[15] +
-              m[0]  * m[7] * m[14] +
-              m[4]  * m[2] * m[15] -
-              m[4]  * m[3] * m[14] -
-              m[12] * m[2] * m[7] +
-              m[12] * m[3] * m[6];
-
-    inv[10] = m[0]  * m[5] * m[15] -
-              m[0]  * m[7] * m[13] -
-              m[4]  * m[1] * m[15] +
-              m[4]  * m[3] * m[13] +
-              m[12] * m[1] * m[7] -
-              m[12] * m[3] * m[5];
-
-    inv[14] = -m[0]  * m[5] * m[14] +
-               m[0]  * m[6] * m[13] +
-               m[4]  * m[1] * m[14] -
-               m[4]  * m[2] * m[13] -
-               m[12] * m[1] * m[6] +
-               m[12] * m[2] * m[5];
-
-    inv[3] = -m[1] * m[6] * m[11] +
-              m[1] * m[7] * m[10] +
-              m[5] * m[2] * m[11] -
-              m[5] * m[3] * m[10] -
-              m[9] * m[2] * m[7] +
-              m[9] * m[3] * m[6];
-
-    inv[7] = m[0] * m[6] * m[11] -
-             m[0] * m[7] * m[10] -
-             m[4] * m[2] * m[11] +
-             m[4] * m[3] * m[10] +
-             m[8] * m[2] * m[7] -
-             m[8] * m[3] * m[6];
-
-    inv[11] = -m[0] * m[5] * m[11] +
-               m[0] * m[7] * m[9] +
-               m[4] * m[1] * m[11] -
-               m[4] * m[3] * m[9] -
-               m[8] * m[1] * m[7] +
-               m[8] * m[3] * m[5];
-
-    inv[15] = m[0] * m[5] * m[10] -
-              m[0] * m[6] * m[9] -
-              m[4] * m[1] * m[10] +
-              m[4] * m[2] * m[9] +
-              m[8] * m[1] * m[6] -
-              m[8] * m[2] * m[5];
-
-    float det = m[0] * inv[0] + m[1] * inv[4] + m[2] * inv[8] + m[3] * inv[12];
-    if (outDeterminant) {
-        *outDeterminant = det;
-    }
-    if (fabsf(det) <= 1e-8f) {
-        return false;
-    }
-
-    const float detInv = 1.0f / det;
-    float* dst = reinterpret_cast<float*>(out);
-    for (int i = 0; i < 16; i++) {
-        dst[i] = inv[i] * detInv;
-    }
-    return true;
+    return matrix_engine::InvertMatrix4x4Deterministic(AsEngineMatrix(in), AsEngineMatrix(out), outDeterminant);
 }
 
 static void ClearAllShaderOverrides() {
     for (auto& entry : g_shaderConstants) {
-        ShaderConstantState& state = entry.second;
-        memset(state.overrideConstants, 0, sizeof(state.overrideConstants));
-        memset(state.overrideValid, 0, sizeof(state.overrideValid));
-        for (int i = 0; i < kMaxConstantRegisters; ++i) state.overrideExpiresAtFrame[i] = -1;
+        entry.second.ClearAllOverrides();
     }
 }
 
@@ -2278,17 +3030,18 @@ static void ClearShaderRegisterOverride(uintptr_t shaderKey, int reg) {
     if (!state) {
         return;
     }
-    memset(state->overrideConstants[reg], 0, sizeof(state->overrideConstants[reg]));
-    state->overrideValid[reg] = false;
-    state->overrideExpiresAtFrame[reg] = -1;
+    state->ClearOverride(reg);
 }
 
 static bool BuildOverriddenConstants(ShaderConstantState& state,
                                      UINT startRegister,
                                      UINT vector4fCount,
                                      const float* sourceData,
-                                     std::vector<float>& scratch) {
-    if (!g_enableShaderEditing || !sourceData || vector4fCount == 0) {
+                                     float* scratch,
+                                     UINT scratchVectors) {
+    // Uploads larger than the scratch arena only happen with software vertex processing
+    // and are forwarded without overrides.
+    if (!g_enableShaderEditing || !sourceData || vector4fCount == 0 || vector4fCount > scratchVectors) {
         return false;
     }
 
@@ -2298,7 +3051,7 @@ static bool BuildOverriddenConstants(ShaderConstantState& state,
         if (reg >= kMaxConstantRegisters) {
             break;
         }
-        if (state.overrideValid[reg]) {
+        if (state.HasOverride(static_cast<int>(reg))) {
             hasOverride = true;
             break;
         }
@@ -2307,22 +3060,21 @@ static bool BuildOverriddenConstants(ShaderConstantState& state,
         return false;
     }
 
-    scratch.assign(sourceData, sourceData + vector4fCount * 4);
+    memcpy(scratch, sourceData, vector4fCount * 4 * sizeof(float));
     for (UINT i = 0; i < vector4fCount; i++) {
         UINT reg = startRegister + i;
         if (reg >= kMaxConstantRegisters) {
             break;
         }
-        if (!state.overrideValid[reg]) {
+        if (!state.HasOverride(static_cast<int>(reg))) {
             continue;
         }
 
-        memcpy(&scratch[i * 4], state.overrideConstants[reg], sizeof(state.overrideConstants[reg]));
+        memcpy(&scratch[i * 4], state.GetOverride(static_cast<int>(reg)), 4 * sizeof(float));
 
-        if (state.overrideExpiresAtFrame[reg] >= 0 &&
-            g_frameCount >= state.overrideExpiresAtFrame[reg]) {
-            state.overrideValid[reg] = false;
-            state.overrideExpiresAtFrame[reg] = -1;
+        const int expiresAtFrame = state.GetOverrideExpiry(static_cast<int>(reg));
+        if (expiresAtFrame >= 0 && g_frameCount >= expiresAtFrame) {
+            state.ClearOverride(static_cast<int>(reg));
             continue;
         }
     }
@@ -2330,72 +3082,57 @@ static bool BuildOverriddenConstants(ShaderConstantState& state,
 }
 
 static void UpdateVariance(ShaderConstantState& state, int reg, const float* values) {
-    state.sampleCounts[reg]++;
+    if (!g_config.trackConstantVariance) {
+        return;
+    }
+    ConstantVariancePage* page = state.GetVariancePage(reg, true);
+    const int index = reg % kConstantPageRegisters;
+    page->sampleCounts[index]++;
     for (int i = 0; i < 4; i++) {
         double value = static_cast<double>(values[i]);
-        double delta = value - state.mean[reg][i];
-        state.mean[reg][i] += delta / static_cast<double>(state.sampleCounts[reg]);
-        double delta2 = value - state.mean[reg][i];
-        state.m2[reg][i] += delta * delta2;
+        double delta = value - page->mean[index][i];
+        page->mean[index][i] += delta / static_cast<double>(page->sampleCounts[index]);
+        double delta2 = value - page->mean[index][i];
+        page->m2[index][i] += delta * delta2;
     }
 }
 
 static float GetVarianceMagnitude(const ShaderConstantState& state, int reg) {
-    if (state.sampleCounts[reg] < 2) {
+    const ConstantVariancePage* page = state.GetVariancePage(reg);
+    const int index = reg % kConstantPageRegisters;
+    if (!page || page->sampleCounts[index] < 2) {
         return 0.0f;
     }
     double sum = 0.0;
     for (int i = 0; i < 4; i++) {
-        sum += state.m2[reg][i] / static_cast<double>(state.sampleCounts[reg] - 1);
+        sum += page->m2[index][i] / static_cast<double>(page->sampleCounts[index] - 1);
     }
     return static_cast<float>(sum / 4.0);
 }
 
-
-static bool TryBuildMatrixFromConstantUpdate(const float* constantData,
-                                             UINT startRegister,
-                                             UINT vector4fCount,
-                                             int baseRegister,
-                                             int rows,
-                                             bool transposed,
-                                             D3DMATRIX* outMatrix) {
-    if (!constantData || !outMatrix || rows < 3 || rows > 4) {
-        return false;
-    }
-    if (baseRegister < 0) {
-        return false;
-    }
-    if (startRegister > static_cast<UINT>(baseRegister) ||
-        startRegister + vector4fCount < static_cast<UINT>(baseRegister + rows)) {
-        return false;
-    }
-
-    int offset = (baseRegister - static_cast<int>(startRegister)) * 4;
-    const float* m = constantData + offset;
-    D3DMATRIX out = {};
-
-    if (!transposed) {
-        out._11 = m[0]; out._12 = m[1]; out._13 = m[2]; out._14 = m[3];
-        out._21 = m[4]; out._22 = m[5]; out._23 = m[6]; out._24 = m[7];
-        out._31 = m[8]; out._32 = m[9]; out._33 = m[10]; out._34 = m[11];
-        if (rows == 4) {
-            out._41 = m[12]; out._42 = m[13]; out._43 = m[14]; out._44 = m[15];
-        } else {
-            out._41 = 0.0f; out._42 = 0.0f; out._43 = 0.0f; out._44 = 1.0f;
-        }
-    } else {
-        out._11 = m[0]; out._21 = m[1]; out._31 = m[2]; out._41 = m[3];
-        out._12 = m[4]; out._22 = m[5]; out._32 = m[6]; out._42 = m[7];
-        out._13 = m[8]; out._23 = m[9]; out._33 = m[10]; out._43 = m[11];
-        if (rows == 4) {
-            out._14 = m[12]; out._24 = m[13]; out._34 = m[14]; out._44 = m[15];
-        } else {
-            out._14 = 0.0f; out._24 = 0.0f; out._34 = 0.0f; out._44 = 1.0f;
+static ShaderConstantMemoryReport BuildShaderConstantMemoryReport() {
+    ShaderConstantMemoryReport report;
+    for (const auto& entry : g_shaderConstants) {
+        const ShaderConstantState& state = entry.second;
+        report.shaders++;
+        report.bytes += sizeof(ShaderConstantState);
+        for (int i = 0; i < kConstantPageCount; ++i) {
+            if (state.valuePages[i]) {
+                report.valuePages++;
+                report.bytes += sizeof(ConstantValuePage);
+            }
+            if (state.overridePages[i]) {
+                report.overridePages++;
+                report.bytes += sizeof(ConstantOverridePage);
+            }
+            if (state.variancePages[i]) {
+                report.variancePages++;
+                report.bytes += sizeof(ConstantVariancePage);
+            }
         }
     }
-
-    *outMatrix = out;
-    return true;
+    report.denseBytes = static_cast<size_t>(report.shaders) * kDenseShaderConstantStateBytes;
+    return report;
 }
 
 static bool TryBuildMatrixSnapshot(const ShaderConstantState& state,
@@ -2408,36 +3145,15 @@ static bool TryBuildMatrixSnapshot(const ShaderConstantState& state,
         return false;
     }
 
+    // Rows may straddle a page boundary, so the gather takes one pointer per register.
+    const float* r[4] = {};
     for (int i = 0; i < rows; i++) {
-        if (!state.valid[baseRegister + i]) {
+        if (!state.IsValid(baseRegister + i)) {
             return false;
         }
+        r[i] = state.GetConstant(baseRegister + i);
     }
-
-    const float* m = &state.constants[baseRegister][0];
-    D3DMATRIX out = {};
-
-    if (!transposed) {
-        out._11 = m[0]; out._12 = m[1]; out._13 = m[2]; out._14 = m[3];
-        out._21 = m[4]; out._22 = m[5]; out._23 = m[6]; out._24 = m[7];
-        out._31 = m[8]; out._32 = m[9]; out._33 = m[10]; out._34 = m[11];
-        if (rows == 4) {
-            out._41 = m[12]; out._42 = m[13]; out._43 = m[14]; out._44 = m[15];
-        } else {
-            out._41 = 0.0f; out._42 = 0.0f; out._43 = 0.0f; out._44 = 1.0f;
-        }
-    } else {
-        out._11 = m[0]; out._21 = m[1]; out._31 = m[2]; out._41 = m[3];
-        out._12 = m[4]; out._22 = m[5]; out._32 = m[6]; out._42 = m[7];
-        out._13 = m[8]; out._23 = m[9]; out._33 = m[10]; out._43 = m[11];
-        if (rows == 4) {
-            out._14 = m[12]; out._24 = m[13]; out._34 = m[14]; out._44 = m[15];
-        } else {
-            out._14 = 0.0f; out._24 = 0.0f; out._34 = 0.0f; out._44 = 1.0f;
-        }
-    }
-
-    *outMatrix = out;
+    matrix_engine::SelectMatrixGather(rows, transposed)(r[0], r[1], r[2], r[3], AsEngineMatrix(outMatrix));
     return true;
 }
 
@@ -2469,38 +3185,41 @@ static bool TryBuildMatrixFromGlobalRegisters(int baseRegister,
         return false;
     }
 
-    float m[16] = {};
+    const float* r[4] = {};
     for (int i = 0; i < rows; i++) {
         const GlobalVertexRegisterState& globalState = g_allVertexRegisters[baseRegister + i];
         if (!globalState.valid) {
             return false;
         }
-        memcpy(&m[i * 4], globalState.value, sizeof(globalState.value));
+        r[i] = globalState.value;
     }
+    matrix_engine::SelectMatrixGather(rows, transposed)(r[0], r[1], r[2], r[3], AsEngineMatrix(outMatrix));
+    return true;
+}
 
-    D3DMATRIX out = {};
-    if (!transposed) {
-        out._11 = m[0]; out._12 = m[1]; out._13 = m[2]; out._14 = m[3];
-        out._21 = m[4]; out._22 = m[5]; out._23 = m[6]; out._24 = m[7];
-        out._31 = m[8]; out._32 = m[9]; out._33 = m[10]; out._34 = m[11];
-        if (rows == 4) {
-            out._41 = m[12]; out._42 = m[13]; out._43 = m[14]; out._44 = m[15];
-        } else {
-            out._41 = 0.0f; out._42 = 0.0f; out._43 = 0.0f; out._44 = 1.0f;
-        }
-    } else {
-        out._11 = m[0]; out._21 = m[1]; out._31 = m[2]; out._41 = m[3];
-        out._12 = m[4]; out._22 = m[5]; out._32 = m[6]; out._42 = m[7];
-        out._13 = m[8]; out._23 = m[9]; out._33 = m[10]; out._43 = m[11];
-        if (rows == 4) {
-            out._14 = m[12]; out._24 = m[13]; out._34 = m[14]; out._44 = m[15];
-        } else {
-            out._14 = 0.0f; out._24 = 0.0f; out._34 = 0.0f; out._44 = 1.0f;
-        }
-    }
+static void ClearLearnedUploadLayouts() {
+    g_learnedUploadLayouts.clear();
+    g_shaderCacheDirty = true;
+    g_layoutFastPathHits = 0;
+    g_layoutFullScans = 0;
+    g_layoutDriftFallbacks = 0;
+}
 
-    *outMatrix = out;
-    return true;
+static void ClearSimdWindowStats() {
+    g_simdWindowsTested = 0;
+    g_simdWindowsRejected = 0;
+    g_paletteUploads = 0;
+    g_paletteWindowsSkipped = 0;
+    g_transformMapUploads = 0;
+    g_transformMapWindowsSkipped = 0;
+    g_deferredRegistersClassified = 0;
+    g_deferredRegistersSkipped = 0;
+    g_deferredRangesClassified = 0;
+    g_deferredQueueFull = 0;
+}
+
+static void ClearMatrixClassCache() {
+    g_matrixClassCache.Clear();
 }
 
 static void ScanBuffer(const void* base, size_t size, int& resultsFound) {
@@ -2521,10 +3240,11 @@ static void ScanBuffer(const void* base, size_t size, int& resultsFound) {
         if (!looksView && !looksProj) {
             continue;
         }
-        uint32_t hash = HashMatrix(mat);
+        const uint64_t hash = HashMatrix(mat);
         char resultLine[256];
-        snprintf(resultLine, sizeof(resultLine), "Memory scan: %s matrix at %p hash 0x%08X",
-                 looksView ? "VIEW" : "PROJ", reinterpret_cast<const void*>(window), hash);
+        snprintf(resultLine, sizeof(resultLine), "Memory scan: %s matrix at %p hash %016llX",
+                 looksView ? "VIEW" : "PROJ", reinterpret_cast<const void*>(window),
+                 static_cast<unsigned long long>(hash));
         LogMsg("%s", resultLine);
         {
             std::lock_guard<std::mutex> lock(g_uiDataMutex);
@@ -2652,6 +3372,10 @@ static void UpdateHotkeys() {
         ResetMatrixRegisterOverridesToAuto();
     }
 
+    if (ConsumeSingleKeyHotkey(HotkeyAction_CaptureTrace, g_config.hotkeyCaptureTraceVk) && !g_traceCaptureActive) {
+        g_traceCaptureRequested = true;
+    }
+
     if (g_showImGui && !g_prevShowImGui) {
         // Menu just became visible — release any game mouse capture.
         ReleaseCapture();
@@ -2695,6 +3419,7 @@ static void UpdateFrameTimeStats() {
 }
 
 static void RenderImGuiOverlay(IDirect3DDevice9* device) {
+    TRACE_SCOPE("OverlayRender");
     EnsureWndProcHookInstalled();
 
     if (!g_imguiInitialized || !g_showImGui) {
@@ -2704,11 +3429,7 @@ static void RenderImGuiOverlay(IDirect3DDevice9* device) {
 
     ClipCursor(NULL);
 
-    CameraMatrices camSnapshot = {};
-    {
-        std::lock_guard<std::mutex> lock(g_cameraMatricesMutex);
-        camSnapshot = g_cameraMatrices;
-    }
+    const CameraMatrices camSnapshot = SnapshotCameraMatrices();
 
     ApplyImGuiScale(g_imguiHwnd);
     ImGui_ImplDX9_NewFrame();
@@ -2779,6 +3500,11 @@ static void RenderImGuiOverlay(IDirect3DDevice9* device) {
     if (g_manualEmitStatus[0] != '\0') {
         ImGui::TextWrapped("%s", g_manualEmitStatus);
     }
+    if (ImGui::Checkbox("Skip redundant SetTransform calls", &g_config.suppressRedundantTransforms)) {
+        SaveConfigBoolValue("SuppressRedundantTransforms", g_config.suppressRedundantTransforms);
+    }
+    ImGui::Text("SetTransform (last frame): %llu emitted, %llu suppressed",
+                g_setTransformEmittedLastFrame, g_setTransformSuppressedLastFrame);
 
     ImGui::Checkbox("Show FPS stats", &g_showFpsStats);
     ImGui::Checkbox("Show transposed matrices", &g_showTransposedMatrices);
@@ -2800,6 +3526,78 @@ static void RenderImGuiOverlay(IDirect3DDevice9* device) {
                          ImVec2(0, 80));
         ImGui::PopStyleColor(2);
     }
+    if (g_showFpsStats) {
+#if CAMERA_PROXY_METHOD_TIMING
+        ImGui::Checkbox("Per-method proxy timing (rdtsc cycles)", &g_methodTimingEnabled);
+        if (g_methodTimingEnabled &&
+            ImGui::BeginTable("MethodTiming", 6, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit)) {
+            ImGui::TableSetupColumn("Method (last frame)");
+            ImGui::TableSetupColumn("Calls");
+            ImGui::TableSetupColumn("Total");
+            ImGui::TableSetupColumn("Min");
+            ImGui::TableSetupColumn("Max");
+            ImGui::TableSetupColumn("p99");
+            ImGui::TableHeadersRow();
+            for (int i = 0; i < TimedMethod_Count; ++i) {
+                const MethodTimingStats& stats = g_methodTimingLastFrame[i];
+                ImGui::TableNextRow();
+                ImGui::TableSetColumnIndex(0);
+                if (ImGui::Selectable(kTimedMethodNames[i], g_methodTimingSelected == i, ImGuiSelectableFlags_SpanAllColumns)) {
+                    g_methodTimingSelected = i;
+                }
+                ImGui::TableSetColumnIndex(1); ImGui::Text("%llu", stats.calls);
+                ImGui::TableSetColumnIndex(2); ImGui::Text("%llu", stats.totalCycles);
+                ImGui::TableSetColumnIndex(3); ImGui::Text("%llu", stats.minCycles);
+                ImGui::TableSetColumnIndex(4); ImGui::Text("%llu", stats.maxCycles);
+                ImGui::TableSetColumnIndex(5); ImGui::Text("<=%llu", stats.p99Cycles);
+            }
+            ImGui::EndTable();
+
+            const MethodTimingStats& selected = g_methodTimingLastFrame[g_methodTimingSelected];
+            float buckets[kMethodTimingBuckets] = {};
+            float bucketMax = 1.0f;
+            for (int bucket = 0; bucket < kMethodTimingBuckets; ++bucket) {
+                buckets[bucket] = static_cast<float>(selected.histogram[bucket]);
+                bucketMax = (std::max)(bucketMax, buckets[bucket]);
+            }
+            char histogramLabel[96];
+            snprintf(histogramLabel, sizeof(histogramLabel), "%s\n(log2 cycles)", kTimedMethodNames[g_methodTimingSelected]);
+            ImGui::PlotHistogram(histogramLabel, buckets, kMethodTimingBuckets, 0, nullptr, 0.0f, bucketMax, ImVec2(0, 80));
+        }
+        ImGui::BeginDisabled(g_traceCaptureActive || g_traceCaptureRequested);
+        if (ImGui::Button("Capture frame trace")) {
+            g_traceCaptureRequested = true;
+        }
+        ImGui::EndDisabled();
+        ImGui::SameLine();
+        ImGui::TextDisabled("%d frame(s), Chrome trace JSON for Perfetto", g_config.traceCaptureFrames);
+        if (g_traceCaptureStatus[0] != '\0') {
+            ImGui::TextWrapped("%s", g_traceCaptureStatus);
+        }
+#else
+        ImGui::TextDisabled("Per-method timing and frame trace compiled out (CAMERA_PROXY_METHOD_TIMING=0).");
+#endif
+        if (!g_apiTraceRecorder.IsRecording()) {
+            if (ImGui::Button("Start API trace")) {
+                StartApiTraceRecording();
+            }
+        } else {
+            if (ImGui::Button("Stop API trace")) {
+                StopApiTraceRecording();
+            }
+            const ApiTraceStats stats = g_apiTraceRecorder.GetStats();
+            ImGui::SameLine();
+            ImGui::Text("%llu records, %.2f MB raw -> %.2f MB file, %llu dictionary hits, %llu stalls",
+                        static_cast<unsigned long long>(stats.records),
+                        static_cast<double>(stats.rawBytes) / (1024.0 * 1024.0),
+                        static_cast<double>(stats.fileBytes) / (1024.0 * 1024.0),
+                        static_cast<unsigned long long>(stats.dictionaryHits),
+                        static_cast<unsigned long long>(stats.producerStalls));
+        }
+        if (g_apiTraceStatus[0] != '\0') {
+            ImGui::TextWrapped("%s", g_apiTraceStatus);
+        }
+    }
 
     ImGui::Separator();
     if (ImGui::BeginTabBar("MainTabs")) {
@@ -2959,20 +3757,20 @@ static void RenderImGuiOverlay(IDirect3DDevice9* device) {
                     SaveConfigBoolValue("MGRRUseAutoProjectionWhenC4Invalid",
                                         g_config.mgrrUseAutoProjectionWhenC4Invalid);
                 }
-                ImGui::Text("Projection c4-c7 validity: %s", g_mgrProjectionRegisterValid ? "valid" : "invalid");
+                ImGui::Text("Projection c4-c7 validity: %s", g_profileState.mgrProjectionRegisterValid ? "valid" : "invalid");
                 float activeViewDeterminant = 0.0f;
                 D3DMATRIX activeViewInverse = {};
                 InvertMatrix4x4Deterministic(camSnapshot.view, &activeViewInverse, &activeViewDeterminant);
                 ImGui::Text("Determinant of active View matrix: %.6f", activeViewDeterminant);
                 ImGui::Text("Captured this frame: Proj=%s View=%s",
-                            g_mgrProjCapturedThisFrame ? "yes" : "no",
-                            g_mgrViewCapturedThisFrame ? "yes" : "no");
-                ImGui::Text("Captured for draw: World=%s", g_mgrWorldCapturedForDraw ? "yes" : "no");
+                            g_profileState.mgrProjCapturedThisFrame ? "yes" : "no",
+                            g_profileState.mgrViewCapturedThisFrame ? "yes" : "no");
+                ImGui::Text("Captured for draw: World=%s", g_profileState.mgrWorldCapturedForDraw ? "yes" : "no");
                 ImGui::Text("Core seen: Proj=%s ViewProj=%s World=%s",
-                            g_profileCoreRegistersSeen[0] ? "yes" : "no",
-                            g_profileCoreRegistersSeen[1] ? "yes" : "no",
-                            g_profileCoreRegistersSeen[2] ? "yes" : "no");
-                ImGui::Text("View source: %s", g_profileViewDerivedFromInverse ? "Derived from VP via inverse projection" : "Not yet derived");
+                            g_profileState.coreRegistersSeen[0] ? "yes" : "no",
+                            g_profileState.coreRegistersSeen[1] ? "yes" : "no",
+                            g_profileState.coreRegistersSeen[2] ? "yes" : "no");
+                ImGui::Text("View source: %s", g_profileState.viewDerivedFromInverse ? "Derived from VP via inverse projection" : "Not yet derived");
                 if (g_profileStatusMessage[0] != '\0') {
                     ImGui::TextWrapped("%s", g_profileStatusMessage);
                 }
@@ -2980,9 +3778,9 @@ static void RenderImGuiOverlay(IDirect3DDevice9* device) {
             else if (g_activeGameProfile == GameProfile_DevilMayCry4) {
                 ImGui::Text("DMC4 layout: MVP=c0-c3, World=c0-c3, View=c4-c7, Projection=c8-c11");
                 ImGui::Text("Core seen: MVP/World=%s View=%s Projection=%s",
-                            g_profileCoreRegistersSeen[0] ? "yes" : "no",
-                            g_profileCoreRegistersSeen[1] ? "yes" : "no",
-                            g_profileCoreRegistersSeen[2] ? "yes" : "no");
+                            g_profileState.coreRegistersSeen[0] ? "yes" : "no",
+                            g_profileState.coreRegistersSeen[1] ? "yes" : "no",
+                            g_profileState.coreRegistersSeen[2] ? "yes" : "no");
                 if (g_profileStatusMessage[0] != '\0') {
                     ImGui::TextWrapped("%s", g_profileStatusMessage);
                 }
@@ -2998,9 +3796,9 @@ static void RenderImGuiOverlay(IDirect3DDevice9* device) {
                     SaveConfigBoolValue("BarnyardForceWorldFromC0", g_barnyardForceWorldFromC0);
                 }
                 ImGui::Text("Seen: View=%s Projection=%s World=%s",
-                            g_profileCoreRegistersSeen[0] ? "yes" : "no",
-                            g_profileCoreRegistersSeen[1] ? "yes" : "no",
-                            g_profileCoreRegistersSeen[2] ? "yes" : "no");
+                            g_profileState.coreRegistersSeen[0] ? "yes" : "no",
+                            g_profileState.coreRegistersSeen[1] ? "yes" : "no",
+                            g_profileState.coreRegistersSeen[2] ? "yes" : "no");
                 if (g_profileStatusMessage[0] != '\0') {
                     ImGui::TextWrapped("%s", g_profileStatusMessage);
                 }
@@ -3160,6 +3958,83 @@ static void RenderImGuiOverlay(IDirect3DDevice9* device) {
                 if (g_combinedDecompDebug.viewFormula[0] != '\0') ImGui::TextWrapped("  %s", g_combinedDecompDebug.viewFormula);
                 ImGui::Text("Solved Projection: %s", g_combinedDecompDebug.solvedProjection ? "yes" : "no");
                 if (g_combinedDecompDebug.projectionFormula[0] != '\0') ImGui::TextWrapped("  %s", g_combinedDecompDebug.projectionFormula);
+                ImGui::Text("Last frame: %d solver runs, %d skipped (inputs unchanged)",
+                            g_combinedDecompRunsLastFrame, g_combinedDecompSkipsLastFrame);
+            }
+
+            if (ImGui::CollapsingHeader("Structural detection caches")) {
+                if (ImGui::Checkbox("Use learned register layouts", &g_config.enableLayoutFastPath)) {
+                    SaveConfigBoolValue("EnableLayoutFastPath", g_config.enableLayoutFastPath);
+                }
+                ImGui::TextWrapped("After %d consistent frames, uploads from the same shader and register range are extracted directly instead of scanned. A failed drift check falls back to full scanning.",
+                                   g_config.layoutLearnFrames);
+                int lockedLayouts = 0;
+                for (const auto& entry : g_learnedUploadLayouts) {
+                    if (entry.second.locked) lockedLayouts++;
+                }
+                const unsigned long long totalUploads = g_layoutFastPathHits + g_layoutFullScans;
+                ImGui::Text("Learned layouts: %d locked / %d tracked", lockedLayouts, static_cast<int>(g_learnedUploadLayouts.size()));
+                ImGui::Text("Fast path hits: %llu / %llu uploads (%.1f%%)", g_layoutFastPathHits, totalUploads,
+                            totalUploads > 0 ? 100.0 * static_cast<double>(g_layoutFastPathHits) / static_cast<double>(totalUploads) : 0.0);
+                ImGui::Text("Drift fallbacks: %llu", g_layoutDriftFallbacks);
+                if (ImGui::Button("Clear learned layouts")) {
+                    ClearLearnedUploadLayouts();
+                }
+                ImGui::Separator();
+                const unsigned long long classCacheHits = g_matrixClassCache.Hits();
+                const unsigned long long classCacheMisses = g_matrixClassCache.Misses();
+                const unsigned long long classLookups = classCacheHits + classCacheMisses;
+                ImGui::Text("Classification cache: %llu hits / %llu misses (%.1f%% hit rate, %d slots)",
+                            classCacheHits, classCacheMisses,
+                            classLookups > 0 ? 100.0 * static_cast<double>(classCacheHits) / static_cast<double>(classLookups) : 0.0,
+                            static_cast<int>(StructuralWindowCache::kEntryCount));
+                if (ImGui::Button("Clear classification cache")) {
+                    ClearMatrixClassCache();
+                }
+                ImGui::Separator();
+                if (ImGui::Checkbox("SSE2 window prefilter", &g_config.enableSimdWindowPrefilter)) {
+                    SaveConfigBoolValue("EnableSimdWindowPrefilter", g_config.enableSimdWindowPrefilter);
+                }
+                ImGui::Text("SIMD windows: %llu tested, %llu rejected (%.1f%%)",
+                            g_simdWindowsTested, g_simdWindowsRejected,
+                            g_simdWindowsTested > 0 ? 100.0 * static_cast<double>(g_simdWindowsRejected) / static_cast<double>(g_simdWindowsTested) : 0.0);
+                if (ImGui::Button("Reset SIMD counters")) {
+                    ClearSimdWindowStats();
+                }
+                ImGui::Text("Skinning palette uploads: %llu (%llu windows skipped)",
+                            g_paletteUploads, g_paletteWindowsSkipped);
+                if (ImGui::Checkbox("Scan only transform-map matrices (deferred)", &g_config.shaderTransformMap)) {
+                    SaveConfigBoolValue("ShaderTransformMap", g_config.shaderTransformMap);
+                }
+                ImGui::Text("Transform-map uploads: %llu (%llu windows skipped)",
+                            g_transformMapUploads, g_transformMapWindowsSkipped);
+                ImGui::Separator();
+                if (ImGui::Checkbox("Defer classification to draw time", &g_config.deferConstantClassification)) {
+                    SaveConfigBoolValue("DeferConstantClassification", g_config.deferConstantClassification);
+                }
+                ImGui::TextWrapped("Uploads only mark registers dirty; the next draw classifies dirty ranges the bound vertex shader reads.");
+                ImGui::Text("Deferred: %llu registers in %llu uploads classified, %llu register visits skipped (not read)",
+                            g_deferredRegistersClassified, g_deferredRangesClassified, g_deferredRegistersSkipped);
+                ImGui::Text("Deferred queue full: %llu unread uploads classified early", g_deferredQueueFull);
+                ImGui::Separator();
+#if CAMERA_PROXY_ALLOCATION_PROBE
+                ImGui::Text("Upload path heap allocations (last frame): %llu in %llu of %llu calls",
+                            g_uploadPathAllocationsLastFrame, g_uploadPathAllocatingCallsLastFrame, g_uploadPathCallsLastFrame);
+#else
+                ImGui::TextDisabled("Upload path allocation probe compiled out (CAMERA_PROXY_ALLOCATION_PROBE=0).");
+#endif
+                ImGui::Separator();
+                if (ImGui::Checkbox("Track per-register variance", &g_config.trackConstantVariance)) {
+                    SaveConfigBoolValue("TrackConstantVariance", g_config.trackConstantVariance);
+                }
+                const ShaderConstantMemoryReport memoryReport = BuildShaderConstantMemoryReport();
+                ImGui::Text("Constant storage: %d shaders, %d value / %d override / %d variance pages (%d registers each)",
+                            memoryReport.shaders, memoryReport.valuePages, memoryReport.overridePages,
+                            memoryReport.variancePages, kConstantPageRegisters);
+                ImGui::Text("Constant memory: %.1f KB paged vs %.1f KB dense (%.1f%%)",
+                            static_cast<double>(memoryReport.bytes) / 1024.0,
+                            static_cast<double>(memoryReport.denseBytes) / 1024.0,
+                            memoryReport.denseBytes > 0 ? 100.0 * static_cast<double>(memoryReport.bytes) / static_cast<double>(memoryReport.denseBytes) : 0.0);
             }
 
             ImGui::Separator();
@@ -3263,13 +4138,13 @@ static void RenderImGuiOverlay(IDirect3DDevice9* device) {
 
             auto selectedByKeyIt = g_shaderRecords.find(g_selectedShaderKey);
             if (selectedByKeyIt != g_shaderRecords.end()) {
-                g_selectedShaderHash = static_cast<uint64_t>(selectedByKeyIt->second.hash);
+                g_selectedShaderHash = selectedByKeyIt->second.hash;
             } else if (g_selectedShaderHash != 0) {
-                auto selectedIt = g_shaderHashToKey.find(static_cast<uint32_t>(g_selectedShaderHash));
+                auto selectedIt = g_shaderHashToKey.find(g_selectedShaderHash);
                 if (selectedIt != g_shaderHashToKey.end()) g_selectedShaderKey = selectedIt->second;
             }
             if (g_selectedShaderHash == 0 && !shaderSnapshot.empty() && shaderSnapshot.front()) {
-                g_selectedShaderHash = static_cast<uint64_t>(shaderSnapshot.front()->hash);
+                g_selectedShaderHash = shaderSnapshot.front()->hash;
                 g_selectedShaderKey = shaderSnapshot.front()->shaderKey;
             }
 
@@ -3283,8 +4158,9 @@ static void RenderImGuiOverlay(IDirect3DDevice9* device) {
                 std::filesystem::create_directories("Shader_dump");
                 for (ShaderRecord* recPtr : shaderSnapshot) {
                     if (!recPtr) continue;
+                    EnsureShaderDisassembly(recPtr);
                     char path[128];
-                    snprintf(path, sizeof(path), "Shader_dump/%08X.asm.txt", recPtr->hash);
+                    snprintf(path, sizeof(path), "Shader_dump/%016llX.asm.txt", static_cast<unsigned long long>(recPtr->hash));
                     std::ofstream(path) << recPtr->editableAssembly;
                 }
             }
@@ -3294,7 +4170,7 @@ static void RenderImGuiOverlay(IDirect3DDevice9* device) {
                 for (ShaderRecord* recPtr : shaderSnapshot) {
                     if (!recPtr) continue;
                     char path[128];
-                    snprintf(path, sizeof(path), "Shader_dump/%08X.bytecode.bin", recPtr->hash);
+                    snprintf(path, sizeof(path), "Shader_dump/%016llX.bytecode.bin", static_cast<unsigned long long>(recPtr->hash));
                     std::ofstream f(path, std::ios::binary);
                     const std::vector<uint32_t>& data = recPtr->replacementEnabled && !recPtr->modifiedBytecode.empty()
                                                              ? recPtr->modifiedBytecode
@@ -3310,14 +4186,15 @@ static void RenderImGuiOverlay(IDirect3DDevice9* device) {
                 ShaderRecord& rec = *recPtr;
                 const uintptr_t shaderKey = rec.shaderKey;
                 char visibleLabel[256];
-                snprintf(visibleLabel, sizeof(visibleLabel), "0x%08X %s %s inst:%d use:%llu%s", rec.hash,
+                snprintf(visibleLabel, sizeof(visibleLabel), "%016llX %s %s inst:%d use:%llu%s%s", static_cast<unsigned long long>(rec.hash),
                          rec.stage == ShaderStage_Vertex ? "VS" : "PS", rec.shaderModel.c_str(),
-                         static_cast<int>(rec.ir.size()), rec.usageCount,
+                         rec.instructionCount, rec.usageCount, rec.analysed ? "" : " (analysing)",
                          (shaderKey == g_activeVertexShaderKey || shaderKey == g_activePixelShaderKey) ? " *" : "");
                 if (shaderFilter[0]) {
                     bool matchesFilter = ContainsCaseInsensitive(visibleLabel, shaderFilter);
                     if (g_shaderSearchScopeMode == ShaderSearchScope_AllAssemblies) {
                         if (!matchesFilter) {
+                            EnsureShaderDisassembly(&rec);
                             matchesFilter = ContainsCaseInsensitive(rec.cachedDisassembly, shaderFilter) ||
                                             ContainsCaseInsensitive(rec.editableAssembly, shaderFilter);
                         }
@@ -3325,6 +4202,7 @@ static void RenderImGuiOverlay(IDirect3DDevice9* device) {
                         if (shaderKey != g_selectedShaderKey) {
                             matchesFilter = false;
                         } else if (!matchesFilter) {
+                            EnsureShaderDisassembly(&rec);
                             matchesFilter = ContainsCaseInsensitive(rec.cachedDisassembly, shaderFilter) ||
                                             ContainsCaseInsensitive(rec.editableAssembly, shaderFilter);
                         }
@@ -3336,7 +4214,7 @@ static void RenderImGuiOverlay(IDirect3DDevice9* device) {
                 snprintf(selectableLabel, sizeof(selectableLabel), "%s###shader_row_%p", visibleLabel,
                          reinterpret_cast<void*>(shaderKey));
                 if (ImGui::Selectable(selectableLabel, selected)) {
-                    g_selectedShaderHash = static_cast<uint64_t>(rec.hash);
+                    g_selectedShaderHash = rec.hash;
                     g_selectedShaderKey = shaderKey;
                     g_selectedRegister = -1;
                 }
@@ -3346,9 +4224,10 @@ static void RenderImGuiOverlay(IDirect3DDevice9* device) {
             ImGui::NextColumn();
             ImGui::BeginChild("ShaderInspect", ImVec2(0, 420), true);
             auto it = g_shaderRecords.find(g_selectedShaderKey);
-            if (it != g_shaderRecords.end() && static_cast<uint64_t>(it->second.hash) == g_selectedShaderHash) {
+            if (it != g_shaderRecords.end() && it->second.hash == g_selectedShaderHash) {
                 ShaderRecord& rec = it->second;
-                ImGui::Text("Hash: 0x%08X", rec.hash);
+                EnsureShaderDisassembly(&rec);
+                ImGui::Text("Hash: %016llX", static_cast<unsigned long long>(rec.hash));
                 ImGui::Text("Type: %s", rec.stage == ShaderStage_Vertex ? "VS" : "PS");
                 ImGui::Text("Model: %s", rec.shaderModel.c_str());
 
@@ -3362,13 +4241,13 @@ static void RenderImGuiOverlay(IDirect3DDevice9* device) {
 
                 if (ImGui::Button("Dump assembly")) {
                     std::filesystem::create_directories("Shader_dump");
-                    char path[128]; snprintf(path, sizeof(path), "Shader_dump/%08X.asm.txt", rec.hash);
+                    char path[128]; snprintf(path, sizeof(path), "Shader_dump/%016llX.asm.txt", static_cast<unsigned long long>(rec.hash));
                     std::ofstream(path) << rec.editableAssembly;
                 }
                 ImGui::SameLine();
                 if (ImGui::Button("Dump bytecode")) {
                     std::filesystem::create_directories("Shader_dump");
-                    char path[128]; snprintf(path, sizeof(path), "Shader_dump/%08X.bytecode.bin", rec.hash);
+                    char path[128]; snprintf(path, sizeof(path), "Shader_dump/%016llX.bytecode.bin", static_cast<unsigned long long>(rec.hash));
                     std::ofstream f(path, std::ios::binary);
                     const std::vector<uint32_t>& data = rec.replacementEnabled && !rec.modifiedBytecode.empty()
                                                          ? rec.modifiedBytecode : rec.originalBytecode;
@@ -3417,7 +4296,7 @@ static void RenderImGuiOverlay(IDirect3DDevice9* device) {
             ImGui::NextColumn();
             ImGui::BeginChild("ShaderAnalysis", ImVec2(0, 420), true, ImGuiWindowFlags_AlwaysVerticalScrollbar);
             auto ai = g_shaderRecords.find(g_selectedShaderKey);
-            if (ai != g_shaderRecords.end() && static_cast<uint64_t>(ai->second.hash) == g_selectedShaderHash) {
+            if (ai != g_shaderRecords.end() && ai->second.hash == g_selectedShaderHash) {
                 ShaderRecord& rec = ai->second;
                 int usedMin = -1;
                 int usedMax = -1;
@@ -3431,6 +4310,16 @@ static void RenderImGuiOverlay(IDirect3DDevice9* device) {
                 const int effectiveLightingBase = g_manualLightingBaseOverride >= 0 ? g_manualLightingBaseOverride : rec.lightingConstantBase;
                 ImGui::Text("Transform: %s", rec.isFFPTransform ? "Yes" : "No");
                 ImGui::Text("Transform base: c%d", effectiveTransformBase);
+                const ShaderTransformMap& map = rec.transformMap;
+                if (map.useCount > 0) {
+                    ImGui::Text("Transform map: %s%s%s", map.complete ? "complete" : "partial",
+                                map.skinned ? ", skinned" : "", map.ambiguousSplit ? ", World/WorldView ambiguous" : "");
+                    for (int i = 0; i < map.useCount; ++i) {
+                        const ShaderMatrixUse& use = map.uses[i];
+                        ImGui::Text("  c%d%s (%d rows): %s", use.baseRegister, use.relative ? "[a0]" : "", use.rows,
+                                    ShaderMatrixRoleName(use.role));
+                    }
+                }
                 ImGui::Text("Lighting: %s", rec.isFFPLighting ? "Yes" : "No");
                 ImGui::Text("Skinning: %s", rec.usesSkinning ? "Yes" : "No");
                 ImGui::Text("Flow control: %s", rec.usesFlowControl ? "Yes" : "No");
@@ -3472,13 +4361,13 @@ static void RenderImGuiOverlay(IDirect3DDevice9* device) {
                                         rec.attenuationRegister,
                                         rec.coneAngleRegister);
 
-                    ImGui::InputInt("Direction register##ldir", &rec.lightDirectionRegisterOverride);
-                    ImGui::InputInt("Color register##lcol", &rec.lightColorRegisterOverride);
-                    ImGui::InputInt("Material color reg##lmat", &rec.materialColorRegisterOverride);
-                    ImGui::InputInt("Position register##lpos", &rec.positionRegisterOverride);
-                    ImGui::InputInt("Attenuation register##latten", &rec.attenuationRegisterOverride);
-                    ImGui::InputInt("Cone angle register##lcone", &rec.coneAngleRegisterOverride);
-                    ImGui::InputInt("Light count override##lcnt", &rec.lightCountOverride);
+                    g_shaderCacheDirty |= ImGui::InputInt("Direction register##ldir", &rec.lightDirectionRegisterOverride);
+                    g_shaderCacheDirty |= ImGui::InputInt("Color register##lcol", &rec.lightColorRegisterOverride);
+                    g_shaderCacheDirty |= ImGui::InputInt("Material color reg##lmat", &rec.materialColorRegisterOverride);
+                    g_shaderCacheDirty |= ImGui::InputInt("Position register##lpos", &rec.positionRegisterOverride);
+                    g_shaderCacheDirty |= ImGui::InputInt("Attenuation register##latten", &rec.attenuationRegisterOverride);
+                    g_shaderCacheDirty |= ImGui::InputInt("Cone angle register##lcone", &rec.coneAngleRegisterOverride);
+                    g_shaderCacheDirty |= ImGui::InputInt("Light count override##lcnt", &rec.lightCountOverride);
                     ImGui::TextDisabled("Light count: -1 = default (1)");
 
                     ImGui::Text("Light space override:");
@@ -3486,6 +4375,7 @@ static void RenderImGuiOverlay(IDirect3DDevice9* device) {
                     int spaceIdx = static_cast<int>(rec.lightSpaceOverride) + 1;
                     if (ImGui::Combo("##lspace", &spaceIdx, spaceLabels, 4)) {
                         rec.lightSpaceOverride = static_cast<LightingSpace>(spaceIdx - 1);
+                        g_shaderCacheDirty = true;
                     }
 
                     if (rec.lightDirectionRegister >= 0) {
@@ -3610,23 +4500,20 @@ static void RenderImGuiOverlay(IDirect3DDevice9* device) {
                 ImGui::Text("Selected register: c%d", g_selectedRegister);
                 if (editState && g_selectedRegister < kMaxConstantRegisters) {
                     float editValues[4] = {};
-                    if (editState->overrideValid[g_selectedRegister]) {
-                        memcpy(editValues, editState->overrideConstants[g_selectedRegister], sizeof(editValues));
-                    } else if (editState->valid[g_selectedRegister]) {
-                        memcpy(editValues, editState->constants[g_selectedRegister], sizeof(editValues));
+                    if (editState->HasOverride(g_selectedRegister)) {
+                        memcpy(editValues, editState->GetOverride(g_selectedRegister), sizeof(editValues));
+                    } else if (editState->IsValid(g_selectedRegister)) {
+                        memcpy(editValues, editState->GetConstant(g_selectedRegister), sizeof(editValues));
                     }
 
                     if (ImGui::InputFloat4("Override values", editValues, "%.6f")) {
-                        memcpy(editState->overrideConstants[g_selectedRegister], editValues,
-                               sizeof(editState->overrideConstants[g_selectedRegister]));
-                        editState->overrideValid[g_selectedRegister] = true;
+                        int expiresAtFrame = -1;
                         if (g_overrideScopeMode == Override_OneFrame) {
-                            editState->overrideExpiresAtFrame[g_selectedRegister] = g_frameCount + 1;
+                            expiresAtFrame = g_frameCount + 1;
                         } else if (g_overrideScopeMode == Override_NFrames) {
-                            editState->overrideExpiresAtFrame[g_selectedRegister] = g_frameCount + g_overrideNFrames;
-                        } else {
-                            editState->overrideExpiresAtFrame[g_selectedRegister] = -1;
+                            expiresAtFrame = g_frameCount + g_overrideNFrames;
                         }
+                        editState->SetOverride(g_selectedRegister, editValues, expiresAtFrame);
                     }
                     ImGui::SameLine();
                     if (ImGui::Button("Reset selected override")) {
@@ -3765,7 +4652,7 @@ static void RenderImGuiOverlay(IDirect3DDevice9* device) {
                         } else {
                             bool anyValid = false;
                             for (int reg = base; reg < base + 4; reg++) {
-                                if (state->valid[reg]) {
+                                if (state->IsValid(reg)) {
                                     anyValid = true;
                                     break;
                                 }
@@ -3794,14 +4681,14 @@ static void RenderImGuiOverlay(IDirect3DDevice9* device) {
                             }
                             for (int reg = base; reg < base + 4; reg++) {
                                 char rowLabel[128];
-                                if (state->valid[reg]) {
+                                if (state->IsValid(reg)) {
                                     if (g_showTransposedMatrices && hasMatrix) {
                                         int row = reg - base;
                                         const float* data = reinterpret_cast<const float*>(&displayMat) + row * 4;
                                         snprintf(rowLabel, sizeof(rowLabel), "r%d: [%.3f %.3f %.3f %.3f]###reg_%d",
                                                  row, data[0], data[1], data[2], data[3], reg);
                                     } else {
-                                        const float* data = state->constants[reg];
+                                        const float* data = state->GetConstant(reg);
                                         snprintf(rowLabel, sizeof(rowLabel), "c%d: [%.3f %.3f %.3f %.3f]###reg_%d",
                                                  reg, data[0], data[1], data[2], data[3], reg);
                                     }
@@ -3817,11 +4704,11 @@ static void RenderImGuiOverlay(IDirect3DDevice9* device) {
                             }
 
                             int selectedRows = g_manualAssignRows;
-                            if (selectedRows == 3 && !state->valid[base + 2]) {
+                            if (selectedRows == 3 && !state->IsValid(base + 2)) {
                                 selectedRows = 4;
                             }
-                            bool canAssign = state->valid[base] && state->valid[base + 1] && state->valid[base + 2] &&
-                                             (selectedRows == 3 || state->valid[base + 3]);
+                            bool canAssign = state->IsValid(base) && state->IsValid(base + 1) && state->IsValid(base + 2) &&
+                                             (selectedRows == 3 || state->IsValid(base + 3));
                             if (canAssign) {
                                 D3DMATRIX assignedMat = {};
                                 if (!TryBuildMatrixSnapshot(*state, base, selectedRows, false, &assignedMat)) {
@@ -3856,10 +4743,10 @@ static void RenderImGuiOverlay(IDirect3DDevice9* device) {
                     }
                 } else {
                     for (int reg = 0; reg < kMaxConstantRegisters; reg++) {
-                        if (!state->valid[reg]) {
+                        if (!state->IsValid(reg)) {
                             continue;
                         }
-                        const float* data = state->constants[reg];
+                        const float* data = state->GetConstant(reg);
                         char rowLabel[128];
                         snprintf(rowLabel, sizeof(rowLabel), "c%d: [%.3f %.3f %.3f %.3f]###reg_%d",
                                  reg, data[0], data[1], data[2], data[3], reg);
@@ -3990,15 +4877,15 @@ static void RenderImGuiOverlay(IDirect3DDevice9* device) {
                         if (ImGui::Button("Use as View")) {
                             StoreViewMatrix(hit.matrix, 0, -1, 4, false, true, "memory scanner");
                             snprintf(g_matrixAssignStatus, sizeof(g_matrixAssignStatus),
-                                     "Assigned VIEW from memory scan @ %p (hash 0x%08X).",
-                                     reinterpret_cast<void*>(hit.address), hit.hash);
+                                     "Assigned VIEW from memory scan @ %p (hash %016llX).",
+                                     reinterpret_cast<void*>(hit.address), static_cast<unsigned long long>(hit.hash));
                         }
                         ImGui::SameLine();
                         if (ImGui::Button("Use as Projection")) {
                             StoreProjectionMatrix(hit.matrix, 0, -1, 4, false, true, "memory scanner");
                             snprintf(g_matrixAssignStatus, sizeof(g_matrixAssignStatus),
-                                     "Assigned PROJECTION from memory scan @ %p (hash 0x%08X).",
-                                     reinterpret_cast<void*>(hit.address), hit.hash);
+                                     "Assigned PROJECTION from memory scan @ %p (hash %016llX).",
+                                     reinterpret_cast<void*>(hit.address), static_cast<unsigned long long>(hit.hash));
                         }
                         ImGui::PopID();
                         ImGui::Separator();
@@ -4021,7 +4908,8 @@ static void RenderImGuiOverlay(IDirect3DDevice9* device) {
             ImGui::SameLine();
             if (ImGui::Button("Clear logs")) {
                 std::lock_guard<std::mutex> lock(g_uiDataMutex);
-                g_logLines.clear();
+                g_logLinesHead = 0;
+                g_logLinesCount = 0;
                 g_logSnapshot.clear();
                 g_logSnapshotDirty = false;
             }
@@ -4084,11 +4972,12 @@ static void AppendUiLogLine(const char* text) {
         return;
     }
     std::lock_guard<std::mutex> lock(g_uiDataMutex);
-    g_logLines.emplace_back(text);
-    g_logSnapshotDirty = true;
-    while (g_logLines.size() > kMaxUiLogLines) {
-        g_logLines.pop_front();
+    snprintf(g_logLines[g_logLinesHead], kUiLogLineLength, "%s", text);
+    g_logLinesHead = (g_logLinesHead + 1) % kMaxUiLogLines;
+    if (g_logLinesCount < kMaxUiLogLines) {
+        g_logLinesCount++;
     }
+    g_logSnapshotDirty = true;
 }
 
 // Logging helper
@@ -4124,454 +5013,55 @@ bool LooksLikeMatrix(const float* data) {
     return true;
 }
 
-static float Dot3(float ax, float ay, float az, float bx, float by, float bz) {
-    return ax * bx + ay * by + az * bz;
-}
-
-static float Determinant3x3(const D3DMATRIX& m) {
-    return m._11 * (m._22 * m._33 - m._23 * m._32) -
-           m._12 * (m._21 * m._33 - m._23 * m._31) +
-           m._13 * (m._21 * m._32 - m._22 * m._31);
-}
-
 static bool LooksLikeViewStrict(const D3DMATRIX& m) {
-    float row0len = sqrtf(Dot3(m._11, m._12, m._13, m._11, m._12, m._13));
-    float row1len = sqrtf(Dot3(m._21, m._22, m._23, m._21, m._22, m._23));
-    float row2len = sqrtf(Dot3(m._31, m._32, m._33, m._31, m._32, m._33));
-
-    if (fabsf(row0len - 1.0f) > 0.05f) return false;
-    if (fabsf(row1len - 1.0f) > 0.05f) return false;
-    if (fabsf(row2len - 1.0f) > 0.05f) return false;
-
-    if (fabsf(Dot3(m._11, m._12, m._13, m._21, m._22, m._23)) > 0.05f) return false;
-    if (fabsf(Dot3(m._11, m._12, m._13, m._31, m._32, m._33)) > 0.05f) return false;
-    if (fabsf(Dot3(m._21, m._22, m._23, m._31, m._32, m._33)) > 0.05f) return false;
-
-    if (fabsf(m._14) > 0.01f || fabsf(m._24) > 0.01f || fabsf(m._34) > 0.01f) return false;
-    if (fabsf(m._44 - 1.0f) > 0.01f) return false;
-
-    float det = Determinant3x3(m);
-    if (fabsf(det - 1.0f) > 0.1f) return false;
-
-    return true;
+    return matrix_engine::LooksLikeViewStrict(AsEngineMatrix(m));
 }
 
 static bool LooksLikeProjectionStrict(const D3DMATRIX& m) {
-    return AnalyzeProjectionMatrixNumeric(m, nullptr);
-}
-
-static bool IsTypicalProjectionMatrix(const D3DMATRIX& m) {
-    ProjectionAnalysis analysis = {};
-    if (!AnalyzeProjectionMatrixNumeric(m, &analysis) || !analysis.valid) {
-        return false;
-    }
-    if (analysis.fovRadians < g_config.minFOV || analysis.fovRadians > g_config.maxFOV) {
-        return false;
-    }
-
-    const bool perspectiveTermsLookValid =
-        fabsf(m._14) <= 0.05f &&
-        fabsf(m._24) <= 0.05f &&
-        fabsf(m._44) <= 0.05f &&
-        fabsf(fabsf(m._34) - 1.0f) <= 0.05f;
-
-    return perspectiveTermsLookValid;
+    return matrix_engine::LooksLikeProjectionStrict(AsEngineMatrix(m));
 }
 
 static bool AnalyzeProjectionMatrixNumeric(const D3DMATRIX& m, ProjectionAnalysis* out) {
-    constexpr float kZeroEpsilon = 0.02f;
-    constexpr float kPerspectiveEpsilon = 0.05f;
-
-    if (!std::isfinite(m._11) || !std::isfinite(m._22) || !std::isfinite(m._33) ||
-        !std::isfinite(m._34) || !std::isfinite(m._43) || !std::isfinite(m._44)) {
-        return false;
-    }
-
-    if (fabsf(m._12) > kZeroEpsilon || fabsf(m._13) > kZeroEpsilon ||
-        fabsf(m._21) > kZeroEpsilon || fabsf(m._23) > kZeroEpsilon ||
-        fabsf(m._31) > kZeroEpsilon || fabsf(m._32) > kZeroEpsilon) {
-        return false;
-    }
-
-    if (fabsf(m._14) > kZeroEpsilon || fabsf(m._24) > kZeroEpsilon) {
-        return false;
-    }
-
-    if (fabsf(fabsf(m._34) - 1.0f) > kPerspectiveEpsilon) {
-        return false;
-    }
-
-    if (fabsf(m._44) > kPerspectiveEpsilon) {
-        return false;
-    }
-
-    if (fabsf(m._11) < 0.001f || fabsf(m._22) < 0.001f) {
-        return false;
-    }
-
-    if (fabsf(m._33) < 0.0001f || fabsf(m._43) < 0.0001f) {
-        return false;
-    }
-
-    const float fov = 2.0f * atanf(1.0f / fabsf(m._22));
-    if (!std::isfinite(fov) || fov < 0.01f || fov > 3.13f) {
-        return false;
-    }
-
-    if (out) {
-        out->valid = true;
-        out->fovRadians = fov;
-        out->handedness = (m._34 >= 0.0f) ? ProjectionHandedness_Left : ProjectionHandedness_Right;
-    }
-    return true;
+    return matrix_engine::AnalyzeProjectionMatrixNumeric(AsEngineMatrix(m), out);
 }
 
 static const char* ProjectionHandednessLabel(ProjectionHandedness handedness) {
-    switch (handedness) {
-        case ProjectionHandedness_Left: return "LH";
-        case ProjectionHandedness_Right: return "RH";
-        default: return "Unknown";
-    }
+    return matrix_engine::ProjectionHandednessLabel(handedness);
 }
 
-static bool HasPerspectiveComponent(const D3DMATRIX& m) {
-    return fabsf(m._34) > 0.5f && fabsf(m._44) < 0.5f;
-}
-
-static bool IsAffineMatrixNoPerspective(const D3DMATRIX& m) {
-    return fabsf(m._14) < 0.02f && fabsf(m._24) < 0.02f && fabsf(m._34) < 0.02f && fabsf(m._44 - 1.0f) < 0.02f;
+static bool IsIdentityMatrix(const D3DMATRIX& m, float tolerance) {
+    return fabsf(m._11 - 1.0f) < tolerance &&
+           fabsf(m._22 - 1.0f) < tolerance &&
+           fabsf(m._33 - 1.0f) < tolerance &&
+           fabsf(m._44 - 1.0f) < tolerance &&
+           fabsf(m._12) < tolerance &&
+           fabsf(m._13) < tolerance &&
+           fabsf(m._14) < tolerance &&
+           fabsf(m._21) < tolerance &&
+           fabsf(m._23) < tolerance &&
+           fabsf(m._24) < tolerance &&
+           fabsf(m._31) < tolerance &&
+           fabsf(m._32) < tolerance &&
+           fabsf(m._34) < tolerance &&
+           fabsf(m._41) < tolerance &&
+           fabsf(m._42) < tolerance &&
+           fabsf(m._43) < tolerance;
 }
-
-static bool IsLikelyBoneTransform(const D3DMATRIX& m,
-                                  int rows,
-                                  UINT vectorCountInUpload,
-                                  UINT uploadStartReg,
-                                  UINT candidateBaseReg) {
-    if (!IsAffineMatrixNoPerspective(m)) {
-        return false;
+static float MatrixIdentityMaxError(const D3DMATRIX& m) {
+    const D3DMATRIX identity = {
+        1.0f, 0.0f, 0.0f, 0.0f,
+        0.0f, 1.0f, 0.0f, 0.0f,
+        0.0f, 0.0f, 1.0f, 0.0f,
+        0.0f, 0.0f, 0.0f, 1.0f
+    };
+    const float* a = reinterpret_cast<const float*>(&m);
+    const float* b = reinterpret_cast<const float*>(&identity);
+    float maxErr = 0.0f;
+    for (int i = 0; i < 16; ++i) {
+        maxErr = (std::max)(maxErr, fabsf(a[i] - b[i]));
     }
-
-    const float r0 = sqrtf(Dot3(m._11, m._12, m._13, m._11, m._12, m._13));
-    const float r1 = sqrtf(Dot3(m._21, m._22, m._23, m._21, m._22, m._23));
-    const float r2 = sqrtf(Dot3(m._31, m._32, m._33, m._31, m._32, m._33));
-    const bool nearUnitRows = fabsf(r0 - 1.0f) < 0.25f && fabsf(r1 - 1.0f) < 0.25f && fabsf(r2 - 1.0f) < 0.25f;
-
-    const bool appearsInPaletteUpload =
-        vectorCountInUpload >= 8 &&
-        candidateBaseReg >= uploadStartReg &&
-        (candidateBaseReg + static_cast<UINT>(rows)) <= (uploadStartReg + vectorCountInUpload);
-
-    return nearUnitRows && appearsInPaletteUpload;
-}
-
-static bool LooksLikeWorldStrict(const D3DMATRIX& m,
-                                 int rows,
-                                 UINT vectorCountInUpload,
-                                 UINT uploadStartReg,
-                                 UINT candidateBaseReg) {
-    if (!IsAffineMatrixNoPerspective(m)) return false;
-    if (LooksLikeViewStrict(m)) return false;
-
-    const float det = Determinant3x3(m);
-    if (!std::isfinite(det) || fabsf(det) < 0.0001f) return false;
-
-    if (IsLikelyBoneTransform(m, rows, vectorCountInUpload, uploadStartReg, candidateBaseReg)) {
-        return false;
-    }
-    return true;
-}
-
-enum MatrixClassification {
-    MatrixClass_None = 0,
-    MatrixClass_World,
-    MatrixClass_View,
-    MatrixClass_Projection,
-    MatrixClass_CombinedPerspective
-};
-
-static MatrixClassification ClassifyMatrixDeterministic(const D3DMATRIX& m,
-                                                        int rows,
-                                                        UINT vectorCountInUpload,
-                                                        UINT uploadStartReg,
-                                                        UINT candidateBaseReg) {
-    if (LooksLikeProjectionStrict(m)) {
-        return MatrixClass_Projection;
-    }
-    if (HasPerspectiveComponent(m)) {
-        return MatrixClass_CombinedPerspective;
-    }
-    if (LooksLikeViewStrict(m)) {
-        return MatrixClass_View;
-    }
-    if (LooksLikeWorldStrict(m, rows, vectorCountInUpload, uploadStartReg, candidateBaseReg)) {
-        return MatrixClass_World;
-    }
-    return MatrixClass_None;
-}
-
-static bool IsThreeRowPrefixOfPerspectiveMatrix(const float* data,
-                                                UINT startReg,
-                                                UINT vectorCount,
-                                                UINT candidateBaseReg,
-                                                bool transposedLayout);
-
-static int CountStridedCandidates(const float* data,
-                                  UINT startReg,
-                                  UINT vectorCount,
-                                  UINT strideRows,
-                                  MatrixClassification targetClass) {
-    int count = 0;
-    for (UINT offset = 0; offset + strideRows <= vectorCount; offset += strideRows) {
-        D3DMATRIX candidate = {};
-        if (!TryBuildMatrixFromConstantUpdate(data + offset * 4,
-                                              startReg + offset,
-                                              strideRows,
-                                              static_cast<int>(startReg + offset),
-                                              static_cast<int>(strideRows),
-                                              false,
-                                              &candidate)) {
-            continue;
-        }
-        MatrixClassification cls = ClassifyMatrixDeterministic(
-            candidate,
-            static_cast<int>(strideRows),
-            vectorCount,
-            startReg,
-            startReg + offset);
-
-        if (strideRows == 3u &&
-            (cls == MatrixClass_View || cls == MatrixClass_World) &&
-            IsThreeRowPrefixOfPerspectiveMatrix(data,
-                                                startReg,
-                                                vectorCount,
-                                                startReg + offset,
-                                                false)) {
-            continue;
-        }
-
-        if (cls == targetClass && ++count > 1) {
-            return count;
-        }
-    }
-    return count;
-}
-
-static bool IsThreeRowPrefixOfPerspectiveMatrix(const float* data,
-                                                UINT startReg,
-                                                UINT vectorCount,
-                                                UINT candidateBaseReg,
-                                                bool transposedLayout) {
-    if (!data || vectorCount < 4) {
-        return false;
-    }
-    if (candidateBaseReg < startReg) {
-        return false;
-    }
-
-    const UINT offset = candidateBaseReg - startReg;
-    if (offset + 4 > vectorCount) {
-        return false;
-    }
-
-    D3DMATRIX candidate4x4 = {};
-    if (!TryBuildMatrixFromConstantUpdate(data + offset * 4,
-                                          candidateBaseReg,
-                                          4u,
-                                          static_cast<int>(candidateBaseReg),
-                                          4,
-                                          transposedLayout,
-                                          &candidate4x4)) {
-        return false;
-    }
-
-    const MatrixClassification directClass = ClassifyMatrixDeterministic(
-        candidate4x4,
-        4,
-        vectorCount,
-        startReg,
-        candidateBaseReg);
-    if (directClass == MatrixClass_Projection || directClass == MatrixClass_CombinedPerspective) {
-        return true;
-    }
-
-    const D3DMATRIX transposed = TransposeMatrix(candidate4x4);
-    const MatrixClassification transposedClass = ClassifyMatrixDeterministic(
-        transposed,
-        4,
-        vectorCount,
-        startReg,
-        candidateBaseReg);
-    return transposedClass == MatrixClass_Projection ||
-           transposedClass == MatrixClass_CombinedPerspective;
-}
-
-static D3DMATRIX MultiplyMatrix(const D3DMATRIX& a, const D3DMATRIX& b) {
-    D3DMATRIX out = {};
-    out._11 = a._11*b._11 + a._12*b._21 + a._13*b._31 + a._14*b._41;
-    out._12 = a._11*b._12 + a._12*b._22 + a._13*b._32 + a._14*b._42;
-    out._13 = a._11*b._13 + a._12*b._23 + a._13*b._33 + a._14*b._43;
-    out._14 = a._11*b._14 + a._12*b._24 + a._13*b._34 + a._14*b._44;
-
-    out._21 = a._21*b._11 + a._22*b._21 + a._23*b._31 + a._24*b._41;
-    out._22 = a._21*b._12 + a._22*b._22 + a._23*b._32 + a._24*b._42;
-    out._23 = a._21*b._13 + a._22*b._23 + a._23*b._33 + a._24*b._43;
-    out._24 = a._21*b._14 + a._22*b._24 + a._23*b._34 + a._24*b._44;
-
-    out._31 = a._31*b._11 + a._32*b._21 + a._33*b._31 + a._34*b._41;
-    out._32 = a._31*b._12 + a._32*b._22 + a._33*b._32 + a._34*b._42;
-    out._33 = a._31*b._13 + a._32*b._23 + a._33*b._33 + a._34*b._43;
-    out._34 = a._31*b._14 + a._32*b._24 + a._33*b._34 + a._34*b._44;
-
-    out._41 = a._41*b._11 + a._42*b._21 + a._43*b._31 + a._44*b._41;
-    out._42 = a._41*b._12 + a._42*b._22 + a._43*b._32 + a._44*b._42;
-    out._43 = a._41*b._13 + a._42*b._23 + a._43*b._33 + a._44*b._43;
-    out._44 = a._41*b._14 + a._42*b._24 + a._43*b._34 + a._44*b._44;
-    return out;
-}
-
-
-// Returns true if candidateView is consistent with being a pure orthonormal
-// view matrix relative to knownProjection.
-static bool CrossValidateViewAgainstProjection(const D3DMATRIX& candidateView,
-                                               const D3DMATRIX& knownProjection) {
-    D3DMATRIX vp = MultiplyMatrix(candidateView, knownProjection);
-
-    const float p_c0 = sqrtf(
-        knownProjection._11 * knownProjection._11 +
-        knownProjection._21 * knownProjection._21 +
-        knownProjection._31 * knownProjection._31);
-    const float p_c1 = sqrtf(
-        knownProjection._12 * knownProjection._12 +
-        knownProjection._22 * knownProjection._22 +
-        knownProjection._32 * knownProjection._32);
-    const float vp_c0 = sqrtf(
-        vp._11 * vp._11 + vp._21 * vp._21 + vp._31 * vp._31);
-    const float vp_c1 = sqrtf(
-        vp._12 * vp._12 + vp._22 * vp._22 + vp._32 * vp._32);
-
-    if (p_c0 < 1e-6f || p_c1 < 1e-6f) {
-        return true;
-    }
-
-    constexpr float kTol = 0.15f;
-    return (fabsf(vp_c0 - p_c0) / p_c0 < kTol) &&
-           (fabsf(vp_c1 - p_c1) / p_c1 < kTol);
-}
-
-static float MatrixMaxAbsDiff(const D3DMATRIX& a, const D3DMATRIX& b) {
-    const float* pa = reinterpret_cast<const float*>(&a);
-    const float* pb = reinterpret_cast<const float*>(&b);
-    float maxErr = 0.0f;
-    for (int i = 0; i < 16; ++i) {
-        maxErr = (std::max)(maxErr, fabsf(pa[i] - pb[i]));
-    }
-    return maxErr;
-}
-
-enum ViewCandidateConsistency {
-    ViewCandidateConsistency_None,
-    ViewCandidateConsistency_Original,
-    ViewCandidateConsistency_Inverse,
-    ViewCandidateConsistency_Ambiguous
-};
-
-static ViewCandidateConsistency ResolveViewInverseConsistency(const D3DMATRIX& originalView,
-                                                              const D3DMATRIX& inverseView,
-                                                              const D3DMATRIX* knownProjection,
-                                                              bool hasProjection,
-                                                              const D3DMATRIX* knownWorld,
-                                                              bool hasWorld,
-                                                              const D3DMATRIX* knownVP,
-                                                              bool hasVP,
-                                                              const D3DMATRIX* knownWV,
-                                                              bool hasWV,
-                                                              const D3DMATRIX* knownMVP,
-                                                              bool hasMVP) {
-    constexpr float kTolerance = 0.08f;
-    constexpr float kEdge = 0.02f;
-
-    int originalVotes = 0;
-    int inverseVotes = 0;
-    int checks = 0;
-
-    auto voteForLowerError = [&](float originalErr, float inverseErr) {
-        ++checks;
-        const bool originalGood = originalErr <= kTolerance;
-        const bool inverseGood = inverseErr <= kTolerance;
-        if (originalGood && !inverseGood) {
-            ++originalVotes;
-        } else if (inverseGood && !originalGood) {
-            ++inverseVotes;
-        } else if ((std::max)(0.0f, inverseErr - originalErr) > kEdge) {
-            ++originalVotes;
-        } else if ((std::max)(0.0f, originalErr - inverseErr) > kEdge) {
-            ++inverseVotes;
-        }
-    };
-
-    if (hasProjection && hasVP && knownProjection && knownVP) {
-        const D3DMATRIX originalVP = MultiplyMatrix(originalView, *knownProjection);
-        const D3DMATRIX inverseVP = MultiplyMatrix(inverseView, *knownProjection);
-        voteForLowerError(MatrixMaxAbsDiff(originalVP, *knownVP),
-                         MatrixMaxAbsDiff(inverseVP, *knownVP));
-    }
-    if (hasWorld && hasWV && knownWorld && knownWV) {
-        const D3DMATRIX originalWV = MultiplyMatrix(*knownWorld, originalView);
-        const D3DMATRIX inverseWV = MultiplyMatrix(*knownWorld, inverseView);
-        voteForLowerError(MatrixMaxAbsDiff(originalWV, *knownWV),
-                         MatrixMaxAbsDiff(inverseWV, *knownWV));
-    }
-    if (hasWorld && hasProjection && hasMVP && knownWorld && knownProjection && knownMVP) {
-        const D3DMATRIX originalMVP = MultiplyMatrix(MultiplyMatrix(*knownWorld, originalView), *knownProjection);
-        const D3DMATRIX inverseMVP = MultiplyMatrix(MultiplyMatrix(*knownWorld, inverseView), *knownProjection);
-        voteForLowerError(MatrixMaxAbsDiff(originalMVP, *knownMVP),
-                         MatrixMaxAbsDiff(inverseMVP, *knownMVP));
-    }
-
-    if (checks == 0 || originalVotes == inverseVotes) {
-        if (checks > 0 && originalVotes > 0 && inverseVotes > 0) {
-            return ViewCandidateConsistency_Ambiguous;
-        }
-        return ViewCandidateConsistency_None;
-    }
-    return (inverseVotes > originalVotes)
-        ? ViewCandidateConsistency_Inverse
-        : ViewCandidateConsistency_Original;
-}
-
-static bool IsIdentityMatrix(const D3DMATRIX& m, float tolerance) {
-    return fabsf(m._11 - 1.0f) < tolerance &&
-           fabsf(m._22 - 1.0f) < tolerance &&
-           fabsf(m._33 - 1.0f) < tolerance &&
-           fabsf(m._44 - 1.0f) < tolerance &&
-           fabsf(m._12) < tolerance &&
-           fabsf(m._13) < tolerance &&
-           fabsf(m._14) < tolerance &&
-           fabsf(m._21) < tolerance &&
-           fabsf(m._23) < tolerance &&
-           fabsf(m._24) < tolerance &&
-           fabsf(m._31) < tolerance &&
-           fabsf(m._32) < tolerance &&
-           fabsf(m._34) < tolerance &&
-           fabsf(m._41) < tolerance &&
-           fabsf(m._42) < tolerance &&
-           fabsf(m._43) < tolerance;
-}
-static float MatrixIdentityMaxError(const D3DMATRIX& m) {
-    const D3DMATRIX identity = {
-        1.0f, 0.0f, 0.0f, 0.0f,
-        0.0f, 1.0f, 0.0f, 0.0f,
-        0.0f, 0.0f, 1.0f, 0.0f,
-        0.0f, 0.0f, 0.0f, 1.0f
-    };
-    const float* a = reinterpret_cast<const float*>(&m);
-    const float* b = reinterpret_cast<const float*>(&identity);
-    float maxErr = 0.0f;
-    for (int i = 0; i < 16; ++i) {
-        maxErr = (std::max)(maxErr, fabsf(a[i] - b[i]));
-    }
-    return maxErr;
-}
+    return maxErr;
+}
 
 
 static bool MatrixClose(const D3DMATRIX& a, const D3DMATRIX& b, float tolerance) {
@@ -4664,344 +5154,6 @@ static bool TryGetCurrentDisplayAspect(IDirect3DDevice9* device,
     return false;
 }
 
-static bool BuildExperimentalCustomProjectionMatrix(IDirect3DDevice9* device,
-                                                    HWND hwnd,
-                                                    D3DMATRIX* outProjection,
-                                                    bool* outUsedAuto,
-                                                    float* outResolvedAspect,
-                                                    UINT* outWidth,
-                                                    UINT* outHeight) {
-    if (!outProjection || !g_config.experimentalCustomProjectionEnabled) {
-        return false;
-    }
-
-    const CustomProjectionMode mode = g_config.experimentalCustomProjectionMode;
-    if (mode == CustomProjectionMode_Manual) {
-        *outProjection = g_config.experimentalCustomProjectionManualMatrix;
-        if (outUsedAuto) {
-            *outUsedAuto = false;
-        }
-        return true;
-    }
-
-    if (mode != CustomProjectionMode_Auto) {
-        return false;
-    }
-
-    float aspect = g_config.experimentalCustomProjectionAutoAspectFallback;
-    UINT width = 0;
-    UINT height = 0;
-    TryGetCurrentDisplayAspect(device, hwnd, &aspect, &width, &height);
-
-    const float safeAspect = (std::max)(0.1f, aspect);
-    const float fovDeg = (std::max)(1.0f, (std::min)(g_config.experimentalCustomProjectionAutoFovDeg, 179.0f));
-    const float nearZ = (std::max)(0.0001f, g_config.experimentalCustomProjectionAutoNearZ);
-    const float farZ = (std::max)(nearZ + 0.001f, g_config.experimentalCustomProjectionAutoFarZ);
-    const ProjectionHandedness handedness =
-        g_config.experimentalCustomProjectionAutoHandedness == ProjectionHandedness_Right
-            ? ProjectionHandedness_Right
-            : ProjectionHandedness_Left;
-
-    CreateProjectionMatrixWithHandedness(outProjection,
-                                         fovDeg * (3.14159265f / 180.0f),
-                                         safeAspect,
-                                         nearZ,
-                                         farZ,
-                                         handedness);
-
-    if (outUsedAuto) {
-        *outUsedAuto = true;
-    }
-    if (outResolvedAspect) {
-        *outResolvedAspect = safeAspect;
-    }
-    if (outWidth) {
-        *outWidth = width;
-    }
-    if (outHeight) {
-        *outHeight = height;
-    }
-    return true;
-}
-
-static void OrthonormalizeViewMatrix(D3DMATRIX* view) {
-    if (!view) {
-        return;
-    }
-
-    const float origTx = view->_41;
-    const float origTy = view->_42;
-    const float origTz = view->_43;
-
-    float r0x = view->_11, r0y = view->_12, r0z = view->_13;
-    float r1x = view->_21, r1y = view->_22, r1z = view->_23;
-
-    const float len0 = sqrtf(Dot3(r0x, r0y, r0z, r0x, r0y, r0z));
-    if (len0 > 1e-6f) {
-        r0x /= len0; r0y /= len0; r0z /= len0;
-    }
-
-    float dot01 = Dot3(r1x, r1y, r1z, r0x, r0y, r0z);
-    r1x -= dot01 * r0x;
-    r1y -= dot01 * r0y;
-    r1z -= dot01 * r0z;
-
-    const float len1 = sqrtf(Dot3(r1x, r1y, r1z, r1x, r1y, r1z));
-    if (len1 > 1e-6f) {
-        r1x /= len1; r1y /= len1; r1z /= len1;
-    }
-
-    const float r2x = r0y * r1z - r0z * r1y;
-    const float r2y = r0z * r1x - r0x * r1z;
-    const float r2z = r0x * r1y - r0y * r1x;
-
-    view->_11 = r0x; view->_12 = r0y; view->_13 = r0z; view->_14 = 0.0f;
-    view->_21 = r1x; view->_22 = r1y; view->_23 = r1z; view->_24 = 0.0f;
-    view->_31 = r2x; view->_32 = r2y; view->_33 = r2z; view->_34 = 0.0f;
-    view->_41 = Dot3(origTx, origTy, origTz, view->_11, view->_12, view->_13);
-    view->_42 = Dot3(origTx, origTy, origTz, view->_21, view->_22, view->_23);
-    view->_43 = Dot3(origTx, origTy, origTz, view->_31, view->_32, view->_33);
-    view->_44 = 1.0f;
-}
-
-
-static bool TryExtractProjectionFromCombined(const D3DMATRIX& combined,
-                                             const D3DMATRIX* worldOptional,
-                                             bool worldAvailable,
-                                             ProjectionAnalysis* outAnalysis,
-                                             D3DMATRIX* outProjection,
-                                             bool /*forceDecomposition*/) {
-    if (!outProjection) return false;
-    D3DMATRIX candidate = combined;
-    if (worldAvailable && worldOptional) {
-        D3DMATRIX worldInv = {};
-        if (!InvertMatrix4x4Deterministic(*worldOptional, &worldInv, nullptr)) return false;
-        candidate = MultiplyMatrix(worldInv, combined);
-    }
-    if (!AnalyzeProjectionMatrixNumeric(candidate, outAnalysis)) return false;
-    *outProjection = candidate;
-    return true;
-}
-
-static bool TrySolveFromInverseLeftMultiply(const D3DMATRIX& known,
-                                          const D3DMATRIX& combined,
-                                          D3DMATRIX* out) {
-    if (!out) return false;
-    D3DMATRIX inv = {};
-    if (!InvertMatrix4x4Deterministic(known, &inv, nullptr)) {
-        return false;
-    }
-    *out = MultiplyMatrix(inv, combined);
-    return true;
-}
-
-static bool TrySolveFromInverseRightMultiply(const D3DMATRIX& combined,
-                                             const D3DMATRIX& knownRight,
-                                             D3DMATRIX* out) {
-    if (!out) return false;
-    D3DMATRIX inv = {};
-    if (!InvertMatrix4x4Deterministic(knownRight, &inv, nullptr)) {
-        return false;
-    }
-    *out = MultiplyMatrix(combined, inv);
-    return true;
-}
-
-static bool IsFiniteMatrix(const D3DMATRIX& m) {
-    const float* v = reinterpret_cast<const float*>(&m);
-    for (int i = 0; i < 16; ++i) {
-        if (!std::isfinite(v[i])) return false;
-    }
-    return true;
-}
-
-static bool IsWorldCandidateForDecomposition(const D3DMATRIX& m) {
-    if (!IsFiniteMatrix(m) || !IsAffineMatrixNoPerspective(m)) return false;
-    const float det = Determinant3x3(m);
-    return std::isfinite(det) && fabsf(det) > 0.0001f;
-}
-
-static bool IsViewCandidateForDecomposition(const D3DMATRIX& m) {
-    return IsFiniteMatrix(m) && LooksLikeViewStrict(m);
-}
-
-static bool IsProjectionCandidateForDecomposition(const D3DMATRIX& m) {
-    return IsFiniteMatrix(m) && LooksLikeProjectionStrict(m);
-}
-
-static void TryDecomposeCombinedMatricesDeterministic(D3DMATRIX* world,
-                                                      bool* hasWorld,
-                                                      D3DMATRIX* view,
-                                                      bool* hasView,
-                                                      D3DMATRIX* projection,
-                                                      bool* hasProjection,
-                                                      const D3DMATRIX* mvp,
-                                                      bool hasMvp,
-                                                      const D3DMATRIX* mv,
-                                                      bool hasMv,
-                                                      const D3DMATRIX* vp,
-                                                      bool hasVp,
-                                                      const D3DMATRIX* generatedProjection,
-                                                      bool hasGeneratedProjection) {
-    if (!world || !hasWorld || !view || !hasView || !projection || !hasProjection) return;
-
-    g_combinedDecompDebug = {};
-    g_combinedDecompDebug.attempted = hasMvp || hasMv || hasVp;
-    if (!g_config.enableCombinedDecomposition || !g_combinedDecompDebug.attempted) {
-        return;
-    }
-
-    bool changed = true;
-    D3DMATRIX knownMvp = {};
-    D3DMATRIX knownMv = {};
-    D3DMATRIX knownVp = {};
-    bool knownHasMvp = hasMvp;
-    bool knownHasMv = hasMv;
-    bool knownHasVp = hasVp;
-    if (knownHasMvp && mvp) knownMvp = *mvp;
-    if (knownHasMv && mv) knownMv = *mv;
-    if (knownHasVp && vp) knownVp = *vp;
-
-    auto solveWorld = [&](const D3DMATRIX& candidate, const char* formula) {
-        if (*hasWorld || !IsWorldCandidateForDecomposition(candidate)) return false;
-        *world = candidate;
-        *hasWorld = true;
-        g_combinedDecompDebug.solvedWorld = true;
-        snprintf(g_combinedDecompDebug.worldFormula, sizeof(g_combinedDecompDebug.worldFormula), "%s", formula);
-        return true;
-    };
-
-    auto solveView = [&](const D3DMATRIX& candidate, const char* formula) {
-        if (*hasView || !IsViewCandidateForDecomposition(candidate)) return false;
-        *view = candidate;
-        *hasView = true;
-        g_combinedDecompDebug.solvedView = true;
-        snprintf(g_combinedDecompDebug.viewFormula, sizeof(g_combinedDecompDebug.viewFormula), "%s", formula);
-        return true;
-    };
-
-    auto solveProjection = [&](const D3DMATRIX& candidate, const char* formula) {
-        if (*hasProjection || !IsProjectionCandidateForDecomposition(candidate)) return false;
-        *projection = candidate;
-        *hasProjection = true;
-        g_combinedDecompDebug.solvedProjection = true;
-        snprintf(g_combinedDecompDebug.projectionFormula, sizeof(g_combinedDecompDebug.projectionFormula), "%s", formula);
-        return true;
-    };
-
-    for (int pass = 0; pass < 8 && changed; ++pass) {
-        changed = false;
-
-        if (!knownHasMv && *hasView && *hasWorld) {
-            knownMv = MultiplyMatrix(*world, *view);
-            knownHasMv = true;
-            changed = true;
-        }
-        if (!knownHasVp && *hasView && *hasProjection) {
-            knownVp = MultiplyMatrix(*view, *projection);
-            knownHasVp = true;
-            changed = true;
-        }
-        if (!knownHasMvp && knownHasMv && *hasProjection) {
-            knownMvp = MultiplyMatrix(knownMv, *projection);
-            knownHasMvp = true;
-            changed = true;
-        }
-        if (!knownHasMvp && knownHasVp && *hasWorld) {
-            knownMvp = MultiplyMatrix(*world, knownVp);
-            knownHasMvp = true;
-            changed = true;
-        }
-
-        if (knownHasMvp && *hasWorld && !knownHasVp) {
-            D3DMATRIX solvedVp = {};
-            if (TrySolveFromInverseLeftMultiply(*world, knownMvp, &solvedVp)) {
-                knownVp = solvedVp;
-                knownHasVp = true;
-                changed = true;
-            }
-        }
-        if (knownHasMvp && *hasProjection && !knownHasMv) {
-            D3DMATRIX solvedMv = {};
-            if (TrySolveFromInverseRightMultiply(knownMvp, *projection, &solvedMv)) {
-                knownMv = solvedMv;
-                knownHasMv = true;
-                changed = true;
-            }
-        }
-
-        if (knownHasMv && !*hasWorld && *hasView) {
-            D3DMATRIX solved = {};
-            if (TrySolveFromInverseRightMultiply(knownMv, *view, &solved) &&
-                solveWorld(solved, "World = MV * inv(View)")) {
-                changed = true;
-            }
-        }
-        if (knownHasMv && !*hasView && *hasWorld) {
-            D3DMATRIX solved = {};
-            if (TrySolveFromInverseLeftMultiply(*world, knownMv, &solved) &&
-                solveView(solved, "View = inv(World) * MV")) {
-                changed = true;
-            }
-        }
-
-        if (knownHasVp && !*hasView && *hasProjection) {
-            D3DMATRIX solved = {};
-            if (TrySolveFromInverseRightMultiply(knownVp, *projection, &solved) &&
-                solveView(solved, "View = VP * inv(Projection)")) {
-                changed = true;
-            }
-        }
-        if (knownHasVp && !*hasProjection && *hasView) {
-            D3DMATRIX solved = {};
-            if (TrySolveFromInverseLeftMultiply(*view, knownVp, &solved) &&
-                solveProjection(solved, "Projection = inv(View) * VP")) {
-                changed = true;
-            }
-        }
-
-        if (knownHasMvp && knownHasVp && !*hasWorld) {
-            D3DMATRIX solved = {};
-            if (TrySolveFromInverseRightMultiply(knownMvp, knownVp, &solved) &&
-                solveWorld(solved, "World = MVP * inv(VP)")) {
-                changed = true;
-            }
-        }
-        if (knownHasMvp && knownHasMv && !*hasProjection) {
-            D3DMATRIX solved = {};
-            if (TrySolveFromInverseLeftMultiply(knownMv, knownMvp, &solved) &&
-                solveProjection(solved, "Projection = inv(MV) * MVP")) {
-                changed = true;
-            }
-        }
-        if (knownHasVp && !*hasProjection && !*hasView && hasGeneratedProjection && g_config.allowGeneratedProjectionForVPDecomposition) {
-            D3DMATRIX solvedView = {};
-            if (TrySolveFromInverseRightMultiply(knownVp, *generatedProjection, &solvedView) &&
-                IsProjectionCandidateForDecomposition(*generatedProjection) &&
-                IsViewCandidateForDecomposition(solvedView)) {
-                *projection = *generatedProjection;
-                *hasProjection = true;
-                *view = solvedView;
-                *hasView = true;
-                g_combinedDecompDebug.solvedProjection = true;
-                g_combinedDecompDebug.solvedView = true;
-                snprintf(g_combinedDecompDebug.projectionFormula, sizeof(g_combinedDecompDebug.projectionFormula),
-                         "Projection = Generated manual/auto matrix (config-enabled)");
-                snprintf(g_combinedDecompDebug.viewFormula, sizeof(g_combinedDecompDebug.viewFormula),
-                         "View = VP * inv(GeneratedProjection)");
-                changed = true;
-            }
-        }
-    }
-
-    if (g_config.combinedDecompositionLog && g_combinedDecompDebug.attempted) {
-        LogMsg("Combined decomposition result: world=%s view=%s projection=%s.",
-               *hasWorld ? "yes" : "no",
-               *hasView ? "yes" : "no",
-               *hasProjection ? "yes" : "no");
-    }
-}
-
 // Create an identity matrix
 void CreateIdentityMatrix(D3DMATRIX* out) {
     memset(out, 0, sizeof(D3DMATRIX));
@@ -5052,54 +5204,322 @@ bool LooksLikeView(const D3DMATRIX& m) {
 class WrappedD3D9Device;
 class WrappedD3D9;
 
+// Devices alive in this process, so shader releases can reach their cached record pointers.
+static std::vector<WrappedD3D9Device*> g_liveDevices;
+
 class WrappedPixelShader9 : public IDirect3DPixelShader9 {
 private:
     IDirect3DPixelShader9* m_real;
     uintptr_t m_key;
+    ShaderRecord* m_record = nullptr;
 public:
     explicit WrappedPixelShader9(IDirect3DPixelShader9* real)
         : m_real(real), m_key(reinterpret_cast<uintptr_t>(this)) {}
 
-    IDirect3DPixelShader9* GetReal() const { return m_real; }
-    uintptr_t GetKey() const { return m_key; }
+    IDirect3DPixelShader9* GetReal() const { return m_real; }
+    uintptr_t GetKey() const { return m_key; }
+    // Owned by g_shaderRecords; erased together with this wrapper in Release.
+    ShaderRecord* GetRecord() const { return m_record; }
+    void SetRecord(ShaderRecord* record) { m_record = record; }
+
+    HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** ppv) override { return m_real->QueryInterface(riid, ppv); }
+    ULONG STDMETHODCALLTYPE AddRef() override { return m_real->AddRef(); }
+    ULONG STDMETHODCALLTYPE Release() override {
+        ULONG count = m_real->Release();
+        if (count == 0) {
+            OnVertexShaderReleased(m_key);
+            delete this;
+        }
+        return count;
+    }
+    HRESULT STDMETHODCALLTYPE GetDevice(IDirect3DDevice9** ppDevice) override { return m_real->GetDevice(ppDevice); }
+    HRESULT STDMETHODCALLTYPE GetFunction(void* pData, UINT* pSizeOfData) override { return m_real->GetFunction(pData, pSizeOfData); }
+};
+
+class WrappedVertexShader9 : public IDirect3DVertexShader9 {
+private:
+    IDirect3DVertexShader9* m_real;
+    uintptr_t m_key;
+    ShaderRecord* m_record = nullptr;
+    ShaderConstantState* m_constantState = nullptr;
+public:
+    explicit WrappedVertexShader9(IDirect3DVertexShader9* real)
+        : m_real(real), m_key(reinterpret_cast<uintptr_t>(this)) {}
+
+    IDirect3DVertexShader9* GetReal() const { return m_real; }
+    uintptr_t GetKey() const { return m_key; }
+    // Resolved once at creation (record) or first bind (constant state). Both maps are
+    // node-based and only erase this key from Release, so the pointers stay valid.
+    ShaderRecord* GetRecord() const { return m_record; }
+    ShaderConstantState* GetConstantState() const { return m_constantState; }
+    void SetRecord(ShaderRecord* record) { m_record = record; }
+    void SetConstantState(ShaderConstantState* state) { m_constantState = state; }
+
+    HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** ppv) override { return m_real->QueryInterface(riid, ppv); }
+    ULONG STDMETHODCALLTYPE AddRef() override { return m_real->AddRef(); }
+    ULONG STDMETHODCALLTYPE Release() override {
+        ULONG count = m_real->Release();
+        if (count == 0) {
+            OnVertexShaderReleased(m_key);
+            delete this;
+        }
+        return count;
+    }
+    HRESULT STDMETHODCALLTYPE GetDevice(IDirect3DDevice9** ppDevice) override { return m_real->GetDevice(ppDevice); }
+    HRESULT STDMETHODCALLTYPE GetFunction(void* pData, UINT* pSizeOfData) override { return m_real->GetFunction(pData, pSizeOfData); }
+};
+
+class WrappedStateBlock9 : public IDirect3DStateBlock9 {
+private:
+    IDirect3DStateBlock9* m_real;
+public:
+    explicit WrappedStateBlock9(IDirect3DStateBlock9* real) : m_real(real) {}
+
+    HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** ppv) override { return m_real->QueryInterface(riid, ppv); }
+    ULONG STDMETHODCALLTYPE AddRef() override { return m_real->AddRef(); }
+    ULONG STDMETHODCALLTYPE Release() override {
+        ULONG count = m_real->Release();
+        if (count == 0) {
+            delete this;
+        }
+        return count;
+    }
+    HRESULT STDMETHODCALLTYPE GetDevice(IDirect3DDevice9** ppDevice) override { return m_real->GetDevice(ppDevice); }
+    HRESULT STDMETHODCALLTYPE Capture() override { return m_real->Capture(); }
+    HRESULT STDMETHODCALLTYPE Apply() override {
+        // The block may carry transforms; the next draw must re-send everything.
+        g_fixedFunctionTransformEpoch++;
+        return m_real->Apply();
+    }
+};
+
+// The device engine's view of g_config and the active profile.
+static MatrixEngineConfig BuildMatrixEngineConfig() {
+    MatrixEngineConfig config;
+    config.profile = g_activeGameProfile;
+    config.viewMatrixRegister = g_config.viewMatrixRegister;
+    config.projMatrixRegister = g_config.projMatrixRegister;
+    config.worldMatrixRegister = g_config.worldMatrixRegister;
+    config.mvpMatrixRegister = g_config.mvpMatrixRegister;
+    config.mvMatrixRegister = g_config.mvMatrixRegister;
+    config.vpMatrixRegister = g_config.vpMatrixRegister;
+    config.minFOV = g_config.minFOV;
+    config.maxFOV = g_config.maxFOV;
+    config.autoDetectMatrices = g_config.autoDetectMatrices;
+    config.probeTransposedLayouts = g_probeTransposedLayouts;
+    config.probeInverseView = g_probeInverseView;
+    config.logAllConstants = g_config.logAllConstants;
+    config.enableCombinedDecomposition = g_config.enableCombinedDecomposition;
+    config.combinedDecompositionLog = g_config.combinedDecompositionLog;
+    config.allowGeneratedProjectionForVPDecomposition = g_config.allowGeneratedProjectionForVPDecomposition;
+    config.enableLayoutFastPath = g_config.enableLayoutFastPath;
+    config.layoutLearnFrames = g_config.layoutLearnFrames;
+    config.enableSimdWindowPrefilter = g_config.enableSimdWindowPrefilter;
+    config.deferConstantClassification = g_config.deferConstantClassification;
+    config.shaderTransformMap = g_config.shaderTransformMap;
+    config.emitFixedFunctionTransforms = g_config.emitFixedFunctionTransforms;
+    config.suppressRedundantTransforms = g_config.suppressRedundantTransforms;
+    config.setTransformBypassProxyWhenGameProvides = g_config.setTransformBypassProxyWhenGameProvides;
+    config.setTransformRoundTripCompatibilityMode = g_config.setTransformRoundTripCompatibilityMode;
+    config.mgrUseAutoProjection = g_config.mgrrUseAutoProjectionWhenC4Invalid;
+    config.barnyardUseGameSetTransformsForViewProjection = g_config.barnyardUseGameSetTransformsForViewProjection;
+    config.barnyardForceWorldFromC0 = g_barnyardForceWorldFromC0;
+    config.customProjectionEnabled = g_config.experimentalCustomProjectionEnabled;
+    config.customProjectionMode = static_cast<EngineCustomProjectionMode>(g_config.experimentalCustomProjectionMode);
+    config.customProjectionOverrideDetected = g_config.experimentalCustomProjectionOverrideDetectedProjection;
+    config.customProjectionOverrideCombinedMVP = g_config.experimentalCustomProjectionOverrideCombinedMVP;
+    config.customProjectionAutoFovDeg = g_config.experimentalCustomProjectionAutoFovDeg;
+    config.customProjectionAutoNearZ = g_config.experimentalCustomProjectionAutoNearZ;
+    config.customProjectionAutoFarZ = g_config.experimentalCustomProjectionAutoFarZ;
+    config.customProjectionAutoAspectFallback = g_config.experimentalCustomProjectionAutoAspectFallback;
+    config.customProjectionAutoHandedness = g_config.experimentalCustomProjectionAutoHandedness;
+    config.customProjectionManualMatrix = AsEngineMatrix(g_config.experimentalCustomProjectionManualMatrix);
+    return config;
+}
+
+// The overlay's preview of what the device engines bind as the experimental projection.
+static bool BuildExperimentalCustomProjectionMatrix(IDirect3DDevice9* device,
+                                                    HWND hwnd,
+                                                    D3DMATRIX* outProjection,
+                                                    bool* outUsedAuto,
+                                                    float* outResolvedAspect,
+                                                    UINT* outWidth,
+                                                    UINT* outHeight) {
+    if (!outProjection) {
+        return false;
+    }
+    float aspect = 0.0f;
+    UINT width = 0;
+    UINT height = 0;
+    if (!TryGetCurrentDisplayAspect(device, hwnd, &aspect, &width, &height)) {
+        width = 0;
+        height = 0;
+    }
+    if (!MatrixEngine::BuildCustomProjection(BuildMatrixEngineConfig(), width, height,
+                                             AsEngineMatrix(outProjection), outUsedAuto, outResolvedAspect)) {
+        return false;
+    }
+    if (outWidth) {
+        *outWidth = width;
+    }
+    if (outHeight) {
+        *outHeight = height;
+    }
+    return true;
+}
+
+// What the engine needs from a shader's record: the layout key, the registers it
+// reads and the fixed matrices of a complete transform map.
+static EngineShaderInfo BuildEngineShaderInfo(uintptr_t shaderKey) {
+    EngineShaderInfo info;
+    info.hash = GetShaderHashForKey(shaderKey);
+    auto it = g_shaderRecords.find(shaderKey);
+    if (it == g_shaderRecords.end()) {
+        return info;
+    }
+    const ShaderRecord& rec = it->second;
+    if (rec.constantReadsKnown) {
+        info.constantReadsKnown = true;
+        PackRegisterBits(rec.constantReads, info.constantReads);
+    }
+    if (rec.analysed && rec.transformMap.complete) {
+        info.transformMapComplete = true;
+        for (int i = 0; i < rec.transformMap.useCount && info.transformBaseCount < EngineShaderInfo::kMaxTransformBases; ++i) {
+            const ShaderMatrixUse& use = rec.transformMap.uses[i];
+            if (!use.relative) {
+                info.transformBases[info.transformBaseCount++] = use.baseRegister;
+            }
+        }
+    }
+    return info;
+}
+
+// Publishes a device engine's captures to the overlay globals and forwards its
+// draw-time transforms to the real device.
+class ProxyMatrixEngineHost : public MatrixEngineHost {
+public:
+#if CAMERA_PROXY_METHOD_TIMING
+    // Engine phases become frame-trace events like TRACE_SCOPE; scopes deeper than
+    // kMaxScopeDepth are dropped.
+    void BeginScope(const char* name) override {
+        if (m_scopeDepth < kMaxScopeDepth) {
+            OpenScope& scope = m_scopes[m_scopeDepth];
+            scope.name = name;
+            scope.active = g_traceCaptureActive;
+            if (scope.active) {
+                LARGE_INTEGER now = {};
+                QueryPerformanceCounter(&now);
+                scope.beginTicks = now.QuadPart;
+            }
+        }
+        m_scopeDepth++;
+    }
+
+    void EndScope() override {
+        if (m_scopeDepth == 0) {
+            return;
+        }
+        m_scopeDepth--;
+        if (m_scopeDepth < kMaxScopeDepth && m_scopes[m_scopeDepth].active) {
+            LARGE_INTEGER now = {};
+            QueryPerformanceCounter(&now);
+            RecordTraceEvent(m_scopes[m_scopeDepth].name, m_scopes[m_scopeDepth].beginTicks, now.QuadPart);
+        }
+    }
+#endif
+
+    void Attach(IDirect3DDevice9* device, HWND hwnd) {
+        m_device = device;
+        m_hwnd = hwnd;
+    }
+
+    void OnMatrixCaptured(EngineMatrixSlot slot, const EngineMatrix& m, const EngineCaptureInfo& info) override {
+        const D3DMATRIX matrix = ToD3DMatrix(m);
+        const uintptr_t shaderKey = static_cast<uintptr_t>(info.shaderId);
+        if (info.detection) {
+            g_projectionDetectedByNumericStructure = info.detection->numeric;
+            g_projectionDetectedFovRadians = info.detection->fovRadians;
+            g_projectionDetectedRegister = info.detection->reg;
+            g_projectionDetectedHandedness = info.detection->handedness;
+        }
+        switch (slot) {
+        case EngineMatrix_World:
+            StoreWorldMatrix(matrix, shaderKey, info.baseRegister, info.rows, info.transposed, info.manual,
+                             info.label, info.extractedFromRegister);
+            break;
+        case EngineMatrix_View:
+            StoreViewMatrix(matrix, shaderKey, info.baseRegister, info.rows, info.transposed, info.manual,
+                            info.label, info.extractedFromRegister);
+            break;
+        case EngineMatrix_Projection:
+            StoreProjectionMatrix(matrix, shaderKey, info.baseRegister, info.rows, info.transposed, info.manual,
+                                  info.label, info.extractedFromRegister);
+            break;
+        case EngineMatrix_MVP:
+            StoreMVPMatrix(matrix, shaderKey, info.baseRegister, info.rows, info.transposed, info.manual,
+                           info.label, info.extractedFromRegister);
+            break;
+        case EngineMatrix_VP:
+            StoreVPMatrix(matrix, shaderKey, info.baseRegister, info.rows, info.transposed, info.manual,
+                          info.label, info.extractedFromRegister);
+            break;
+        case EngineMatrix_WV:
+            StoreWVMatrix(matrix, shaderKey, info.baseRegister, info.rows, info.transposed, info.manual,
+                          info.label, info.extractedFromRegister);
+            break;
+        default:
+            break;
+        }
+    }
+
+    bool EmitTransform(EngineTransformSlot slot, const EngineMatrix& m) override {
+        static const D3DTRANSFORMSTATETYPE kStates[EngineTransform_Count] = {
+            D3DTS_WORLD, D3DTS_VIEW, D3DTS_PROJECTION
+        };
+        return m_device && SUCCEEDED(m_device->SetTransform(kStates[slot], AsD3DMatrix(&m)));
+    }
 
-    HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** ppv) override { return m_real->QueryInterface(riid, ppv); }
-    ULONG STDMETHODCALLTYPE AddRef() override { return m_real->AddRef(); }
-    ULONG STDMETHODCALLTYPE Release() override {
-        ULONG count = m_real->Release();
-        if (count == 0) {
-            OnVertexShaderReleased(m_key);
-            delete this;
+    void OnStatus(EngineStatusKind kind, const char* text) override {
+        if (kind == EngineStatus_CustomProjection) {
+            snprintf(g_customProjectionStatus, sizeof(g_customProjectionStatus), "%s", text);
+        } else {
+            snprintf(g_profileStatusMessage, sizeof(g_profileStatusMessage), "%s", text);
         }
-        return count;
     }
-    HRESULT STDMETHODCALLTYPE GetDevice(IDirect3DDevice9** ppDevice) override { return m_real->GetDevice(ppDevice); }
-    HRESULT STDMETHODCALLTYPE GetFunction(void* pData, UINT* pSizeOfData) override { return m_real->GetFunction(pData, pSizeOfData); }
-};
 
-class WrappedVertexShader9 : public IDirect3DVertexShader9 {
-private:
-    IDirect3DVertexShader9* m_real;
-    uintptr_t m_key;
-public:
-    explicit WrappedVertexShader9(IDirect3DVertexShader9* real)
-        : m_real(real), m_key(reinterpret_cast<uintptr_t>(this)) {}
+    void OnLayoutLocked() override {
+        g_shaderCacheDirty = true;
+    }
 
-    IDirect3DVertexShader9* GetReal() const { return m_real; }
-    uintptr_t GetKey() const { return m_key; }
+    void Log(const char* text) override {
+        LogMsg("%s", text);
+    }
 
-    HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** ppv) override { return m_real->QueryInterface(riid, ppv); }
-    ULONG STDMETHODCALLTYPE AddRef() override { return m_real->AddRef(); }
-    ULONG STDMETHODCALLTYPE Release() override {
-        ULONG count = m_real->Release();
-        if (count == 0) {
-            OnVertexShaderReleased(m_key);
-            delete this;
+    bool QueryViewportSize(uint32_t* width, uint32_t* height) override {
+        float aspect = 0.0f;
+        UINT w = 0;
+        UINT h = 0;
+        if (!TryGetCurrentDisplayAspect(m_device, m_hwnd, &aspect, &w, &h)) {
+            return false;
         }
-        return count;
+        *width = w;
+        *height = h;
+        return true;
     }
-    HRESULT STDMETHODCALLTYPE GetDevice(IDirect3DDevice9** ppDevice) override { return m_real->GetDevice(ppDevice); }
-    HRESULT STDMETHODCALLTYPE GetFunction(void* pData, UINT* pSizeOfData) override { return m_real->GetFunction(pData, pSizeOfData); }
+
+private:
+    IDirect3DDevice9* m_device = nullptr;
+    HWND m_hwnd = nullptr;
+#if CAMERA_PROXY_METHOD_TIMING
+    struct OpenScope {
+        const char* name;
+        bool active;
+        long long beginTicks;
+    };
+    static const int kMaxScopeDepth = 4;
+    OpenScope m_scopes[kMaxScopeDepth] = {};
+    int m_scopeDepth = 0;
+#endif
 };
 
 /**
@@ -5109,28 +5529,20 @@ class WrappedD3D9Device : public IDirect3DDevice9Ex {
 private:
     IDirect3DDevice9* m_real;
     IDirect3DDevice9Ex* m_realEx = nullptr;
-    D3DMATRIX m_currentView;
-    D3DMATRIX m_currentProj;
-    D3DMATRIX m_currentWorld;
     HWND m_hwnd = nullptr;
     IDirect3DVertexShader9* m_currentVertexShader = nullptr;
     IDirect3DPixelShader9* m_currentPixelShader = nullptr;
-    bool m_hasView = false;
-    bool m_hasProj = false;
-    bool m_hasWorld = false;
-    bool m_everHadView  = false;
-    bool m_everHadProj  = false;
-    bool m_everHadWorld = false;
-    bool m_mgrrUseAutoProjection = false;
-    int m_constantLogThrottle = 0;
-    int m_viewLastFrame = -1;
-    int m_projLastFrame = -1;
-    int m_projDetectedFrame = -1;
-    int m_worldLastFrame = -1;
-    uintptr_t m_viewLockedShader = 0;
-    int m_viewLockedRegister = -1;
-    uintptr_t m_projLockedShader = 0;
-    int m_projLockedRegister = -1;
+    // Classification, decomposition and draw-time emission; the tools replay traces
+    // through the same class.
+    MatrixEngine m_engine;
+    ProxyMatrixEngineHost m_engineHost;
+    // Engine stats already added to the overlay totals.
+    MatrixEngineStats m_publishedEngineStats = {};
+    // Shader and analysis epoch last pushed to m_engine.
+    uintptr_t m_engineShaderKey = 0;
+    uint32_t m_engineShaderEpoch = 0;
+    // g_goldenRunSerial the engine's caches and state follow.
+    uint32_t m_goldenRunSerial = 0;
     bool m_remixFrameOpen = false;
     IDirect3DSurface9* m_rasterCaptureSurface = nullptr;
     IDirect3DSurface9* m_remixOutputSurface = nullptr;
@@ -5143,6 +5555,13 @@ private:
     bool m_lastRasterCaptureSucceeded = false;
     bool m_lastRemixCaptureSucceeded = false;
     bool m_lastBlendEnabledState = false;
+    // g_fixedFunctionTransformEpoch the engine's emitted-transform cache is valid for.
+    uint32_t m_emittedTransformEpoch = 0;
+    float m_overrideScratch[kMaxConstantRegisters * 4] = {};
+    // Records of the bound shaders for per-draw usage counts. A shader can be released while
+    // still bound, so ForgetShaderRecord clears these before the record is erased.
+    ShaderRecord* m_currentVertexRecord = nullptr;
+    ShaderRecord* m_currentPixelRecord = nullptr;
 
     void ReleaseBlendResources() {
         if (m_blendQuadVB) { m_blendQuadVB->Release(); m_blendQuadVB = nullptr; }
@@ -5320,11 +5739,6 @@ public:
         if (m_real) {
             m_real->QueryInterface(__uuidof(IDirect3DDevice9Ex), reinterpret_cast<void**>(&m_realEx));
         }
-        CreateIdentityMatrix(&m_currentView);
-        CreateIdentityMatrix(&m_currentProj);
-        CreateIdentityMatrix(&m_currentWorld);
-        m_projDetectedFrame = -1;
-        m_mgrrUseAutoProjection = g_config.mgrrUseAutoProjectionWhenC4Invalid;
         D3DDEVICE_CREATION_PARAMETERS params = {};
         if (SUCCEEDED(m_real->GetCreationParameters(&params))) {
             m_hwnd = params.hFocusWindow;
@@ -5332,11 +5746,18 @@ public:
         if (!m_hwnd) {
             m_hwnd = GetForegroundWindow();
         }
-		
+        m_engineHost.Attach(m_real, m_hwnd);
+        m_engine.SetHost(&m_engineHost);
+        m_engine.SetLayoutTable(&g_learnedUploadLayouts);
+        m_engine.SetWindowCache(&g_matrixClassCache);
+        m_engine.SetConfig(BuildMatrixEngineConfig());
+
+        g_liveDevices.push_back(this);
         LogMsg("WrappedD3D9Device created, wrapping device at %p", real);
     }
 
     ~WrappedD3D9Device() {
+        g_liveDevices.erase(std::remove(g_liveDevices.begin(), g_liveDevices.end(), this), g_liveDevices.end());
         if (m_lastWhiteMaterialApplied && remix_api::g_initialized && remix_api::g_api.SetConfigVariable) {
             remix_api::g_api.SetConfigVariable("rtx.whiteMaterialModeEnabled", "0");
             m_lastWhiteMaterialApplied = false;
@@ -5349,144 +5770,150 @@ public:
         LogMsg("WrappedD3D9Device destroyed");
     }
 
+    void ForgetShaderRecord(const ShaderRecord* record) {
+        if (m_currentVertexRecord == record) m_currentVertexRecord = nullptr;
+        if (m_currentPixelRecord == record) m_currentPixelRecord = nullptr;
+    }
+
     void SubmitLightingFromCurrentDraw() {
+        METHOD_TIMING_SCOPE(TimedMethod_SubmitLighting);
+        TRACE_SCOPE("LightingExtraction");
         ShaderLightingMetadata meta = BuildLightingMetadataForShader(g_activeVertexShaderKey);
-        g_remixLightingManager.ProcessDrawCall(meta, g_vsConstants, m_currentWorld, m_currentView, m_hasWorld, m_hasView);
+        g_remixLightingManager.ProcessDrawCall(meta, g_vsConstants,
+                                               *AsD3DMatrix(&m_engine.Current(EngineTransform_World)),
+                                               *AsD3DMatrix(&m_engine.Current(EngineTransform_View)),
+                                               m_engine.Has(EngineTransform_World),
+                                               m_engine.Has(EngineTransform_View));
     }
 
-    void EmitFixedFunctionTransforms() {
-        if (!g_config.emitFixedFunctionTransforms) {
+    static int TransformCacheIndex(D3DTRANSFORMSTATETYPE state) {
+        switch (state) {
+        case D3DTS_WORLD: return EngineTransform_World;
+        case D3DTS_VIEW: return EngineTransform_View;
+        case D3DTS_PROJECTION: return EngineTransform_Projection;
+        default: return -1;
+        }
+    }
+
+    // Pushes the bound shader's record to the engine when it or its analysis changed.
+    void SyncEngineShader() {
+        const uintptr_t shaderKey = reinterpret_cast<uintptr_t>(m_currentVertexShader);
+        if (shaderKey == m_engineShaderKey && g_shaderAnalysisEpoch == m_engineShaderEpoch) {
+            return;
+        }
+        m_engineShaderKey = shaderKey;
+        m_engineShaderEpoch = g_shaderAnalysisEpoch;
+        m_engine.OnSetVertexShader(shaderKey, BuildEngineShaderInfo(shaderKey));
+    }
+
+    // A golden run starts the engine where trace_replay starts: no history, an empty
+    // layout table and window memo, then the trace's opening shader and register file.
+    // When the run ends the engine returns to the shared caches.
+    void SyncGoldenRun() {
+        if (m_goldenRunSerial == g_goldenRunSerial) {
+            return;
+        }
+        m_goldenRunSerial = g_goldenRunSerial;
+        if (!g_goldenWriter.IsOpen()) {
+            m_engine.SetLayoutTable(&g_learnedUploadLayouts);
+            m_engine.SetWindowCache(&g_matrixClassCache);
             return;
         }
-        if (g_forceFfpTransform) {
+        PublishEngineStats();
+        m_engine.Reset();
+        m_publishedEngineStats = MatrixEngineStats();
+        g_goldenRunLayouts.clear();
+        g_goldenRunWindowCache.Clear();
+        m_engine.SetLayoutTable(&g_goldenRunLayouts);
+        m_engine.SetWindowCache(&g_goldenRunWindowCache);
+
+        const uintptr_t shaderKey = reinterpret_cast<uintptr_t>(m_currentVertexShader);
+        m_engineShaderKey = shaderKey;
+        m_engineShaderEpoch = g_shaderAnalysisEpoch;
+        m_engine.OnSetVertexShader(shaderKey, BuildEngineShaderInfo(shaderKey));
+        float vertexRegisters[kMaxConstantRegisters][4] = {};
+        for (int reg = 0; reg < kMaxConstantRegisters; ++reg) {
+            memcpy(vertexRegisters[reg], g_allVertexRegisters[reg].value, sizeof(vertexRegisters[reg]));
+        }
+        m_engine.OnVertexShaderConstants(0, &vertexRegisters[0][0], kMaxConstantRegisters);
+    }
+
+    // Adds what the engine counted since the last call to the overlay totals.
+    void PublishEngineStats() {
+        const MatrixEngineStats& stats = m_engine.GetStats();
+        MatrixEngineStats& last = m_publishedEngineStats;
+        g_layoutFastPathHits += stats.layoutFastPathHits - last.layoutFastPathHits;
+        g_layoutFullScans += stats.layoutFullScans - last.layoutFullScans;
+        g_layoutDriftFallbacks += stats.layoutDriftFallbacks - last.layoutDriftFallbacks;
+        g_paletteUploads += stats.paletteUploads - last.paletteUploads;
+        g_paletteWindowsSkipped += stats.paletteWindowsSkipped - last.paletteWindowsSkipped;
+        g_transformMapUploads += stats.transformMapUploads - last.transformMapUploads;
+        g_transformMapWindowsSkipped += stats.transformMapWindowsSkipped - last.transformMapWindowsSkipped;
+        g_deferredRegistersClassified += stats.deferredRegistersClassified - last.deferredRegistersClassified;
+        g_deferredRegistersSkipped += stats.deferredRegistersSkipped - last.deferredRegistersSkipped;
+        g_deferredRangesClassified += stats.deferredRangesClassified - last.deferredRangesClassified;
+        g_deferredQueueFull += stats.deferredQueueFull - last.deferredQueueFull;
+        g_simdWindowsTested += stats.prefilterWindowsTested - last.prefilterWindowsTested;
+        g_simdWindowsRejected += stats.prefilterWindowsRejected - last.prefilterWindowsRejected;
+        g_combinedDecompRunsThisFrame += static_cast<int>(stats.decompositionRuns - last.decompositionRuns);
+        g_combinedDecompSkipsThisFrame += static_cast<int>(stats.decompositionSkips - last.decompositionSkips);
+        g_setTransformEmittedThisFrame += static_cast<int>(stats.transformsEmitted - last.transformsEmitted);
+        g_setTransformSuppressedThisFrame += static_cast<int>(stats.transformsSuppressed - last.transformsSuppressed);
+        last = stats;
+    }
+
+    // Binds the engine's World/View/Projection for a draw (`draw`) or a manual emit.
+    void EmitFixedFunctionTransforms(EngineDrawTransforms* out, bool draw) {
+        METHOD_TIMING_SCOPE(TimedMethod_EmitFixedFunctionTransforms);
+        TRACE_SCOPE("EmitTransforms");
+        if (m_emittedTransformEpoch != g_fixedFunctionTransformEpoch) {
+            m_engine.InvalidateEmittedTransforms();
+            m_emittedTransformEpoch = g_fixedFunctionTransformEpoch;
+        }
+        if (g_config.emitFixedFunctionTransforms && g_forceFfpTransform) {
             uintptr_t shaderKey = reinterpret_cast<uintptr_t>(m_currentVertexShader);
             auto it = g_shaderRecords.find(shaderKey);
             if (it != g_shaderRecords.end() && it->second.isFFPTransform) {
                 const int base = g_manualTransformBaseOverride >= 0 ? g_manualTransformBaseOverride : it->second.transformConstantBase;
                 ShaderConstantState* state = GetShaderState(shaderKey, false);
                 D3DMATRIX m = {};
-                if (state && TryBuildMatrixSnapshot(*state, base, 4, false, &m)) {
-                    m_currentWorld = m;
-                    m_hasWorld = true; m_everHadWorld = true;
+                if (state && TryBuildMatrixSnapshot(*state, base, 4, it->second.transformTransposed, &m)) {
+                    EngineCaptureInfo info;
+                    info.shaderId = shaderKey;
+                    info.baseRegister = base;
+                    info.transposed = it->second.transformTransposed;
+                    info.manual = true;
+                    info.label = "forced FFP transform constants";
+                    m_engine.ApplyExternalMatrix(EngineMatrix_World, AsEngineMatrix(m), info);
                 }
             }
         }
-        // Keep strict game profiles deterministic even if generic SetTransform compatibility is enabled.
-        if (g_activeGameProfile == GameProfile_None &&
-            g_config.setTransformBypassProxyWhenGameProvides && g_gameSetTransformAnySeen) {
-            return;
-        }
-        if (g_activeGameProfile == GameProfile_MetalGearRising) {
-            // MGR profile is strict: only emit transforms when all three known registers
-            // have been captured. Never emit identity/fallback transforms in this mode.
-            if (!(m_everHadWorld && m_everHadView && m_everHadProj)) {
-                snprintf(g_profileStatusMessage, sizeof(g_profileStatusMessage),
-                         "MGR draw skipped: no valid matrices ever captured (Proj=%s View=%s World=%s).",
-                         m_everHadProj  ? "ready" : "never seen",
-                         m_everHadView  ? "ready" : "never seen",
-                         m_everHadWorld ? "ready" : "never seen");
-                return;
-            }
-
-            // Keep MGR strict and deterministic: WORLD always comes from c16-c19.
-            m_real->SetTransform(D3DTS_WORLD, &m_currentWorld);
-            m_real->SetTransform(D3DTS_VIEW, &m_currentView);
-            m_real->SetTransform(D3DTS_PROJECTION, &m_currentProj);
-            return;
-        }
-
-        if (g_activeGameProfile == GameProfile_DevilMayCry4) {
-            if (!(m_everHadWorld && m_everHadView && m_everHadProj)) {
-                snprintf(g_profileStatusMessage, sizeof(g_profileStatusMessage),
-                         "DMC4 draw skipped: no valid matrices ever captured (World=%s View=%s Proj=%s).",
-                         m_everHadWorld ? "ready" : "never seen",
-                         m_everHadView  ? "ready" : "never seen",
-                         m_everHadProj  ? "ready" : "never seen");
-                return;
-            }
-
-            // Keep DMC4 strict and deterministic: WORLD always comes from c0-c3.
-            m_real->SetTransform(D3DTS_WORLD, &m_currentWorld);
-            m_real->SetTransform(D3DTS_VIEW, &m_currentView);
-            m_real->SetTransform(D3DTS_PROJECTION, &m_currentProj);
-            return;
+        if (draw) {
+            m_engine.OnDraw(out);
+        } else {
+            m_engine.EmitTransforms(out);
         }
+    }
 
-        if (g_activeGameProfile == GameProfile_Barnyard) {
-            const bool useGameViewProj = g_config.barnyardUseGameSetTransformsForViewProjection;
-            if (!m_everHadWorld || (useGameViewProj && (!m_everHadView || !m_everHadProj))) {
-                snprintf(g_profileStatusMessage, sizeof(g_profileStatusMessage),
-                         "Barnyard draw skipped: no valid matrices ever captured (World=%s View=%s Proj=%s).",
-                         m_everHadWorld ? "ready" : "never seen",
-                         m_everHadView  ? "ready" : "never seen",
-                         m_everHadProj  ? "ready" : "never seen");
-                return;
-            }
-
-            // Keep Barnyard profile semantics deterministic: WORLD comes from shader constants.
-            m_real->SetTransform(D3DTS_WORLD, &m_currentWorld);
-            if (useGameViewProj) {
-                m_real->SetTransform(D3DTS_VIEW, &m_currentView);
-                m_real->SetTransform(D3DTS_PROJECTION, &m_currentProj);
-            }
+    // Appends what this draw bound to the golden run. Skipped draws pass nullptr and are
+    // recorded with nothing bound so the run stays aligned with the API trace draw for draw.
+    void RecordGoldenDraw(const EngineDrawTransforms* transforms) {
+        if (!g_goldenWriter.IsOpen() || g_isRenderingImGui) {
             return;
         }
-
-        bool shouldApplyCustomProjection = false;
-        const bool strictMgrProfileActive = (g_activeGameProfile == GameProfile_MetalGearRising);
-
-        if (g_config.experimentalCustomProjectionEnabled && !strictMgrProfileActive) {
-            const bool projectionMissing = !m_hasProj;
-            const bool projectionOverrideAllowed = g_config.experimentalCustomProjectionOverrideDetectedProjection;
-            bool hasMvp = false;
-            { std::lock_guard<std::mutex> lock(g_cameraMatricesMutex); hasMvp = g_cameraMatrices.hasMVP; }
-            const bool mvpBlocksProjection = hasMvp && !g_config.experimentalCustomProjectionOverrideCombinedMVP;
-            shouldApplyCustomProjection = (projectionMissing || projectionOverrideAllowed) && !mvpBlocksProjection;
-        }
-
-        if (shouldApplyCustomProjection) {
-            D3DMATRIX customProjection = {};
-            bool usedAuto = false;
-            float resolvedAspect = 0.0f;
-            UINT width = 0;
-            UINT height = 0;
-            if (BuildExperimentalCustomProjectionMatrix(m_real, m_hwnd, &customProjection,
-                                                        &usedAuto, &resolvedAspect,
-                                                        &width, &height)) {
-                m_currentProj = customProjection;
-                m_hasProj = true; m_everHadProj = true;
-                m_projLastFrame = g_frameCount;
-                g_projectionDetectedByNumericStructure = false;
-                g_projectionDetectedRegister = -1;
-                g_projectionDetectedHandedness = ProjectionHandedness_Unknown;
-                g_projectionDetectedFovRadians = ExtractFOV(customProjection);
-                StoreProjectionMatrix(m_currentProj, 0, -1, 4, false, true,
-                                      usedAuto
-                                          ? "experimental custom projection auto"
-                                          : "experimental custom projection manual");
-                if (usedAuto) {
-                    snprintf(g_customProjectionStatus, sizeof(g_customProjectionStatus),
-                             "Experimental projection active (auto): %ux%u aspect=%.4f fov=%.2f near=%.4f far=%.2f.",
-                             width, height, resolvedAspect,
-                             g_config.experimentalCustomProjectionAutoFovDeg,
-                             g_config.experimentalCustomProjectionAutoNearZ,
-                             g_config.experimentalCustomProjectionAutoFarZ);
-                } else {
-                    snprintf(g_customProjectionStatus, sizeof(g_customProjectionStatus),
-                             "Experimental projection active (manual matrix mode).");
-                }
+        GoldenDraw golden;
+        golden.frame = static_cast<uint32_t>(g_frameCount - g_goldenFrameBase);
+        golden.shaderHash = GetShaderHashForKey(reinterpret_cast<uintptr_t>(m_currentVertexShader));
+        if (transforms) {
+            for (int slot = 0; slot < EngineTransform_Count; ++slot) {
+                golden.bound[slot] = transforms->bound[slot];
+                golden.sourceRegister[slot] = transforms->sourceRegister[slot];
+                memcpy(golden.matrices[slot], &transforms->matrices[slot], sizeof(golden.matrices[slot]));
             }
         }
-
-        // Only emit slots that have ever had a valid capture.
-        // Never emit identity for uncaptured slots — leave Remix state untouched instead.
-        // Always use last-known-good for stale slots rather than poisoning with identity.
-        if (m_everHadWorld) m_real->SetTransform(D3DTS_WORLD,      &m_currentWorld);
-        if (m_everHadView)  m_real->SetTransform(D3DTS_VIEW,       &m_currentView);
-        if (m_everHadProj)  m_real->SetTransform(D3DTS_PROJECTION, &m_currentProj);
+        g_goldenWriter.Append(golden);
     }
 
-
     // IUnknown
     HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** ppvObj) override {
         if (!ppvObj) return E_POINTER;
@@ -5510,6 +5937,17 @@ public:
     ULONG STDMETHODCALLTYPE Release() override {
         ULONG count = m_real->Release();
         if (count == 0) {
+            // Worker threads are joined here, while the process is still running; the
+            // static destructors run under the loader lock and must not wait for them.
+            StopApiTraceRecording();
+            StopShaderAnalysisThreads();
+            ReapTraceCapture(true);
+            ApplyCompletedShaderAnalyses();
+            if (g_shaderCacheDirty) {
+                SaveShaderCache(false);
+            } else {
+                ReapShaderCacheSave(true);
+            }
             ShutdownImGui();
             delete this;
         }
@@ -5522,10 +5960,17 @@ public:
         const float* pConstantData,
         UINT Vector4fCount) override
     {
+        METHOD_TIMING_SCOPE(TimedMethod_SetVertexShaderConstantF);
+        TRACE_SCOPE("ConstantUpload");
+
+        UPLOAD_ALLOCATION_PROBE();
         uintptr_t shaderKey = reinterpret_cast<uintptr_t>(m_currentVertexShader);
         if (g_constantUploadRecordingEnabled) {
             RecordConstantUpload(ConstantUploadStage_Vertex, shaderKey, StartRegister, Vector4fCount);
         }
+        if (g_apiTraceRecorder.IsRecording()) {
+            g_apiTraceRecorder.RecordShaderConstantsF(ApiTraceStage::Vertex, StartRegister, pConstantData, Vector4fCount);
+        }
         auto recIt = g_shaderRecords.find(shaderKey);
         if (recIt != g_shaderRecords.end()) {
             for (UINT i = 0; i < Vector4fCount; ++i) {
@@ -5538,11 +5983,12 @@ public:
         const bool profileIsMgr = g_activeGameProfile == GameProfile_MetalGearRising;
         const bool profileIsBarnyard = g_activeGameProfile == GameProfile_Barnyard;
 
-        std::vector<float> overrideScratch;
         const float* effectiveConstantData = pConstantData;
         // Keep MGR profile extraction isolated from manual/override paths.
-        if (!profileIsMgr && !profileIsBarnyard && BuildOverriddenConstants(*state, StartRegister, Vector4fCount, pConstantData, overrideScratch)) {
-            effectiveConstantData = overrideScratch.data();
+        if (!profileIsMgr && !profileIsBarnyard &&
+            BuildOverriddenConstants(*state, StartRegister, Vector4fCount, pConstantData,
+                                     m_overrideScratch, kMaxConstantRegisters)) {
+            effectiveConstantData = m_overrideScratch;
         }
 
         bool constantsChanged = false;
@@ -5551,15 +5997,9 @@ public:
             if (reg >= kMaxConstantRegisters) {
                 break;
             }
-            if (!constantsChanged) {
-                if (!state->valid[reg] ||
-                    memcmp(state->constants[reg], effectiveConstantData + i * 4,
-                           sizeof(state->constants[reg])) != 0) {
-                    constantsChanged = true;
-                }
+            if (state->StoreConstant(static_cast<int>(reg), effectiveConstantData + i * 4)) {
+                constantsChanged = true;
             }
-            memcpy(state->constants[reg], effectiveConstantData + i * 4, sizeof(state->constants[reg]));
-            state->valid[reg] = true;
             UpdateVariance(*state, static_cast<int>(reg), effectiveConstantData + i * 4);
 
             GlobalVertexRegisterState& globalState = g_allVertexRegisters[reg];
@@ -5574,692 +6014,121 @@ public:
         }
         state->snapshotReady = true;
 
-        bool slotResolvedByOverride[MatrixSlot_Count] = {};
-        bool slotResolvedStructurally[MatrixSlot_Count] = {};
-
-        if (!profileIsMgr && !profileIsBarnyard && shaderKey != 0) {
-            for (int slot = 0; slot < MatrixSlot_Count; slot++) {
-                const ManualMatrixBinding& binding = g_manualBindings[slot];
-                if (!binding.enabled || binding.shaderKey != shaderKey) {
-                    continue;
-                }
-                D3DMATRIX manualMat = {};
-                if (!TryBuildMatrixSnapshot(*state, binding.baseRegister, binding.rows, false, &manualMat)) {
-                    continue;
-                }
-                slotResolvedByOverride[slot] = true;
-                if (slot == MatrixSlot_World) {
-                    m_currentWorld = manualMat;
-                    m_hasWorld = true; m_everHadWorld = true;
-                m_worldLastFrame = g_frameCount;
-                    StoreWorldMatrix(m_currentWorld, shaderKey, binding.baseRegister, binding.rows, false, true);
-                } else if (slot == MatrixSlot_View) {
-                    m_currentView = manualMat;
-                    m_hasView = true; m_everHadView = true;
-                m_viewLastFrame = g_frameCount;
-                    StoreViewMatrix(m_currentView, shaderKey, binding.baseRegister, binding.rows, false, true);
-                } else if (slot == MatrixSlot_Projection) {
-                    m_currentProj = manualMat;
-                    m_hasProj = true; m_everHadProj = true;
-                m_projLastFrame = g_frameCount;
-                    g_projectionDetectedByNumericStructure = false;
-                    g_projectionDetectedRegister = binding.baseRegister;
-                    g_projectionDetectedHandedness = ProjectionHandedness_Unknown;
-                    g_projectionDetectedFovRadians = 0.0f;
-                    StoreProjectionMatrix(m_currentProj, shaderKey, binding.baseRegister, binding.rows, false, true);
-                } else if (slot == MatrixSlot_MVP) {
-                    StoreMVPMatrix(manualMat, shaderKey, binding.baseRegister, binding.rows, false, true);
-                } else if (slot == MatrixSlot_VP) {
-                    StoreVPMatrix(manualMat, shaderKey, binding.baseRegister, binding.rows, false, true);
-                } else if (slot == MatrixSlot_WV) {
-                    StoreWVMatrix(manualMat, shaderKey, binding.baseRegister, binding.rows, false, true);
-                }
-            }
-        }
-
-        if (profileIsMgr) {
-            g_profileDisableStructuralDetection = true;
-            // MGR strict known-layout mode:
-            // - capture c4-c7 projection, c8-c11 viewProjection, c16-c19 world
-            // - derive View as inverse(Projection) * ViewProjection
-            // - do not run structural detection fallback or candidate scanning
-            // - persist projection/view across draws until overwritten by the same known registers
-            auto tryExtractMgrMatrix = [&](int baseRegister, D3DMATRIX* outMat) -> bool {
-                if (!outMat || !effectiveConstantData || baseRegister < 0) {
-                    return false;
-                }
-                const UINT uploadStart = StartRegister;
-                const UINT uploadEnd = (Vector4fCount == 0) ? StartRegister : (StartRegister + Vector4fCount - 1);
-                const UINT matrixEnd = static_cast<UINT>(baseRegister + 3);
-                if (uploadStart > static_cast<UINT>(baseRegister) || uploadEnd < matrixEnd) {
-                    return false;
-                }
-                return TryBuildMatrixFromConstantUpdate(effectiveConstantData,
-                                                        StartRegister,
-                                                        Vector4fCount,
-                                                        baseRegister,
-                                                        4,
-                                                        false,
-                                                        outMat);
-            };
-
-            D3DMATRIX mat = {};
-            if (tryExtractMgrMatrix(4, &mat)) {
-                g_profileCoreRegistersSeen[0] = true;
-                g_mgrProjectionRegisterValid = IsTypicalProjectionMatrix(mat);
-                m_currentProj = mat;
-                m_hasProj = true; m_everHadProj = true;
-                m_projLastFrame = g_frameCount;
-                g_mgrProjCapturedThisFrame = true;
-                if (g_mgrProjectionRegisterValid) {
-                    g_projectionDetectedByNumericStructure = false;
-                    g_projectionDetectedRegister = 4;
-                    g_projectionDetectedHandedness = ProjectionHandedness_Unknown;
-                    g_projectionDetectedFovRadians = ExtractFOV(mat);
-                    StoreProjectionMatrix(m_currentProj, shaderKey, 4, 4, false, true,
-                                          "MetalGearRising profile projection (c4-c7)");
-                } else {
-                    g_projectionDetectedByNumericStructure = false;
-                    g_projectionDetectedRegister = 4;
-                    g_projectionDetectedHandedness = ProjectionHandedness_Unknown;
-                    g_projectionDetectedFovRadians = 0.0f;
-                    StoreProjectionMatrix(m_currentProj, shaderKey, 4, 4, false, true,
-                                          "MetalGearRising profile projection (c4-c7, non-typical)");
-                    snprintf(g_profileStatusMessage, sizeof(g_profileStatusMessage),
-                             "MGR projection at c4-c7 is non-typical; using it by default.");
-                }
-            }
-
-            if (tryExtractMgrMatrix(8, &mat)) {
-                g_profileCoreRegistersSeen[1] = true;
-                g_profileOptionalRegistersSeen[0] = true;
-
-                D3DMATRIX resolvedProjection = {};
-                bool haveProjectionForViewDerivation = false;
-
-                if (m_hasProj) {
-                    resolvedProjection = m_currentProj;
-                    haveProjectionForViewDerivation = true;
-                }
-
-                if (!g_mgrProjectionRegisterValid && m_mgrrUseAutoProjection) {
-                    ProjectionAnalysis generatedProjectionInfo = {};
-                    D3DMATRIX generatedProjection = {};
-                    if (TryExtractProjectionFromCombined(mat,
-                                                         nullptr,
-                                                         false,
-                                                         &generatedProjectionInfo,
-                                                         &generatedProjection,
-                                                         true)) {
-                        resolvedProjection = generatedProjection;
-                        m_currentProj = generatedProjection;
-                        m_hasProj = true; m_everHadProj = true;
-                m_projLastFrame = g_frameCount;
-                        g_mgrProjCapturedThisFrame = true;
-                        g_projectionDetectedByNumericStructure = true;
-                        g_projectionDetectedRegister = 8;
-                        g_projectionDetectedHandedness = generatedProjectionInfo.handedness;
-                        g_projectionDetectedFovRadians = generatedProjectionInfo.fovRadians;
-                        StoreProjectionMatrix(m_currentProj, shaderKey, 8, 4, false, true,
-                                              "MetalGearRising auto projection from VP (c8-c11)");
-                        haveProjectionForViewDerivation = true;
-                    }
-                }
-
-                if (haveProjectionForViewDerivation) {
-                    D3DMATRIX projectionInv = {};
-                    if (InvertMatrix4x4Deterministic(resolvedProjection, &projectionInv, nullptr)) {
-                        D3DMATRIX derivedView = MultiplyMatrix(mat, projectionInv);
-                        OrthonormalizeViewMatrix(&derivedView);
-                        m_currentView = derivedView;
-                        m_hasView = true; m_everHadView = true;
-                m_viewLastFrame = g_frameCount;
-                        g_mgrViewCapturedThisFrame = true;
-                        g_profileViewDerivedFromInverse = true;
-                        snprintf(g_profileStatusMessage, sizeof(g_profileStatusMessage),
-                                 "MGR view updated from VP (c8-c11) using inverse projection.");
-                        StoreViewMatrix(m_currentView, shaderKey, 8, 4, false, true,
-                                        "MetalGearRising profile view from VP", 8);
-                    } else {
-                        g_profileViewDerivedFromInverse = false;
-                        snprintf(g_profileStatusMessage, sizeof(g_profileStatusMessage),
-                                 "MGR VP derivation failed: projection inversion failed.");
-                    }
-                } else {
-                    g_profileViewDerivedFromInverse = false;
-                    snprintf(g_profileStatusMessage, sizeof(g_profileStatusMessage),
-                             "MGR VP detected but projection inversion failed. Enable auto projection to prefer generated projection.");
-                }
-            }
-
-            if (tryExtractMgrMatrix(16, &mat)) {
-                m_currentWorld = mat;
-                m_hasWorld = true; m_everHadWorld = true;
-                m_worldLastFrame = g_frameCount;
-                g_mgrWorldCapturedForDraw = true;
-                g_profileCoreRegistersSeen[2] = true;
-                StoreWorldMatrix(m_currentWorld, shaderKey, 16, 4, false, true,
-                                 "MetalGearRising profile world (c16-c19)");
-            }
-
-            return m_real->SetVertexShaderConstantF(StartRegister, effectiveConstantData, Vector4fCount);
-        }
-
-        if (profileIsBarnyard) {
-            bool worldCaptured = false;
-            D3DMATRIX mat = {};
-
-            if (g_barnyardForceWorldFromC0 &&
-                TryBuildMatrixFromConstantUpdate(effectiveConstantData, StartRegister, Vector4fCount,
-                                                 0, 4, false, &mat)) {
-                m_currentWorld = mat;
-                m_hasWorld = true; m_everHadWorld = true;
-                m_worldLastFrame = g_frameCount;
-                worldCaptured = true;
-                g_profileCoreRegistersSeen[2] = true;
-                StoreWorldMatrix(m_currentWorld, shaderKey, 0, 4, false, true,
-                                 "Barnyard profile forced world (c0-c3)");
-            }
-
-            if (!worldCaptured && g_config.worldMatrixRegister >= 0 &&
-                TryBuildMatrixFromConstantUpdate(effectiveConstantData, StartRegister, Vector4fCount,
-                                                 g_config.worldMatrixRegister, 4, false, &mat)) {
-                m_currentWorld = mat;
-                m_hasWorld = true; m_everHadWorld = true;
-                m_worldLastFrame = g_frameCount;
-                worldCaptured = true;
-                g_profileCoreRegistersSeen[2] = true;
-                StoreWorldMatrix(m_currentWorld, shaderKey, g_config.worldMatrixRegister, 4, false, true,
-                                 "Barnyard profile world (explicit register override)");
-            }
-
-            if (!worldCaptured && g_config.autoDetectMatrices && effectiveConstantData && Vector4fCount >= 3) {
-                for (UINT rows : {4u, 3u}) {
-                    if (Vector4fCount < rows || worldCaptured) {
-                        continue;
-                    }
-                    for (UINT offset = 0; offset + rows <= Vector4fCount; ++offset) {
-                        UINT baseReg = StartRegister + offset;
-                        D3DMATRIX candidate = {};
-                        if (!TryBuildMatrixFromConstantUpdate(effectiveConstantData + offset * 4, baseReg, rows,
-                                                              static_cast<int>(baseReg), static_cast<int>(rows),
-                                                              false, &candidate)) {
-                            continue;
-                        }
-
-                        MatrixClassification cls = ClassifyMatrixDeterministic(candidate, static_cast<int>(rows),
-                                                                               Vector4fCount, StartRegister, baseReg);
-                        bool transposed = false;
-                        if (cls == MatrixClass_None && g_probeTransposedLayouts) {
-                            D3DMATRIX t = TransposeMatrix(candidate);
-                            cls = ClassifyMatrixDeterministic(t, static_cast<int>(rows), Vector4fCount, StartRegister, baseReg);
-                            if (cls != MatrixClass_None) {
-                                candidate = t;
-                                transposed = true;
-                            }
-                        }
-
-                        if (cls == MatrixClass_World) {
-                            m_currentWorld = candidate;
-                            m_hasWorld = true; m_everHadWorld = true;
-                m_worldLastFrame = g_frameCount;
-                            worldCaptured = true;
-                            g_profileCoreRegistersSeen[2] = true;
-                            StoreWorldMatrix(m_currentWorld, shaderKey, static_cast<int>(baseReg),
-                                             static_cast<int>(rows), transposed, false,
-                                             "Barnyard profile structural world");
-                            break;
-                        }
-                    }
-                }
-            }
-
-            if (worldCaptured) {
-                snprintf(g_profileStatusMessage, sizeof(g_profileStatusMessage),
-                         "Barnyard profile active: forwarding WORLD only; VIEW/PROJECTION SetTransform blocked.");
-            } else {
-                snprintf(g_profileStatusMessage, sizeof(g_profileStatusMessage),
-                         "Barnyard profile active: waiting for world matrix in shader constants.");
-            }
-
-            g_profileDisableStructuralDetection = true;
-            return m_real->SetVertexShaderConstantF(StartRegister, effectiveConstantData, Vector4fCount);
+        SyncEngineShader();
+        // Deferred uploads take their manual-binding snapshot at the flush instead.
+        if (!profileIsMgr && !profileIsBarnyard && shaderKey != 0 &&
+            !m_engine.DefersUpload(StartRegister, Vector4fCount)) {
+            ApplyManualBindings(shaderKey, *state);
         }
-
-        const bool profileIsDmc4 = g_activeGameProfile == GameProfile_DevilMayCry4;
-        const bool profileActive = profileIsMgr || profileIsDmc4 || profileIsBarnyard;
-
-        auto tryExtractProfileMatrix = [&](int baseRegister, D3DMATRIX* outMat) -> bool {
-            if (!outMat || !effectiveConstantData || baseRegister < 0) {
-                return false;
-            }
-            return TryBuildMatrixFromConstantUpdate(effectiveConstantData, StartRegister, Vector4fCount,
-                                                    baseRegister, 4, false, outMat);
-        };
-
-        if (profileIsDmc4) {
-            D3DMATRIX mat = {};
-            bool anyCaptured = false;
-
-            if (tryExtractProfileMatrix(g_profileLayout.combinedMvpBase, &mat)) {
-                anyCaptured = true;
-                StoreMVPMatrix(mat, shaderKey, g_profileLayout.combinedMvpBase, 4, false, true,
-                               "DevilMayCry4 profile combined MVP (c0-c3)");
-                m_currentWorld = mat;
-                m_hasWorld = true; m_everHadWorld = true;
-                m_worldLastFrame = g_frameCount;
-                slotResolvedByOverride[MatrixSlot_World] = true;
-                g_profileCoreRegistersSeen[0] = true;
-                StoreWorldMatrix(m_currentWorld, shaderKey, g_profileLayout.worldBase, 4, false, true,
-                                 "DevilMayCry4 profile world (c0-c3)");
-            }
-
-            if (tryExtractProfileMatrix(g_profileLayout.viewInverseBase, &mat)) {
-                anyCaptured = true;
-                m_currentView = mat;
-                m_hasView = true; m_everHadView = true;
-                m_viewLastFrame = g_frameCount;
-                slotResolvedByOverride[MatrixSlot_View] = true;
-                g_profileCoreRegistersSeen[1] = true;
-                g_profileViewDerivedFromInverse = false;
-                StoreViewMatrix(m_currentView, shaderKey, g_profileLayout.viewInverseBase, 4, false, true,
-                                "DevilMayCry4 profile view (c4-c7)");
-            }
-
-            if (tryExtractProfileMatrix(g_profileLayout.projectionBase, &mat)) {
-                anyCaptured = true;
-                m_currentProj = mat;
-                m_hasProj = true; m_everHadProj = true;
-                m_projLastFrame = g_frameCount;
-                slotResolvedByOverride[MatrixSlot_Projection] = true;
-                g_projectionDetectedByNumericStructure = false;
-                g_projectionDetectedRegister = g_profileLayout.projectionBase;
-                g_projectionDetectedHandedness = ProjectionHandedness_Unknown;
-                g_projectionDetectedFovRadians = ExtractFOV(mat);
-                g_profileCoreRegistersSeen[2] = true;
-                StoreProjectionMatrix(m_currentProj, shaderKey, g_profileLayout.projectionBase, 4, false, true,
-                                      "DevilMayCry4 profile projection (c8-c11)");
-            }
-
-            if (anyCaptured) {
-                snprintf(g_profileStatusMessage, sizeof(g_profileStatusMessage),
-                         "DMC4 profile active: strict mapping MVP/World=c0-c3 View=c4-c7 Projection=c8-c11.");
-            } else {
-                snprintf(g_profileStatusMessage, sizeof(g_profileStatusMessage),
-                         "DMC4 profile active but upload did not hit c0-c11 transform registers.");
-            }
-
-            g_profileDisableStructuralDetection = true;
-            return m_real->SetVertexShaderConstantF(StartRegister, effectiveConstantData, Vector4fCount);
+        {
+            TRACE_SCOPE("Classification");
+            m_engine.OnVertexShaderConstants(StartRegister, effectiveConstantData, Vector4fCount);
         }
+        METHOD_TIMING_END();
+        return m_real->SetVertexShaderConstantF(StartRegister, effectiveConstantData, Vector4fCount);
+    }
 
-        auto tryExplicitRegisterOverride = [&](MatrixSlot slot, int configuredRegister) {
-            if (profileActive) {
-                return;
-            }
-            if (configuredRegister < 0 || !effectiveConstantData) {
-                return;
-            }
-            if (slotResolvedByOverride[slot]) {
-                return;
-            }
-            for (UINT rows : {4u, 3u}) {
-                D3DMATRIX mat = {};
-                if (!TryBuildMatrixFromConstantUpdate(effectiveConstantData, StartRegister, Vector4fCount,
-                                                      configuredRegister, static_cast<int>(rows), false, &mat)) {
-                    continue;
-                }
-                slotResolvedByOverride[slot] = true;
-                if (slot == MatrixSlot_World) {
-                    m_currentWorld = mat;
-                    m_hasWorld = true; m_everHadWorld = true;
-                m_worldLastFrame = g_frameCount;
-                    StoreWorldMatrix(m_currentWorld, shaderKey, configuredRegister, static_cast<int>(rows), false, true,
-                                     "explicit register override");
-                } else if (slot == MatrixSlot_View) {
-                    m_currentView = mat;
-                    m_hasView = true; m_everHadView = true;
-                m_viewLastFrame = g_frameCount;
-                    StoreViewMatrix(m_currentView, shaderKey, configuredRegister, static_cast<int>(rows), false, true,
-                                    "explicit register override");
-                } else if (slot == MatrixSlot_Projection) {
-                    m_currentProj = mat;
-                    m_hasProj = true; m_everHadProj = true;
-                m_projLastFrame = g_frameCount;
-                    g_projectionDetectedByNumericStructure = false;
-                    g_projectionDetectedRegister = configuredRegister;
-                    g_projectionDetectedHandedness = ProjectionHandedness_Unknown;
-                    g_projectionDetectedFovRadians = 0.0f;
-                    StoreProjectionMatrix(m_currentProj, shaderKey, configuredRegister, static_cast<int>(rows), false, true,
-                                          "explicit register override");
-                } else if (slot == MatrixSlot_MVP) {
-                    StoreMVPMatrix(mat, shaderKey, configuredRegister, static_cast<int>(rows), false, true,
-                                   "explicit register override");
-                } else if (slot == MatrixSlot_VP) {
-                    StoreVPMatrix(mat, shaderKey, configuredRegister, static_cast<int>(rows), false, true,
-                                  "explicit register override");
-                } else if (slot == MatrixSlot_WV) {
-                    StoreWVMatrix(mat, shaderKey, configuredRegister, static_cast<int>(rows), false, true,
-                                  "explicit register override");
-                }
-                return;
-            }
-        };
-
-        tryExplicitRegisterOverride(MatrixSlot_World, g_config.worldMatrixRegister);
-        tryExplicitRegisterOverride(MatrixSlot_View, g_config.viewMatrixRegister);
-        tryExplicitRegisterOverride(MatrixSlot_Projection, g_config.projMatrixRegister);
-        tryExplicitRegisterOverride(MatrixSlot_MVP, g_config.mvpMatrixRegister);
-        tryExplicitRegisterOverride(MatrixSlot_WV, g_config.mvMatrixRegister);
-        tryExplicitRegisterOverride(MatrixSlot_VP, g_config.vpMatrixRegister);
-
-        bool suppressViewFromUpload = false;
-        bool suppressWorldFromUpload = false;
-
-        auto updateFromClassification = [&](D3DMATRIX mat, UINT baseReg, int rows, bool transposed) {
-            MatrixClassification cls = ClassifyMatrixDeterministic(mat, rows, Vector4fCount, StartRegister, baseReg);
-
-            if (cls == MatrixClass_Projection &&
-                g_config.projMatrixRegister < 0 &&
-                !slotResolvedByOverride[MatrixSlot_Projection] &&
-                !slotResolvedStructurally[MatrixSlot_Projection]) {
-                ProjectionAnalysis projectionInfo = {};
-                if (!AnalyzeProjectionMatrixNumeric(mat, &projectionInfo)) return;
-                if (projectionInfo.fovRadians < g_config.minFOV ||
-                    projectionInfo.fovRadians > g_config.maxFOV) return;
-
-                const bool sameSource =
-                    (m_projLockedShader == 0) ||
-                    (shaderKey == m_projLockedShader &&
-                     static_cast<int>(baseReg) == m_projLockedRegister);
-                if (sameSource) {
-                    m_projLockedShader = shaderKey;
-                    m_projLockedRegister = static_cast<int>(baseReg);
-                    m_currentProj = mat;
-                    m_hasProj = true; m_everHadProj = true;
-                    m_projLastFrame = g_frameCount;
-                    m_projDetectedFrame = g_frameCount;
-                    slotResolvedStructurally[MatrixSlot_Projection] = true;
-                    g_projectionDetectedByNumericStructure = true;
-                    g_projectionDetectedFovRadians = projectionInfo.fovRadians;
-                    g_projectionDetectedRegister = static_cast<int>(baseReg);
-                    g_projectionDetectedHandedness = projectionInfo.handedness;
-                    StoreProjectionMatrix(m_currentProj, shaderKey, static_cast<int>(baseReg),
-                                          rows, transposed, false,
-                                          "deterministic structural projection");
-                    LogMsg("Projection accepted: c%d-c%d rows=%d fov=%.2f deg (%s)",
-                           static_cast<int>(baseReg), static_cast<int>(baseReg) + rows - 1, rows,
-                           projectionInfo.fovRadians * 180.0f / 3.14159265f,
-                           ProjectionHandednessLabel(projectionInfo.handedness));
-                }
-            } else if (cls == MatrixClass_View &&
-                       !suppressViewFromUpload &&
-                       g_config.viewMatrixRegister < 0 &&
-                       !slotResolvedByOverride[MatrixSlot_View] &&
-                       !slotResolvedStructurally[MatrixSlot_View]) {
-                const bool sameSource =
-                    (m_viewLockedShader == 0) ||
-                    (shaderKey == m_viewLockedShader &&
-                     static_cast<int>(baseReg) == m_viewLockedRegister);
-                if (sameSource) {
-                    if (m_hasProj && m_projDetectedFrame == g_frameCount &&
-                        !CrossValidateViewAgainstProjection(mat, m_currentProj)) {
-                        // Column norms of candidateView * P do not match column norms of P.
-                        // This is WV, VP, or some other combined form — not a pure view matrix.
-                        // Do not mark slotResolvedStructurally so detection can continue.
-                        return;
-                    }
-                    m_viewLockedShader = shaderKey;
-                    m_viewLockedRegister = static_cast<int>(baseReg);
-                    m_currentView = mat;
-                    m_hasView = true; m_everHadView = true;
-                    m_viewLastFrame = g_frameCount;
-                    slotResolvedStructurally[MatrixSlot_View] = true;
-                    StoreViewMatrix(m_currentView, shaderKey, static_cast<int>(baseReg),
-                                    rows, transposed, false,
-                                    "deterministic structural view");
-                }
-            } else if (cls == MatrixClass_World &&
-                       !suppressWorldFromUpload &&
-                       g_config.worldMatrixRegister < 0 &&
-                       !slotResolvedByOverride[MatrixSlot_World] &&
-                       !slotResolvedStructurally[MatrixSlot_World]) {
-                m_currentWorld = mat;
-                m_hasWorld = true; m_everHadWorld = true;
-                m_worldLastFrame = g_frameCount;
-                slotResolvedStructurally[MatrixSlot_World] = true;
-                StoreWorldMatrix(m_currentWorld, shaderKey, static_cast<int>(baseReg), rows, transposed, false, "deterministic structural world");
-            } else if (cls == MatrixClass_CombinedPerspective &&
-                       g_config.worldMatrixRegister < 0 && g_config.viewMatrixRegister < 0 && g_config.projMatrixRegister < 0 &&
-                       !slotResolvedByOverride[MatrixSlot_World] && !slotResolvedByOverride[MatrixSlot_View] && !slotResolvedByOverride[MatrixSlot_Projection] &&
-                       !slotResolvedStructurally[MatrixSlot_World] && !slotResolvedStructurally[MatrixSlot_View] && !slotResolvedStructurally[MatrixSlot_Projection] &&
-                       rows == 4) {
-                StoreMVPMatrix(mat, shaderKey, static_cast<int>(baseReg), rows, transposed, false, "deterministic structural combined MVP", static_cast<int>(baseReg));
-            }
-        };
-
-        g_profileDisableStructuralDetection = false;
-        const bool allowStructuralDetection = !profileActive;
-
-        D3DMATRIX knownCombinedVp = {};
-        D3DMATRIX knownCombinedWv = {};
-        D3DMATRIX knownCombinedMvp = {};
-        bool hasKnownCombinedVp = false;
-        bool hasKnownCombinedWv = false;
-        bool hasKnownCombinedMvp = false;
-        {
-            std::lock_guard<std::mutex> lock(g_cameraMatricesMutex);
-            knownCombinedVp = g_cameraMatrices.vp;
-            knownCombinedWv = g_cameraMatrices.wv;
-            knownCombinedMvp = g_cameraMatrices.mvp;
-            hasKnownCombinedVp = g_cameraMatrices.hasVP;
-            hasKnownCombinedWv = g_cameraMatrices.hasWV;
-            hasKnownCombinedMvp = g_cameraMatrices.hasMVP;
-        }
-
-        if (allowStructuralDetection && effectiveConstantData && Vector4fCount >= 12) {
-            if (CountStridedCandidates(effectiveConstantData, StartRegister,
-                                      Vector4fCount, 4u, MatrixClass_View) > 2) {
-                suppressViewFromUpload = true;
-            }
-            if (CountStridedCandidates(effectiveConstantData, StartRegister,
-                                      Vector4fCount, 4u, MatrixClass_World) > 2) {
-                suppressWorldFromUpload = true;
+    // Publishes the bound shader's enabled manual bindings from its constant snapshot
+    // and keeps their slots out of the next classification.
+    void ApplyManualBindings(uintptr_t shaderKey, const ShaderConstantState& state) {
+        for (int slot = 0; slot < MatrixSlot_Count; slot++) {
+            const ManualMatrixBinding& binding = g_manualBindings[slot];
+            if (!binding.enabled || binding.shaderKey != shaderKey) {
+                continue;
             }
-            if (!suppressViewFromUpload &&
-                CountStridedCandidates(effectiveConstantData, StartRegister,
-                                      Vector4fCount, 3u, MatrixClass_View) > 2) {
-                suppressViewFromUpload = true;
+            D3DMATRIX manualMat = {};
+            if (!TryBuildMatrixSnapshot(state, binding.baseRegister, binding.rows, false, &manualMat)) {
+                continue;
             }
-            if (!suppressWorldFromUpload &&
-                CountStridedCandidates(effectiveConstantData, StartRegister,
-                                      Vector4fCount, 3u, MatrixClass_World) > 2) {
-                suppressWorldFromUpload = true;
+            EngineProjectionDetection detection;
+            detection.reg = binding.baseRegister;
+            EngineCaptureInfo info;
+            info.shaderId = shaderKey;
+            info.baseRegister = binding.baseRegister;
+            info.rows = binding.rows;
+            info.manual = true;
+            if (slot == MatrixSlot_Projection) {
+                info.detection = &detection;
             }
+            const EngineMatrixSlot engineSlot = static_cast<EngineMatrixSlot>(slot);
+            m_engine.ApplyExternalMatrix(engineSlot, AsEngineMatrix(manualMat), info);
+            m_engine.HoldSlotForNextClassification(engineSlot);
         }
+    }
 
-        bool anyStructuralMatch = false;
-        if (allowStructuralDetection && effectiveConstantData && Vector4fCount >= 3) {
-            for (UINT rows : {4u, 3u}) {
-                if (Vector4fCount < rows) {
-                    continue;
-                }
-                for (UINT offset = 0; offset + rows <= Vector4fCount; ++offset) {
-                    UINT baseReg = StartRegister + offset;
-                    D3DMATRIX mat = {};
-                    if (!TryBuildMatrixFromConstantUpdate(effectiveConstantData + offset * 4, baseReg, rows,
-                                                          static_cast<int>(baseReg), static_cast<int>(rows),
-                                                          false, &mat)) {
-                        continue;
-                    }
-
-                    MatrixClassification directClass = ClassifyMatrixDeterministic(mat, static_cast<int>(rows), Vector4fCount, StartRegister, baseReg);
-                    bool transposed = false;
-                    if (directClass == MatrixClass_None && g_probeTransposedLayouts) {
-                        D3DMATRIX t = TransposeMatrix(mat);
-                        MatrixClassification transposedClass = ClassifyMatrixDeterministic(t, static_cast<int>(rows), Vector4fCount, StartRegister, baseReg);
-                        if (transposedClass != MatrixClass_None) {
-                            mat = t;
-                            transposed = true;
-                        }
-                    }
-
-                    MatrixClassification finalClass = ClassifyMatrixDeterministic(mat, static_cast<int>(rows), Vector4fCount, StartRegister, baseReg);
-                    if (rows == 3u &&
-                        (finalClass == MatrixClass_View || finalClass == MatrixClass_World) &&
-                        IsThreeRowPrefixOfPerspectiveMatrix(effectiveConstantData,
-                                                            StartRegister,
-                                                            Vector4fCount,
-                                                            baseReg,
-                                                            transposed)) {
-                        finalClass = MatrixClass_None;
-                    }
-                    if (g_probeInverseView && rows == 4u &&
-                        (finalClass == MatrixClass_None || finalClass == MatrixClass_View)) {
-                        const float row0Len = sqrtf(Dot3(mat._11, mat._12, mat._13, mat._11, mat._12, mat._13));
-                        const float row1Len = sqrtf(Dot3(mat._21, mat._22, mat._23, mat._21, mat._22, mat._23));
-                        const float row2Len = sqrtf(Dot3(mat._31, mat._32, mat._33, mat._31, mat._32, mat._33));
-                        const bool orthonormal =
-                            fabsf(row0Len - 1.0f) < 0.05f &&
-                            fabsf(row1Len - 1.0f) < 0.05f &&
-                            fabsf(row2Len - 1.0f) < 0.05f &&
-                            fabsf(Dot3(mat._11, mat._12, mat._13, mat._21, mat._22, mat._23)) < 0.05f &&
-                            fabsf(Dot3(mat._11, mat._12, mat._13, mat._31, mat._32, mat._33)) < 0.05f &&
-                            fabsf(Dot3(mat._21, mat._22, mat._23, mat._31, mat._32, mat._33)) < 0.05f;
-                        if (orthonormal) {
-                            const D3DMATRIX originalMat = mat;
-                            const D3DMATRIX invCandidate = InvertSimpleRigidView(mat);
-                            MatrixClassification inverseClass = ClassifyMatrixDeterministic(invCandidate, static_cast<int>(rows), Vector4fCount, StartRegister, baseReg);
-
-                            if (finalClass == MatrixClass_None && inverseClass == MatrixClass_View) {
-                                mat = invCandidate;
-                                finalClass = inverseClass;
-                            }
-
-                            if (finalClass == MatrixClass_View) {
-                                const ViewCandidateConsistency viewConsistency = ResolveViewInverseConsistency(
-                                    originalMat,
-                                    invCandidate,
-                                    &m_currentProj,
-                                    m_hasProj,
-                                    &m_currentWorld,
-                                    m_hasWorld,
-                                    &knownCombinedVp,
-                                    hasKnownCombinedVp,
-                                    &knownCombinedWv,
-                                    hasKnownCombinedWv,
-                                    &knownCombinedMvp,
-                                    hasKnownCombinedMvp);
-                                if (viewConsistency == ViewCandidateConsistency_Inverse) {
-                                    mat = invCandidate;
-                                    LogMsg("Structural view disambiguation: c%d prefers inverse candidate using composition consistency",
-                                           static_cast<int>(baseReg));
-                                } else if (viewConsistency == ViewCandidateConsistency_Ambiguous ||
-                                           viewConsistency == ViewCandidateConsistency_None) {
-                                    LogMsg("Structural view disambiguation: c%d ambiguous/no consistency signal; keeping classified candidate",
-                                           static_cast<int>(baseReg));
-                                }
-                            }
-                        }
-                    }
-                    if (finalClass != MatrixClass_None) {
-                        anyStructuralMatch = true;
-                        updateFromClassification(mat, baseReg, static_cast<int>(rows), transposed);
-                    }
-
-                    const bool allSlotsResolved =
-                        (slotResolvedStructurally[MatrixSlot_View] || slotResolvedByOverride[MatrixSlot_View] || g_config.viewMatrixRegister >= 0) &&
-                        (slotResolvedStructurally[MatrixSlot_Projection] || slotResolvedByOverride[MatrixSlot_Projection] || g_config.projMatrixRegister >= 0) &&
-                        (slotResolvedStructurally[MatrixSlot_World] || slotResolvedByOverride[MatrixSlot_World] || g_config.worldMatrixRegister >= 0);
-                    if (allSlotsResolved) goto done_scanning;
-                }
-            }
+    // Publishes the draw shader's manual bindings and classifies the queued uploads it
+    // reads; see MatrixEngine::FlushDeferredClassification.
+    void FlushDeferredConstantClassification() {
+        if (!m_engine.HasDeferredClassification()) {
+            return;
         }
-        done_scanning:
-
-        if (g_config.logAllConstants && m_constantLogThrottle == 0 && Vector4fCount >= 4) {
-            LogMsg("SetVertexShaderConstantF: c%d-%d (%d vectors)",
-                   StartRegister, StartRegister + Vector4fCount - 1, Vector4fCount);
-            for (UINT i = 0; i < Vector4fCount && i < 4; i++) {
-                LogMsg("  c%d: [%.3f, %.3f, %.3f, %.3f]",
-                       StartRegister + i,
-                       effectiveConstantData[i*4+0], effectiveConstantData[i*4+1],
-                       effectiveConstantData[i*4+2], effectiveConstantData[i*4+3]);
+        TRACE_SCOPE("DeferredClassification");
+        UPLOAD_ALLOCATION_PROBE();
+        SyncEngineShader();
+        const uintptr_t shaderKey = reinterpret_cast<uintptr_t>(m_currentVertexShader);
+        if (shaderKey != 0) {
+            const ShaderConstantState* state = GetShaderState(shaderKey, false);
+            if (state) {
+                ApplyManualBindings(shaderKey, *state);
             }
         }
+        m_engine.FlushDeferredClassification();
+    }
 
-        D3DMATRIX combinedMvp = {};
-        D3DMATRIX combinedMv = {};
-        D3DMATRIX combinedVp = {};
-        bool hasMvp = false;
-        bool hasMv = false;
-        bool hasVp = false;
-        {
-            std::lock_guard<std::mutex> lock(g_cameraMatricesMutex);
-            combinedMvp = g_cameraMatrices.mvp;
-            combinedMv = g_cameraMatrices.wv;
-            combinedVp = g_cameraMatrices.vp;
-            hasMvp = g_cameraMatrices.hasMVP;
-            hasMv = g_cameraMatrices.hasWV;
-            hasVp = g_cameraMatrices.hasVP;
-        }
-
-        D3DMATRIX generatedProjection = {};
-        bool hasGeneratedProjection = false;
-        if (g_config.allowGeneratedProjectionForVPDecomposition) {
-            hasGeneratedProjection = BuildExperimentalCustomProjectionMatrix(m_real, m_hwnd, &generatedProjection, nullptr, nullptr, nullptr, nullptr);
-        }
-
-        TryDecomposeCombinedMatricesDeterministic(&m_currentWorld, &m_hasWorld,
-                                                  &m_currentView, &m_hasView,
-                                                  &m_currentProj, &m_hasProj,
-                                                  &combinedMvp, hasMvp,
-                                                  &combinedMv, hasMv,
-                                                  &combinedVp, hasVp,
-                                                  &generatedProjection, hasGeneratedProjection);
-
-        if (g_combinedDecompDebug.solvedWorld) {
-            m_everHadWorld = true;
-            m_worldLastFrame = g_frameCount;
-            StoreWorldMatrix(m_currentWorld, shaderKey, -1, 4, false, false,
-                             "deterministic combined decomposition");
-        }
-        if (g_combinedDecompDebug.solvedView) {
-            m_everHadView = true;
-            m_viewLastFrame = g_frameCount;
-            StoreViewMatrix(m_currentView, shaderKey, -1, 4, false, false,
-                            "deterministic combined decomposition");
-        }
-        if (g_combinedDecompDebug.solvedProjection) {
-            m_everHadProj = true;
-            m_projLastFrame = g_frameCount;
-            StoreProjectionMatrix(m_currentProj, shaderKey, -1, 4, false, false,
-                                  "deterministic combined decomposition");
-        }
-
-        return m_real->SetVertexShaderConstantF(StartRegister, effectiveConstantData, Vector4fCount);
+    void ClearDeferredConstantClassification() {
+        m_engine.ClearDeferredClassification();
     }
 
+
     // Present - good place to do per-frame logging throttle
     HRESULT STDMETHODCALLTYPE Present(const RECT* pSourceRect, const RECT* pDestRect,
                                        HWND hDestWindowOverride, const RGNDATA* pDirtyRegion) override {
-        g_frameCount++;
+        {
+            METHOD_TIMING_SCOPE(TimedMethod_Present);
+            TRACE_SCOPE("Present");
+            EndProxyFrame();
+        }
+        const HRESULT hr = m_real->Present(pSourceRect, pDestRect, hDestWindowOverride, pDirtyRegion);
+        // The frame's last sample and event, Present's own, are closed by now.
+        RollMethodTimingFrame();
+        AdvanceTraceCapture();
+        return hr;
+    }
 
-        // Reset per-frame source locks. Locks set during SetVertexShaderConstantF calls
-        // this frame will be validated against these — after Present they reset for the
-        // next frame. This ensures correct behavior regardless of BeginScene call count.
-        if (g_activeGameProfile == GameProfile_None) {
-            m_viewLockedShader = 0;
-            m_viewLockedRegister = -1;
-            m_projLockedShader = 0;
-            m_projLockedRegister = -1;
+    // Per-frame proxy work done by Present before it forwards.
+    void EndProxyFrame() {
+        if (g_apiTraceRecorder.IsRecording()) {
+            g_apiTraceRecorder.RecordPresent(static_cast<uint32_t>(g_frameCount));
         }
+        g_frameCount++;
+        ApplyCompletedShaderAnalyses();
+        if (g_shaderCacheDirty && g_frameCount - g_shaderCacheSavedFrame >= kShaderCacheSaveIntervalFrames) {
+            SaveShaderCache(true);
+        }
+
+        // Per-frame source locks and the constant log throttle.
+        m_engine.OnPresent();
+        PublishEngineStats();
+        g_profileState = m_engine.GetProfileState();
+
+        g_combinedDecompRunsLastFrame = g_combinedDecompRunsThisFrame;
+        g_combinedDecompSkipsLastFrame = g_combinedDecompSkipsThisFrame;
+        g_combinedDecompRunsThisFrame = 0;
+        g_combinedDecompSkipsThisFrame = 0;
+#if CAMERA_PROXY_ALLOCATION_PROBE
+        g_uploadPathCallsLastFrame = g_uploadPathCallsThisFrame;
+        g_uploadPathAllocatingCallsLastFrame = g_uploadPathAllocatingCallsThisFrame;
+        g_uploadPathAllocationsLastFrame = g_uploadPathAllocationsThisFrame;
+        g_uploadPathCallsThisFrame = 0;
+        g_uploadPathAllocatingCallsThisFrame = 0;
+        g_uploadPathAllocationsThisFrame = 0;
+#endif
+        g_setTransformEmittedLastFrame = g_setTransformEmittedThisFrame;
+        g_setTransformSuppressedLastFrame = g_setTransformSuppressedThisFrame;
+        g_setTransformEmittedThisFrame = 0;
+        g_setTransformSuppressedThisFrame = 0;
 
         UpdateFrameTimeStats();
-        // Throttle constant logging to every 60 frames
-        if (g_config.logAllConstants) {
-            m_constantLogThrottle = (m_constantLogThrottle + 1) % 60;
-        }
         UpdateConstantSnapshot();
         if (g_config.enableMemoryScanner && g_config.memoryScannerIntervalSec > 0) {
             DWORD nowTick = GetTickCount();
@@ -6272,7 +6141,8 @@ public:
 
         // Log periodic status
         if (g_frameCount % 300 == 0) {
-            LogMsg("Frame %d - hasView: %d, hasProj: %d", g_frameCount, m_hasView, m_hasProj);
+            LogMsg("Frame %d - hasView: %d, hasProj: %d", g_frameCount,
+                   m_engine.Has(EngineTransform_View), m_engine.Has(EngineTransform_Projection));
         }
 
         if (!g_imguiInitialized) {
@@ -6282,13 +6152,17 @@ public:
         if (g_imguiInitialized) {
             ImGui::GetIO().MouseDrawCursor = g_showImGui;
         }
-        g_imguiMgrrUseAutoProjection = m_mgrrUseAutoProjection;
+        g_combinedDecompDebug = m_engine.GetLastDecomposition();
+        g_imguiMgrrUseAutoProjection = g_config.mgrrUseAutoProjectionWhenC4Invalid;
         g_imguiBarnyardUseGameSetTransformsForViewProjection = g_config.barnyardUseGameSetTransformsForViewProjection;
         RenderImGuiOverlay(m_real);
-        m_mgrrUseAutoProjection = g_imguiMgrrUseAutoProjection;
         g_config.barnyardUseGameSetTransformsForViewProjection = g_imguiBarnyardUseGameSetTransformsForViewProjection;
+        // The overlay may have changed the profile or any extraction setting.
+        m_engine.SetConfig(BuildMatrixEngineConfig());
+        SyncGoldenRun();
         if (g_requestManualEmit) {
-            EmitFixedFunctionTransforms();
+            m_engine.InvalidateEmittedTransforms();
+            EmitFixedFunctionTransforms(nullptr, false);
             g_requestManualEmit = false;
             if (g_activeGameProfile == GameProfile_Barnyard) {
                 snprintf(g_manualEmitStatus, sizeof(g_manualEmitStatus),
@@ -6305,8 +6179,8 @@ public:
             g_remixLightingManager.EndFrame();
             {
                 CameraState cam = {};
-                if (m_everHadView) {
-                    D3DMATRIX vi = InvertSimpleRigidView(m_currentView);
+                if (m_engine.EverHad(EngineTransform_View)) {
+                    D3DMATRIX vi = InvertSimpleRigidView(ToD3DMatrix(m_engine.Current(EngineTransform_View)));
                     cam.valid = true;
                     cam.row0[0] = vi._11; cam.row0[1] = vi._12; cam.row0[2] = vi._13;
                     cam.row1[0] = vi._21; cam.row1[1] = vi._22; cam.row1[2] = vi._23;
@@ -6351,7 +6225,6 @@ public:
         }
 
         m_rasterCaptureTakenThisFrame = false;
-        return m_real->Present(pSourceRect, pDestRect, hDestWindowOverride, pDirtyRegion);
     }
 
     // All other methods pass through
@@ -6368,16 +6241,28 @@ public:
     HRESULT STDMETHODCALLTYPE CreateAdditionalSwapChain(D3DPRESENT_PARAMETERS* pPresentationParameters, IDirect3DSwapChain9** pSwapChain) override { return m_real->CreateAdditionalSwapChain(pPresentationParameters, pSwapChain); }
     HRESULT STDMETHODCALLTYPE GetSwapChain(UINT iSwapChain, IDirect3DSwapChain9** pSwapChain) override { return m_real->GetSwapChain(iSwapChain, pSwapChain); }
     UINT STDMETHODCALLTYPE GetNumberOfSwapChains() override { return m_real->GetNumberOfSwapChains(); }
-    HRESULT STDMETHODCALLTYPE Reset(D3DPRESENT_PARAMETERS* pPresentationParameters) override {
+    // Shared by Reset and ResetEx: a reset returns the fixed-function transforms to
+    // their defaults and drops default-pool resources, so cached state must go first.
+    void BeginDeviceReset() {
         ReleaseBlendResources();
+        ClearDeferredConstantClassification();
+        g_fixedFunctionTransformEpoch++;
         if (g_imguiInitialized) {
             ImGui_ImplDX9_InvalidateDeviceObjects();
             // Do NOT call ImGui_ImplWin32_Shutdown here.
         }
-        HRESULT hr = m_real->Reset(pPresentationParameters);
+    }
+
+    void EndDeviceReset(HRESULT hr) {
         if (SUCCEEDED(hr) && g_imguiInitialized) {
             ImGui_ImplDX9_CreateDeviceObjects();
         }
+    }
+
+    HRESULT STDMETHODCALLTYPE Reset(D3DPRESENT_PARAMETERS* pPresentationParameters) override {
+        BeginDeviceReset();
+        HRESULT hr = m_real->Reset(pPresentationParameters);
+        EndDeviceReset(hr);
         return hr;
     }
     HRESULT STDMETHODCALLTYPE GetBackBuffer(UINT iSwapChain, UINT iBackBuffer, D3DBACKBUFFER_TYPE Type, IDirect3DSurface9** ppBackBuffer) override { return m_real->GetBackBuffer(iSwapChain, iBackBuffer, Type, ppBackBuffer); }
@@ -6404,22 +6289,10 @@ public:
     HRESULT STDMETHODCALLTYPE SetDepthStencilSurface(IDirect3DSurface9* pNewZStencil) override { return m_real->SetDepthStencilSurface(pNewZStencil); }
     HRESULT STDMETHODCALLTYPE GetDepthStencilSurface(IDirect3DSurface9** ppZStencilSurface) override { return m_real->GetDepthStencilSurface(ppZStencilSurface); }
     HRESULT STDMETHODCALLTYPE BeginScene() override {
-        g_combinedDecompDebug = {};
-        if (g_activeGameProfile == GameProfile_MetalGearRising) {
-            // MGR frame lifecycle: keep projection/view persistent across draws and frames,
-            // but require a fresh world upload for each frame.
-            CreateIdentityMatrix(&m_currentWorld);
-            m_hasWorld = false;
-            g_mgrWorldCapturedForDraw = false;
-            g_mgrProjCapturedThisFrame = false;
-            g_mgrViewCapturedThisFrame = false;
-            g_mgrProjectionRegisterValid = false;
-        } else if (g_activeGameProfile == GameProfile_None) {
-            m_viewLockedShader = 0;
-            m_viewLockedRegister = -1;
-            m_projLockedShader = 0;
-            m_projLockedRegister = -1;
+        if (g_apiTraceRecorder.IsRecording()) {
+            g_apiTraceRecorder.RecordBeginScene();
         }
+        m_engine.OnBeginScene();
         if (!m_remixFrameOpen) {
             g_remixLightingManager.BeginFrame();
 			g_customLightsManager.BeginFrame(g_lastDeltaSec);
@@ -6448,76 +6321,44 @@ public:
     }
     HRESULT STDMETHODCALLTYPE Clear(DWORD Count, const D3DRECT* pRects, DWORD Flags, D3DCOLOR Color, float Z, DWORD Stencil) override { return m_real->Clear(Count, pRects, Flags, Color, Z, Stencil); }
     HRESULT STDMETHODCALLTYPE SetTransform(D3DTRANSFORMSTATETYPE State, const D3DMATRIX* pMatrix) override {
-        int transformIdx = -1;
-        if (State == D3DTS_WORLD) transformIdx = 0;
-        if (State == D3DTS_VIEW) transformIdx = 1;
-        if (State == D3DTS_PROJECTION) transformIdx = 2;
-        if (transformIdx >= 0 && pMatrix) {
-            g_gameSetTransformSeen[transformIdx] = true;
-            g_gameSetTransformAnySeen = true;
-
-            const bool allowGenericSetTransformCompatibility = (g_activeGameProfile == GameProfile_None);
-            if (allowGenericSetTransformCompatibility && g_config.setTransformBypassProxyWhenGameProvides) {
-                if (State == D3DTS_WORLD) {
-                    m_currentWorld = *pMatrix;
-                    m_hasWorld = true; m_everHadWorld = true;
-                    m_worldLastFrame = g_frameCount;
-                    StoreWorldMatrix(m_currentWorld, 0, -1, 4, false, true,
-                                     "game SetTransform(World) direct passthrough");
-                } else if (State == D3DTS_VIEW) {
-                    m_currentView = *pMatrix;
-                    m_hasView = true; m_everHadView = true;
-                    m_viewLastFrame = g_frameCount;
-                    StoreViewMatrix(m_currentView, 0, -1, 4, false, true,
-                                    "game SetTransform(View) direct passthrough");
-                } else if (State == D3DTS_PROJECTION) {
-                    m_currentProj = *pMatrix;
-                    m_hasProj = true; m_everHadProj = true;
-                    m_projLastFrame = g_frameCount;
-                    StoreProjectionMatrix(m_currentProj, 0, -1, 4, false, true,
-                                          "game SetTransform(Projection) direct passthrough");
-                }
-                return m_real->SetTransform(State, pMatrix);
-            }
-
-            if (allowGenericSetTransformCompatibility && g_config.setTransformRoundTripCompatibilityMode) {
-                const HRESULT setHr = m_real->SetTransform(State, pMatrix);
-                if (FAILED(setHr)) {
-                    return setHr;
-                }
-                D3DMATRIX roundTrip = *pMatrix;
-                if (SUCCEEDED(m_real->GetTransform(State, &roundTrip))) {
-                    m_real->SetTransform(State, &roundTrip);
-                }
-                if (State == D3DTS_WORLD) {
-                    m_currentWorld = roundTrip;
-                    m_hasWorld = true; m_everHadWorld = true;
-                    m_worldLastFrame = g_frameCount;
-                    StoreWorldMatrix(m_currentWorld, 0, -1, 4, false, true,
-                                     "game SetTransform(World)+GetTransform compatibility");
-                } else if (State == D3DTS_VIEW) {
-                    m_currentView = roundTrip;
-                    m_hasView = true; m_everHadView = true;
-                    m_viewLastFrame = g_frameCount;
-                    StoreViewMatrix(m_currentView, 0, -1, 4, false, true,
-                                    "game SetTransform(View)+GetTransform compatibility");
-                } else if (State == D3DTS_PROJECTION) {
-                    m_currentProj = roundTrip;
-                    m_hasProj = true; m_everHadProj = true;
-                    m_projLastFrame = g_frameCount;
-                    StoreProjectionMatrix(m_currentProj, 0, -1, 4, false, true,
-                                          "game SetTransform(Projection)+GetTransform compatibility");
-                }
+        const int transformIdx = TransformCacheIndex(State);
+        if (pMatrix && g_apiTraceRecorder.IsRecording()) {
+            g_apiTraceRecorder.RecordSetTransform(static_cast<uint32_t>(State), &pMatrix->_11);
+        }
+        if (transformIdx < 0) {
+            return m_real->SetTransform(State, pMatrix);
+        }
+        const EngineTransformSlot slot = static_cast<EngineTransformSlot>(transformIdx);
+        const bool barnyardBlocksState = g_activeGameProfile == GameProfile_Barnyard &&
+                                         (State == D3DTS_VIEW || State == D3DTS_PROJECTION);
+        if (!pMatrix) {
+            m_engine.OnGameSetTransform(slot, nullptr);
+            return barnyardBlocksState ? D3D_OK : m_real->SetTransform(State, pMatrix);
+        }
+        g_gameSetTransformSeen[transformIdx] = true;
+        g_gameSetTransformAnySeen = true;
+
+        const bool allowGenericSetTransformCompatibility = (g_activeGameProfile == GameProfile_None);
+        if (allowGenericSetTransformCompatibility && !g_config.setTransformBypassProxyWhenGameProvides &&
+            g_config.setTransformRoundTripCompatibilityMode) {
+            const HRESULT setHr = m_real->SetTransform(State, pMatrix);
+            if (FAILED(setHr)) {
+                m_engine.OnGameSetTransform(slot, nullptr);
                 return setHr;
             }
+            D3DMATRIX roundTrip = *pMatrix;
+            if (SUCCEEDED(m_real->GetTransform(State, &roundTrip))) {
+                m_real->SetTransform(State, &roundTrip);
+            }
+            m_engine.OnGameSetTransform(slot, AsEngineMatrix(&roundTrip), true);
+            return setHr;
         }
 
-        if (g_activeGameProfile == GameProfile_Barnyard &&
-            (State == D3DTS_VIEW || State == D3DTS_PROJECTION)) {
-            if (!g_config.barnyardUseGameSetTransformsForViewProjection || !pMatrix) {
+        if (barnyardBlocksState) {
+            if (!g_config.barnyardUseGameSetTransformsForViewProjection) {
+                m_engine.OnGameSetTransform(slot, nullptr);
                 return D3D_OK;
             }
-
             const HRESULT setHr = m_real->SetTransform(State, pMatrix);
             D3DMATRIX captured = *pMatrix;
             D3DMATRIX roundTrip = {};
@@ -6525,40 +6366,20 @@ public:
             if (SUCCEEDED(getHr)) {
                 captured = roundTrip;
             }
-
-            if (State == D3DTS_VIEW) {
-                m_currentView = captured;
-                m_hasView = true; m_everHadView = true;
-                m_viewLastFrame = g_frameCount;
-                g_profileCoreRegistersSeen[0] = true;
-                StoreViewMatrix(m_currentView, 0, -1, 4, false, true,
-                                SUCCEEDED(getHr)
-                                    ? "Barnyard intercepted game SetTransform(View)+GetTransform"
-                                    : "Barnyard intercepted game SetTransform(View)");
-            } else {
-                m_currentProj = captured;
-                m_hasProj = true; m_everHadProj = true;
-                m_projLastFrame = g_frameCount;
-                g_profileCoreRegistersSeen[1] = true;
-                g_projectionDetectedByNumericStructure = false;
-                g_projectionDetectedRegister = -1;
-                g_projectionDetectedHandedness = ProjectionHandedness_Unknown;
-                g_projectionDetectedFovRadians = ExtractFOV(captured);
-                StoreProjectionMatrix(m_currentProj, 0, -1, 4, false, true,
-                                      SUCCEEDED(getHr)
-                                          ? "Barnyard intercepted game SetTransform(Projection)+GetTransform"
-                                          : "Barnyard intercepted game SetTransform(Projection)");
-            }
-
-            snprintf(g_profileStatusMessage, sizeof(g_profileStatusMessage),
-                     "Barnyard intercepted game %s transform and cached for draw-time forwarding.",
-                     State == D3DTS_VIEW ? "VIEW" : "PROJECTION");
+            m_engine.OnGameSetTransform(slot, AsEngineMatrix(&captured), SUCCEEDED(getHr));
             return setHr;
         }
+        m_engine.OnGameSetTransform(slot, AsEngineMatrix(pMatrix));
         return m_real->SetTransform(State, pMatrix);
     }
     HRESULT STDMETHODCALLTYPE GetTransform(D3DTRANSFORMSTATETYPE State, D3DMATRIX* pMatrix) override { return m_real->GetTransform(State, pMatrix); }
-    HRESULT STDMETHODCALLTYPE MultiplyTransform(D3DTRANSFORMSTATETYPE State, const D3DMATRIX* pMatrix) override { return m_real->MultiplyTransform(State, pMatrix); }
+    HRESULT STDMETHODCALLTYPE MultiplyTransform(D3DTRANSFORMSTATETYPE State, const D3DMATRIX* pMatrix) override {
+        const int slot = TransformCacheIndex(State);
+        if (slot >= 0) {
+            m_engine.InvalidateEmittedTransform(static_cast<EngineTransformSlot>(slot));
+        }
+        return m_real->MultiplyTransform(State, pMatrix);
+    }
     HRESULT STDMETHODCALLTYPE SetViewport(const D3DVIEWPORT9* pViewport) override { return m_real->SetViewport(pViewport); }
     HRESULT STDMETHODCALLTYPE GetViewport(D3DVIEWPORT9* pViewport) override { return m_real->GetViewport(pViewport); }
     HRESULT STDMETHODCALLTYPE SetMaterial(const D3DMATERIAL9* pMaterial) override { return m_real->SetMaterial(pMaterial); }
@@ -6571,9 +6392,23 @@ public:
     HRESULT STDMETHODCALLTYPE GetClipPlane(DWORD Index, float* pPlane) override { return m_real->GetClipPlane(Index, pPlane); }
     HRESULT STDMETHODCALLTYPE SetRenderState(D3DRENDERSTATETYPE State, DWORD Value) override { return m_real->SetRenderState(State, Value); }
     HRESULT STDMETHODCALLTYPE GetRenderState(D3DRENDERSTATETYPE State, DWORD* pValue) override { return m_real->GetRenderState(State, pValue); }
-    HRESULT STDMETHODCALLTYPE CreateStateBlock(D3DSTATEBLOCKTYPE Type, IDirect3DStateBlock9** ppSB) override { return m_real->CreateStateBlock(Type, ppSB); }
+    HRESULT STDMETHODCALLTYPE CreateStateBlock(D3DSTATEBLOCKTYPE Type, IDirect3DStateBlock9** ppSB) override {
+        HRESULT hr = m_real->CreateStateBlock(Type, ppSB);
+        if (SUCCEEDED(hr) && ppSB && *ppSB) {
+            *ppSB = new WrappedStateBlock9(*ppSB);
+        }
+        return hr;
+    }
     HRESULT STDMETHODCALLTYPE BeginStateBlock() override { return m_real->BeginStateBlock(); }
-    HRESULT STDMETHODCALLTYPE EndStateBlock(IDirect3DStateBlock9** ppSB) override { return m_real->EndStateBlock(ppSB); }
+    HRESULT STDMETHODCALLTYPE EndStateBlock(IDirect3DStateBlock9** ppSB) override {
+        // Transforms sent while recording land in the block, not on the device.
+        g_fixedFunctionTransformEpoch++;
+        HRESULT hr = m_real->EndStateBlock(ppSB);
+        if (SUCCEEDED(hr) && ppSB && *ppSB) {
+            *ppSB = new WrappedStateBlock9(*ppSB);
+        }
+        return hr;
+    }
     HRESULT STDMETHODCALLTYPE SetClipStatus(const D3DCLIPSTATUS9* pClipStatus) override { return m_real->SetClipStatus(pClipStatus); }
     HRESULT STDMETHODCALLTYPE GetClipStatus(D3DCLIPSTATUS9* pClipStatus) override { return m_real->GetClipStatus(pClipStatus); }
     HRESULT STDMETHODCALLTYPE GetTexture(DWORD Stage, IDirect3DBaseTexture9** ppTexture) override { return m_real->GetTexture(Stage, ppTexture); }
@@ -6594,49 +6429,101 @@ public:
     HRESULT STDMETHODCALLTYPE SetNPatchMode(float nSegments) override { return m_real->SetNPatchMode(nSegments); }
     float STDMETHODCALLTYPE GetNPatchMode() override { return m_real->GetNPatchMode(); }
     HRESULT STDMETHODCALLTYPE DrawPrimitive(D3DPRIMITIVETYPE PrimitiveType, UINT StartVertex, UINT PrimitiveCount) override {
+        METHOD_TIMING_SCOPE(TimedMethod_DrawPrimitive);
+        if (g_apiTraceRecorder.IsRecording() && !g_isRenderingImGui) {
+            g_apiTraceRecorder.RecordDraw(ApiTraceDrawKind::DrawPrimitive, static_cast<uint32_t>(PrimitiveType), PrimitiveCount);
+        }
         if ((g_pauseRendering || IsCurrentShaderDrawDisabled(m_currentVertexShader)) && !g_isRenderingImGui) {
+            RecordGoldenDraw(nullptr);
             return D3D_OK;
         }
+        FlushDeferredConstantClassification();
         SubmitLightingFromCurrentDraw();
-        EmitFixedFunctionTransforms();
-        if (g_shaderRecords.count(g_activeVertexShaderKey)) g_shaderRecords[g_activeVertexShaderKey].usageCount++;
-        if (g_shaderRecords.count(g_activePixelShaderKey)) g_shaderRecords[g_activePixelShaderKey].usageCount++;
+        EngineDrawTransforms transforms;
+        EmitFixedFunctionTransforms(g_goldenWriter.IsOpen() ? &transforms : nullptr, true);
+        RecordGoldenDraw(&transforms);
+        if (m_currentVertexRecord) m_currentVertexRecord->usageCount++;
+        if (m_currentPixelRecord) m_currentPixelRecord->usageCount++;
+        METHOD_TIMING_END();
         return m_real->DrawPrimitive(PrimitiveType, StartVertex, PrimitiveCount);
     }
     HRESULT STDMETHODCALLTYPE DrawIndexedPrimitive(D3DPRIMITIVETYPE PrimitiveType, INT BaseVertexIndex, UINT MinVertexIndex, UINT NumVertices, UINT startIndex, UINT primCount) override {
+        METHOD_TIMING_SCOPE(TimedMethod_DrawIndexedPrimitive);
+        if (g_apiTraceRecorder.IsRecording() && !g_isRenderingImGui) {
+            g_apiTraceRecorder.RecordDraw(ApiTraceDrawKind::DrawIndexedPrimitive, static_cast<uint32_t>(PrimitiveType), primCount);
+        }
         if ((g_pauseRendering || IsCurrentShaderDrawDisabled(m_currentVertexShader)) && !g_isRenderingImGui) {
+            RecordGoldenDraw(nullptr);
             return D3D_OK;
         }
+        FlushDeferredConstantClassification();
         SubmitLightingFromCurrentDraw();
-        EmitFixedFunctionTransforms();
-        if (g_shaderRecords.count(g_activeVertexShaderKey)) g_shaderRecords[g_activeVertexShaderKey].usageCount++;
-        if (g_shaderRecords.count(g_activePixelShaderKey)) g_shaderRecords[g_activePixelShaderKey].usageCount++;
+        EngineDrawTransforms transforms;
+        EmitFixedFunctionTransforms(g_goldenWriter.IsOpen() ? &transforms : nullptr, true);
+        RecordGoldenDraw(&transforms);
+        if (m_currentVertexRecord) m_currentVertexRecord->usageCount++;
+        if (m_currentPixelRecord) m_currentPixelRecord->usageCount++;
+        METHOD_TIMING_END();
         return m_real->DrawIndexedPrimitive(PrimitiveType, BaseVertexIndex, MinVertexIndex, NumVertices, startIndex, primCount);
     }
     HRESULT STDMETHODCALLTYPE DrawPrimitiveUP(D3DPRIMITIVETYPE PrimitiveType, UINT PrimitiveCount, const void* pVertexStreamZeroData, UINT VertexStreamZeroStride) override {
+        METHOD_TIMING_SCOPE(TimedMethod_DrawPrimitiveUP);
+        if (g_apiTraceRecorder.IsRecording() && !g_isRenderingImGui) {
+            g_apiTraceRecorder.RecordDraw(ApiTraceDrawKind::DrawPrimitiveUP, static_cast<uint32_t>(PrimitiveType), PrimitiveCount);
+        }
         if ((g_pauseRendering || IsCurrentShaderDrawDisabled(m_currentVertexShader)) && !g_isRenderingImGui) {
+            RecordGoldenDraw(nullptr);
             return D3D_OK;
         }
+        FlushDeferredConstantClassification();
         SubmitLightingFromCurrentDraw();
-        EmitFixedFunctionTransforms();
+        EngineDrawTransforms transforms;
+        EmitFixedFunctionTransforms(g_goldenWriter.IsOpen() ? &transforms : nullptr, true);
+        RecordGoldenDraw(&transforms);
+        METHOD_TIMING_END();
         return m_real->DrawPrimitiveUP(PrimitiveType, PrimitiveCount, pVertexStreamZeroData, VertexStreamZeroStride);
     }
     HRESULT STDMETHODCALLTYPE DrawIndexedPrimitiveUP(D3DPRIMITIVETYPE PrimitiveType, UINT MinVertexIndex, UINT NumVertices, UINT PrimitiveCount, const void* pIndexData, D3DFORMAT IndexDataFormat, const void* pVertexStreamZeroData, UINT VertexStreamZeroStride) override {
+        METHOD_TIMING_SCOPE(TimedMethod_DrawIndexedPrimitiveUP);
+        if (g_apiTraceRecorder.IsRecording() && !g_isRenderingImGui) {
+            g_apiTraceRecorder.RecordDraw(ApiTraceDrawKind::DrawIndexedPrimitiveUP, static_cast<uint32_t>(PrimitiveType), PrimitiveCount);
+        }
         if ((g_pauseRendering || IsCurrentShaderDrawDisabled(m_currentVertexShader)) && !g_isRenderingImGui) {
+            RecordGoldenDraw(nullptr);
             return D3D_OK;
         }
+        FlushDeferredConstantClassification();
         SubmitLightingFromCurrentDraw();
-        EmitFixedFunctionTransforms();
+        EngineDrawTransforms transforms;
+        EmitFixedFunctionTransforms(g_goldenWriter.IsOpen() ? &transforms : nullptr, true);
+        RecordGoldenDraw(&transforms);
+        METHOD_TIMING_END();
         return m_real->DrawIndexedPrimitiveUP(PrimitiveType, MinVertexIndex, NumVertices, PrimitiveCount, pIndexData, IndexDataFormat, pVertexStreamZeroData, VertexStreamZeroStride);
     }
     HRESULT STDMETHODCALLTYPE ProcessVertices(UINT SrcStartIndex, UINT DestIndex, UINT VertexCount, IDirect3DVertexBuffer9* pDestBuffer, IDirect3DVertexDeclaration9* pVertexDecl, DWORD Flags) override { return m_real->ProcessVertices(SrcStartIndex, DestIndex, VertexCount, pDestBuffer, pVertexDecl, Flags); }
     HRESULT STDMETHODCALLTYPE CreateVertexDeclaration(const D3DVERTEXELEMENT9* pVertexElements, IDirect3DVertexDeclaration9** ppDecl) override { return m_real->CreateVertexDeclaration(pVertexElements, ppDecl); }
     HRESULT STDMETHODCALLTYPE SetVertexDeclaration(IDirect3DVertexDeclaration9* pDecl) override {
+        METHOD_TIMING_SCOPE(TimedMethod_SetVertexDeclaration);
         g_activeVertexDeclInfo = {};
+        g_activeVertexDeclElementCount = 0;
         if (pDecl) {
             D3DVERTEXELEMENT9 elems[MAXD3DDECLLENGTH] = {};
             UINT num = MAXD3DDECLLENGTH;
             if (SUCCEEDED(pDecl->GetDeclaration(elems, &num))) {
+                const UINT traceCount = (std::min)(num, static_cast<UINT>(MAXD3DDECLLENGTH));
+                for (UINT i = 0; i < traceCount; ++i) {
+                    ApiTraceVertexElement& element = g_activeVertexDeclElements[i];
+                    element.stream = elems[i].Stream;
+                    element.offset = elems[i].Offset;
+                    element.type = elems[i].Type;
+                    element.method = elems[i].Method;
+                    element.usage = elems[i].Usage;
+                    element.usageIndex = elems[i].UsageIndex;
+                }
+                g_activeVertexDeclElementCount = traceCount;
+                if (g_apiTraceRecorder.IsRecording()) {
+                    g_apiTraceRecorder.RecordVertexDeclaration(g_activeVertexDeclElements, traceCount);
+                }
                 for (UINT i = 0; i < num; ++i) {
                     const D3DVERTEXELEMENT9& e = elems[i];
                     if (e.Stream == 0xFF && e.Type == D3DDECLTYPE_UNUSED) break;
@@ -6648,6 +6535,10 @@ public:
                 }
             }
         }
+        if (!pDecl && g_apiTraceRecorder.IsRecording()) {
+            g_apiTraceRecorder.RecordVertexDeclaration(nullptr, 0);
+        }
+        METHOD_TIMING_END();
         return m_real->SetVertexDeclaration(pDecl);
     }
     HRESULT STDMETHODCALLTYPE GetVertexDeclaration(IDirect3DVertexDeclaration9** ppDecl) override { return m_real->GetVertexDeclaration(ppDecl); }
@@ -6671,28 +6562,48 @@ public:
                 if ((pFunction[i] & D3DSI_OPCODE_MASK) == D3DSIO_END) break;
             }
         }
-        RegisterShaderBytecode(reinterpret_cast<WrappedVertexShader9*>(*ppShader)->GetKey(), ShaderStage_Vertex, data);
+        WrappedVertexShader9* wrapped = static_cast<WrappedVertexShader9*>(*ppShader);
+        const uintptr_t shaderKey = wrapped->GetKey();
+        RegisterShaderBytecode(shaderKey, ShaderStage_Vertex, data);
+        if (g_apiTraceRecorder.IsRecording() && !data.empty()) {
+            g_apiTraceRecorder.RecordCreateVertexShader(ApiTraceShaderId(shaderKey), data.data(),
+                                                        static_cast<uint32_t>(data.size()));
+        }
+        // RegisterShaderBytecode already hashed the tokens into the record and
+        // g_shaderBytecodeHashes; the wrapper only caches the record pointer.
+        auto recIt = g_shaderRecords.find(shaderKey);
+        wrapped->SetRecord(recIt != g_shaderRecords.end() ? &recIt->second : nullptr);
         return hr;
     }
     HRESULT STDMETHODCALLTYPE SetVertexShader(IDirect3DVertexShader9* pShader) override {
+        METHOD_TIMING_SCOPE(TimedMethod_SetVertexShader);
+        ApplyCompletedShaderAnalyses();
         m_currentVertexShader = pShader;
         g_activeShaderKey = reinterpret_cast<uintptr_t>(pShader);
         g_activeVertexShaderKey = g_activeShaderKey;
-        GetShaderState(g_activeShaderKey, true);
+        if (g_apiTraceRecorder.IsRecording()) {
+            g_apiTraceRecorder.RecordSetShader(ApiTraceStage::Vertex, ApiTraceShaderId(g_activeVertexShaderKey));
+        }
 
         IDirect3DVertexShader9* realShader = nullptr;
+        ShaderRecord* record = nullptr;
         if (pShader) {
             WrappedVertexShader9* wrapped = static_cast<WrappedVertexShader9*>(pShader);
             realShader = wrapped->GetReal();
-            uint32_t shaderHash = ComputeShaderBytecodeHash(realShader);
-            if (shaderHash != 0) {
-                g_shaderBytecodeHashes[g_activeShaderKey] = shaderHash;
+            record = wrapped->GetRecord();
+            if (!wrapped->GetConstantState()) {
+                wrapped->SetConstantState(GetShaderState(g_activeShaderKey, true));
             }
+        } else {
+            GetShaderState(0, true);
         }
+        m_currentVertexRecord = record;
+        SyncEngineShader();
 
-        if (pShader && g_shaderRecords.count(g_activeShaderKey) && g_shaderRecords[g_activeShaderKey].replacementEnabled && g_shaderRecords[g_activeShaderKey].replacementShader) {
-            realShader = reinterpret_cast<IDirect3DVertexShader9*>(g_shaderRecords[g_activeShaderKey].replacementShader);
+        if (record && record->replacementEnabled && record->replacementShader) {
+            realShader = reinterpret_cast<IDirect3DVertexShader9*>(record->replacementShader);
         }
+        METHOD_TIMING_END();
         return m_real->SetVertexShader(realShader);
     }
     HRESULT STDMETHODCALLTYPE GetVertexShader(IDirect3DVertexShader9** ppShader) override { return m_real->GetVertexShader(ppShader); }
@@ -6723,19 +6634,32 @@ public:
                 if ((pFunction[i] & D3DSI_OPCODE_MASK) == D3DSIO_END) break;
             }
         }
-        RegisterShaderBytecode(reinterpret_cast<WrappedPixelShader9*>(*ppShader)->GetKey(), ShaderStage_Pixel, data);
+        WrappedPixelShader9* wrapped = static_cast<WrappedPixelShader9*>(*ppShader);
+        RegisterShaderBytecode(wrapped->GetKey(), ShaderStage_Pixel, data);
+        auto recIt = g_shaderRecords.find(wrapped->GetKey());
+        wrapped->SetRecord(recIt != g_shaderRecords.end() ? &recIt->second : nullptr);
         return hr;
     }
     HRESULT STDMETHODCALLTYPE SetPixelShader(IDirect3DPixelShader9* pShader) override {
+        METHOD_TIMING_SCOPE(TimedMethod_SetPixelShader);
+        ApplyCompletedShaderAnalyses();
         m_currentPixelShader = pShader;
         g_activePixelShaderKey = reinterpret_cast<uintptr_t>(pShader);
+        if (g_apiTraceRecorder.IsRecording()) {
+            g_apiTraceRecorder.RecordSetShader(ApiTraceStage::Pixel, ApiTraceShaderId(g_activePixelShaderKey));
+        }
         IDirect3DPixelShader9* realShader = nullptr;
+        ShaderRecord* record = nullptr;
         if (pShader) {
-            realShader = static_cast<WrappedPixelShader9*>(pShader)->GetReal();
-            if (g_shaderRecords.count(g_activePixelShaderKey) && g_shaderRecords[g_activePixelShaderKey].replacementEnabled && g_shaderRecords[g_activePixelShaderKey].replacementShader) {
-                realShader = reinterpret_cast<IDirect3DPixelShader9*>(g_shaderRecords[g_activePixelShaderKey].replacementShader);
+            WrappedPixelShader9* wrapped = static_cast<WrappedPixelShader9*>(pShader);
+            realShader = wrapped->GetReal();
+            record = wrapped->GetRecord();
+            if (record && record->replacementEnabled && record->replacementShader) {
+                realShader = reinterpret_cast<IDirect3DPixelShader9*>(record->replacementShader);
             }
         }
+        m_currentPixelRecord = record;
+        METHOD_TIMING_END();
         return m_real->SetPixelShader(realShader);
     }
     HRESULT STDMETHODCALLTYPE GetPixelShader(IDirect3DPixelShader9** ppShader) override { return m_real->GetPixelShader(ppShader); }
@@ -6744,6 +6668,13 @@ public:
         if (g_constantUploadRecordingEnabled) {
             RecordConstantUpload(ConstantUploadStage_Pixel, shaderKey, StartRegister, Vector4fCount);
         }
+        if (g_apiTraceRecorder.IsRecording()) {
+            g_apiTraceRecorder.RecordShaderConstantsF(ApiTraceStage::Pixel, StartRegister, pConstantData, Vector4fCount);
+        }
+        if (pConstantData && StartRegister < static_cast<UINT>(kMaxConstantRegisters)) {
+            const UINT count = (std::min)(Vector4fCount, static_cast<UINT>(kMaxConstantRegisters) - StartRegister);
+            memcpy(g_psConstants[StartRegister], pConstantData, count * sizeof(g_psConstants[0]));
+        }
         return m_real->SetPixelShaderConstantF(StartRegister, pConstantData, Vector4fCount);
     }
     HRESULT STDMETHODCALLTYPE GetPixelShaderConstantF(UINT StartRegister, float* pConstantData, UINT Vector4fCount) override { return m_real->GetPixelShaderConstantF(StartRegister, pConstantData, Vector4fCount); }
@@ -6789,7 +6720,13 @@ public:
         return m_realEx ? m_realEx->CreateDepthStencilSurfaceEx(Width, Height, Format, MultiSample, MultisampleQuality, Discard, ppSurface, pSharedHandle, Usage) : D3DERR_INVALIDCALL;
     }
     HRESULT STDMETHODCALLTYPE ResetEx(D3DPRESENT_PARAMETERS* pPresentationParameters, D3DDISPLAYMODEEX* pFullscreenDisplayMode) override {
-        return m_realEx ? m_realEx->ResetEx(pPresentationParameters, pFullscreenDisplayMode) : Reset(pPresentationParameters);
+        if (!m_realEx) {
+            return Reset(pPresentationParameters);
+        }
+        BeginDeviceReset();
+        HRESULT hr = m_realEx->ResetEx(pPresentationParameters, pFullscreenDisplayMode);
+        EndDeviceReset(hr);
+        return hr;
     }
     HRESULT STDMETHODCALLTYPE GetDisplayModeEx(UINT iSwapChain, D3DDISPLAYMODEEX* pMode, D3DDISPLAYROTATION* pRotation) override {
         return m_realEx ? m_realEx->GetDisplayModeEx(iSwapChain, pMode, pRotation) : D3DERR_INVALIDCALL;
@@ -6802,6 +6739,12 @@ public:
         : WrappedD3D9Device(real) {}
 };
 
+static void ForgetShaderRecordOnDevices(const ShaderRecord* record) {
+    for (WrappedD3D9Device* device : g_liveDevices) {
+        device->ForgetShaderRecord(record);
+    }
+}
+
 /**
  * Wrapped IDirect3D9 - intercepts CreateDevice to return wrapped devices
  */
@@ -7037,15 +6980,12 @@ void LoadConfig() {
                              MAX_PATH, path);
     g_config.useRemixRuntime = GetPrivateProfileIntA("CameraProxy", "UseRemixRuntime", 1, path) != 0;
     g_config.emitFixedFunctionTransforms = GetPrivateProfileIntA("CameraProxy", "EmitFixedFunctionTransforms", 1, path) != 0;
+    g_config.suppressRedundantTransforms = GetPrivateProfileIntA("CameraProxy", "SuppressRedundantTransforms", 1, path) != 0;
     GetPrivateProfileStringA("CameraProxy", "GameProfile", "", g_config.gameProfile,
                              static_cast<DWORD>(sizeof(g_config.gameProfile)), path);
     g_activeGameProfile = ParseGameProfile(g_config.gameProfile);
-    ConfigureActiveProfileLayout();
-    g_profileCoreRegistersSeen[0] = g_profileCoreRegistersSeen[1] = g_profileCoreRegistersSeen[2] = false;
-    g_profileOptionalRegistersSeen[0] = g_profileOptionalRegistersSeen[1] = false;
-    g_profileViewDerivedFromInverse = false;
+    g_profileState = EngineProfileState();
     g_profileStatusMessage[0] = '\0';
-    g_profileDisableStructuralDetection = false;
     g_barnyardForceWorldFromC0 = GetPrivateProfileIntA("CameraProxy", "BarnyardForceWorldFromC0", 0, path) != 0;
     g_config.barnyardUseGameSetTransformsForViewProjection =
         GetPrivateProfileIntA("CameraProxy", "BarnyardUseGameSetTransformsForViewProjection", 1, path) != 0;
@@ -7082,10 +7022,26 @@ void LoadConfig() {
     g_config.hotkeyTogglePauseVk = GetPrivateProfileIntA("CameraProxy", "HotkeyTogglePauseVK", VK_F9, path);
     g_config.hotkeyEmitMatricesVk = GetPrivateProfileIntA("CameraProxy", "HotkeyEmitMatricesVK", VK_F8, path);
     g_config.hotkeyResetMatrixOverridesVk = GetPrivateProfileIntA("CameraProxy", "HotkeyResetMatrixOverridesVK", VK_F7, path);
+    g_config.hotkeyCaptureTraceVk = GetPrivateProfileIntA("CameraProxy", "HotkeyCaptureTraceVK", VK_F6, path);
+    g_config.traceCaptureFrames = GetPrivateProfileIntA("CameraProxy", "TraceCaptureFrames", 3, path);
+    if (g_config.traceCaptureFrames < 1) g_config.traceCaptureFrames = 1;
+    if (g_config.traceCaptureFrames > 120) g_config.traceCaptureFrames = 120;
+    g_config.apiTraceRecordGolden = GetPrivateProfileIntA("CameraProxy", "ApiTraceRecordGolden", 1, path) != 0;
     g_config.enableCombinedDecomposition = GetPrivateProfileIntA("CameraProxy", "EnableCombinedDecomposition", 1, path) != 0;
     g_config.combinedDecompositionLog = GetPrivateProfileIntA("CameraProxy", "CombinedDecompositionLog", 0, path) != 0;
     g_config.allowGeneratedProjectionForVPDecomposition =
         GetPrivateProfileIntA("CameraProxy", "AllowGeneratedProjectionForVPDecomposition", 0, path) != 0;
+    g_config.enableLayoutFastPath = GetPrivateProfileIntA("CameraProxy", "EnableLayoutFastPath", 1, path) != 0;
+    g_config.layoutLearnFrames = GetPrivateProfileIntA("CameraProxy", "LayoutLearnFrames", 30, path);
+    if (g_config.layoutLearnFrames < 1) g_config.layoutLearnFrames = 1;
+    g_config.enableSimdWindowPrefilter = GetPrivateProfileIntA("CameraProxy", "EnableSimdWindowPrefilter", 1, path) != 0;
+    g_config.deferConstantClassification = GetPrivateProfileIntA("CameraProxy", "DeferConstantClassification", 0, path) != 0;
+    g_config.shaderTransformMap = GetPrivateProfileIntA("CameraProxy", "ShaderTransformMap", 1, path) != 0;
+    g_config.shaderAnalysisThreads = GetPrivateProfileIntA("CameraProxy", "ShaderAnalysisThreads", 2, path);
+    if (g_config.shaderAnalysisThreads < 0) g_config.shaderAnalysisThreads = 0;
+    if (g_config.shaderAnalysisThreads > 8) g_config.shaderAnalysisThreads = 8;
+    g_config.shaderCache = GetPrivateProfileIntA("CameraProxy", "ShaderCache", 1, path) != 0;
+    g_config.trackConstantVariance = GetPrivateProfileIntA("CameraProxy", "TrackConstantVariance", 0, path) != 0;
 
     g_config.experimentalCustomProjectionEnabled =
         GetPrivateProfileIntA("CameraProxy", "ExperimentalCustomProjectionEnabled", 0, path) != 0;
@@ -7159,6 +7115,7 @@ static void EnsureProxyInitialized() {
             LogMsg("Game executable name: %s", g_gameExeName[0] ? g_gameExeName : "<unknown>");
             LogMsg("Game display name: %s", g_gameDisplayName[0] ? g_gameDisplayName : "<unknown>");
         }
+        LoadShaderCache();
         g_hD3D9 = LoadTargetD3D9();
         if (g_config.useRemixRuntime) {
             g_remixLightingManager.Initialize();
@@ -7252,9 +7209,8 @@ BOOL WINAPI DllMain(HINSTANCE hinstDLL, DWORD fdwReason, LPVOID lpvReserved) {
 
 extern "C" {
     __declspec(dllexport) const CameraMatrices* WINAPI Proxy_GetCameraMatrices() {
-        static CameraMatrices snapshot = {};
-        std::lock_guard<std::mutex> lock(g_cameraMatricesMutex);
-        snapshot = g_cameraMatrices;
+        static thread_local CameraMatrices snapshot = {};
+        snapshot = SnapshotCameraMatrices();
         return &snapshot;
     }
 
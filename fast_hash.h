@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// ─── Fast hash ───────────────────────────────────────────────────────────────
+//
+// One 64-bit hash for shader bytecode, matrices, constant payloads and light
+// signatures. It is XXH64: four independent 64-bit lanes consume 32 bytes per
+// step, so multi-KB bytecode hashes a word at a time instead of a byte at a time,
+// and the result has none of the 32-bit FNV-1a collision risk. Header-only,
+// free of Windows/D3D9 dependencies, and identical on every platform
+// (little-endian reads), so the proxy and the offline tools agree on every value.
+// FastHashFold32 gives the 32-bit form for places that store a u32.
+
+namespace fast_hash {
+
+static constexpr uint64_t kPrime1 = 11400714785074694791ull;
+static constexpr uint64_t kPrime2 = 14029467366897019727ull;
+static constexpr uint64_t kPrime3 = 1609587929392839161ull;
+static constexpr uint64_t kPrime4 = 9650029242287828579ull;
+static constexpr uint64_t kPrime5 = 2870177450012600261ull;
+
+inline uint64_t Rotl(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+inline uint64_t Read64(const uint8_t* p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline uint32_t Read32(const uint8_t* p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline uint64_t Round(uint64_t acc, uint64_t input) {
+    acc += input * kPrime2;
+    acc = Rotl(acc, 31);
+    return acc * kPrime1;
+}
+
+inline uint64_t MergeRound(uint64_t acc, uint64_t lane) {
+    acc ^= Round(0, lane);
+    return acc * kPrime1 + kPrime4;
+}
+
+} // namespace fast_hash
+
+inline uint64_t FastHash64(const void* data, size_t size, uint64_t seed = 0) {
+    using namespace fast_hash;
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    const uint8_t* const end = p + size;
+    uint64_t h;
+    if (size >= 32) {
+        uint64_t v1 = seed + kPrime1 + kPrime2;
+        uint64_t v2 = seed + kPrime2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - kPrime1;
+        const uint8_t* const limit = end - 32;
+        do {
+            v1 = Round(v1, Read64(p));
+            v2 = Round(v2, Read64(p + 8));
+            v3 = Round(v3, Read64(p + 16));
+            v4 = Round(v4, Read64(p + 24));
+            p += 32;
+        } while (p <= limit);
+        h = Rotl(v1, 1) + Rotl(v2, 7) + Rotl(v3, 12) + Rotl(v4, 18);
+        h = MergeRound(h, v1);
+        h = MergeRound(h, v2);
+        h = MergeRound(h, v3);
+        h = MergeRound(h, v4);
+    } else {
+        h = seed + kPrime5;
+    }
+    h += static_cast<uint64_t>(size);
+
+    for (; p + 8 <= end; p += 8) {
+        h ^= Round(0, Read64(p));
+        h = Rotl(h, 27) * kPrime1 + kPrime4;
+    }
+    if (p + 4 <= end) {
+        h ^= static_cast<uint64_t>(Read32(p)) * kPrime1;
+        h = Rotl(h, 23) * kPrime2 + kPrime3;
+        p += 4;
+    }
+    for (; p < end; ++p) {
+        h ^= static_cast<uint64_t>(*p) * kPrime5;
+        h = Rotl(h, 11) * kPrime1;
+    }
+
+    h ^= h >> 33;
+    h *= kPrime2;
+    h ^= h >> 29;
+    h *= kPrime3;
+    h ^= h >> 32;
+    return h;
+}
+
+inline uint32_t FastHashFold32(uint64_t hash) {
+    return static_cast<uint32_t>(hash ^ (hash >> 32));
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstdio>
+
+// ─── File I/O ────────────────────────────────────────────────────────────────
+//
+// fopen that keeps MSVC's deprecation warning quiet. Shared by the API trace,
+// golden output and shader cache writers and readers; returns nullptr on failure.
+
+inline FILE* OpenBinaryFile(const char* path, const char* mode) {
+    FILE* file = nullptr;
+#ifdef _MSC_VER
+    if (fopen_s(&file, path, mode) != 0) {
+        file = nullptr;
+    }
+#else
+    file = std::fopen(path, mode);
+#endif
+    return file;
+}
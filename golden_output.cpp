@@ -0,0 +1,197 @@
+#include "golden_output.h"
+#include "fast_hash.h"
+#include "file_io.h"
+
+#include <cstdio>
+#include <cstring>
+
+// ─── helpers ─────────────────────────────────────────────────────────────────
+
+template <typename T>
+static bool WriteColumn(FILE* file, const std::vector<T>& column) {
+    return column.empty() || std::fwrite(column.data(), sizeof(T), column.size(), file) == column.size();
+}
+
+template <typename T>
+static bool ReadColumn(FILE* file, std::vector<T>* column, size_t count) {
+    column->resize(count);
+    return count == 0 || std::fread(column->data(), sizeof(T), count, file) == count;
+}
+
+const char* GoldenSlotName(int slot) {
+    switch (slot) {
+    case 0: return "World";
+    case 1: return "View";
+    case 2: return "Projection";
+    default: return "?";
+    }
+}
+
+uint32_t GoldenShaderHash(const uint32_t* tokens, size_t tokenCount) {
+    return FastHashFold32(FastHash64(tokens, tokenCount * sizeof(uint32_t)));
+}
+
+// ─── GoldenWriter ────────────────────────────────────────────────────────────
+
+GoldenWriter::~GoldenWriter() {
+    Close();
+}
+
+bool GoldenWriter::Open(const char* path, size_t expectedDraws) {
+    if (m_open || !path) {
+        return false;
+    }
+    // Fail now rather than after a long capture.
+    FILE* probe = OpenBinaryFile(path, "wb");
+    if (!probe) {
+        return false;
+    }
+    std::fclose(probe);
+
+    m_path = path;
+    m_frames.clear();
+    m_shaderHashes.clear();
+    m_masks.clear();
+    m_frames.reserve(expectedDraws);
+    m_shaderHashes.reserve(expectedDraws);
+    m_masks.reserve(expectedDraws);
+    for (int slot = 0; slot < kGoldenSlotCount; ++slot) {
+        m_sourceRegisters[slot].clear();
+        m_sourceRegisters[slot].reserve(expectedDraws);
+        m_matrices[slot].clear();
+        m_matrices[slot].reserve(expectedDraws * 4);
+        m_hasLastMatrix[slot] = false;
+    }
+    m_open = true;
+    return true;
+}
+
+void GoldenWriter::Append(const GoldenDraw& draw) {
+    if (!m_open) {
+        return;
+    }
+    uint8_t mask = 0;
+    for (int slot = 0; slot < kGoldenSlotCount; ++slot) {
+        int16_t sourceRegister = -1;
+        if (draw.bound[slot]) {
+            mask |= static_cast<uint8_t>(1u << slot);
+            sourceRegister = static_cast<int16_t>(draw.sourceRegister[slot]);
+            if (!m_hasLastMatrix[slot] ||
+                memcmp(m_lastMatrix[slot], draw.matrices[slot], sizeof(m_lastMatrix[slot])) != 0) {
+                mask |= static_cast<uint8_t>(1u << (3 + slot));
+                m_matrices[slot].insert(m_matrices[slot].end(), draw.matrices[slot], draw.matrices[slot] + 16);
+                memcpy(m_lastMatrix[slot], draw.matrices[slot], sizeof(m_lastMatrix[slot]));
+                m_hasLastMatrix[slot] = true;
+            }
+        }
+        m_sourceRegisters[slot].push_back(sourceRegister);
+    }
+    m_frames.push_back(draw.frame);
+    m_shaderHashes.push_back(draw.shaderHash);
+    m_masks.push_back(mask);
+}
+
+bool GoldenWriter::Close() {
+    if (!m_open) {
+        return false;
+    }
+    m_open = false;
+    FILE* file = OpenBinaryFile(m_path.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    GoldenFileHeader header;
+    header.drawCount = m_frames.size();
+    bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1;
+    ok = ok && WriteColumn(file, m_frames);
+    ok = ok && WriteColumn(file, m_shaderHashes);
+    ok = ok && WriteColumn(file, m_masks);
+    for (int slot = 0; slot < kGoldenSlotCount; ++slot) {
+        ok = ok && WriteColumn(file, m_sourceRegisters[slot]);
+    }
+    for (int slot = 0; slot < kGoldenSlotCount; ++slot) {
+        ok = ok && WriteColumn(file, m_matrices[slot]);
+    }
+    ok = (std::fclose(file) == 0) && ok;
+    return ok;
+}
+
+// ─── GoldenReader ────────────────────────────────────────────────────────────
+
+bool GoldenReader::Load(const char* path) {
+    FILE* file = path ? OpenBinaryFile(path, "rb") : nullptr;
+    if (!file) {
+        return false;
+    }
+    GoldenFileHeader header;
+    bool ok = std::fread(&header, sizeof(header), 1, file) == 1 &&
+              header.magic == kGoldenMagic && header.version == kGoldenVersion;
+    // Every draw costs its fixed columns, so a drawCount the remaining bytes cannot hold
+    // is corrupt; checking before the resizes keeps a bad header from allocating.
+    long payloadBytes = -1;
+    if (ok && std::fseek(file, 0, SEEK_END) == 0) {
+        payloadBytes = std::ftell(file) - static_cast<long>(sizeof(header));
+        ok = payloadBytes >= 0 && std::fseek(file, static_cast<long>(sizeof(header)), SEEK_SET) == 0;
+    } else {
+        ok = false;
+    }
+    const size_t drawBytes = sizeof(uint32_t) * 2 + sizeof(uint8_t) + sizeof(int16_t) * kGoldenSlotCount;
+    ok = ok && header.drawCount <= static_cast<uint64_t>(payloadBytes) / drawBytes;
+    const size_t count = ok ? static_cast<size_t>(header.drawCount) : 0;
+    ok = ok && ReadColumn(file, &m_frames, count);
+    ok = ok && ReadColumn(file, &m_shaderHashes, count);
+    ok = ok && ReadColumn(file, &m_masks, count);
+    for (int slot = 0; slot < kGoldenSlotCount; ++slot) {
+        ok = ok && ReadColumn(file, &m_sourceRegisters[slot], count);
+    }
+    for (int slot = 0; ok && slot < kGoldenSlotCount; ++slot) {
+        // A slot bound before its first stored matrix has nothing to point at.
+        size_t stored = 0;
+        for (uint8_t mask : m_masks) {
+            if (mask & (1u << (3 + slot))) {
+                stored++;
+            } else if ((mask & (1u << slot)) && stored == 0) {
+                ok = false;
+                break;
+            }
+        }
+        ok = ok && ReadColumn(file, &m_matrices[slot], stored * 16);
+    }
+    std::fclose(file);
+    if (!ok) {
+        m_frames.clear();
+        return false;
+    }
+
+    for (int slot = 0; slot < kGoldenSlotCount; ++slot) {
+        std::vector<uint32_t>& offsets = m_matrixOffsets[slot];
+        offsets.assign(count, 0);
+        uint32_t next = 0;
+        uint32_t current = 0;
+        for (size_t i = 0; i < count; ++i) {
+            if (m_masks[i] & (1u << (3 + slot))) {
+                current = next;
+                next += 16;
+            }
+            offsets[i] = current;
+        }
+    }
+    return true;
+}
+
+void GoldenReader::GetDraw(size_t index, GoldenDraw* out) const {
+    if (!out || index >= m_frames.size()) {
+        return;
+    }
+    *out = GoldenDraw();
+    out->frame = m_frames[index];
+    out->shaderHash = m_shaderHashes[index];
+    for (int slot = 0; slot < kGoldenSlotCount; ++slot) {
+        out->sourceRegister[slot] = m_sourceRegisters[slot][index];
+        if (m_masks[index] & (1u << slot)) {
+            out->bound[slot] = true;
+            memcpy(out->matrices[slot], m_matrices[slot].data() + m_matrixOffsets[slot][index],
+                   sizeof(out->matrices[slot]));
+        }
+    }
+}
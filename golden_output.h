@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// ─── File format ─────────────────────────────────────────────────────────────
+//
+// A .cpgd file holds the World/View/Projection bound for every draw of one run,
+// stored column by column so identical runs compress well and the diff tool can
+// scan one column without touching the others. Little-endian throughout.
+//
+//   GoldenFileHeader
+//   u32 frame[drawCount]
+//   u32 shaderHash[drawCount]        FastHashFold32(FastHash64) of the vertex shader
+//                                    bytecode, 0 = none
+//   u8  mask[drawCount]              bit s = slot s bound, bit 3+s = slot s matrix
+//                                    differs from the previous one bound for s
+//   i16 sourceRegister[3][drawCount] -1 = not bound or not from a shader register
+//   f32 matrix[16] per set 3+s bit, slot 0 first, then slot 1, then slot 2
+//
+// Slots are 0 = World, 1 = View, 2 = Projection. A bound matrix that equals the
+// previous one for its slot is not stored again.
+
+static constexpr uint32_t kGoldenMagic = 0x44475043u; // "CPGD"
+static constexpr uint32_t kGoldenVersion = 2;
+static constexpr int kGoldenSlotCount = 3;
+
+struct GoldenFileHeader {
+    uint32_t magic     = kGoldenMagic;
+    uint32_t version   = kGoldenVersion;
+    uint64_t drawCount = 0;
+};
+
+// What one draw bound, whether or not the SetTransform itself was suppressed as
+// redundant.
+struct GoldenDraw {
+    uint32_t frame = 0;
+    uint32_t shaderHash = 0;
+    bool bound[kGoldenSlotCount] = {};
+    int sourceRegister[kGoldenSlotCount] = { -1, -1, -1 };
+    float matrices[kGoldenSlotCount][16] = {};
+};
+
+const char* GoldenSlotName(int slot);
+
+// Same hash the proxy stores per vertex shader, so runs recorded live and runs
+// replayed offline agree on shader identity.
+uint32_t GoldenShaderHash(const uint32_t* tokens, size_t tokenCount);
+
+// ─── Writer ──────────────────────────────────────────────────────────────────
+
+// Columns are kept in memory and written by Close(); Append() only pushes into
+// vectors reserved up front.
+class GoldenWriter {
+public:
+    ~GoldenWriter();
+
+    bool Open(const char* path, size_t expectedDraws = 1u << 16);
+    // Writes the file. Returns false if it could not be written completely.
+    bool Close();
+    bool IsOpen() const { return m_open; }
+    uint64_t GetDrawCount() const { return m_frames.size(); }
+
+    void Append(const GoldenDraw& draw);
+
+private:
+    bool m_open = false;
+    std::string m_path;
+    std::vector<uint32_t> m_frames;
+    std::vector<uint32_t> m_shaderHashes;
+    std::vector<uint8_t> m_masks;
+    std::vector<int16_t> m_sourceRegisters[kGoldenSlotCount];
+    std::vector<float> m_matrices[kGoldenSlotCount];
+    float m_lastMatrix[kGoldenSlotCount][16] = {};
+    bool m_hasLastMatrix[kGoldenSlotCount] = {};
+};
+
+// ─── Reader ──────────────────────────────────────────────────────────────────
+
+class GoldenReader {
+public:
+    // Loads the whole file. Returns false if it is missing, of another version or truncated.
+    bool Load(const char* path);
+    uint64_t GetDrawCount() const { return m_frames.size(); }
+    void GetDraw(size_t index, GoldenDraw* out) const;
+
+private:
+    std::vector<uint32_t> m_frames;
+    std::vector<uint32_t> m_shaderHashes;
+    std::vector<uint8_t> m_masks;
+    std::vector<int16_t> m_sourceRegisters[kGoldenSlotCount];
+    std::vector<float> m_matrices[kGoldenSlotCount];
+    // Per draw, the offset (in floats) of the matrix bound for each slot.
+    std::vector<uint32_t> m_matrixOffsets[kGoldenSlotCount];
+};
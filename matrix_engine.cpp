@@ -0,0 +1,2273 @@
+#include "matrix_engine.h"
+#include "fast_hash.h"
+#include "matrix_kernels.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+
+namespace matrix_engine {
+
+// ─── helpers ─────────────────────────────────────────────────────────────────
+
+using matrix_kernels::Dot3;
+
+static bool IsLikelyBoneTransform(const EngineMatrix& m,
+                                  int rows,
+                                  uint32_t vectorCountInUpload,
+                                  uint32_t uploadStartReg,
+                                  uint32_t candidateBaseReg) {
+    if (!IsAffineMatrixNoPerspective(m)) {
+        return false;
+    }
+
+    const float r0 = sqrtf(Dot3(m._11, m._12, m._13, m._11, m._12, m._13));
+    const float r1 = sqrtf(Dot3(m._21, m._22, m._23, m._21, m._22, m._23));
+    const float r2 = sqrtf(Dot3(m._31, m._32, m._33, m._31, m._32, m._33));
+    const bool nearUnitRows = fabsf(r0 - 1.0f) < 0.25f && fabsf(r1 - 1.0f) < 0.25f && fabsf(r2 - 1.0f) < 0.25f;
+
+    const bool appearsInPaletteUpload =
+        vectorCountInUpload >= 8 &&
+        candidateBaseReg >= uploadStartReg &&
+        (candidateBaseReg + static_cast<uint32_t>(rows)) <= (uploadStartReg + vectorCountInUpload);
+
+    return nearUnitRows && appearsInPaletteUpload;
+}
+
+static bool InvertDerived(MatrixDerivationCache* derivations, uint32_t key,
+                          const EngineMatrix& in, EngineMatrix* out) {
+    if (derivations) {
+        return derivations->Invert(key, in, out);
+    }
+    return InvertMatrix4x4Deterministic(in, out, nullptr);
+}
+
+static EngineMatrix MultiplyDerived(MatrixDerivationCache* derivations,
+                                    uint32_t leftKey, const EngineMatrix& left,
+                                    uint32_t rightKey, const EngineMatrix& right) {
+    if (derivations) {
+        return derivations->Multiply(leftKey, left, rightKey, right);
+    }
+    return MultiplyMatrix(left, right);
+}
+
+static bool TrySolveFromInverseLeftMultiply(const EngineMatrix& known,
+                                            const EngineMatrix& combined,
+                                            EngineMatrix* out,
+                                            MatrixDerivationCache* derivations,
+                                            uint32_t knownKey) {
+    if (!out) return false;
+    EngineMatrix inv = {};
+    if (!InvertDerived(derivations, knownKey, known, &inv)) {
+        return false;
+    }
+    *out = MultiplyMatrix(inv, combined);
+    return true;
+}
+
+static bool TrySolveFromInverseRightMultiply(const EngineMatrix& combined,
+                                             const EngineMatrix& knownRight,
+                                             EngineMatrix* out,
+                                             MatrixDerivationCache* derivations,
+                                             uint32_t knownRightKey) {
+    if (!out) return false;
+    EngineMatrix inv = {};
+    if (!InvertDerived(derivations, knownRightKey, knownRight, &inv)) {
+        return false;
+    }
+    *out = MultiplyMatrix(combined, inv);
+    return true;
+}
+
+static bool IsWorldCandidateForDecomposition(const EngineMatrix& m) {
+    if (!IsFiniteMatrix(m) || !IsAffineMatrixNoPerspective(m)) return false;
+    const float det = Determinant3x3(m);
+    return std::isfinite(det) && fabsf(det) > 0.0001f;
+}
+
+static bool IsViewCandidateForDecomposition(const EngineMatrix& m) {
+    return IsFiniteMatrix(m) && LooksLikeViewStrict(m);
+}
+
+static bool IsProjectionCandidateForDecomposition(const EngineMatrix& m) {
+    return IsFiniteMatrix(m) && LooksLikeProjectionStrict(m);
+}
+
+// ─── matrix math ─────────────────────────────────────────────────────────────
+
+EngineMatrix IdentityMatrix() {
+    EngineMatrix out = {};
+    out._11 = out._22 = out._33 = out._44 = 1.0f;
+    return out;
+}
+
+EngineMatrix TransposeMatrix(const EngineMatrix& mat) {
+    EngineMatrix out;
+    matrix_kernels::Transpose(&mat._11, &out._11);
+    return out;
+}
+
+EngineMatrix MultiplyMatrix(const EngineMatrix& a, const EngineMatrix& b) {
+    EngineMatrix out;
+    matrix_kernels::Multiply(&a._11, &b._11, &out._11);
+    return out;
+}
+
+EngineMatrix InvertSimpleRigidView(const EngineMatrix& view) {
+    EngineMatrix out;
+    matrix_kernels::InvertRigid(&view._11, &out._11);
+    return out;
+}
+
+bool InvertMatrix4x4Deterministic(const EngineMatrix& in, EngineMatrix* out, float* outDeterminant) {
+    if (!out) {
+        return false;
+    }
+    return matrix_kernels::Invert4x4(&in._11, &out->_11, outDeterminant);
+}
+
+float Determinant3x3(const EngineMatrix& m) {
+    return m._11 * (m._22 * m._33 - m._23 * m._32) -
+           m._12 * (m._21 * m._33 - m._23 * m._31) +
+           m._13 * (m._21 * m._32 - m._22 * m._31);
+}
+
+bool IsFiniteMatrix(const EngineMatrix& m) {
+    const float* v = reinterpret_cast<const float*>(&m);
+    for (int i = 0; i < 16; ++i) {
+        if (!std::isfinite(v[i])) return false;
+    }
+    return true;
+}
+
+float MatrixMaxAbsDiff(const EngineMatrix& a, const EngineMatrix& b) {
+    return matrix_kernels::MaxAbsDiff(&a._11, &b._11);
+}
+
+void OrthonormalizeViewMatrix(EngineMatrix* view) {
+    if (!view) {
+        return;
+    }
+    matrix_kernels::OrthonormalizeView(&view->_11);
+}
+
+// ─── classification ──────────────────────────────────────────────────────────
+
+bool LooksLikeViewStrict(const EngineMatrix& m) {
+    float row0len = sqrtf(Dot3(m._11, m._12, m._13, m._11, m._12, m._13));
+    float row1len = sqrtf(Dot3(m._21, m._22, m._23, m._21, m._22, m._23));
+    float row2len = sqrtf(Dot3(m._31, m._32, m._33, m._31, m._32, m._33));
+
+    if (fabsf(row0len - 1.0f) > 0.05f) return false;
+    if (fabsf(row1len - 1.0f) > 0.05f) return false;
+    if (fabsf(row2len - 1.0f) > 0.05f) return false;
+
+    if (fabsf(Dot3(m._11, m._12, m._13, m._21, m._22, m._23)) > 0.05f) return false;
+    if (fabsf(Dot3(m._11, m._12, m._13, m._31, m._32, m._33)) > 0.05f) return false;
+    if (fabsf(Dot3(m._21, m._22, m._23, m._31, m._32, m._33)) > 0.05f) return false;
+
+    if (fabsf(m._14) > 0.01f || fabsf(m._24) > 0.01f || fabsf(m._34) > 0.01f) return false;
+    if (fabsf(m._44 - 1.0f) > 0.01f) return false;
+
+    float det = Determinant3x3(m);
+    if (fabsf(det - 1.0f) > 0.1f) return false;
+
+    return true;
+}
+
+bool AnalyzeProjectionMatrixNumeric(const EngineMatrix& m, ProjectionAnalysis* out) {
+    constexpr float kZeroEpsilon = 0.02f;
+    constexpr float kPerspectiveEpsilon = 0.05f;
+
+    if (!std::isfinite(m._11) || !std::isfinite(m._22) || !std::isfinite(m._33) ||
+        !std::isfinite(m._34) || !std::isfinite(m._43) || !std::isfinite(m._44)) {
+        return false;
+    }
+
+    if (fabsf(m._12) > kZeroEpsilon || fabsf(m._13) > kZeroEpsilon ||
+        fabsf(m._21) > kZeroEpsilon || fabsf(m._23) > kZeroEpsilon ||
+        fabsf(m._31) > kZeroEpsilon || fabsf(m._32) > kZeroEpsilon) {
+        return false;
+    }
+
+    if (fabsf(m._14) > kZeroEpsilon || fabsf(m._24) > kZeroEpsilon) {
+        return false;
+    }
+
+    if (fabsf(fabsf(m._34) - 1.0f) > kPerspectiveEpsilon) {
+        return false;
+    }
+
+    if (fabsf(m._44) > kPerspectiveEpsilon) {
+        return false;
+    }
+
+    if (fabsf(m._11) < 0.001f || fabsf(m._22) < 0.001f) {
+        return false;
+    }
+
+    if (fabsf(m._33) < 0.0001f || fabsf(m._43) < 0.0001f) {
+        return false;
+    }
+
+    const float fov = 2.0f * atanf(1.0f / fabsf(m._22));
+    if (!std::isfinite(fov) || fov < 0.01f || fov > 3.13f) {
+        return false;
+    }
+
+    if (out) {
+        out->valid = true;
+        out->fovRadians = fov;
+        out->handedness = (m._34 >= 0.0f) ? ProjectionHandedness_Left : ProjectionHandedness_Right;
+    }
+    return true;
+}
+
+bool LooksLikeProjectionStrict(const EngineMatrix& m) {
+    return AnalyzeProjectionMatrixNumeric(m, nullptr);
+}
+
+bool HasPerspectiveComponent(const EngineMatrix& m) {
+    return fabsf(m._34) > 0.5f && fabsf(m._44) < 0.5f;
+}
+
+bool IsAffineMatrixNoPerspective(const EngineMatrix& m) {
+    return fabsf(m._14) < 0.02f && fabsf(m._24) < 0.02f && fabsf(m._34) < 0.02f && fabsf(m._44 - 1.0f) < 0.02f;
+}
+
+bool LooksLikeWorldStrict(const EngineMatrix& m,
+                          int rows,
+                          uint32_t vectorCountInUpload,
+                          uint32_t uploadStartReg,
+                          uint32_t candidateBaseReg) {
+    if (!IsAffineMatrixNoPerspective(m)) return false;
+    if (LooksLikeViewStrict(m)) return false;
+
+    const float det = Determinant3x3(m);
+    if (!std::isfinite(det) || fabsf(det) < 0.0001f) return false;
+
+    if (IsLikelyBoneTransform(m, rows, vectorCountInUpload, uploadStartReg, candidateBaseReg)) {
+        return false;
+    }
+    return true;
+}
+
+MatrixClassification ClassifyMatrixDeterministic(const EngineMatrix& m,
+                                                 int rows,
+                                                 uint32_t vectorCountInUpload,
+                                                 uint32_t uploadStartReg,
+                                                 uint32_t candidateBaseReg) {
+    if (LooksLikeProjectionStrict(m)) {
+        return MatrixClass_Projection;
+    }
+    if (HasPerspectiveComponent(m)) {
+        return MatrixClass_CombinedPerspective;
+    }
+    if (LooksLikeViewStrict(m)) {
+        return MatrixClass_View;
+    }
+    if (LooksLikeWorldStrict(m, rows, vectorCountInUpload, uploadStartReg, candidateBaseReg)) {
+        return MatrixClass_World;
+    }
+    return MatrixClass_None;
+}
+
+MatrixGatherFn SelectMatrixGather(int rows, bool transposed) {
+    static const MatrixGatherFn kGathers[2][2] = {
+        { GatherMatrix<3, false>, GatherMatrix<3, true> },
+        { GatherMatrix<4, false>, GatherMatrix<4, true> },
+    };
+    if (rows < 3 || rows > 4) {
+        return nullptr;
+    }
+    return kGathers[rows - 3][transposed ? 1 : 0];
+}
+
+bool TryBuildMatrixFromConstantUpdate(const float* constantData,
+                                      uint32_t startRegister,
+                                      uint32_t vector4fCount,
+                                      int baseRegister,
+                                      int rows,
+                                      bool transposed,
+                                      EngineMatrix* outMatrix) {
+    if (!constantData || !outMatrix || rows < 3 || rows > 4) {
+        return false;
+    }
+    if (baseRegister < 0) {
+        return false;
+    }
+    if (startRegister > static_cast<uint32_t>(baseRegister) ||
+        startRegister + vector4fCount < static_cast<uint32_t>(baseRegister + rows)) {
+        return false;
+    }
+
+    const float* m = constantData + (baseRegister - static_cast<int>(startRegister)) * 4;
+    SelectMatrixGather(rows, transposed)(m, m + 4, m + 8, m + 12, outMatrix);
+    return true;
+}
+
+bool IsThreeRowPrefixOfPerspectiveMatrix(const float* data,
+                                         uint32_t startReg,
+                                         uint32_t vectorCount,
+                                         uint32_t candidateBaseReg,
+                                         bool transposedLayout) {
+    if (!data || vectorCount < 4) {
+        return false;
+    }
+    if (candidateBaseReg < startReg) {
+        return false;
+    }
+
+    const uint32_t offset = candidateBaseReg - startReg;
+    if (offset + 4 > vectorCount) {
+        return false;
+    }
+
+    const float* m = data + offset * 4;
+    EngineMatrix candidate4x4;
+    if (transposedLayout) {
+        GatherMatrix<4, true>(m, m + 4, m + 8, m + 12, &candidate4x4);
+    } else {
+        GatherMatrix<4, false>(m, m + 4, m + 8, m + 12, &candidate4x4);
+    }
+
+    const MatrixClassification directClass = ClassifyMatrixDeterministic(
+        candidate4x4,
+        4,
+        vectorCount,
+        startReg,
+        candidateBaseReg);
+    if (directClass == MatrixClass_Projection || directClass == MatrixClass_CombinedPerspective) {
+        return true;
+    }
+
+    const EngineMatrix transposed = TransposeMatrix(candidate4x4);
+    const MatrixClassification transposedClass = ClassifyMatrixDeterministic(
+        transposed,
+        4,
+        vectorCount,
+        startReg,
+        candidateBaseReg);
+    return transposedClass == MatrixClass_Projection ||
+           transposedClass == MatrixClass_CombinedPerspective;
+}
+
+StructuralWindowResult ClassifyStructuralWindow(const float* data,
+                                                uint32_t startReg,
+                                                uint32_t vectorCount,
+                                                uint32_t offset,
+                                                uint32_t rows,
+                                                const StructuralProbeOptions& probes) {
+    StructuralWindowResult result = {};
+    const uint32_t baseReg = startReg + offset;
+    const MatrixGatherFn gather = SelectMatrixGather(static_cast<int>(rows), false);
+    if (!data || !gather || offset + rows > vectorCount) {
+        return result;
+    }
+    const float* m = data + offset * 4;
+    EngineMatrix mat;
+    gather(m, m + 4, m + 8, m + 12, &mat);
+
+    MatrixClassification directClass = ClassifyMatrixDeterministic(mat, static_cast<int>(rows), vectorCount, startReg, baseReg);
+    if (directClass == MatrixClass_None && probes.transposedLayouts) {
+        EngineMatrix t = TransposeMatrix(mat);
+        MatrixClassification transposedClass = ClassifyMatrixDeterministic(t, static_cast<int>(rows), vectorCount, startReg, baseReg);
+        if (transposedClass != MatrixClass_None) {
+            mat = t;
+            result.transposed = true;
+        }
+    }
+
+    MatrixClassification finalClass = ClassifyMatrixDeterministic(mat, static_cast<int>(rows), vectorCount, startReg, baseReg);
+    if (rows == 3u &&
+        (finalClass == MatrixClass_View || finalClass == MatrixClass_World) &&
+        IsThreeRowPrefixOfPerspectiveMatrix(data, startReg, vectorCount, baseReg, result.transposed)) {
+        finalClass = MatrixClass_None;
+    }
+    result.directClass = result.transposed ? MatrixClass_None : finalClass;
+    if (probes.inverseView && rows == 4u &&
+        (finalClass == MatrixClass_None || finalClass == MatrixClass_View)) {
+        const float row0Len = sqrtf(Dot3(mat._11, mat._12, mat._13, mat._11, mat._12, mat._13));
+        const float row1Len = sqrtf(Dot3(mat._21, mat._22, mat._23, mat._21, mat._22, mat._23));
+        const float row2Len = sqrtf(Dot3(mat._31, mat._32, mat._33, mat._31, mat._32, mat._33));
+        const bool orthonormal =
+            fabsf(row0Len - 1.0f) < 0.05f &&
+            fabsf(row1Len - 1.0f) < 0.05f &&
+            fabsf(row2Len - 1.0f) < 0.05f &&
+            fabsf(Dot3(mat._11, mat._12, mat._13, mat._21, mat._22, mat._23)) < 0.05f &&
+            fabsf(Dot3(mat._11, mat._12, mat._13, mat._31, mat._32, mat._33)) < 0.05f &&
+            fabsf(Dot3(mat._21, mat._22, mat._23, mat._31, mat._32, mat._33)) < 0.05f;
+        if (orthonormal) {
+            const EngineMatrix invCandidate = InvertSimpleRigidView(mat);
+            MatrixClassification inverseClass = ClassifyMatrixDeterministic(invCandidate, static_cast<int>(rows), vectorCount, startReg, baseReg);
+            if (finalClass == MatrixClass_None && inverseClass == MatrixClass_View) {
+                finalClass = inverseClass;
+                result.invertedByClass = true;
+            }
+            result.resolveInverseConsistency = (finalClass == MatrixClass_View);
+        }
+    }
+    result.finalClass = finalClass;
+    return result;
+}
+
+// ─── SSE2 window prefilter ───────────────────────────────────────────────────
+//
+// Necessary conditions for ClassifyStructuralWindow to return anything but None,
+// evaluated for four windows at once. Each gate is loosened by a margin so SIMD
+// rounding can never reject a window the scalar path accepts.
+
+#if MATRIX_KERNELS_SSE2
+
+static inline __m128 AbsPs(__m128 v) {
+    return _mm_and_ps(v, _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF)));
+}
+
+static inline __m128 InRangePs(__m128 v, float lo, float hi) {
+    return _mm_and_ps(_mm_cmpgt_ps(v, _mm_set1_ps(lo)), _mm_cmplt_ps(v, _mm_set1_ps(hi)));
+}
+
+static inline __m128 PerspectiveColumnGatePs(__m128 c2, __m128 c3) {
+    return _mm_and_ps(_mm_cmpgt_ps(AbsPs(c2), _mm_set1_ps(0.49f)),
+                      _mm_cmplt_ps(AbsPs(c3), _mm_set1_ps(0.51f)));
+}
+
+static inline __m128 AffineColumnGatePs(__m128 c0, __m128 c1, __m128 c2, __m128 c3) {
+    const __m128 eps = _mm_set1_ps(0.021f);
+    __m128 ok = _mm_cmplt_ps(AbsPs(c0), eps);
+    ok = _mm_and_ps(ok, _mm_cmplt_ps(AbsPs(c1), eps));
+    ok = _mm_and_ps(ok, _mm_cmplt_ps(AbsPs(c2), eps));
+    return _mm_and_ps(ok, _mm_cmplt_ps(AbsPs(_mm_sub_ps(c3, _mm_set1_ps(1.0f))), eps));
+}
+
+static inline __m128 UnitBasisGatePs(__m128 n0, __m128 n1, __m128 n2) {
+    return _mm_and_ps(_mm_and_ps(InRangePs(n0, 0.89f, 1.12f), InRangePs(n1, 0.89f, 1.12f)),
+                      InRangePs(n2, 0.89f, 1.12f));
+}
+
+static inline __m128 WorldBasisGatePs(__m128 n0, __m128 n1, __m128 n2, __m128 absDet, bool paletteUpload) {
+    __m128 ok = _mm_cmpge_ps(absDet, _mm_set1_ps(0.9e-4f));
+    if (paletteUpload) {
+        const __m128 clearlyBone = _mm_and_ps(_mm_and_ps(InRangePs(n0, 0.58f, 1.54f), InRangePs(n1, 0.58f, 1.54f)),
+                                              InRangePs(n2, 0.58f, 1.54f));
+        ok = _mm_andnot_ps(clearlyBone, ok);
+    }
+    return ok;
+}
+
+#endif
+
+void BuildStructuralCandidateMask(const float* data,
+                                  uint32_t vectorCount,
+                                  uint32_t rows,
+                                  const StructuralProbeOptions& probes,
+                                  bool* outCandidates) {
+    if (vectorCount < rows) {
+        return;
+    }
+    const uint32_t windowCount = vectorCount - rows + 1;
+    for (uint32_t i = 0; i < windowCount; ++i) {
+        outCandidates[i] = true;
+    }
+#if MATRIX_KERNELS_SSE2
+    const bool paletteUpload = vectorCount >= 8;
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 finiteLimit = _mm_set1_ps(FLT_MAX);
+
+    // Lane j of block `offset` is the window starting at register offset + j, so row r of
+    // those four windows lives in registers offset + r .. offset + r + 3.
+    for (uint32_t offset = 0; offset + 3 + rows <= vectorCount; offset += 4) {
+        // A 3-row window keeps the identity fourth row the scalar gather adds.
+        __m128 x[4], y[4], z[4], w[4];
+        x[3] = zero; y[3] = zero; z[3] = zero; w[3] = one;
+        for (uint32_t r = 0; r < rows; ++r) {
+            const float* base = data + (offset + r) * 4;
+            x[r] = _mm_loadu_ps(base);
+            y[r] = _mm_loadu_ps(base + 4);
+            z[r] = _mm_loadu_ps(base + 8);
+            w[r] = _mm_loadu_ps(base + 12);
+            _MM_TRANSPOSE4_PS(x[r], y[r], z[r], w[r]);
+        }
+
+        __m128 finite = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (uint32_t r = 0; r < rows; ++r) {
+            finite = _mm_and_ps(finite, _mm_cmple_ps(AbsPs(x[r]), finiteLimit));
+            finite = _mm_and_ps(finite, _mm_cmple_ps(AbsPs(y[r]), finiteLimit));
+            finite = _mm_and_ps(finite, _mm_cmple_ps(AbsPs(z[r]), finiteLimit));
+            finite = _mm_and_ps(finite, _mm_cmple_ps(AbsPs(w[r]), finiteLimit));
+        }
+
+        __m128 rowNorm[3], colNorm[3];
+        for (int r = 0; r < 3; ++r) {
+            rowNorm[r] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x[r], x[r]), _mm_mul_ps(y[r], y[r])), _mm_mul_ps(z[r], z[r]));
+        }
+        colNorm[0] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x[0], x[0]), _mm_mul_ps(x[1], x[1])), _mm_mul_ps(x[2], x[2]));
+        colNorm[1] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(y[0], y[0]), _mm_mul_ps(y[1], y[1])), _mm_mul_ps(y[2], y[2]));
+        colNorm[2] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(z[0], z[0]), _mm_mul_ps(z[1], z[1])), _mm_mul_ps(z[2], z[2]));
+        const __m128 det = _mm_add_ps(
+            _mm_sub_ps(_mm_mul_ps(x[0], _mm_sub_ps(_mm_mul_ps(y[1], z[2]), _mm_mul_ps(z[1], y[2]))),
+                       _mm_mul_ps(y[0], _mm_sub_ps(_mm_mul_ps(x[1], z[2]), _mm_mul_ps(z[1], x[2])))),
+            _mm_mul_ps(z[0], _mm_sub_ps(_mm_mul_ps(x[1], y[2]), _mm_mul_ps(y[1], x[2]))));
+        const __m128 absDet = AbsPs(det);
+
+        const __m128 directGate = _mm_or_ps(
+            PerspectiveColumnGatePs(w[2], w[3]),
+            _mm_and_ps(AffineColumnGatePs(w[0], w[1], w[2], w[3]),
+                       _mm_or_ps(UnitBasisGatePs(rowNorm[0], rowNorm[1], rowNorm[2]),
+                                 WorldBasisGatePs(rowNorm[0], rowNorm[1], rowNorm[2], absDet, paletteUpload))));
+        __m128 candidate = _mm_or_ps(_mm_andnot_ps(finite, _mm_castsi128_ps(_mm_set1_epi32(-1))), directGate);
+
+        if (probes.transposedLayouts) {
+            // The transposed candidate's fourth column is the upload's fourth row.
+            const __m128 transposedBasis = _mm_or_ps(UnitBasisGatePs(colNorm[0], colNorm[1], colNorm[2]),
+                                                     WorldBasisGatePs(colNorm[0], colNorm[1], colNorm[2], absDet, paletteUpload));
+            const __m128 transposedGate = _mm_or_ps(
+                PerspectiveColumnGatePs(z[3], w[3]),
+                _mm_and_ps(AffineColumnGatePs(x[3], y[3], z[3], w[3]), transposedBasis));
+            candidate = _mm_or_ps(candidate, transposedGate);
+        }
+        if (probes.inverseView && rows == 4) {
+            candidate = _mm_or_ps(candidate, UnitBasisGatePs(rowNorm[0], rowNorm[1], rowNorm[2]));
+            candidate = _mm_or_ps(candidate, UnitBasisGatePs(colNorm[0], colNorm[1], colNorm[2]));
+        }
+
+        const int laneMask = _mm_movemask_ps(candidate);
+        for (uint32_t lane = 0; lane < 4; ++lane) {
+            outCandidates[offset + lane] = (laneMask & (1 << lane)) != 0;
+        }
+    }
+#else
+    (void)data;
+    (void)probes;
+#endif
+}
+
+// ─── composition checks ──────────────────────────────────────────────────────
+
+bool CrossValidateViewAgainstProjection(const EngineMatrix& candidateView,
+                                        const EngineMatrix& knownProjection) {
+    EngineMatrix vp = MultiplyMatrix(candidateView, knownProjection);
+
+    const float p_c0 = sqrtf(
+        knownProjection._11 * knownProjection._11 +
+        knownProjection._21 * knownProjection._21 +
+        knownProjection._31 * knownProjection._31);
+    const float p_c1 = sqrtf(
+        knownProjection._12 * knownProjection._12 +
+        knownProjection._22 * knownProjection._22 +
+        knownProjection._32 * knownProjection._32);
+    const float vp_c0 = sqrtf(
+        vp._11 * vp._11 + vp._21 * vp._21 + vp._31 * vp._31);
+    const float vp_c1 = sqrtf(
+        vp._12 * vp._12 + vp._22 * vp._22 + vp._32 * vp._32);
+
+    if (p_c0 < 1e-6f || p_c1 < 1e-6f) {
+        return true;
+    }
+
+    constexpr float kTol = 0.15f;
+    return (fabsf(vp_c0 - p_c0) / p_c0 < kTol) &&
+           (fabsf(vp_c1 - p_c1) / p_c1 < kTol);
+}
+
+ViewCandidateConsistency ResolveViewInverseConsistency(const EngineMatrix& originalView,
+                                                       const EngineMatrix& inverseView,
+                                                       const EngineMatrix* knownProjection,
+                                                       bool hasProjection,
+                                                       const EngineMatrix* knownWorld,
+                                                       bool hasWorld,
+                                                       const EngineMatrix* knownVP,
+                                                       bool hasVP,
+                                                       const EngineMatrix* knownWV,
+                                                       bool hasWV,
+                                                       const EngineMatrix* knownMVP,
+                                                       bool hasMVP) {
+    constexpr float kTolerance = 0.08f;
+    constexpr float kEdge = 0.02f;
+
+    int originalVotes = 0;
+    int inverseVotes = 0;
+    int checks = 0;
+
+    auto voteForLowerError = [&](float originalErr, float inverseErr) {
+        ++checks;
+        const bool originalGood = originalErr <= kTolerance;
+        const bool inverseGood = inverseErr <= kTolerance;
+        if (originalGood && !inverseGood) {
+            ++originalVotes;
+        } else if (inverseGood && !originalGood) {
+            ++inverseVotes;
+        } else if ((std::max)(0.0f, inverseErr - originalErr) > kEdge) {
+            ++originalVotes;
+        } else if ((std::max)(0.0f, originalErr - inverseErr) > kEdge) {
+            ++inverseVotes;
+        }
+    };
+
+    // Both candidates go through each product together. W * V is formed once and
+    // shared by the WV and MVP checks; the MVP products keep the (W * V) * P order.
+    const bool checkVP = hasProjection && hasVP && knownProjection && knownVP;
+    const bool checkWV = hasWorld && hasWV && knownWorld && knownWV;
+    const bool checkMVP = hasWorld && hasProjection && hasMVP && knownWorld && knownProjection && knownMVP;
+
+    if (checkVP) {
+        EngineMatrix originalVP;
+        EngineMatrix inverseVP;
+        matrix_kernels::MultiplyPair(&originalView._11, &inverseView._11, &knownProjection->_11,
+                                     &originalVP._11, &inverseVP._11);
+        voteForLowerError(MatrixMaxAbsDiff(originalVP, *knownVP),
+                         MatrixMaxAbsDiff(inverseVP, *knownVP));
+    }
+    if (checkWV || checkMVP) {
+        EngineMatrix originalWV;
+        EngineMatrix inverseWV;
+        matrix_kernels::MultiplySharedLeft(&knownWorld->_11, &originalView._11, &inverseView._11,
+                                           &originalWV._11, &inverseWV._11);
+        if (checkWV) {
+            voteForLowerError(MatrixMaxAbsDiff(originalWV, *knownWV),
+                             MatrixMaxAbsDiff(inverseWV, *knownWV));
+        }
+        if (checkMVP) {
+            EngineMatrix originalMVP;
+            EngineMatrix inverseMVP;
+            matrix_kernels::MultiplyPair(&originalWV._11, &inverseWV._11, &knownProjection->_11,
+                                         &originalMVP._11, &inverseMVP._11);
+            voteForLowerError(MatrixMaxAbsDiff(originalMVP, *knownMVP),
+                             MatrixMaxAbsDiff(inverseMVP, *knownMVP));
+        }
+    }
+
+    if (checks == 0 || originalVotes == inverseVotes) {
+        if (checks > 0 && originalVotes > 0 && inverseVotes > 0) {
+            return ViewCandidateConsistency_Ambiguous;
+        }
+        return ViewCandidateConsistency_None;
+    }
+    return (inverseVotes > originalVotes)
+        ? ViewCandidateConsistency_Inverse
+        : ViewCandidateConsistency_Original;
+}
+
+// ─── decomposition ───────────────────────────────────────────────────────────
+
+bool TryExtractProjectionFromCombined(const EngineMatrix& combined,
+                                      const EngineMatrix* worldOptional,
+                                      bool worldAvailable,
+                                      ProjectionAnalysis* outAnalysis,
+                                      EngineMatrix* outProjection) {
+    if (!outProjection) return false;
+    EngineMatrix candidate = combined;
+    if (worldAvailable && worldOptional) {
+        EngineMatrix worldInv = {};
+        if (!InvertMatrix4x4Deterministic(*worldOptional, &worldInv, nullptr)) return false;
+        candidate = MultiplyMatrix(worldInv, combined);
+    }
+    if (!AnalyzeProjectionMatrixNumeric(candidate, outAnalysis)) return false;
+    *outProjection = candidate;
+    return true;
+}
+
+void DecomposeCombinedMatrices(EngineMatrix* world,
+                               bool* hasWorld,
+                               EngineMatrix* view,
+                               bool* hasView,
+                               EngineMatrix* projection,
+                               bool* hasProjection,
+                               const EngineMatrix* mvp,
+                               bool hasMvp,
+                               const EngineMatrix* mv,
+                               bool hasMv,
+                               const EngineMatrix* vp,
+                               bool hasVp,
+                               const EngineMatrix* generatedProjection,
+                               bool hasGeneratedProjection,
+                               CombinedDecompositionDebugState* debug,
+                               MatrixDerivationCache* derivations,
+                               const DecompositionSourceKeys* sourceKeys) {
+    if (!world || !hasWorld || !view || !hasView || !projection || !hasProjection || !debug) return;
+
+    *debug = {};
+    debug->attempted = hasMvp || hasMv || hasVp;
+    if (!debug->attempted) {
+        return;
+    }
+
+    bool changed = true;
+    EngineMatrix knownMvp = {};
+    EngineMatrix knownMv = {};
+    EngineMatrix knownVp = {};
+    bool knownHasMvp = hasMvp;
+    bool knownHasMv = hasMv;
+    bool knownHasVp = hasVp;
+    if (knownHasMvp && mvp) knownMvp = *mvp;
+    if (knownHasMv && mv) knownMv = *mv;
+    if (knownHasVp && vp) knownVp = *vp;
+
+    // Inputs keep their generation until the solver replaces them; anything derived
+    // here is untracked (key 0).
+    DecompositionSourceKeys keys = {};
+    if (derivations && sourceKeys) keys = *sourceKeys;
+    if (!knownHasMvp) keys.mvp = 0;
+    if (!knownHasMv) keys.mv = 0;
+    if (!knownHasVp) keys.vp = 0;
+
+    auto solveWorld = [&](const EngineMatrix& candidate, const char* formula) {
+        if (*hasWorld || !IsWorldCandidateForDecomposition(candidate)) return false;
+        *world = candidate;
+        *hasWorld = true;
+        keys.world = 0;
+        debug->solvedWorld = true;
+        snprintf(debug->worldFormula, sizeof(debug->worldFormula), "%s", formula);
+        return true;
+    };
+
+    auto solveView = [&](const EngineMatrix& candidate, const char* formula) {
+        if (*hasView || !IsViewCandidateForDecomposition(candidate)) return false;
+        *view = candidate;
+        *hasView = true;
+        keys.view = 0;
+        debug->solvedView = true;
+        snprintf(debug->viewFormula, sizeof(debug->viewFormula), "%s", formula);
+        return true;
+    };
+
+    auto solveProjection = [&](const EngineMatrix& candidate, const char* formula) {
+        if (*hasProjection || !IsProjectionCandidateForDecomposition(candidate)) return false;
+        *projection = candidate;
+        *hasProjection = true;
+        keys.projection = 0;
+        debug->solvedProjection = true;
+        snprintf(debug->projectionFormula, sizeof(debug->projectionFormula), "%s", formula);
+        return true;
+    };
+
+    for (int pass = 0; pass < 8 && changed; ++pass) {
+        changed = false;
+
+        if (!knownHasMv && *hasView && *hasWorld) {
+            knownMv = MultiplyDerived(derivations, keys.world, *world, keys.view, *view);
+            knownHasMv = true;
+            changed = true;
+        }
+        if (!knownHasVp && *hasView && *hasProjection) {
+            knownVp = MultiplyDerived(derivations, keys.view, *view, keys.projection, *projection);
+            knownHasVp = true;
+            changed = true;
+        }
+        if (!knownHasMvp && knownHasMv && *hasProjection) {
+            knownMvp = MultiplyDerived(derivations, keys.mv, knownMv, keys.projection, *projection);
+            knownHasMvp = true;
+            changed = true;
+        }
+        if (!knownHasMvp && knownHasVp && *hasWorld) {
+            knownMvp = MultiplyDerived(derivations, keys.world, *world, keys.vp, knownVp);
+            knownHasMvp = true;
+            changed = true;
+        }
+
+        if (knownHasMvp && *hasWorld && !knownHasVp) {
+            EngineMatrix solvedVp = {};
+            if (TrySolveFromInverseLeftMultiply(*world, knownMvp, &solvedVp, derivations, keys.world)) {
+                knownVp = solvedVp;
+                knownHasVp = true;
+                changed = true;
+            }
+        }
+        if (knownHasMvp && *hasProjection && !knownHasMv) {
+            EngineMatrix solvedMv = {};
+            if (TrySolveFromInverseRightMultiply(knownMvp, *projection, &solvedMv, derivations, keys.projection)) {
+                knownMv = solvedMv;
+                knownHasMv = true;
+                changed = true;
+            }
+        }
+
+        if (knownHasMv && !*hasWorld && *hasView) {
+            EngineMatrix solved = {};
+            if (TrySolveFromInverseRightMultiply(knownMv, *view, &solved, derivations, keys.view) &&
+                solveWorld(solved, "World = MV * inv(View)")) {
+                changed = true;
+            }
+        }
+        if (knownHasMv && !*hasView && *hasWorld) {
+            EngineMatrix solved = {};
+            if (TrySolveFromInverseLeftMultiply(*world, knownMv, &solved, derivations, keys.world) &&
+                solveView(solved, "View = inv(World) * MV")) {
+                changed = true;
+            }
+        }
+
+        if (knownHasVp && !*hasView && *hasProjection) {
+            EngineMatrix solved = {};
+            if (TrySolveFromInverseRightMultiply(knownVp, *projection, &solved, derivations, keys.projection) &&
+                solveView(solved, "View = VP * inv(Projection)")) {
+                changed = true;
+            }
+        }
+        if (knownHasVp && !*hasProjection && *hasView) {
+            EngineMatrix solved = {};
+            if (TrySolveFromInverseLeftMultiply(*view, knownVp, &solved, derivations, keys.view) &&
+                solveProjection(solved, "Projection = inv(View) * VP")) {
+                changed = true;
+            }
+        }
+
+        if (knownHasMvp && knownHasVp && !*hasWorld) {
+            EngineMatrix solved = {};
+            if (TrySolveFromInverseRightMultiply(knownMvp, knownVp, &solved, derivations, keys.vp) &&
+                solveWorld(solved, "World = MVP * inv(VP)")) {
+                changed = true;
+            }
+        }
+        if (knownHasMvp && knownHasMv && !*hasProjection) {
+            EngineMatrix solved = {};
+            if (TrySolveFromInverseLeftMultiply(knownMv, knownMvp, &solved, derivations, keys.mv) &&
+                solveProjection(solved, "Projection = inv(MV) * MVP")) {
+                changed = true;
+            }
+        }
+        if (knownHasVp && !*hasProjection && !*hasView && hasGeneratedProjection && generatedProjection) {
+            EngineMatrix solvedView = {};
+            if (TrySolveFromInverseRightMultiply(knownVp, *generatedProjection, &solvedView, derivations, 0) &&
+                IsProjectionCandidateForDecomposition(*generatedProjection) &&
+                IsViewCandidateForDecomposition(solvedView)) {
+                *projection = *generatedProjection;
+                *hasProjection = true;
+                *view = solvedView;
+                *hasView = true;
+                keys.projection = 0;
+                keys.view = 0;
+                debug->solvedProjection = true;
+                debug->solvedView = true;
+                snprintf(debug->projectionFormula, sizeof(debug->projectionFormula),
+                         "Projection = Generated manual/auto matrix (config-enabled)");
+                snprintf(debug->viewFormula, sizeof(debug->viewFormula),
+                         "View = VP * inv(GeneratedProjection)");
+                changed = true;
+            }
+        }
+    }
+}
+
+RegisterLayoutProfile BuildProfileRegisterLayout(GameProfileKind profile) {
+    RegisterLayoutProfile layout = {};
+    if (profile == GameProfile_MetalGearRising) {
+        layout.projectionBase = 4;
+        layout.viewProjectionBase = 8;
+        layout.viewInverseBase = 12;
+        layout.worldBase = 16;
+        layout.worldViewBase = 20;
+    } else if (profile == GameProfile_DevilMayCry4) {
+        // Original DMC4 fixed layout.
+        layout.combinedMvpBase = 0;
+        layout.worldBase = 0;
+        layout.viewInverseBase = 4;
+        layout.projectionBase = 8;
+    }
+    return layout;
+}
+
+const char* ProjectionHandednessLabel(ProjectionHandedness handedness) {
+    switch (handedness) {
+        case ProjectionHandedness_Left: return "LH";
+        case ProjectionHandedness_Right: return "RH";
+        default: return "Unknown";
+    }
+}
+
+float ExtractFOV(const EngineMatrix& projection) {
+    if (fabsf(projection._22) < 0.001f) return 0;
+    return 2.0f * atanf(1.0f / fabsf(projection._22));
+}
+
+bool IsTypicalProjectionMatrix(const EngineMatrix& m, float minFOV, float maxFOV) {
+    ProjectionAnalysis analysis = {};
+    if (!AnalyzeProjectionMatrixNumeric(m, &analysis) || !analysis.valid) {
+        return false;
+    }
+    if (analysis.fovRadians < minFOV || analysis.fovRadians > maxFOV) {
+        return false;
+    }
+
+    const bool perspectiveTermsLookValid =
+        fabsf(m._14) <= 0.05f &&
+        fabsf(m._24) <= 0.05f &&
+        fabsf(m._44) <= 0.05f &&
+        fabsf(fabsf(m._34) - 1.0f) <= 0.05f;
+
+    return perspectiveTermsLookValid;
+}
+
+EngineMatrix CreateProjectionMatrix(float fovY, float aspect, float zNear, float zFar,
+                                    ProjectionHandedness handedness) {
+    const float yScale = 1.0f / tanf(fovY / 2.0f);
+    const float xScale = yScale / aspect;
+    EngineMatrix out = {};
+    out._11 = xScale;
+    out._22 = yScale;
+    if (handedness == ProjectionHandedness_Right) {
+        out._33 = zFar / (zNear - zFar);
+        out._34 = -1.0f;
+        out._43 = zNear * zFar / (zNear - zFar);
+    } else {
+        out._33 = zFar / (zFar - zNear);
+        out._34 = 1.0f;
+        out._43 = -zNear * zFar / (zFar - zNear);
+    }
+    return out;
+}
+
+uint64_t MakeLearnedLayoutKey(uint32_t shaderHash, uint32_t startRegister, uint32_t vectorCount) {
+    return (static_cast<uint64_t>(shaderHash) << 32) |
+           (static_cast<uint64_t>(startRegister & 0xFFFFu) << 16) |
+           static_cast<uint64_t>(vectorCount & 0xFFFFu);
+}
+
+static bool LearnedSlotsMatch(const LearnedMatrixSlot& a, const LearnedMatrixSlot& b) {
+    if (a.valid != b.valid) {
+        return false;
+    }
+    if (!a.valid) {
+        return true;
+    }
+    return a.baseRegister == b.baseRegister && a.rows == b.rows &&
+           a.transposed == b.transposed && a.inverted == b.inverted;
+}
+
+bool ObserveUploadLayout(LearnedLayoutMap* layouts, uint64_t key, const LearnedMatrixSlot observed[3],
+                         int frame, int learnFrames) {
+    if (!layouts || (!observed[0].valid && !observed[1].valid && !observed[2].valid)) {
+        return false;
+    }
+    LearnedUploadLayout& layout = (*layouts)[key];
+    bool sameLayout = true;
+    for (int i = 0; i < 3; ++i) {
+        if (!LearnedSlotsMatch(layout.slots[i], observed[i])) {
+            sameLayout = false;
+            break;
+        }
+    }
+    if (!sameLayout) {
+        for (int i = 0; i < 3; ++i) {
+            layout.slots[i] = observed[i];
+        }
+        layout.consistentFrames = 1;
+        layout.lastObservedFrame = frame;
+        layout.locked = false;
+        return false;
+    }
+    // Count frames, not uploads: a layout seen on 50 draws of one frame is still one sample.
+    if (layout.lastObservedFrame != frame) {
+        layout.consistentFrames++;
+        layout.lastObservedFrame = frame;
+    }
+    if (!layout.locked && layout.consistentFrames >= (std::max)(1, learnFrames)) {
+        layout.locked = true;
+        return true;
+    }
+    return false;
+}
+
+} // namespace matrix_engine
+
+// ─── MatrixDerivationCache ───────────────────────────────────────────────────
+
+void MatrixDerivationCache::Clear() {
+    m_entryCount = 0;
+    m_nextEntry = 0;
+}
+
+const MatrixDerivationCache::Entry* MatrixDerivationCache::Find(uint32_t leftKey, uint32_t rightKey) {
+    for (int i = 0; i < m_entryCount; ++i) {
+        if (m_entries[i].leftKey == leftKey && m_entries[i].rightKey == rightKey) {
+            m_hits++;
+            return &m_entries[i];
+        }
+    }
+    m_misses++;
+    return nullptr;
+}
+
+// Round-robin replacement; a frame rarely derives more than a handful of values.
+MatrixDerivationCache::Entry* MatrixDerivationCache::Insert(uint32_t leftKey, uint32_t rightKey) {
+    Entry* entry = &m_entries[m_nextEntry];
+    m_nextEntry = (m_nextEntry + 1) % kEntryCount;
+    if (m_entryCount < kEntryCount) {
+        m_entryCount++;
+    }
+    entry->leftKey = leftKey;
+    entry->rightKey = rightKey;
+    return entry;
+}
+
+bool MatrixDerivationCache::Invert(uint32_t key, const EngineMatrix& source, EngineMatrix* out) {
+    if (!out) return false;
+    if (key == 0) {
+        return matrix_engine::InvertMatrix4x4Deterministic(source, out, nullptr);
+    }
+    if (const Entry* hit = Find(key, 0)) {
+        if (hit->ok) *out = hit->value;
+        return hit->ok;
+    }
+    Entry* entry = Insert(key, 0);
+    entry->ok = matrix_engine::InvertMatrix4x4Deterministic(source, &entry->value, nullptr);
+    if (entry->ok) *out = entry->value;
+    return entry->ok;
+}
+
+EngineMatrix MatrixDerivationCache::Multiply(uint32_t leftKey, const EngineMatrix& left,
+                                             uint32_t rightKey, const EngineMatrix& right) {
+    if (leftKey == 0 || rightKey == 0) {
+        return matrix_engine::MultiplyMatrix(left, right);
+    }
+    if (const Entry* hit = Find(leftKey, rightKey)) {
+        return hit->value;
+    }
+    Entry* entry = Insert(leftKey, rightKey);
+    entry->ok = true;
+    entry->value = matrix_engine::MultiplyMatrix(left, right);
+    return entry->value;
+}
+
+// ─── StructuralWindowCache ───────────────────────────────────────────────────
+
+using namespace matrix_engine;
+
+StructuralWindowResult StructuralWindowCache::Classify(const float* data,
+                                                       uint32_t startReg,
+                                                       uint32_t vectorCount,
+                                                       uint32_t offset,
+                                                       uint32_t rows,
+                                                       const StructuralProbeOptions& probes) {
+    const uint32_t baseReg = startReg + offset;
+    const uint32_t dataRegisters = (std::min)(4u, vectorCount - offset);
+    const uint32_t probeFlags = (probes.transposedLayouts ? 1u : 0u) | (probes.inverseView ? 2u : 0u);
+    const float* window = data + offset * 4;
+    const uint32_t shapeSeed = (rows << 28) ^ (probeFlags << 24) ^ (startReg << 16) ^ (vectorCount << 8) ^ offset;
+    const uint32_t hash = FastHashFold32(FastHash64(window, dataRegisters * 4 * sizeof(float), shapeSeed));
+
+    Entry& entry = m_entries[hash & (kEntryCount - 1)];
+    if (entry.valid && entry.hash == hash && entry.rows == rows &&
+        entry.startRegister == startReg && entry.vectorCount == vectorCount &&
+        entry.baseRegister == baseReg && entry.probeFlags == probeFlags &&
+        entry.dataRegisters == dataRegisters &&
+        memcmp(entry.data, window, dataRegisters * 4 * sizeof(float)) == 0) {
+        m_hits++;
+        return entry.result;
+    }
+
+    m_misses++;
+    entry.valid = true;
+    entry.hash = hash;
+    entry.rows = rows;
+    entry.startRegister = startReg;
+    entry.vectorCount = vectorCount;
+    entry.baseRegister = baseReg;
+    entry.probeFlags = probeFlags;
+    entry.dataRegisters = dataRegisters;
+    memcpy(entry.data, window, dataRegisters * 4 * sizeof(float));
+    entry.result = ClassifyStructuralWindow(data, startReg, vectorCount, offset, rows, probes);
+    return entry.result;
+}
+
+void StructuralWindowCache::Clear() {
+    for (size_t i = 0; i < kEntryCount; i++) {
+        m_entries[i].valid = false;
+    }
+    m_hits = 0;
+    m_misses = 0;
+}
+
+// ─── MatrixEngine ────────────────────────────────────────────────────────────
+
+static const float kRadiansToDegrees = 180.0f / 3.14159265f;
+
+struct HostScope {
+    MatrixEngineHost* host;
+    HostScope(MatrixEngineHost* scopeHost, const char* name) : host(scopeHost) {
+        if (host) {
+            host->BeginScope(name);
+        }
+    }
+    ~HostScope() {
+        if (host) {
+            host->EndScope();
+        }
+    }
+};
+
+// Only a 4-row window with a perspective column (direct or transposed) can still yield
+// Projection or CombinedPerspective once View and World are suppressed.
+static bool WindowMayHoldPerspective(const float* window, uint32_t rows, bool probeTransposed) {
+    if (rows != 4u) {
+        return false;
+    }
+    const bool direct = fabsf(window[11]) > 0.49f && fabsf(window[15]) < 0.51f;
+    const bool transposed = probeTransposed && fabsf(window[14]) > 0.49f && fabsf(window[15]) < 0.51f;
+    return direct || transposed;
+}
+
+static bool TryExtractProfileMatrix(const float* data, uint32_t startRegister, uint32_t vectorCount,
+                                    int baseRegister, EngineMatrix* out) {
+    return baseRegister >= 0 &&
+           TryBuildMatrixFromConstantUpdate(data, startRegister, vectorCount, baseRegister, 4, false, out);
+}
+
+MatrixEngine::MatrixEngine(const MatrixEngineConfig& config) : m_config(config) {
+    Reset();
+}
+
+void MatrixEngine::SetConfig(const MatrixEngineConfig& config) {
+    const bool profileChanged = config.profile != m_config.profile;
+    m_config = config;
+    if (!profileChanged) {
+        return;
+    }
+    m_layout = BuildProfileRegisterLayout(m_config.profile);
+    m_profileState = EngineProfileState();
+    m_projLockedShader = 0;
+    m_projLockedRegister = -1;
+    m_viewLockedShader = 0;
+    m_viewLockedRegister = -1;
+    ClearDeferredClassification();
+}
+
+void MatrixEngine::Reset() {
+    m_layout = BuildProfileRegisterLayout(m_config.profile);
+    m_stats = MatrixEngineStats();
+    m_profileState = EngineProfileState();
+    m_lastDecomposition = CombinedDecompositionDebugState();
+    m_frame = 0;
+    m_constantLogThrottle = 0;
+    m_shaderId = 0;
+    m_shader = EngineShaderInfo();
+    for (int i = 0; i < EngineMatrix_Count; ++i) {
+        m_current[i] = IdentityMatrix();
+        m_has[i] = false;
+        m_everHad[i] = false;
+        m_sourceRegister[i] = -1;
+        m_generation[i] = 0;
+        m_held[i] = false;
+    }
+    m_lastGeneration = 0;
+    m_derivations = MatrixDerivationCache();
+    m_memo = DecompositionMemo();
+    m_projLockedShader = 0;
+    m_projLockedRegister = -1;
+    m_viewLockedShader = 0;
+    m_viewLockedRegister = -1;
+    m_projDetectedFrame = -1;
+    m_gameTransformSeen = false;
+    InvalidateEmittedTransforms();
+    memset(m_registers, 0, sizeof(m_registers));
+    ClearDeferredClassification();
+}
+
+uint32_t MatrixEngine::NextGeneration() {
+    if (++m_lastGeneration == 0) {
+        ++m_lastGeneration;
+    }
+    return m_lastGeneration;
+}
+
+// Re-capturing the same value keeps the generation, so derivations from it stay cached.
+void MatrixEngine::Capture(EngineMatrixSlot slot, const EngineMatrix& m, const EngineCaptureInfo& info) {
+    if (!m_has[slot] || memcmp(&m_current[slot], &m, sizeof(EngineMatrix)) != 0) {
+        m_generation[slot] = NextGeneration();
+    }
+    m_current[slot] = m;
+    m_has[slot] = true;
+    m_everHad[slot] = true;
+    m_sourceRegister[slot] = info.baseRegister;
+    if (m_host) {
+        m_host->OnMatrixCaptured(slot, m, info);
+    }
+}
+
+void MatrixEngine::Status(EngineStatusKind kind, const char* format, ...) {
+    if (!m_host) {
+        return;
+    }
+    char text[256];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(text, sizeof(text), format, args);
+    va_end(args);
+    m_host->OnStatus(kind, text);
+}
+
+void MatrixEngine::Logf(const char* format, ...) {
+    if (!m_host) {
+        return;
+    }
+    char text[256];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(text, sizeof(text), format, args);
+    va_end(args);
+    m_host->Log(text);
+}
+
+EngineCaptureInfo MatrixEngine::CaptureInfo(int baseRegister, int rows, bool transposed, bool manual,
+                                            const char* label, int extractedFromRegister) const {
+    EngineCaptureInfo info;
+    info.shaderId = m_shaderId;
+    info.baseRegister = baseRegister;
+    info.rows = rows;
+    info.transposed = transposed;
+    info.manual = manual;
+    info.label = label;
+    info.extractedFromRegister = extractedFromRegister;
+    return info;
+}
+
+void MatrixEngine::OnSetVertexShader(uint64_t shaderId, const EngineShaderInfo& info) {
+    m_shaderId = shaderId;
+    m_shader = info;
+}
+
+void MatrixEngine::ApplyExternalMatrix(EngineMatrixSlot slot, const EngineMatrix& m, const EngineCaptureInfo& info) {
+    if (slot < 0 || slot >= EngineMatrix_Count) {
+        return;
+    }
+    Capture(slot, m, info);
+}
+
+void MatrixEngine::OnVertexShaderConstants(uint32_t startRegister, const float* data, uint32_t vectorCount) {
+    if (!data) {
+        return;
+    }
+    m_stats.uploads++;
+    if (m_config.profile == GameProfile_MetalGearRising) {
+        ApplyMgrUpload(startRegister, data, vectorCount);
+    } else if (m_config.profile == GameProfile_Barnyard) {
+        ApplyBarnyardUpload(startRegister, data, vectorCount);
+    } else if (m_config.profile == GameProfile_DevilMayCry4) {
+        ApplyDmc4Upload(startRegister, data, vectorCount);
+    } else {
+        const bool inRange = startRegister <= kMaxRegisters && vectorCount <= kMaxRegisters - startRegister;
+        if (inRange) {
+            memcpy(m_registers + startRegister * 4, data, vectorCount * 4 * sizeof(float));
+        }
+        if (DefersUpload(startRegister, vectorCount)) {
+            // A repeat of a queued span only refreshes the register values.
+            if (FindDeferredSpan(startRegister, vectorCount) < 0) {
+                if (m_deferredSpanCount == kMaxDeferredSpans) {
+                    EvictOldestDeferredSpan();
+                }
+                DeferredSpan& span = m_deferredSpans[m_deferredSpanCount++];
+                span.start = static_cast<uint16_t>(startRegister);
+                span.count = static_cast<uint16_t>(vectorCount);
+            }
+        } else {
+            bool resolvedByOverride[EngineMatrix_Count];
+            memcpy(resolvedByOverride, m_held, sizeof(resolvedByOverride));
+            ClassifyRange(startRegister, data, vectorCount, resolvedByOverride, false);
+        }
+    }
+    m_stats.derivationHits = m_derivations.Hits();
+    m_stats.derivationMisses = m_derivations.Misses();
+    memset(m_held, 0, sizeof(m_held));
+}
+
+// MGR strict known-layout mode: c4-c7 projection, c8-c11 view-projection, c16-c19 world.
+// View is derived as VP * inverse(Projection); there is no structural fallback, and
+// projection and view persist across draws until the same registers are rewritten.
+void MatrixEngine::ApplyMgrUpload(uint32_t startRegister, const float* data, uint32_t vectorCount) {
+    EngineMatrix mat = {};
+    if (TryExtractProfileMatrix(data, startRegister, vectorCount, m_layout.projectionBase, &mat)) {
+        const int reg = m_layout.projectionBase;
+        m_profileState.coreRegistersSeen[0] = true;
+        m_profileState.mgrProjectionRegisterValid = IsTypicalProjectionMatrix(mat, m_config.minFOV, m_config.maxFOV);
+        m_profileState.mgrProjCapturedThisFrame = true;
+        EngineProjectionDetection detection;
+        detection.reg = reg;
+        EngineCaptureInfo info;
+        if (m_profileState.mgrProjectionRegisterValid) {
+            detection.fovRadians = ExtractFOV(mat);
+            info = CaptureInfo(reg, 4, false, true, "MetalGearRising profile projection (c4-c7)");
+        } else {
+            info = CaptureInfo(reg, 4, false, true, "MetalGearRising profile projection (c4-c7, non-typical)");
+        }
+        info.detection = &detection;
+        Capture(EngineMatrix_Projection, mat, info);
+        if (!m_profileState.mgrProjectionRegisterValid) {
+            Status(EngineStatus_Profile, "MGR projection at c4-c7 is non-typical; using it by default.");
+        }
+    }
+
+    if (TryExtractProfileMatrix(data, startRegister, vectorCount, m_layout.viewProjectionBase, &mat)) {
+        const int reg = m_layout.viewProjectionBase;
+        m_profileState.coreRegistersSeen[1] = true;
+        bool haveProjection = m_has[EngineMatrix_Projection];
+
+        if (!m_profileState.mgrProjectionRegisterValid && m_config.mgrUseAutoProjection) {
+            ProjectionAnalysis generatedInfo = {};
+            EngineMatrix generated = {};
+            if (TryExtractProjectionFromCombined(mat, nullptr, false, &generatedInfo, &generated)) {
+                m_profileState.mgrProjCapturedThisFrame = true;
+                EngineProjectionDetection detection;
+                detection.numeric = true;
+                detection.reg = reg;
+                detection.handedness = generatedInfo.handedness;
+                detection.fovRadians = generatedInfo.fovRadians;
+                EngineCaptureInfo info = CaptureInfo(reg, 4, false, true, "MetalGearRising auto projection from VP (c8-c11)");
+                info.detection = &detection;
+                Capture(EngineMatrix_Projection, generated, info);
+                haveProjection = true;
+            }
+        }
+
+        if (haveProjection) {
+            EngineMatrix projectionInv = {};
+            if (m_derivations.Invert(m_generation[EngineMatrix_Projection], m_current[EngineMatrix_Projection],
+                                     &projectionInv)) {
+                EngineMatrix derivedView = MultiplyMatrix(mat, projectionInv);
+                OrthonormalizeViewMatrix(&derivedView);
+                m_profileState.mgrViewCapturedThisFrame = true;
+                m_profileState.viewDerivedFromInverse = true;
+                Status(EngineStatus_Profile, "MGR view updated from VP (c8-c11) using inverse projection.");
+                Capture(EngineMatrix_View, derivedView,
+                        CaptureInfo(reg, 4, false, true, "MetalGearRising profile view from VP", reg));
+            } else {
+                m_profileState.viewDerivedFromInverse = false;
+                Status(EngineStatus_Profile, "MGR VP derivation failed: projection inversion failed.");
+            }
+        } else {
+            m_profileState.viewDerivedFromInverse = false;
+            Status(EngineStatus_Profile,
+                   "MGR VP detected but projection inversion failed. Enable auto projection to prefer generated projection.");
+        }
+    }
+
+    if (TryExtractProfileMatrix(data, startRegister, vectorCount, m_layout.worldBase, &mat)) {
+        m_profileState.mgrWorldCapturedForDraw = true;
+        m_profileState.coreRegistersSeen[2] = true;
+        Capture(EngineMatrix_World, mat,
+                CaptureInfo(m_layout.worldBase, 4, false, true, "MetalGearRising profile world (c16-c19)"));
+    }
+}
+
+// Barnyard: WORLD from shader constants, VIEW/PROJECTION from the game's SetTransform.
+void MatrixEngine::ApplyBarnyardUpload(uint32_t startRegister, const float* data, uint32_t vectorCount) {
+    bool worldCaptured = false;
+    EngineMatrix mat = {};
+
+    if (m_config.barnyardForceWorldFromC0 &&
+        TryBuildMatrixFromConstantUpdate(data, startRegister, vectorCount, 0, 4, false, &mat)) {
+        worldCaptured = true;
+        m_profileState.coreRegistersSeen[2] = true;
+        Capture(EngineMatrix_World, mat, CaptureInfo(0, 4, false, true, "Barnyard profile forced world (c0-c3)"));
+    }
+
+    if (!worldCaptured && m_config.worldMatrixRegister >= 0 &&
+        TryBuildMatrixFromConstantUpdate(data, startRegister, vectorCount, m_config.worldMatrixRegister, 4, false, &mat)) {
+        worldCaptured = true;
+        m_profileState.coreRegistersSeen[2] = true;
+        Capture(EngineMatrix_World, mat,
+                CaptureInfo(m_config.worldMatrixRegister, 4, false, true,
+                            "Barnyard profile world (explicit register override)"));
+    }
+
+    if (!worldCaptured && m_config.autoDetectMatrices && vectorCount >= 3) {
+        for (uint32_t rows : {4u, 3u}) {
+            if (vectorCount < rows || worldCaptured) {
+                continue;
+            }
+            const MatrixGatherFn gather = SelectMatrixGather(static_cast<int>(rows), false);
+            for (uint32_t offset = 0; offset + rows <= vectorCount; ++offset) {
+                const uint32_t baseReg = startRegister + offset;
+                const float* m = data + offset * 4;
+                EngineMatrix candidate;
+                gather(m, m + 4, m + 8, m + 12, &candidate);
+
+                MatrixClassification cls = ClassifyMatrixDeterministic(candidate, static_cast<int>(rows),
+                                                                       vectorCount, startRegister, baseReg);
+                bool transposed = false;
+                if (cls == MatrixClass_None && m_config.probeTransposedLayouts) {
+                    const EngineMatrix t = TransposeMatrix(candidate);
+                    cls = ClassifyMatrixDeterministic(t, static_cast<int>(rows), vectorCount, startRegister, baseReg);
+                    if (cls != MatrixClass_None) {
+                        candidate = t;
+                        transposed = true;
+                    }
+                }
+
+                if (cls == MatrixClass_World) {
+                    worldCaptured = true;
+                    m_profileState.coreRegistersSeen[2] = true;
+                    Capture(EngineMatrix_World, candidate,
+                            CaptureInfo(static_cast<int>(baseReg), static_cast<int>(rows), transposed, false,
+                                        "Barnyard profile structural world"));
+                    break;
+                }
+            }
+        }
+    }
+
+    if (worldCaptured) {
+        Status(EngineStatus_Profile, "Barnyard profile active: forwarding WORLD only; VIEW/PROJECTION SetTransform blocked.");
+    } else {
+        Status(EngineStatus_Profile, "Barnyard profile active: waiting for world matrix in shader constants.");
+    }
+}
+
+// DMC4 strict mapping: MVP (also used as WORLD) c0-c3, View c4-c7, Projection c8-c11.
+void MatrixEngine::ApplyDmc4Upload(uint32_t startRegister, const float* data, uint32_t vectorCount) {
+    EngineMatrix mat = {};
+    bool anyCaptured = false;
+
+    if (TryExtractProfileMatrix(data, startRegister, vectorCount, m_layout.combinedMvpBase, &mat)) {
+        anyCaptured = true;
+        m_profileState.coreRegistersSeen[0] = true;
+        Capture(EngineMatrix_MVP, mat,
+                CaptureInfo(m_layout.combinedMvpBase, 4, false, true, "DevilMayCry4 profile combined MVP (c0-c3)"));
+        Capture(EngineMatrix_World, mat,
+                CaptureInfo(m_layout.worldBase, 4, false, true, "DevilMayCry4 profile world (c0-c3)"));
+    }
+
+    if (TryExtractProfileMatrix(data, startRegister, vectorCount, m_layout.viewInverseBase, &mat)) {
+        anyCaptured = true;
+        m_profileState.coreRegistersSeen[1] = true;
+        m_profileState.viewDerivedFromInverse = false;
+        Capture(EngineMatrix_View, mat,
+                CaptureInfo(m_layout.viewInverseBase, 4, false, true, "DevilMayCry4 profile view (c4-c7)"));
+    }
+
+    if (TryExtractProfileMatrix(data, startRegister, vectorCount, m_layout.projectionBase, &mat)) {
+        anyCaptured = true;
+        m_profileState.coreRegistersSeen[2] = true;
+        EngineProjectionDetection detection;
+        detection.reg = m_layout.projectionBase;
+        detection.fovRadians = ExtractFOV(mat);
+        EngineCaptureInfo info = CaptureInfo(m_layout.projectionBase, 4, false, true,
+                                             "DevilMayCry4 profile projection (c8-c11)");
+        info.detection = &detection;
+        Capture(EngineMatrix_Projection, mat, info);
+    }
+
+    if (anyCaptured) {
+        Status(EngineStatus_Profile, "DMC4 profile active: strict mapping MVP/World=c0-c3 View=c4-c7 Projection=c8-c11.");
+    } else {
+        Status(EngineStatus_Profile, "DMC4 profile active but upload did not hit c0-c11 transform registers.");
+    }
+}
+
+StructuralWindowResult MatrixEngine::ClassifyWindow(const float* data, uint32_t startRegister, uint32_t vectorCount,
+                                                    uint32_t offset, uint32_t rows,
+                                                    const StructuralProbeOptions& probes) {
+    if (m_windowCache) {
+        return m_windowCache->Classify(data, startRegister, vectorCount, offset, rows, probes);
+    }
+    return ClassifyStructuralWindow(data, startRegister, vectorCount, offset, rows, probes);
+}
+
+bool MatrixEngine::TransformMapHasBase(int baseRegister) const {
+    for (int i = 0; i < m_shader.transformBaseCount; ++i) {
+        if (m_shader.transformBases[i] == baseRegister) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Explicit overrides, the learned layout fast path, the structural scan and combined
+// decomposition for one upload's register range. `resolvedByOverride` starts with the
+// held slots. `drawShaderBound` is set by the deferred flush, where the bound shader is
+// the one that will read the registers.
+void MatrixEngine::ClassifyRange(uint32_t startRegister, const float* data, uint32_t vectorCount,
+                                 bool* resolvedByOverride, bool drawShaderBound) {
+    bool resolvedStructurally[EngineTransform_Count] = {};
+
+    const int configuredRegisters[EngineMatrix_Count] = {
+        m_config.worldMatrixRegister, m_config.viewMatrixRegister, m_config.projMatrixRegister,
+        m_config.mvpMatrixRegister, m_config.vpMatrixRegister, m_config.mvMatrixRegister
+    };
+    for (int slot = 0; slot < EngineMatrix_Count; ++slot) {
+        const int reg = configuredRegisters[slot];
+        if (reg < 0 || resolvedByOverride[slot]) {
+            continue;
+        }
+        for (int rows : {4, 3}) {
+            EngineMatrix mat = {};
+            if (!TryBuildMatrixFromConstantUpdate(data, startRegister, vectorCount, reg, rows, false, &mat)) {
+                continue;
+            }
+            resolvedByOverride[slot] = true;
+            EngineProjectionDetection detection;
+            detection.reg = reg;
+            EngineCaptureInfo info = CaptureInfo(reg, rows, false, true, "explicit register override");
+            if (slot == EngineMatrix_Projection) {
+                info.detection = &detection;
+            }
+            Capture(static_cast<EngineMatrixSlot>(slot), mat, info);
+            break;
+        }
+    }
+
+    bool suppressView = false;
+    bool suppressWorld = false;
+
+    // The final matrix is classified again: a transposed or inverted window is only
+    // taken for the slot its corrected form belongs to.
+    auto updateFromClassification = [&](const EngineMatrix& mat, uint32_t baseReg, int rows, bool transposed) {
+        const MatrixClassification cls = ClassifyMatrixDeterministic(mat, rows, vectorCount, startRegister, baseReg);
+        const int reg = static_cast<int>(baseReg);
+
+        if (cls == MatrixClass_Projection &&
+            m_config.projMatrixRegister < 0 &&
+            !resolvedByOverride[EngineMatrix_Projection] &&
+            !resolvedStructurally[EngineTransform_Projection]) {
+            ProjectionAnalysis projectionInfo = {};
+            if (!AnalyzeProjectionMatrixNumeric(mat, &projectionInfo)) return;
+            if (projectionInfo.fovRadians < m_config.minFOV || projectionInfo.fovRadians > m_config.maxFOV) return;
+
+            const bool sameSource = m_projLockedShader == 0 ||
+                (m_shaderId == m_projLockedShader && reg == m_projLockedRegister);
+            if (sameSource) {
+                m_projLockedShader = m_shaderId;
+                m_projLockedRegister = reg;
+                m_projDetectedFrame = m_frame;
+                resolvedStructurally[EngineTransform_Projection] = true;
+                EngineProjectionDetection detection;
+                detection.numeric = true;
+                detection.fovRadians = projectionInfo.fovRadians;
+                detection.reg = reg;
+                detection.handedness = projectionInfo.handedness;
+                EngineCaptureInfo info = CaptureInfo(reg, rows, transposed, false, "deterministic structural projection");
+                info.detection = &detection;
+                Capture(EngineMatrix_Projection, mat, info);
+                Logf("Projection accepted: c%d-c%d rows=%d fov=%.2f deg (%s)",
+                     reg, reg + rows - 1, rows, projectionInfo.fovRadians * kRadiansToDegrees,
+                     ProjectionHandednessLabel(projectionInfo.handedness));
+            }
+        } else if (cls == MatrixClass_View &&
+                   !suppressView &&
+                   m_config.viewMatrixRegister < 0 &&
+                   !resolvedByOverride[EngineMatrix_View] &&
+                   !resolvedStructurally[EngineTransform_View]) {
+            const bool sameSource = m_viewLockedShader == 0 ||
+                (m_shaderId == m_viewLockedShader && reg == m_viewLockedRegister);
+            if (sameSource) {
+                if (m_has[EngineMatrix_Projection] && m_projDetectedFrame == m_frame &&
+                    !CrossValidateViewAgainstProjection(mat, m_current[EngineMatrix_Projection])) {
+                    // Column norms of candidateView * P do not match those of P: this is WV,
+                    // VP or another combined form. The slot stays open so the scan continues.
+                    return;
+                }
+                m_viewLockedShader = m_shaderId;
+                m_viewLockedRegister = reg;
+                resolvedStructurally[EngineTransform_View] = true;
+                Capture(EngineMatrix_View, mat, CaptureInfo(reg, rows, transposed, false, "deterministic structural view"));
+            }
+        } else if (cls == MatrixClass_World &&
+                   !suppressWorld &&
+                   m_config.worldMatrixRegister < 0 &&
+                   !resolvedByOverride[EngineMatrix_World] &&
+                   !resolvedStructurally[EngineTransform_World]) {
+            resolvedStructurally[EngineTransform_World] = true;
+            Capture(EngineMatrix_World, mat, CaptureInfo(reg, rows, transposed, false, "deterministic structural world"));
+        } else if (cls == MatrixClass_CombinedPerspective && rows == 4 &&
+                   m_config.worldMatrixRegister < 0 && m_config.viewMatrixRegister < 0 &&
+                   m_config.projMatrixRegister < 0 &&
+                   !resolvedByOverride[EngineMatrix_World] && !resolvedByOverride[EngineMatrix_View] &&
+                   !resolvedByOverride[EngineMatrix_Projection] &&
+                   !resolvedStructurally[EngineTransform_World] && !resolvedStructurally[EngineTransform_View] &&
+                   !resolvedStructurally[EngineTransform_Projection]) {
+            Capture(EngineMatrix_MVP, mat,
+                    CaptureInfo(reg, rows, transposed, false, "deterministic structural combined MVP", reg));
+        }
+    };
+
+    const StructuralProbeOptions probes = { m_config.probeTransposedLayouts, m_config.probeInverseView };
+    const bool structuralUpload = vectorCount >= 3;
+    // A complete transform map names every constant matrix the shader multiplies by;
+    // windows at other registers cannot hold one and are not scanned. At upload time the
+    // bound shader may not be the one the next draw uses, so only the flush applies it.
+    const bool useTransformMap = structuralUpload && drawShaderBound && m_config.shaderTransformMap &&
+                                 m_shader.transformMapComplete;
+
+    const bool useLayoutLearning = structuralUpload && m_config.enableLayoutFastPath && m_layouts &&
+                                   m_shader.hash != 0;
+    const uint64_t layoutKey = MakeLearnedLayoutKey(m_shader.hash, startRegister, vectorCount);
+    bool layoutFastPathHit = false;
+    if (useLayoutLearning) {
+        auto layoutIt = m_layouts->find(layoutKey);
+        if (layoutIt != m_layouts->end() && layoutIt->second.locked) {
+            LearnedUploadLayout& layout = layoutIt->second;
+            // Every learned window is validated before any is stored, so a partial drift
+            // never publishes slots from a layout that is about to be rescanned.
+            EngineMatrix learnedMatrices[EngineTransform_Count] = {};
+            bool drifted = false;
+            for (int slot = 0; slot < EngineTransform_Count && !drifted; ++slot) {
+                const LearnedMatrixSlot& learned = layout.slots[slot];
+                if (!learned.valid) {
+                    continue;
+                }
+                EngineMatrix mat = {};
+                if (!TryBuildMatrixFromConstantUpdate(data, startRegister, vectorCount,
+                                                      learned.baseRegister, learned.rows, false, &mat)) {
+                    drifted = true;
+                    break;
+                }
+                if (learned.transposed) {
+                    mat = TransposeMatrix(mat);
+                }
+                if (learned.rows == 3 &&
+                    IsThreeRowPrefixOfPerspectiveMatrix(data, startRegister, vectorCount,
+                                                        static_cast<uint32_t>(learned.baseRegister),
+                                                        learned.transposed)) {
+                    drifted = true;
+                    break;
+                }
+                if (learned.inverted) {
+                    mat = InvertSimpleRigidView(mat);
+                }
+                // Drift check: the learned window must still classify as the learned slot.
+                const MatrixClassification expected =
+                    slot == EngineTransform_World ? MatrixClass_World :
+                    slot == EngineTransform_View ? MatrixClass_View : MatrixClass_Projection;
+                if (ClassifyMatrixDeterministic(mat, learned.rows, vectorCount, startRegister,
+                                                static_cast<uint32_t>(learned.baseRegister)) != expected) {
+                    drifted = true;
+                }
+                learnedMatrices[slot] = mat;
+            }
+            for (int slot = 0; slot < EngineTransform_Count && !drifted; ++slot) {
+                const LearnedMatrixSlot& learned = layout.slots[slot];
+                if (learned.valid) {
+                    updateFromClassification(learnedMatrices[slot], static_cast<uint32_t>(learned.baseRegister),
+                                             learned.rows, learned.transposed);
+                }
+            }
+            if (drifted) {
+                layout.locked = false;
+                layout.consistentFrames = 0;
+                m_stats.layoutDriftFallbacks++;
+                Logf("Layout fast path drift for shader 0x%08X upload c%u (+%u); rescanning",
+                     m_shader.hash, startRegister, vectorCount);
+            } else {
+                layoutFastPathHit = true;
+                m_stats.layoutFastPathHits++;
+            }
+        }
+    }
+    if (structuralUpload && !layoutFastPathHit) {
+        m_stats.layoutFullScans++;
+    }
+    LearnedMatrixSlot observedLayout[EngineTransform_Count] = {};
+
+    const bool useSimdPrefilter = m_config.enableSimdWindowPrefilter && vectorCount <= kMaxRegisters;
+    const bool useWindowVerdicts = structuralUpload && !layoutFastPathHit && vectorCount <= kMaxRegisters;
+    WindowVerdicts& verdicts = m_verdicts;
+    if (useWindowVerdicts) {
+        memset(verdicts.valid, 0, sizeof(verdicts.valid));
+        if (useSimdPrefilter) {
+            BuildStructuralCandidateMask(data, vectorCount, 4u, probes, verdicts.candidate[0]);
+            BuildStructuralCandidateMask(data, vectorCount, 3u, probes, verdicts.candidate[1]);
+        }
+    }
+
+    // One stride-4 and one stride-3 walk over the upload. Each window is classified once
+    // and the verdict is kept for the main scan. More than two View or World hits at a
+    // fixed stride means the upload is a bone palette.
+    bool skinningPalette = false;
+    if (useWindowVerdicts && vectorCount >= 12 && !useTransformMap) {
+        for (uint32_t rows : {4u, 3u}) {
+            const int rowsIndex = rows == 4u ? 0 : 1;
+            int viewCount = 0;
+            int worldCount = 0;
+            for (uint32_t offset = 0; offset + rows <= vectorCount; offset += rows) {
+                StructuralWindowResult& verdict = verdicts.result[rowsIndex][offset];
+                if (useSimdPrefilter && !verdicts.candidate[rowsIndex][offset]) {
+                    verdict = StructuralWindowResult();
+                } else {
+                    verdict = ClassifyWindow(data, startRegister, vectorCount, offset, rows, probes);
+                }
+                verdicts.valid[rowsIndex][offset] = true;
+                if (verdict.directClass == MatrixClass_View) {
+                    viewCount++;
+                } else if (verdict.directClass == MatrixClass_World) {
+                    worldCount++;
+                }
+            }
+            if (viewCount > 2) suppressView = true;
+            if (worldCount > 2) suppressWorld = true;
+        }
+        skinningPalette = suppressView || suppressWorld;
+        if (skinningPalette) {
+            m_stats.paletteUploads++;
+        }
+    }
+
+    if (structuralUpload && !layoutFastPathHit) {
+        if (useTransformMap) {
+            m_stats.transformMapUploads++;
+        }
+        for (uint32_t rows : {4u, 3u}) {
+            if (vectorCount < rows) {
+                continue;
+            }
+            const int rowsIndex = rows == 4u ? 0 : 1;
+            const MatrixGatherFn gather = SelectMatrixGather(static_cast<int>(rows), false);
+            for (uint32_t offset = 0; offset + rows <= vectorCount; ++offset) {
+                const uint32_t baseReg = startRegister + offset;
+                if (useTransformMap && !TransformMapHasBase(static_cast<int>(baseReg))) {
+                    m_stats.transformMapWindowsSkipped++;
+                    continue;
+                }
+                if (skinningPalette &&
+                    !WindowMayHoldPerspective(data + offset * 4, rows, m_config.probeTransposedLayouts)) {
+                    m_stats.paletteWindowsSkipped++;
+                    continue;
+                }
+                if (useSimdPrefilter) {
+                    m_stats.prefilterWindowsTested++;
+                    if (!verdicts.candidate[rowsIndex][offset]) {
+                        m_stats.prefilterWindowsRejected++;
+                        continue;
+                    }
+                }
+                const float* m = data + offset * 4;
+                EngineMatrix mat;
+                gather(m, m + 4, m + 8, m + 12, &mat);
+
+                const StructuralWindowResult window =
+                    (useWindowVerdicts && verdicts.valid[rowsIndex][offset])
+                        ? verdicts.result[rowsIndex][offset]
+                        : ClassifyWindow(data, startRegister, vectorCount, offset, rows, probes);
+                const bool transposed = window.transposed;
+                bool inverted = false;
+                if (transposed) {
+                    mat = TransposeMatrix(mat);
+                }
+                // Both inverse flags imply a View verdict; skip the inversion and the
+                // consistency products when updateFromClassification would drop it anyway.
+                const bool viewSlotOpen = !suppressView && m_config.viewMatrixRegister < 0 &&
+                    !resolvedByOverride[EngineMatrix_View] &&
+                    !resolvedStructurally[EngineTransform_View];
+                if (viewSlotOpen && (window.invertedByClass || window.resolveInverseConsistency)) {
+                    const EngineMatrix originalMat = mat;
+                    const EngineMatrix invCandidate = InvertSimpleRigidView(mat);
+                    if (window.invertedByClass) {
+                        mat = invCandidate;
+                        inverted = true;
+                    }
+                    if (window.resolveInverseConsistency) {
+                        const ViewCandidateConsistency consistency = ResolveViewInverseConsistency(
+                            originalMat, invCandidate,
+                            &m_current[EngineMatrix_Projection], m_has[EngineMatrix_Projection],
+                            &m_current[EngineMatrix_World], m_has[EngineMatrix_World],
+                            &m_current[EngineMatrix_VP], m_has[EngineMatrix_VP],
+                            &m_current[EngineMatrix_WV], m_has[EngineMatrix_WV],
+                            &m_current[EngineMatrix_MVP], m_has[EngineMatrix_MVP]);
+                        if (consistency == ViewCandidateConsistency_Inverse) {
+                            mat = invCandidate;
+                            inverted = true;
+                            Logf("Structural view disambiguation: c%d prefers inverse candidate using composition consistency",
+                                 static_cast<int>(baseReg));
+                        } else if (consistency == ViewCandidateConsistency_Ambiguous ||
+                                   consistency == ViewCandidateConsistency_None) {
+                            Logf("Structural view disambiguation: c%d ambiguous/no consistency signal; keeping classified candidate",
+                                 static_cast<int>(baseReg));
+                        }
+                    }
+                }
+                if (window.finalClass != MatrixClass_None) {
+                    m_stats.structuralMatches++;
+                    bool resolvedBefore[EngineTransform_Count];
+                    memcpy(resolvedBefore, resolvedStructurally, sizeof(resolvedBefore));
+                    updateFromClassification(mat, baseReg, static_cast<int>(rows), transposed);
+                    for (int slot = 0; slot < EngineTransform_Count; ++slot) {
+                        if (!resolvedBefore[slot] && resolvedStructurally[slot]) {
+                            observedLayout[slot].valid = true;
+                            observedLayout[slot].baseRegister = static_cast<int>(baseReg);
+                            observedLayout[slot].rows = static_cast<int>(rows);
+                            observedLayout[slot].transposed = transposed;
+                            observedLayout[slot].inverted = inverted;
+                        }
+                    }
+                }
+
+                bool allResolved = true;
+                for (int slot = 0; slot < EngineTransform_Count; ++slot) {
+                    allResolved = allResolved &&
+                        (resolvedStructurally[slot] || resolvedByOverride[slot] || configuredRegisters[slot] >= 0);
+                }
+                if (allResolved) {
+                    goto done_scanning;
+                }
+            }
+        }
+    }
+    done_scanning:
+    if (useLayoutLearning && !layoutFastPathHit &&
+        ObserveUploadLayout(m_layouts, layoutKey, observedLayout, m_frame, m_config.layoutLearnFrames)) {
+        Logf("Layout fast path locked for shader 0x%08X upload c%u (+%u)", m_shader.hash, startRegister, vectorCount);
+        if (m_host) {
+            m_host->OnLayoutLocked();
+        }
+    }
+
+    if (m_config.logAllConstants && m_constantLogThrottle == 0 && vectorCount >= 4) {
+        Logf("SetVertexShaderConstantF: c%d-%d (%d vectors)",
+             static_cast<int>(startRegister), static_cast<int>(startRegister + vectorCount - 1),
+             static_cast<int>(vectorCount));
+        for (uint32_t i = 0; i < vectorCount && i < 4; i++) {
+            Logf("  c%d: [%.3f, %.3f, %.3f, %.3f]", static_cast<int>(startRegister + i),
+                 data[i * 4 + 0], data[i * 4 + 1], data[i * 4 + 2], data[i * 4 + 3]);
+        }
+    }
+
+    DecomposeCombined();
+}
+
+// Fills World/View/Projection from the combined matrices. The solver is skipped when
+// every input is unchanged since the last run and that run's result is replayed.
+void MatrixEngine::DecomposeCombined() {
+    HostScope scope(m_host, "CombinedDecomposition");
+    EngineMatrix generatedProjection = {};
+    bool hasGeneratedProjection = false;
+    if (m_config.allowGeneratedProjectionForVPDecomposition) {
+        hasGeneratedProjection = BuildCustomProjection(&generatedProjection);
+    }
+
+    DecompositionMemo& memo = m_memo;
+    const bool inputsUnchanged =
+        memo.valid &&
+        memo.enabled == m_config.enableCombinedDecomposition &&
+        memcmp(memo.generations, m_generation, sizeof(memo.generations)) == 0 &&
+        memcmp(memo.has, m_has, sizeof(memo.has)) == 0 &&
+        memo.hasGeneratedProjection == hasGeneratedProjection &&
+        (!hasGeneratedProjection ||
+         memcmp(&memo.generatedProjection, &generatedProjection, sizeof(EngineMatrix)) == 0);
+    if (inputsUnchanged) {
+        m_lastDecomposition = memo.debug;
+        m_stats.decompositionSkips++;
+    } else {
+        memo.valid = true;
+        memo.enabled = m_config.enableCombinedDecomposition;
+        memcpy(memo.generations, m_generation, sizeof(memo.generations));
+        memcpy(memo.has, m_has, sizeof(memo.has));
+        memo.hasGeneratedProjection = hasGeneratedProjection;
+        memo.generatedProjection = generatedProjection;
+        m_stats.decompositionRuns++;
+        if (!m_config.enableCombinedDecomposition) {
+            m_lastDecomposition = CombinedDecompositionDebugState();
+            m_lastDecomposition.attempted = m_has[EngineMatrix_MVP] || m_has[EngineMatrix_WV] || m_has[EngineMatrix_VP];
+        } else {
+            for (int slot = 0; slot < EngineTransform_Count; ++slot) {
+                memo.results[slot] = m_current[slot];
+                memo.resultHas[slot] = m_has[slot];
+            }
+            DecompositionSourceKeys keys;
+            keys.world = m_generation[EngineMatrix_World];
+            keys.view = m_generation[EngineMatrix_View];
+            keys.projection = m_generation[EngineMatrix_Projection];
+            keys.mvp = m_generation[EngineMatrix_MVP];
+            keys.mv = m_generation[EngineMatrix_WV];
+            keys.vp = m_generation[EngineMatrix_VP];
+            DecomposeCombinedMatrices(&memo.results[EngineMatrix_World], &memo.resultHas[EngineMatrix_World],
+                                      &memo.results[EngineMatrix_View], &memo.resultHas[EngineMatrix_View],
+                                      &memo.results[EngineMatrix_Projection], &memo.resultHas[EngineMatrix_Projection],
+                                      &m_current[EngineMatrix_MVP], m_has[EngineMatrix_MVP],
+                                      &m_current[EngineMatrix_WV], m_has[EngineMatrix_WV],
+                                      &m_current[EngineMatrix_VP], m_has[EngineMatrix_VP],
+                                      &generatedProjection, hasGeneratedProjection,
+                                      &m_lastDecomposition, &m_derivations, &keys);
+            if (m_config.combinedDecompositionLog && m_lastDecomposition.attempted) {
+                Logf("Combined decomposition result: world=%s view=%s projection=%s.",
+                     memo.resultHas[EngineMatrix_World] ? "yes" : "no",
+                     memo.resultHas[EngineMatrix_View] ? "yes" : "no",
+                     memo.resultHas[EngineMatrix_Projection] ? "yes" : "no");
+            }
+        }
+        memo.debug = m_lastDecomposition;
+    }
+
+    const bool solved[EngineTransform_Count] = {
+        m_lastDecomposition.solvedWorld, m_lastDecomposition.solvedView, m_lastDecomposition.solvedProjection
+    };
+    for (int slot = 0; slot < EngineTransform_Count; ++slot) {
+        if (solved[slot]) {
+            Capture(static_cast<EngineMatrixSlot>(slot), memo.results[slot],
+                    CaptureInfo(-1, 4, false, false, "deterministic combined decomposition"));
+        }
+    }
+}
+
+int MatrixEngine::FindDeferredSpan(uint32_t startRegister, uint32_t vectorCount) const {
+    for (int i = 0; i < m_deferredSpanCount; ++i) {
+        if (m_deferredSpans[i].start == startRegister && m_deferredSpans[i].count == vectorCount) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+bool MatrixEngine::DefersUpload(uint32_t startRegister, uint32_t vectorCount) const {
+    if (m_config.profile != GameProfile_None || !m_config.deferConstantClassification || vectorCount == 0) {
+        return false;
+    }
+    return startRegister <= kMaxRegisters && vectorCount <= kMaxRegisters - startRegister;
+}
+
+void MatrixEngine::ClassifyDeferredSpan(const DeferredSpan& span, bool drawShaderBound) {
+    m_stats.deferredRegistersClassified += span.count;
+    m_stats.deferredRangesClassified++;
+    bool resolvedByOverride[EngineMatrix_Count];
+    memcpy(resolvedByOverride, m_held, sizeof(resolvedByOverride));
+    ClassifyRange(span.start, m_registers + span.start * 4, span.count, resolvedByOverride, drawShaderBound);
+}
+
+// A span no bound shader reads would otherwise stay queued until Reset. When the queue
+// is full the oldest span is classified now, as the eager path would have, so new
+// uploads keep deferring. No shader is known to read it, so the transform map is off.
+void MatrixEngine::EvictOldestDeferredSpan() {
+    m_stats.deferredQueueFull++;
+    ClassifyDeferredSpan(m_deferredSpans[0], false);
+    memmove(m_deferredSpans, m_deferredSpans + 1, (m_deferredSpanCount - 1) * sizeof(DeferredSpan));
+    m_deferredSpanCount--;
+}
+
+void MatrixEngine::FlushDeferredClassification() {
+    if (m_deferredSpanCount == 0) {
+        memset(m_held, 0, sizeof(m_held));
+        return;
+    }
+    if (m_config.profile != GameProfile_None) {
+        ClearDeferredClassification();
+        memset(m_held, 0, sizeof(m_held));
+        return;
+    }
+
+    // Each span is classified on its own, exactly as the eager path would have seen the
+    // upload, but with the registers' latest values. Spans the bound shader does not read
+    // stay queued for a later shader, or until a full queue evicts them.
+    int kept = 0;
+    for (int i = 0; i < m_deferredSpanCount; ++i) {
+        const DeferredSpan span = m_deferredSpans[i];
+        bool intersects = !m_shader.constantReadsKnown;
+        for (uint32_t reg = span.start; !intersects && reg < uint32_t(span.start) + span.count; ++reg) {
+            intersects = (m_shader.constantReads[reg >> 5] & (1u << (reg & 31))) != 0;
+        }
+        if (!intersects) {
+            m_stats.deferredRegistersSkipped += span.count;
+            m_deferredSpans[kept++] = span;
+            continue;
+        }
+        ClassifyDeferredSpan(span, true);
+    }
+    m_deferredSpanCount = kept;
+    m_stats.derivationHits = m_derivations.Hits();
+    m_stats.derivationMisses = m_derivations.Misses();
+    memset(m_held, 0, sizeof(m_held));
+}
+
+void MatrixEngine::ClearDeferredClassification() {
+    m_deferredSpanCount = 0;
+}
+
+void MatrixEngine::OnGameSetTransform(EngineTransformSlot slot, const EngineMatrix* matrix, bool readBack) {
+    if (slot < 0 || slot >= EngineTransform_Count) {
+        return;
+    }
+    // Whatever the game sends replaces the last draw-time emit for this slot.
+    m_emittedValid[slot] = false;
+    if (!matrix) {
+        return;
+    }
+    m_gameTransformSeen = true;
+
+    static const char* const kPassthroughLabels[EngineTransform_Count] = {
+        "game SetTransform(World) direct passthrough",
+        "game SetTransform(View) direct passthrough",
+        "game SetTransform(Projection) direct passthrough"
+    };
+    static const char* const kRoundTripLabels[EngineTransform_Count] = {
+        "game SetTransform(World)+GetTransform compatibility",
+        "game SetTransform(View)+GetTransform compatibility",
+        "game SetTransform(Projection)+GetTransform compatibility"
+    };
+    const EngineMatrixSlot matrixSlot = static_cast<EngineMatrixSlot>(slot);
+
+    if (m_config.profile == GameProfile_None) {
+        if (m_config.setTransformBypassProxyWhenGameProvides) {
+            EngineCaptureInfo info = CaptureInfo(-1, 4, false, true, kPassthroughLabels[slot]);
+            info.shaderId = 0;
+            Capture(matrixSlot, *matrix, info);
+            return;
+        }
+        if (m_config.setTransformRoundTripCompatibilityMode) {
+            EngineCaptureInfo info = CaptureInfo(-1, 4, false, true, kRoundTripLabels[slot]);
+            info.shaderId = 0;
+            Capture(matrixSlot, *matrix, info);
+            return;
+        }
+    }
+
+    if (m_config.profile == GameProfile_Barnyard && m_config.barnyardUseGameSetTransformsForViewProjection &&
+        (slot == EngineTransform_View || slot == EngineTransform_Projection)) {
+        EngineProjectionDetection detection;
+        EngineCaptureInfo info;
+        if (slot == EngineTransform_View) {
+            m_profileState.coreRegistersSeen[0] = true;
+            info = CaptureInfo(-1, 4, false, true,
+                               readBack ? "Barnyard intercepted game SetTransform(View)+GetTransform"
+                                        : "Barnyard intercepted game SetTransform(View)");
+        } else {
+            m_profileState.coreRegistersSeen[1] = true;
+            detection.fovRadians = ExtractFOV(*matrix);
+            info = CaptureInfo(-1, 4, false, true,
+                               readBack ? "Barnyard intercepted game SetTransform(Projection)+GetTransform"
+                                        : "Barnyard intercepted game SetTransform(Projection)");
+            info.detection = &detection;
+        }
+        info.shaderId = 0;
+        Capture(matrixSlot, *matrix, info);
+        Status(EngineStatus_Profile, "Barnyard intercepted game %s transform and cached for draw-time forwarding.",
+               slot == EngineTransform_View ? "VIEW" : "PROJECTION");
+    }
+}
+
+void MatrixEngine::OnBeginScene() {
+    m_lastDecomposition = CombinedDecompositionDebugState();
+    if (m_config.profile == GameProfile_MetalGearRising) {
+        // MGR keeps projection and view across draws and frames but wants a fresh
+        // world upload every frame.
+        m_current[EngineMatrix_World] = IdentityMatrix();
+        m_has[EngineMatrix_World] = false;
+        m_generation[EngineMatrix_World] = NextGeneration();
+        m_profileState.mgrWorldCapturedForDraw = false;
+        m_profileState.mgrProjCapturedThisFrame = false;
+        m_profileState.mgrViewCapturedThisFrame = false;
+        m_profileState.mgrProjectionRegisterValid = false;
+    } else if (m_config.profile == GameProfile_None) {
+        m_viewLockedShader = 0;
+        m_viewLockedRegister = -1;
+        m_projLockedShader = 0;
+        m_projLockedRegister = -1;
+    }
+}
+
+bool MatrixEngine::BuildCustomProjection(EngineMatrix* out, bool* usedAuto, float* aspect,
+                                         uint32_t* width, uint32_t* height) {
+    uint32_t viewportWidth = 0;
+    uint32_t viewportHeight = 0;
+    if (m_config.customProjectionEnabled && m_config.customProjectionMode == EngineCustomProjection_Auto &&
+        (!m_host || !m_host->QueryViewportSize(&viewportWidth, &viewportHeight) ||
+         viewportWidth == 0 || viewportHeight == 0)) {
+        viewportWidth = 0;
+        viewportHeight = 0;
+    }
+    if (!BuildCustomProjection(m_config, viewportWidth, viewportHeight, out, usedAuto, aspect)) {
+        return false;
+    }
+    if (width) {
+        *width = viewportWidth;
+    }
+    if (height) {
+        *height = viewportHeight;
+    }
+    return true;
+}
+
+bool MatrixEngine::BuildCustomProjection(const MatrixEngineConfig& config, uint32_t viewportWidth,
+                                         uint32_t viewportHeight, EngineMatrix* out,
+                                         bool* usedAuto, float* aspect) {
+    if (!out || !config.customProjectionEnabled) {
+        return false;
+    }
+    if (config.customProjectionMode == EngineCustomProjection_Manual) {
+        *out = config.customProjectionManualMatrix;
+        if (usedAuto) {
+            *usedAuto = false;
+        }
+        return true;
+    }
+    if (config.customProjectionMode != EngineCustomProjection_Auto) {
+        return false;
+    }
+
+    float resolvedAspect = config.customProjectionAutoAspectFallback;
+    if (viewportWidth > 0 && viewportHeight > 0) {
+        resolvedAspect = static_cast<float>(viewportWidth) / static_cast<float>(viewportHeight);
+    }
+    const float safeAspect = (std::max)(0.1f, resolvedAspect);
+    const float fovDeg = (std::max)(1.0f, (std::min)(config.customProjectionAutoFovDeg, 179.0f));
+    const float nearZ = (std::max)(0.0001f, config.customProjectionAutoNearZ);
+    const float farZ = (std::max)(nearZ + 0.001f, config.customProjectionAutoFarZ);
+    const ProjectionHandedness handedness =
+        config.customProjectionAutoHandedness == ProjectionHandedness_Right
+            ? ProjectionHandedness_Right
+            : ProjectionHandedness_Left;
+    *out = CreateProjectionMatrix(fovDeg * (3.14159265f / 180.0f), safeAspect, nearZ, farZ, handedness);
+
+    if (usedAuto) {
+        *usedAuto = true;
+    }
+    if (aspect) {
+        *aspect = safeAspect;
+    }
+    return true;
+}
+
+void MatrixEngine::InvalidateEmittedTransforms() {
+    for (int i = 0; i < EngineTransform_Count; ++i) {
+        m_emittedValid[i] = false;
+    }
+}
+
+// Forwards one draw-time transform unless the device already holds the same bits.
+void MatrixEngine::Emit(EngineTransformSlot slot, EngineDrawTransforms* out) {
+    const EngineMatrix& matrix = m_current[slot];
+    if (out) {
+        out->bound[slot] = true;
+        out->matrices[slot] = matrix;
+        out->sourceRegister[slot] = m_sourceRegister[slot];
+    }
+    if (m_config.suppressRedundantTransforms && m_emittedValid[slot] &&
+        memcmp(&m_emitted[slot], &matrix, sizeof(EngineMatrix)) == 0) {
+        m_stats.transformsSuppressed++;
+        return;
+    }
+    m_stats.transformsEmitted++;
+    if (m_host && !m_host->EmitTransform(slot, matrix)) {
+        m_emittedValid[slot] = false;
+        return;
+    }
+    m_emitted[slot] = matrix;
+    m_emittedValid[slot] = true;
+    if (out) {
+        out->emitted[slot] = true;
+    }
+}
+
+void MatrixEngine::OnDraw(EngineDrawTransforms* out) {
+    m_stats.draws++;
+    EmitTransforms(out);
+}
+
+void MatrixEngine::EmitTransforms(EngineDrawTransforms* out) {
+    if (out) {
+        *out = EngineDrawTransforms();
+    }
+    if (!m_config.emitFixedFunctionTransforms) {
+        return;
+    }
+    // Strict game profiles stay deterministic even with SetTransform compatibility on.
+    if (m_config.profile == GameProfile_None &&
+        m_config.setTransformBypassProxyWhenGameProvides && m_gameTransformSeen) {
+        return;
+    }
+
+    const bool everWorld = m_everHad[EngineMatrix_World];
+    const bool everView = m_everHad[EngineMatrix_View];
+    const bool everProj = m_everHad[EngineMatrix_Projection];
+    if (m_config.profile == GameProfile_MetalGearRising) {
+        // MGR never emits identity or fallback transforms: all three registers first.
+        if (!(everWorld && everView && everProj)) {
+            Status(EngineStatus_Profile,
+                   "MGR draw skipped: no valid matrices ever captured (Proj=%s View=%s World=%s).",
+                   everProj ? "ready" : "never seen",
+                   everView ? "ready" : "never seen",
+                   everWorld ? "ready" : "never seen");
+            return;
+        }
+        Emit(EngineTransform_World, out);
+        Emit(EngineTransform_View, out);
+        Emit(EngineTransform_Projection, out);
+        return;
+    }
+    if (m_config.profile == GameProfile_DevilMayCry4) {
+        if (!(everWorld && everView && everProj)) {
+            Status(EngineStatus_Profile,
+                   "DMC4 draw skipped: no valid matrices ever captured (World=%s View=%s Proj=%s).",
+                   everWorld ? "ready" : "never seen",
+                   everView ? "ready" : "never seen",
+                   everProj ? "ready" : "never seen");
+            return;
+        }
+        Emit(EngineTransform_World, out);
+        Emit(EngineTransform_View, out);
+        Emit(EngineTransform_Projection, out);
+        return;
+    }
+    if (m_config.profile == GameProfile_Barnyard) {
+        const bool useGameViewProj = m_config.barnyardUseGameSetTransformsForViewProjection;
+        if (!everWorld || (useGameViewProj && (!everView || !everProj))) {
+            Status(EngineStatus_Profile,
+                   "Barnyard draw skipped: no valid matrices ever captured (World=%s View=%s Proj=%s).",
+                   everWorld ? "ready" : "never seen",
+                   everView ? "ready" : "never seen",
+                   everProj ? "ready" : "never seen");
+            return;
+        }
+        // WORLD always comes from shader constants.
+        Emit(EngineTransform_World, out);
+        if (useGameViewProj) {
+            Emit(EngineTransform_View, out);
+            Emit(EngineTransform_Projection, out);
+        }
+        return;
+    }
+
+    if (m_config.customProjectionEnabled) {
+        const bool projectionMissing = !m_has[EngineMatrix_Projection];
+        const bool mvpBlocksProjection = m_has[EngineMatrix_MVP] && !m_config.customProjectionOverrideCombinedMVP;
+        EngineMatrix customProjection = {};
+        bool usedAuto = false;
+        float resolvedAspect = 0.0f;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        if ((projectionMissing || m_config.customProjectionOverrideDetected) && !mvpBlocksProjection &&
+            BuildCustomProjection(&customProjection, &usedAuto, &resolvedAspect, &width, &height)) {
+            EngineProjectionDetection detection;
+            detection.fovRadians = ExtractFOV(customProjection);
+            EngineCaptureInfo info = CaptureInfo(-1, 4, false, true,
+                                                 usedAuto ? "experimental custom projection auto"
+                                                          : "experimental custom projection manual");
+            info.shaderId = 0;
+            info.detection = &detection;
+            Capture(EngineMatrix_Projection, customProjection, info);
+            if (usedAuto) {
+                Status(EngineStatus_CustomProjection,
+                       "Experimental projection active (auto): %ux%u aspect=%.4f fov=%.2f near=%.4f far=%.2f.",
+                       width, height, resolvedAspect,
+                       m_config.customProjectionAutoFovDeg,
+                       m_config.customProjectionAutoNearZ,
+                       m_config.customProjectionAutoFarZ);
+            } else {
+                Status(EngineStatus_CustomProjection, "Experimental projection active (manual matrix mode).");
+            }
+        }
+    }
+
+    // Only slots that have ever had a valid capture: never identity for an uncaptured
+    // slot, and last-known-good rather than identity for a stale one.
+    for (int slot = 0; slot < EngineTransform_Count; ++slot) {
+        if (m_everHad[slot]) {
+            Emit(static_cast<EngineTransformSlot>(slot), out);
+        }
+    }
+}
+
+void MatrixEngine::OnPresent() {
+    m_stats.frames++;
+    m_frame++;
+    m_derivations.Clear();
+    // Source locks are per frame, whatever the BeginScene count.
+    if (m_config.profile == GameProfile_None) {
+        m_viewLockedShader = 0;
+        m_viewLockedRegister = -1;
+        m_projLockedShader = 0;
+        m_projLockedRegister = -1;
+    }
+    if (m_config.logAllConstants) {
+        m_constantLogThrottle = (m_constantLogThrottle + 1) % 60;
+    }
+}
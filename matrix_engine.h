@@ -0,0 +1,691 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+
+// ─── Matrix type ─────────────────────────────────────────────────────────────
+//
+// Row-major 4x4 with the same member names and layout as D3DMATRIX, so the proxy
+// can alias its matrices in place. Nothing in this header depends on Windows or
+// D3D9; the proxy DLL and the offline replay tool both build it.
+
+struct EngineMatrix {
+    float _11, _12, _13, _14;
+    float _21, _22, _23, _24;
+    float _31, _32, _33, _34;
+    float _41, _42, _43, _44;
+};
+static_assert(sizeof(EngineMatrix) == 16 * sizeof(float), "EngineMatrix must be 16 packed floats");
+
+enum ProjectionHandedness {
+    ProjectionHandedness_Unknown = 0,
+    ProjectionHandedness_Left,
+    ProjectionHandedness_Right
+};
+
+struct ProjectionAnalysis {
+    bool valid = false;
+    float fovRadians = 0.0f;
+    ProjectionHandedness handedness = ProjectionHandedness_Unknown;
+};
+
+enum MatrixClassification {
+    MatrixClass_None = 0,
+    MatrixClass_World,
+    MatrixClass_View,
+    MatrixClass_Projection,
+    MatrixClass_CombinedPerspective
+};
+
+enum ViewCandidateConsistency {
+    ViewCandidateConsistency_None,
+    ViewCandidateConsistency_Original,
+    ViewCandidateConsistency_Inverse,
+    ViewCandidateConsistency_Ambiguous
+};
+
+// Content-only outcome of classifying one structural scan window. The inverse-view
+// consistency check depends on live camera state, so only whether it is needed is stored.
+struct StructuralWindowResult {
+    int finalClass = 0; // MatrixClassification
+    int directClass = 0; // untransposed, non-inverted class used for palette counting
+    bool transposed = false;
+    bool invertedByClass = false;
+    bool resolveInverseConsistency = false;
+};
+
+struct StructuralProbeOptions {
+    bool transposedLayouts = true;
+    bool inverseView = true;
+};
+
+struct CombinedDecompositionDebugState {
+    bool attempted = false;
+    bool solvedWorld = false;
+    bool solvedView = false;
+    bool solvedProjection = false;
+    char worldFormula[160] = {};
+    char viewFormula[160] = {};
+    char projectionFormula[160] = {};
+};
+
+// Generation keys of the DecomposeCombinedMatrices inputs. 0 marks an input whose
+// value is not tracked; derivations from it are never cached.
+struct DecompositionSourceKeys {
+    uint32_t world = 0;
+    uint32_t view = 0;
+    uint32_t projection = 0;
+    uint32_t mvp = 0;
+    uint32_t mv = 0;
+    uint32_t vp = 0;
+};
+
+// Memo of inverses and products of tracked matrices, keyed by source generation.
+// A generation names one exact matrix value, so a hit returns the bits a fresh
+// computation would. Owners clear it once per frame; key 0 is never cached.
+class MatrixDerivationCache {
+public:
+    MatrixDerivationCache() { Clear(); }
+
+    // Same contract as InvertMatrix4x4Deterministic; singular sources are cached too.
+    bool Invert(uint32_t key, const EngineMatrix& source, EngineMatrix* out);
+    EngineMatrix Multiply(uint32_t leftKey, const EngineMatrix& left,
+                          uint32_t rightKey, const EngineMatrix& right);
+    void Clear();
+
+    uint64_t Hits() const { return m_hits; }
+    uint64_t Misses() const { return m_misses; }
+
+private:
+    // rightKey 0 marks the inverse of leftKey.
+    struct Entry {
+        uint32_t leftKey;
+        uint32_t rightKey;
+        bool ok;
+        EngineMatrix value;
+    };
+    static const int kEntryCount = 8;
+
+    const Entry* Find(uint32_t leftKey, uint32_t rightKey);
+    Entry* Insert(uint32_t leftKey, uint32_t rightKey);
+
+    Entry m_entries[kEntryCount];
+    int m_entryCount;
+    int m_nextEntry;
+    uint64_t m_hits = 0;
+    uint64_t m_misses = 0;
+};
+
+enum GameProfileKind {
+    GameProfile_None = 0,
+    GameProfile_MetalGearRising,
+    GameProfile_DevilMayCry4,
+    GameProfile_Barnyard
+};
+
+struct RegisterLayoutProfile {
+    int combinedMvpBase = -1;
+    int projectionBase = -1;
+    int viewInverseBase = -1;
+    int worldBase = -1;
+    int viewProjectionBase = -1;
+    int worldViewBase = -1;
+};
+
+// ─── Stateless extraction primitives ─────────────────────────────────────────
+
+namespace matrix_engine {
+
+EngineMatrix IdentityMatrix();
+EngineMatrix TransposeMatrix(const EngineMatrix& m);
+EngineMatrix MultiplyMatrix(const EngineMatrix& a, const EngineMatrix& b);
+EngineMatrix InvertSimpleRigidView(const EngineMatrix& view);
+bool InvertMatrix4x4Deterministic(const EngineMatrix& in, EngineMatrix* out, float* outDeterminant = nullptr);
+float Determinant3x3(const EngineMatrix& m);
+bool IsFiniteMatrix(const EngineMatrix& m);
+float MatrixMaxAbsDiff(const EngineMatrix& a, const EngineMatrix& b);
+void OrthonormalizeViewMatrix(EngineMatrix* view);
+
+bool LooksLikeViewStrict(const EngineMatrix& m);
+bool AnalyzeProjectionMatrixNumeric(const EngineMatrix& m, ProjectionAnalysis* out);
+bool LooksLikeProjectionStrict(const EngineMatrix& m);
+bool HasPerspectiveComponent(const EngineMatrix& m);
+bool IsAffineMatrixNoPerspective(const EngineMatrix& m);
+bool LooksLikeWorldStrict(const EngineMatrix& m,
+                          int rows,
+                          uint32_t vectorCountInUpload,
+                          uint32_t uploadStartReg,
+                          uint32_t candidateBaseReg);
+MatrixClassification ClassifyMatrixDeterministic(const EngineMatrix& m,
+                                                 int rows,
+                                                 uint32_t vectorCountInUpload,
+                                                 uint32_t uploadStartReg,
+                                                 uint32_t candidateBaseReg);
+
+// Assembles a matrix from Rows constant registers, one pointer per register, so
+// paged and non-contiguous register files need no staging copy. A 3-row matrix gets
+// an identity fourth row (or column when transposed) and ignores r3. Both template
+// parameters are compile-time, so each variant is straight-line code.
+template <int Rows, bool Transposed>
+inline void GatherMatrix(const float* r0, const float* r1, const float* r2, const float* r3, EngineMatrix* out) {
+    static_assert(Rows == 3 || Rows == 4, "GatherMatrix reads 3 or 4 registers");
+    const float w0 = Rows == 4 ? r3[0] : 0.0f;
+    const float w1 = Rows == 4 ? r3[1] : 0.0f;
+    const float w2 = Rows == 4 ? r3[2] : 0.0f;
+    const float w3 = Rows == 4 ? r3[3] : 1.0f;
+    if (!Transposed) {
+        out->_11 = r0[0]; out->_12 = r0[1]; out->_13 = r0[2]; out->_14 = r0[3];
+        out->_21 = r1[0]; out->_22 = r1[1]; out->_23 = r1[2]; out->_24 = r1[3];
+        out->_31 = r2[0]; out->_32 = r2[1]; out->_33 = r2[2]; out->_34 = r2[3];
+        out->_41 = w0;    out->_42 = w1;    out->_43 = w2;    out->_44 = w3;
+    } else {
+        out->_11 = r0[0]; out->_21 = r0[1]; out->_31 = r0[2]; out->_41 = r0[3];
+        out->_12 = r1[0]; out->_22 = r1[1]; out->_32 = r1[2]; out->_42 = r1[3];
+        out->_13 = r2[0]; out->_23 = r2[1]; out->_33 = r2[2]; out->_43 = r2[3];
+        out->_14 = w0;    out->_24 = w1;    out->_34 = w2;    out->_44 = w3;
+    }
+}
+
+typedef void (*MatrixGatherFn)(const float* r0, const float* r1, const float* r2, const float* r3,
+                               EngineMatrix* out);
+
+// The GatherMatrix variant for a runtime row count and layout, or nullptr when rows
+// is not 3 or 4. Loops over one shape look it up once, outside the loop.
+MatrixGatherFn SelectMatrixGather(int rows, bool transposed);
+
+// Reads a 3- or 4-row matrix at baseRegister out of one upload. 3-row matrices get
+// an identity fourth row (or column when transposed).
+bool TryBuildMatrixFromConstantUpdate(const float* constantData,
+                                      uint32_t startRegister,
+                                      uint32_t vector4fCount,
+                                      int baseRegister,
+                                      int rows,
+                                      bool transposed,
+                                      EngineMatrix* outMatrix);
+bool IsThreeRowPrefixOfPerspectiveMatrix(const float* data,
+                                         uint32_t startReg,
+                                         uint32_t vectorCount,
+                                         uint32_t candidateBaseReg,
+                                         bool transposedLayout);
+StructuralWindowResult ClassifyStructuralWindow(const float* data,
+                                                uint32_t startReg,
+                                                uint32_t vectorCount,
+                                                uint32_t offset,
+                                                uint32_t rows,
+                                                const StructuralProbeOptions& probes);
+
+// Sets outCandidates[offset] for each window of `rows` registers unless an SSE2 pass
+// proves ClassifyStructuralWindow would return an empty result for it under `probes`.
+// Windows in a partial trailing block, and every window in scalar builds, stay
+// candidates, so skipping the rejected windows never changes a verdict.
+void BuildStructuralCandidateMask(const float* data,
+                                  uint32_t vectorCount,
+                                  uint32_t rows,
+                                  const StructuralProbeOptions& probes,
+                                  bool* outCandidates);
+
+// Returns true if candidateView is consistent with being a pure orthonormal
+// view matrix relative to knownProjection.
+bool CrossValidateViewAgainstProjection(const EngineMatrix& candidateView,
+                                        const EngineMatrix& knownProjection);
+ViewCandidateConsistency ResolveViewInverseConsistency(const EngineMatrix& originalView,
+                                                       const EngineMatrix& inverseView,
+                                                       const EngineMatrix* knownProjection,
+                                                       bool hasProjection,
+                                                       const EngineMatrix* knownWorld,
+                                                       bool hasWorld,
+                                                       const EngineMatrix* knownVP,
+                                                       bool hasVP,
+                                                       const EngineMatrix* knownWV,
+                                                       bool hasWV,
+                                                       const EngineMatrix* knownMVP,
+                                                       bool hasMVP);
+
+bool TryExtractProjectionFromCombined(const EngineMatrix& combined,
+                                      const EngineMatrix* worldOptional,
+                                      bool worldAvailable,
+                                      ProjectionAnalysis* outAnalysis,
+                                      EngineMatrix* outProjection);
+
+// Fills whichever of world/view/projection are missing from the combined MVP, WV
+// and VP matrices that are known. `debug` is reset and receives the formulas used.
+// With `derivations` and `sourceKeys`, inverses and products of unchanged inputs are
+// taken from the cache.
+void DecomposeCombinedMatrices(EngineMatrix* world,
+                               bool* hasWorld,
+                               EngineMatrix* view,
+                               bool* hasView,
+                               EngineMatrix* projection,
+                               bool* hasProjection,
+                               const EngineMatrix* mvp,
+                               bool hasMvp,
+                               const EngineMatrix* mv,
+                               bool hasMv,
+                               const EngineMatrix* vp,
+                               bool hasVp,
+                               const EngineMatrix* generatedProjection,
+                               bool hasGeneratedProjection,
+                               CombinedDecompositionDebugState* debug,
+                               MatrixDerivationCache* derivations = nullptr,
+                               const DecompositionSourceKeys* sourceKeys = nullptr);
+
+RegisterLayoutProfile BuildProfileRegisterLayout(GameProfileKind profile);
+
+// "LH", "RH" or "Unknown".
+const char* ProjectionHandednessLabel(ProjectionHandedness handedness);
+// Vertical field of view from _22, or 0 when _22 is too small to invert.
+float ExtractFOV(const EngineMatrix& projection);
+// A numerically valid projection inside [minFOV, maxFOV] with clean perspective terms.
+bool IsTypicalProjectionMatrix(const EngineMatrix& m, float minFOV, float maxFOV);
+// D3DXMatrixPerspectiveFovLH, or the RH form for ProjectionHandedness_Right.
+EngineMatrix CreateProjectionMatrix(float fovY, float aspect, float zNear, float zFar,
+                                    ProjectionHandedness handedness);
+
+} // namespace matrix_engine
+
+// ─── Shared caches ───────────────────────────────────────────────────────────
+//
+// Owned by the caller and handed to every MatrixEngine that should share them; the
+// proxy keeps one of each for the process and persists the layouts in its shader cache.
+
+struct LearnedMatrixSlot {
+    bool valid = false;
+    int baseRegister = -1;
+    int rows = 4;
+    bool transposed = false;
+    bool inverted = false;
+};
+
+// World/View/Projection placement learned per (shader hash, upload range).
+// Once the same placement repeats for LayoutLearnFrames frames the upload is
+// extracted directly instead of running the sliding-window scan.
+struct LearnedUploadLayout {
+    LearnedMatrixSlot slots[3] = {}; // indexed by EngineTransformSlot
+    int consistentFrames = 0;
+    int lastObservedFrame = -1;
+    bool locked = false;
+};
+
+typedef std::unordered_map<uint64_t, LearnedUploadLayout> LearnedLayoutMap;
+
+namespace matrix_engine {
+
+uint64_t MakeLearnedLayoutKey(uint32_t shaderHash, uint32_t startRegister, uint32_t vectorCount);
+// Records the slots one full scan resolved. Returns true when this observation locks
+// the layout.
+bool ObserveUploadLayout(LearnedLayoutMap* layouts, uint64_t key, const LearnedMatrixSlot observed[3],
+                         int frame, int learnFrames);
+
+} // namespace matrix_engine
+
+// Direct-mapped memo of StructuralWindowResult keyed by the window's raw registers
+// (the fourth register is included for 3-row windows because of the prefix check)
+// plus rows, upload shape and probe toggles.
+class StructuralWindowCache {
+public:
+    static const size_t kEntryCount = 1024;
+
+    StructuralWindowResult Classify(const float* data,
+                                    uint32_t startReg,
+                                    uint32_t vectorCount,
+                                    uint32_t offset,
+                                    uint32_t rows,
+                                    const StructuralProbeOptions& probes);
+    void Clear();
+
+    uint64_t Hits() const { return m_hits; }
+    uint64_t Misses() const { return m_misses; }
+
+private:
+    struct Entry {
+        bool valid = false;
+        uint32_t hash = 0;
+        float data[16] = {};
+        uint32_t dataRegisters = 0;
+        uint32_t rows = 0;
+        uint32_t startRegister = 0;
+        uint32_t vectorCount = 0;
+        uint32_t baseRegister = 0;
+        uint32_t probeFlags = 0;
+        StructuralWindowResult result = {};
+    };
+
+    Entry m_entries[kEntryCount];
+    uint64_t m_hits = 0;
+    uint64_t m_misses = 0;
+};
+
+// ─── Pipeline ────────────────────────────────────────────────────────────────
+
+enum EngineTransformSlot {
+    EngineTransform_World = 0,
+    EngineTransform_View,
+    EngineTransform_Projection,
+    EngineTransform_Count
+};
+
+// Every matrix the engine tracks. The first three alias EngineTransformSlot; the
+// order matches the proxy's MatrixSlot.
+enum EngineMatrixSlot {
+    EngineMatrix_World = 0,
+    EngineMatrix_View,
+    EngineMatrix_Projection,
+    EngineMatrix_MVP,
+    EngineMatrix_VP,
+    EngineMatrix_WV,
+    EngineMatrix_Count
+};
+
+enum EngineCustomProjectionMode {
+    EngineCustomProjection_Manual = 1,
+    EngineCustomProjection_Auto = 2
+};
+
+enum EngineStatusKind {
+    EngineStatus_Profile = 0,
+    EngineStatus_CustomProjection
+};
+
+// The subset of ProxyConfig that drives extraction and emission.
+struct MatrixEngineConfig {
+    GameProfileKind profile = GameProfile_None;
+    int viewMatrixRegister = -1;
+    int projMatrixRegister = -1;
+    int worldMatrixRegister = -1;
+    int mvpMatrixRegister = -1;
+    int mvMatrixRegister = -1;
+    int vpMatrixRegister = -1;
+    float minFOV = 0.1f;
+    float maxFOV = 2.5f;
+    bool autoDetectMatrices = false;
+    bool probeTransposedLayouts = true;
+    bool probeInverseView = true;
+    bool logAllConstants = false;
+    bool enableCombinedDecomposition = true;
+    bool combinedDecompositionLog = false;
+    bool allowGeneratedProjectionForVPDecomposition = false;
+    bool enableLayoutFastPath = true;
+    int layoutLearnFrames = 30;
+    bool enableSimdWindowPrefilter = true;
+    bool deferConstantClassification = false;
+    bool shaderTransformMap = true;
+    bool emitFixedFunctionTransforms = true;
+    bool suppressRedundantTransforms = true;
+    bool setTransformBypassProxyWhenGameProvides = false;
+    bool setTransformRoundTripCompatibilityMode = false;
+    bool mgrUseAutoProjection = false;
+    bool barnyardUseGameSetTransformsForViewProjection = true;
+    bool barnyardForceWorldFromC0 = false;
+    bool customProjectionEnabled = false;
+    EngineCustomProjectionMode customProjectionMode = EngineCustomProjection_Auto;
+    bool customProjectionOverrideDetected = false;
+    bool customProjectionOverrideCombinedMVP = false;
+    float customProjectionAutoFovDeg = 60.0f;
+    float customProjectionAutoNearZ = 0.1f;
+    float customProjectionAutoFarZ = 1000.0f;
+    float customProjectionAutoAspectFallback = 16.0f / 9.0f;
+    ProjectionHandedness customProjectionAutoHandedness = ProjectionHandedness_Left;
+    EngineMatrix customProjectionManualMatrix = {};
+};
+
+// Cumulative since construction or Reset.
+struct MatrixEngineStats {
+    uint64_t uploads = 0;
+    uint64_t draws = 0;
+    uint64_t frames = 0;
+    uint64_t structuralMatches = 0;
+    uint64_t decompositionRuns = 0;
+    uint64_t decompositionSkips = 0;
+    uint64_t derivationHits = 0;
+    uint64_t derivationMisses = 0;
+    uint64_t transformsEmitted = 0;
+    uint64_t transformsSuppressed = 0;
+    uint64_t layoutFastPathHits = 0;
+    uint64_t layoutFullScans = 0;
+    uint64_t layoutDriftFallbacks = 0;
+    uint64_t paletteUploads = 0;
+    uint64_t paletteWindowsSkipped = 0;
+    uint64_t transformMapUploads = 0;
+    uint64_t transformMapWindowsSkipped = 0;
+    uint64_t prefilterWindowsTested = 0;
+    uint64_t prefilterWindowsRejected = 0;
+    uint64_t deferredRegistersClassified = 0;
+    uint64_t deferredRegistersSkipped = 0;
+    uint64_t deferredRangesClassified = 0;
+    uint64_t deferredQueueFull = 0;
+};
+
+// Game-profile progress shown by the overlay.
+struct EngineProfileState {
+    bool coreRegistersSeen[3] = {}; // profile-specific order, see the overlay
+    bool viewDerivedFromInverse = false;
+    bool mgrProjectionRegisterValid = false;
+    bool mgrProjCapturedThisFrame = false;
+    bool mgrViewCapturedThisFrame = false;
+    bool mgrWorldCapturedForDraw = false;
+};
+
+// What the bound vertex shader is known to read, from bytecode analysis.
+struct EngineShaderInfo {
+    static const int kMaxTransformBases = 8;
+
+    // Layout-learning key; 0 disables the layout fast path for the shader.
+    uint32_t hash = 0;
+    bool constantReadsKnown = false;
+    uint32_t constantReads[8] = {}; // one bit per register c0-c255
+    // Base registers of the fixed constant matrices a complete transform map names.
+    bool transformMapComplete = false;
+    int transformBaseCount = 0;
+    int transformBases[kMaxTransformBases] = {};
+};
+
+struct EngineProjectionDetection {
+    bool numeric = false;
+    float fovRadians = 0.0f;
+    int reg = -1;
+    ProjectionHandedness handedness = ProjectionHandedness_Unknown;
+};
+
+// Where a published matrix came from.
+struct EngineCaptureInfo {
+    uint64_t shaderId = 0;
+    int baseRegister = -1;
+    int rows = 4;
+    bool transposed = false;
+    bool manual = false;
+    const char* label = nullptr;
+    int extractedFromRegister = -1;
+    // Set on projection captures that replace the detected-projection readout.
+    const EngineProjectionDetection* detection = nullptr;
+};
+
+// Device side of the engine. Every callback has a no-op default, so offline tools
+// can run the engine without one.
+class MatrixEngineHost {
+public:
+    virtual ~MatrixEngineHost() {}
+    virtual void OnMatrixCaptured(EngineMatrixSlot, const EngineMatrix&, const EngineCaptureInfo&) {}
+    // Forwards one draw-time transform; false leaves the slot unknown to the
+    // redundant-transform filter.
+    virtual bool EmitTransform(EngineTransformSlot, const EngineMatrix&) { return true; }
+    virtual void OnStatus(EngineStatusKind, const char*) {}
+    virtual void OnLayoutLocked() {}
+    virtual void Log(const char*) {}
+    // Current render size, asked for only when an auto projection is built.
+    virtual bool QueryViewportSize(uint32_t*, uint32_t*) { return false; }
+    // Brackets an engine phase worth its own span in the host's frame trace. Scopes
+    // nest and `name` is a string literal.
+    virtual void BeginScope(const char*) {}
+    virtual void EndScope() {}
+};
+
+// What one draw binds. `emitted` marks slots actually forwarded through SetTransform;
+// `bound` also includes slots skipped as redundant, whose matrix is unchanged.
+struct EngineDrawTransforms {
+    bool emitted[EngineTransform_Count] = {};
+    bool bound[EngineTransform_Count] = {};
+    EngineMatrix matrices[EngineTransform_Count] = {};
+    // Base register the bound matrix was read from, -1 when it was derived.
+    int sourceRegister[EngineTransform_Count] = { -1, -1, -1 };
+};
+
+// Per-upload classification and per-draw transform emission: profile register maps,
+// explicit and manual register bindings, learned layouts, the structural scan,
+// combined decomposition and the redundant SetTransform filter. The proxy device
+// owns one and supplies D3D9 through MatrixEngineHost; the replay tools run the
+// same object on recorded traces.
+class MatrixEngine {
+public:
+    explicit MatrixEngine(const MatrixEngineConfig& config = MatrixEngineConfig());
+
+    // Not owned. The layout table and window cache may be shared between engines;
+    // without them learned layouts and the window memo are off.
+    void SetHost(MatrixEngineHost* host) { m_host = host; }
+    void SetLayoutTable(LearnedLayoutMap* layouts) { m_layouts = layouts; }
+    void SetWindowCache(StructuralWindowCache* cache) { m_windowCache = cache; }
+
+    // A profile change restarts the profile state and the source locks.
+    void SetConfig(const MatrixEngineConfig& config);
+    const MatrixEngineConfig& GetConfig() const { return m_config; }
+    void Reset();
+
+    void OnSetVertexShader(uint64_t shaderId, const EngineShaderInfo& info);
+    void OnVertexShaderConstants(uint32_t startRegister, const float* data, uint32_t vectorCount);
+    // Publishes a matrix resolved outside the upload path (manual bindings, forced
+    // FFP constants). World/View/Projection become current; MVP/VP/WV feed decomposition.
+    void ApplyExternalMatrix(EngineMatrixSlot slot, const EngineMatrix& m, const EngineCaptureInfo& info);
+    // The next classified upload, or deferred flush, leaves the slot alone.
+    void HoldSlotForNextClassification(EngineMatrixSlot slot) { m_held[slot] = true; }
+    // True when this upload would be queued for the next flush instead of classified now.
+    bool DefersUpload(uint32_t startRegister, uint32_t vectorCount) const;
+    // Classifies each queued upload span the bound shader reads.
+    void FlushDeferredClassification();
+    void ClearDeferredClassification();
+    bool HasDeferredClassification() const { return m_deferredSpanCount > 0; }
+
+    // A game SetTransform. `matrix` is what the device now holds (after any
+    // GetTransform read-back, flagged by `readBack`); nullptr only invalidates the
+    // emitted-transform cache.
+    void OnGameSetTransform(EngineTransformSlot slot, const EngineMatrix* matrix, bool readBack = false);
+    void OnBeginScene();
+    void OnDraw(EngineDrawTransforms* out = nullptr);
+    // The draw-time emission of OnDraw without counting a draw.
+    void EmitTransforms(EngineDrawTransforms* out = nullptr);
+    void OnPresent();
+
+    // Device transform state changed behind the engine's back.
+    void InvalidateEmittedTransforms();
+    void InvalidateEmittedTransform(EngineTransformSlot slot) { m_emittedValid[slot] = false; }
+
+    const EngineMatrix& Current(EngineTransformSlot slot) const { return m_current[slot]; }
+    bool Has(EngineTransformSlot slot) const { return m_has[slot]; }
+    bool EverHad(EngineTransformSlot slot) const { return m_everHad[slot]; }
+    const MatrixEngineStats& GetStats() const { return m_stats; }
+    const EngineProfileState& GetProfileState() const { return m_profileState; }
+    const CombinedDecompositionDebugState& GetLastDecomposition() const { return m_lastDecomposition; }
+
+    // The configured experimental projection, or false when it is off. In auto mode the
+    // aspect comes from the host's viewport; width and height are 0 when the fallback
+    // aspect was used instead.
+    bool BuildCustomProjection(EngineMatrix* out, bool* usedAuto = nullptr, float* aspect = nullptr,
+                               uint32_t* width = nullptr, uint32_t* height = nullptr);
+    // The same for an explicit config and render size; 0x0 uses the fallback aspect.
+    static bool BuildCustomProjection(const MatrixEngineConfig& config, uint32_t viewportWidth,
+                                      uint32_t viewportHeight, EngineMatrix* out,
+                                      bool* usedAuto = nullptr, float* aspect = nullptr);
+
+private:
+    static const uint32_t kMaxRegisters = 256;
+
+    // Window verdicts of the upload being classified, shared between the palette pass
+    // and the main scan. Index 0 holds 4-row windows, index 1 holds 3-row windows.
+    struct WindowVerdicts {
+        StructuralWindowResult result[2][kMaxRegisters];
+        bool valid[2][kMaxRegisters];
+        bool candidate[2][kMaxRegisters];
+    };
+
+    // Inputs of the last decomposition. An identical tuple yields an identical result,
+    // so the solver is skipped and the recorded debug state is restored instead.
+    struct DecompositionMemo {
+        bool valid = false;
+        bool enabled = false;
+        uint32_t generations[EngineMatrix_Count] = {};
+        bool has[EngineMatrix_Count] = {};
+        bool hasGeneratedProjection = false;
+        EngineMatrix generatedProjection = {};
+        CombinedDecompositionDebugState debug = {};
+        // World/View/Projection as the solver left them; only the solved slots are read.
+        EngineMatrix results[EngineTransform_Count] = {};
+        bool resultHas[EngineTransform_Count] = {};
+    };
+
+    void Capture(EngineMatrixSlot slot, const EngineMatrix& m, const EngineCaptureInfo& info);
+    uint32_t NextGeneration();
+    void Status(EngineStatusKind kind, const char* format, ...);
+    void Logf(const char* format, ...);
+    EngineCaptureInfo CaptureInfo(int baseRegister, int rows, bool transposed, bool manual,
+                                  const char* label, int extractedFromRegister = -1) const;
+
+    void ApplyMgrUpload(uint32_t startRegister, const float* data, uint32_t vectorCount);
+    void ApplyBarnyardUpload(uint32_t startRegister, const float* data, uint32_t vectorCount);
+    void ApplyDmc4Upload(uint32_t startRegister, const float* data, uint32_t vectorCount);
+    void ClassifyRange(uint32_t startRegister, const float* data, uint32_t vectorCount,
+                       bool* resolvedByOverride, bool drawShaderBound);
+    StructuralWindowResult ClassifyWindow(const float* data, uint32_t startRegister, uint32_t vectorCount,
+                                          uint32_t offset, uint32_t rows, const StructuralProbeOptions& probes);
+    bool TransformMapHasBase(int baseRegister) const;
+    void DecomposeCombined();
+    void Emit(EngineTransformSlot slot, EngineDrawTransforms* out);
+
+    MatrixEngineHost* m_host = nullptr;
+    LearnedLayoutMap* m_layouts = nullptr;
+    StructuralWindowCache* m_windowCache = nullptr;
+
+    MatrixEngineConfig m_config;
+    RegisterLayoutProfile m_layout;
+    MatrixEngineStats m_stats;
+    EngineProfileState m_profileState;
+    CombinedDecompositionDebugState m_lastDecomposition;
+    int m_frame = 0;
+    int m_constantLogThrottle = 0;
+    uint64_t m_shaderId = 0;
+    EngineShaderInfo m_shader;
+
+    EngineMatrix m_current[EngineMatrix_Count] = {};
+    bool m_has[EngineMatrix_Count] = {};
+    bool m_everHad[EngineMatrix_Count] = {};
+    int m_sourceRegister[EngineMatrix_Count] = {};
+    // Bumped whenever a slot takes a different value; keys m_derivations and m_memo.
+    uint32_t m_generation[EngineMatrix_Count] = {};
+    uint32_t m_lastGeneration = 0;
+    MatrixDerivationCache m_derivations;
+    DecompositionMemo m_memo;
+    bool m_held[EngineMatrix_Count] = {};
+
+    uint64_t m_projLockedShader = 0;
+    int m_projLockedRegister = -1;
+    uint64_t m_viewLockedShader = 0;
+    int m_viewLockedRegister = -1;
+    int m_projDetectedFrame = -1;
+    bool m_gameTransformSeen = false;
+
+    EngineMatrix m_emitted[EngineTransform_Count] = {};
+    bool m_emittedValid[EngineTransform_Count] = {};
+
+    // Deferred classification: the last value of every register and the (start, count)
+    // of every upload not classified yet, in upload order.
+    struct DeferredSpan {
+        uint16_t start;
+        uint16_t count;
+    };
+    static const int kMaxDeferredSpans = 64;
+    int FindDeferredSpan(uint32_t startRegister, uint32_t vectorCount) const;
+    void ClassifyDeferredSpan(const DeferredSpan& span, bool drawShaderBound);
+    void EvictOldestDeferredSpan();
+    float m_registers[kMaxRegisters * 4] = {};
+    DeferredSpan m_deferredSpans[kMaxDeferredSpans] = {};
+    int m_deferredSpanCount = 0;
+    WindowVerdicts m_verdicts;
+};
@@ -0,0 +1,506 @@
+#pragma once
+
+#include <cmath>
+
+// ─── Matrix kernels ──────────────────────────────────────────────────────────
+//
+// Shared 4x4/3-vector math for the proxy, the matrix engine and both light
+// managers. Matrices are 16 contiguous row-major floats (D3DMATRIX layout), so
+// callers pass &m._11. Header-only and free of Windows/D3D9 dependencies.
+//
+// The SSE2 paths keep the scalar operation order, so every kernel is
+// bit-identical to its scalar reference and golden runs compare equal across the
+// two builds. Build with CAMERA_PROXY_DETERMINISTIC_MATH=1 to compile the scalar
+// reference only, e.g. when checking a suspected SIMD regression.
+
+#ifndef CAMERA_PROXY_DETERMINISTIC_MATH
+#define CAMERA_PROXY_DETERMINISTIC_MATH 0
+#endif
+
+#if !CAMERA_PROXY_DETERMINISTIC_MATH && \
+    (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define MATRIX_KERNELS_SSE2 1
+#include <emmintrin.h>
+#else
+#define MATRIX_KERNELS_SSE2 0
+#endif
+
+namespace matrix_kernels {
+
+// ─── Scalar reference ────────────────────────────────────────────────────────
+//
+// Always compiled; the SIMD kernels are verified against these.
+
+namespace scalar {
+
+inline void Multiply(const float* a, const float* b, float* out) {
+    float r[16];
+    for (int i = 0; i < 4; ++i) {
+        const float* ai = a + i * 4;
+        for (int j = 0; j < 4; ++j) {
+            r[i * 4 + j] = ai[0] * b[j] + ai[1] * b[4 + j] + ai[2] * b[8 + j] + ai[3] * b[12 + j];
+        }
+    }
+    for (int i = 0; i < 16; ++i) out[i] = r[i];
+}
+
+// Two products sharing the right operand: out0 = a0 * b, out1 = a1 * b.
+inline void MultiplyPair(const float* a0, const float* a1, const float* b, float* out0, float* out1) {
+    float r0[16];
+    float r1[16];
+    Multiply(a0, b, r0);
+    Multiply(a1, b, r1);
+    for (int i = 0; i < 16; ++i) {
+        out0[i] = r0[i];
+        out1[i] = r1[i];
+    }
+}
+
+// Two products sharing the left operand: out0 = a * b0, out1 = a * b1.
+inline void MultiplySharedLeft(const float* a, const float* b0, const float* b1, float* out0, float* out1) {
+    float r0[16];
+    float r1[16];
+    Multiply(a, b0, r0);
+    Multiply(a, b1, r1);
+    for (int i = 0; i < 16; ++i) {
+        out0[i] = r0[i];
+        out1[i] = r1[i];
+    }
+}
+
+inline void Transpose(const float* m, float* out) {
+    float r[16];
+    for (int i = 0; i < 4; ++i) {
+        for (int j = 0; j < 4; ++j) {
+            r[j * 4 + i] = m[i * 4 + j];
+        }
+    }
+    for (int i = 0; i < 16; ++i) out[i] = r[i];
+}
+
+// Inverse of a rotation+translation: transposed 3x3, rotated negated translation.
+inline void InvertRigid(const float* m, float* out) {
+    float r[16] = {};
+    r[0] = m[0]; r[1] = m[4]; r[2]  = m[8];
+    r[4] = m[1]; r[5] = m[5]; r[6]  = m[9];
+    r[8] = m[2]; r[9] = m[6]; r[10] = m[10];
+    r[15] = 1.0f;
+    r[12] = -(m[12] * r[0] + m[13] * r[4] + m[14] * r[8]);
+    r[13] = -(m[12] * r[1] + m[13] * r[5] + m[14] * r[9]);
+    r[14] = -(m[12] * r[2] + m[13] * r[6] + m[14] * r[10]);
+    for (int i = 0; i < 16; ++i) out[i] = r[i];
+}
+
+// Full inverse by cofactor expansion. Fails when |det| <= 1e-8.
+inline bool Invert4x4(const float* m, float* out, float* outDeterminant) {
+    float inv[16];
+    inv[0] = m[5] * m[10] * m[15] - m[5] * m[11] * m[14] - m[9] * m[6] * m[15] +
+             m[9] * m[7] * m[14] + m[13] * m[6] * m[11] - m[13] * m[7] * m[10];
+    inv[4] = -m[4] * m[10] * m[15] + m[4] * m[11] * m[14] + m[8] * m[6] * m[15] -
+              m[8] * m[7] * m[14] - m[12] * m[6] * m[11] + m[12] * m[7] * m[10];
+    inv[8] = m[4] * m[9] * m[15] - m[4] * m[11] * m[13] - m[8] * m[5] * m[15] +
+             m[8] * m[7] * m[13] + m[12] * m[5] * m[11] - m[12] * m[7] * m[9];
+    inv[12] = -m[4] * m[9] * m[14] + m[4] * m[10] * m[13] + m[8] * m[5] * m[14] -
+               m[8] * m[6] * m[13] - m[12] * m[5] * m[10] + m[12] * m[6] * m[9];
+    inv[1] = -m[1] * m[10] * m[15] + m[1] * m[11] * m[14] + m[9] * m[2] * m[15] -
+              m[9] * m[3] * m[14] - m[13] * m[2] * m[11] + m[13] * m[3] * m[10];
+    inv[5] = m[0] * m[10] * m[15] - m[0] * m[11] * m[14] - m[8] * m[2] * m[15] +
+             m[8] * m[3] * m[14] + m[12] * m[2] * m[11] - m[12] * m[3] * m[10];
+    inv[9] = -m[0] * m[9] * m[15] + m[0] * m[11] * m[13] + m[8] * m[1] * m[15] -
+              m[8] * m[3] * m[13] - m[12] * m[1] * m[11] + m[12] * m[3] * m[9];
+    inv[13] = m[0] * m[9] * m[14] - m[0] * m[10] * m[13] - m[8] * m[1] * m[14] +
+              m[8] * m[2] * m[13] + m[12] * m[1] * m[10] - m[12] * m[2] * m[9];
+    inv[2] = m[1] * m[6] * m[15] - m[1] * m[7] * m[14] - m[5] * m[2] * m[15] +
+             m[5] * m[3] * m[14] + m[13] * m[2] * m[7] - m[13] * m[3] * m[6];
+    inv[6] = -m[0] * m[6] * m[15] + m[0] * m[7] * m[14] + m[4] * m[2] * m[15] -
+              m[4] * m[3] * m[14] - m[12] * m[2] * m[7] + m[12] * m[3] * m[6];
+    inv[10] = m[0] * m[5] * m[15] - m[0] * m[7] * m[13] - m[4] * m[1] * m[15] +
+              m[4] * m[3] * m[13] + m[12] * m[1] * m[7] - m[12] * m[3] * m[5];
+    inv[14] = -m[0] * m[5] * m[14] + m[0] * m[6] * m[13] + m[4] * m[1] * m[14] -
+               m[4] * m[2] * m[13] - m[12] * m[1] * m[6] + m[12] * m[2] * m[5];
+    inv[3] = -m[1] * m[6] * m[11] + m[1] * m[7] * m[10] + m[5] * m[2] * m[11] -
+              m[5] * m[3] * m[10] - m[9] * m[2] * m[7] + m[9] * m[3] * m[6];
+    inv[7] = m[0] * m[6] * m[11] - m[0] * m[7] * m[10] - m[4] * m[2] * m[11] +
+             m[4] * m[3] * m[10] + m[8] * m[2] * m[7] - m[8] * m[3] * m[6];
+    inv[11] = -m[0] * m[5] * m[11] + m[0] * m[7] * m[9] + m[4] * m[1] * m[11] -
+               m[4] * m[3] * m[9] - m[8] * m[1] * m[7] + m[8] * m[3] * m[5];
+    inv[15] = m[0] * m[5] * m[10] - m[0] * m[6] * m[9] - m[4] * m[1] * m[10] +
+              m[4] * m[2] * m[9] + m[8] * m[1] * m[6] - m[8] * m[2] * m[5];
+
+    const float det = m[0] * inv[0] + m[1] * inv[4] + m[2] * inv[8] + m[3] * inv[12];
+    if (outDeterminant) {
+        *outDeterminant = det;
+    }
+    if (std::fabs(det) <= 1e-8f) {
+        return false;
+    }
+    const float detInv = 1.0f / det;
+    for (int i = 0; i < 16; ++i) {
+        out[i] = inv[i] * detInv;
+    }
+    return true;
+}
+
+inline float MaxAbsDiff(const float* a, const float* b) {
+    float maxErr = 0.0f;
+    for (int i = 0; i < 16; ++i) {
+        const float err = std::fabs(a[i] - b[i]);
+        maxErr = maxErr < err ? err : maxErr;
+    }
+    return maxErr;
+}
+
+inline void TransformPoint(const float* m, const float in[3], float out[3]) {
+    const float x = in[0], y = in[1], z = in[2];
+    out[0] = x * m[0] + y * m[4] + z * m[8]  + m[12];
+    out[1] = x * m[1] + y * m[5] + z * m[9]  + m[13];
+    out[2] = x * m[2] + y * m[6] + z * m[10] + m[14];
+}
+
+inline void TransformDirection(const float* m, const float in[3], float out[3]) {
+    const float x = in[0], y = in[1], z = in[2];
+    out[0] = x * m[0] + y * m[4] + z * m[8];
+    out[1] = x * m[1] + y * m[5] + z * m[9];
+    out[2] = x * m[2] + y * m[6] + z * m[10];
+}
+
+} // namespace scalar
+
+// ─── Vector helpers ──────────────────────────────────────────────────────────
+
+inline float Dot3(float ax, float ay, float az, float bx, float by, float bz) {
+    return ax * bx + ay * by + az * bz;
+}
+
+inline void Cross3(const float a[3], const float b[3], float out[3]) {
+    const float x = a[1] * b[2] - a[2] * b[1];
+    const float y = a[2] * b[0] - a[0] * b[2];
+    const float z = a[0] * b[1] - a[1] * b[0];
+    out[0] = x; out[1] = y; out[2] = z;
+}
+
+// Leaves vectors shorter than 1e-6 unchanged.
+inline void Normalize3(float v[3]) {
+    const float len = std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+    if (len > 1e-6f) { v[0] /= len; v[1] /= len; v[2] /= len; }
+}
+
+// ─── Dispatching kernels ─────────────────────────────────────────────────────
+
+#if MATRIX_KERNELS_SSE2
+
+// Row i of a * b, summed in the scalar reference order.
+inline __m128 MultiplyRow(const float* ai, __m128 b0, __m128 b1, __m128 b2, __m128 b3) {
+    __m128 r = _mm_mul_ps(_mm_set1_ps(ai[0]), b0);
+    r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(ai[1]), b1));
+    r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(ai[2]), b2));
+    return _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(ai[3]), b3));
+}
+
+inline void Multiply(const float* a, const float* b, float* out) {
+    const __m128 b0 = _mm_loadu_ps(b);
+    const __m128 b1 = _mm_loadu_ps(b + 4);
+    const __m128 b2 = _mm_loadu_ps(b + 8);
+    const __m128 b3 = _mm_loadu_ps(b + 12);
+    __m128 rows[4];
+    for (int i = 0; i < 4; ++i) {
+        rows[i] = MultiplyRow(a + i * 4, b0, b1, b2, b3);
+    }
+    for (int i = 0; i < 4; ++i) {
+        _mm_storeu_ps(out + i * 4, rows[i]);
+    }
+}
+
+inline void MultiplyPair(const float* a0, const float* a1, const float* b, float* out0, float* out1) {
+    const __m128 b0 = _mm_loadu_ps(b);
+    const __m128 b1 = _mm_loadu_ps(b + 4);
+    const __m128 b2 = _mm_loadu_ps(b + 8);
+    const __m128 b3 = _mm_loadu_ps(b + 12);
+    // Row i of either output depends only on row i of its left operand, so rows can be
+    // stored as they complete even when an output aliases a left operand.
+    for (int i = 0; i < 4; ++i) {
+        const __m128 r0 = MultiplyRow(a0 + i * 4, b0, b1, b2, b3);
+        const __m128 r1 = MultiplyRow(a1 + i * 4, b0, b1, b2, b3);
+        _mm_storeu_ps(out0 + i * 4, r0);
+        _mm_storeu_ps(out1 + i * 4, r1);
+    }
+}
+
+inline void MultiplySharedLeft(const float* a, const float* b0, const float* b1, float* out0, float* out1) {
+    const __m128 x0 = _mm_loadu_ps(b0);
+    const __m128 x1 = _mm_loadu_ps(b0 + 4);
+    const __m128 x2 = _mm_loadu_ps(b0 + 8);
+    const __m128 x3 = _mm_loadu_ps(b0 + 12);
+    const __m128 y0 = _mm_loadu_ps(b1);
+    const __m128 y1 = _mm_loadu_ps(b1 + 4);
+    const __m128 y2 = _mm_loadu_ps(b1 + 8);
+    const __m128 y3 = _mm_loadu_ps(b1 + 12);
+    for (int i = 0; i < 4; ++i) {
+        const __m128 r0 = MultiplyRow(a + i * 4, x0, x1, x2, x3);
+        const __m128 r1 = MultiplyRow(a + i * 4, y0, y1, y2, y3);
+        _mm_storeu_ps(out0 + i * 4, r0);
+        _mm_storeu_ps(out1 + i * 4, r1);
+    }
+}
+
+inline void Transpose(const float* m, float* out) {
+    __m128 r0 = _mm_loadu_ps(m);
+    __m128 r1 = _mm_loadu_ps(m + 4);
+    __m128 r2 = _mm_loadu_ps(m + 8);
+    __m128 r3 = _mm_loadu_ps(m + 12);
+    _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+    _mm_storeu_ps(out, r0);
+    _mm_storeu_ps(out + 4, r1);
+    _mm_storeu_ps(out + 8, r2);
+    _mm_storeu_ps(out + 12, r3);
+}
+
+inline void InvertRigid(const float* m, float* out) {
+    __m128 r0 = _mm_loadu_ps(m);
+    __m128 r1 = _mm_loadu_ps(m + 4);
+    __m128 r2 = _mm_loadu_ps(m + 8);
+    __m128 r3 = _mm_setzero_ps();
+    _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+    const __m128 t = _mm_loadu_ps(m + 12);
+    __m128 translation = _mm_mul_ps(_mm_shuffle_ps(t, t, _MM_SHUFFLE(0, 0, 0, 0)), r0);
+    translation = _mm_add_ps(translation, _mm_mul_ps(_mm_shuffle_ps(t, t, _MM_SHUFFLE(1, 1, 1, 1)), r1));
+    translation = _mm_add_ps(translation, _mm_mul_ps(_mm_shuffle_ps(t, t, _MM_SHUFFLE(2, 2, 2, 2)), r2));
+    translation = _mm_xor_ps(translation, _mm_set1_ps(-0.0f));
+    alignas(16) float last[4];
+    _mm_store_ps(last, translation);
+    last[3] = 1.0f;
+    _mm_storeu_ps(out, r0);
+    _mm_storeu_ps(out + 4, r1);
+    _mm_storeu_ps(out + 8, r2);
+    _mm_storeu_ps(out + 12, _mm_load_ps(last));
+}
+
+inline __m128 Product3(__m128 a, __m128 b, __m128 c) {
+    return _mm_mul_ps(_mm_mul_ps(a, b), c);
+}
+
+// Cofactor expansion with four outputs per vector. Each lane performs the same
+// multiplies and adds, in the same order, as the scalar reference; subtractions
+// become additions of a negated first factor, which IEEE rounding makes exact.
+inline bool Invert4x4(const float* m, float* out, float* outDeterminant) {
+    alignas(16) float inv[16];
+    {
+        __m128 row = Product3(_mm_setr_ps(m[5], -m[1], m[1], -m[1]),
+                              _mm_setr_ps(m[10], m[10], m[6], m[6]),
+                              _mm_setr_ps(m[15], m[15], m[15], m[11]));
+        row = _mm_add_ps(row, Product3(_mm_setr_ps(-m[5], m[1], -m[1], m[1]),
+                                       _mm_setr_ps(m[11], m[11], m[7], m[7]),
+                                       _mm_setr_ps(m[14], m[14], m[14], m[10])));
+        row = _mm_add_ps(row, Product3(_mm_setr_ps(-m[9], m[9], -m[5], m[5]),
+                                       _mm_setr_ps(m[6], m[2], m[2], m[2]),
+                                       _mm_setr_ps(m[15], m[15], m[15], m[11])));
+        row = _mm_add_ps(row, Product3(_mm_setr_ps(m[9], -m[9], m[5], -m[5]),
+                                       _mm_setr_ps(m[7], m[3], m[3], m[3]),
+                                       _mm_setr_ps(m[14], m[14], m[14], m[10])));
+        row = _mm_add_ps(row, Product3(_mm_setr_ps(m[13], -m[13], m[13], -m[9]),
+                                       _mm_setr_ps(m[6], m[2], m[2], m[2]),
+                                       _mm_setr_ps(m[11], m[11], m[7], m[7])));
+        row = _mm_add_ps(row, Product3(_mm_setr_ps(-m[13], m[13], -m[13], m[9]),
+                                       _mm_setr_ps(m[7], m[3], m[3], m[3]),
+                                       _mm_setr_ps(m[10], m[10], m[6], m[6])));
+        _mm_store_ps(inv + 0, row);
+    }
+    {
+        __m128 row = Product3(_mm_setr_ps(-m[4], m[0], -m[0], m[0]),
+                              _mm_setr_ps(m[10], m[10], m[6], m[6]),
+                              _mm_setr_ps(m[15], m[15], m[15], m[11]));
+        row = _mm_add_ps(row, Product3(_mm_setr_ps(m[4], -m[0], m[0], -m[0]),
+                                       _mm_setr_ps(m[11], m[11], m[7], m[7]),
+                                       _mm_setr_ps(m[14], m[14], m[14], m[10])));
+        row = _mm_add_ps(row, Product3(_mm_setr_ps(m[8], -m[8], m[4], -m[4]),
+                                       _mm_setr_ps(m[6], m[2], m[2], m[2]),
+                                       _mm_setr_ps(m[15], m[15], m[15], m[11])));
+        row = _mm_add_ps(row, Product3(_mm_setr_ps(-m[8], m[8], -m[4], m[4]),
+                                       _mm_setr_ps(m[7], m[3], m[3], m[3]),
+                                       _mm_setr_ps(m[14], m[14], m[14], m[10])));
+        row = _mm_add_ps(row, Product3(_mm_setr_ps(-m[12], m[12], -m[12], m[8]),
+                                       _mm_setr_ps(m[6], m[2], m[2], m[2]),
+                                       _mm_setr_ps(m[11], m[11], m[7], m[7])));
+        row = _mm_add_ps(row, Product3(_mm_setr_ps(m[12], -m[12], m[12], -m[8]),
+                                       _mm_setr_ps(m[7], m[3], m[3], m[3]),
+                                       _mm_setr_ps(m[10], m[10], m[6], m[6])));
+        _mm_store_ps(inv + 4, row);
+    }
+    {
+        __m128 row = Product3(_mm_setr_ps(m[4], -m[0], m[0], -m[0]),
+                              _mm_setr_ps(m[9], m[9], m[5], m[5]),
+                              _mm_setr_ps(m[15], m[15], m[15], m[11]));
+        row = _mm_add_ps(row, Product3(_mm_setr_ps(-m[4], m[0], -m[0], m[0]),
+                                       _mm_setr_ps(m[11], m[11], m[7], m[7]),
+                                       _mm_setr_ps(m[13], m[13], m[13], m[9])));
+        row = _mm_add_ps(row, Product3(_mm_setr_ps(-m[8], m[8], -m[4], m[4]),
+                                       _mm_setr_ps(m[5], m[1], m[1], m[1]),
+                                       _mm_setr_ps(m[15], m[15], m[15], m[11])));
+        row = _mm_add_ps(row, Product3(_mm_setr_ps(m[8], -m[8], m[4], -m[4]),
+                                       _mm_setr_ps(m[7], m[3], m[3], m[3]),
+                                       _mm_setr_ps(m[13], m[13], m[13], m[9])));
+        row = _mm_add_ps(row, Product3(_mm_setr_ps(m[12], -m[12], m[12], -m[8]),
+                                       _mm_setr_ps(m[5], m[1], m[1], m[1]),
+                                       _mm_setr_ps(m[11], m[11], m[7], m[7])));
+        row = _mm_add_ps(row, Product3(_mm_setr_ps(-m[12], m[12], -m[12], m[8]),
+                                       _mm_setr_ps(m[7], m[3], m[3], m[3]),
+                                       _mm_setr_ps(m[9], m[9], m[5], m[5])));
+        _mm_store_ps(inv + 8, row);
+    }
+    {
+        __m128 row = Product3(_mm_setr_ps(-m[4], m[0], -m[0], m[0]),
+                              _mm_setr_ps(m[9], m[9], m[5], m[5]),
+                              _mm_setr_ps(m[14], m[14], m[14], m[10]));
+        row = _mm_add_ps(row, Product3(_mm_setr_ps(m[4], -m[0], m[0], -m[0]),
+                                       _mm_setr_ps(m[10], m[10], m[6], m[6]),
+                                       _mm_setr_ps(m[13], m[13], m[13], m[9])));
+        row = _mm_add_ps(row, Product3(_mm_setr_ps(m[8], -m[8], m[4], -m[4]),
+                                       _mm_setr_ps(m[5], m[1], m[1], m[1]),
+                                       _mm_setr_ps(m[14], m[14], m[14], m[10])));
+        row = _mm_add_ps(row, Product3(_mm_setr_ps(-m[8], m[8], -m[4], m[4]),
+                                       _mm_setr_ps(m[6], m[2], m[2], m[2]),
+                                       _mm_setr_ps(m[13], m[13], m[13], m[9])));
+        row = _mm_add_ps(row, Product3(_mm_setr_ps(-m[12], m[12], -m[12], m[8]),
+                                       _mm_setr_ps(m[5], m[1], m[1], m[1]),
+                                       _mm_setr_ps(m[10], m[10], m[6], m[6])));
+        row = _mm_add_ps(row, Product3(_mm_setr_ps(m[12], -m[12], m[12], -m[8]),
+                                       _mm_setr_ps(m[6], m[2], m[2], m[2]),
+                                       _mm_setr_ps(m[9], m[9], m[5], m[5])));
+        _mm_store_ps(inv + 12, row);
+    }
+
+    const float det = m[0] * inv[0] + m[1] * inv[4] + m[2] * inv[8] + m[3] * inv[12];
+    if (outDeterminant) {
+        *outDeterminant = det;
+    }
+    if (std::fabs(det) <= 1e-8f) {
+        return false;
+    }
+    const __m128 detInv = _mm_set1_ps(1.0f / det);
+    for (int i = 0; i < 16; i += 4) {
+        _mm_storeu_ps(out + i, _mm_mul_ps(_mm_load_ps(inv + i), detInv));
+    }
+    return true;
+}
+
+// NaN differences are skipped, as in the scalar reference.
+inline float MaxAbsDiff(const float* a, const float* b) {
+    const __m128 signMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+    __m128 maxErr = _mm_setzero_ps();
+    for (int i = 0; i < 16; i += 4) {
+        const __m128 err = _mm_and_ps(_mm_sub_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)), signMask);
+        maxErr = _mm_max_ps(err, maxErr);
+    }
+    maxErr = _mm_max_ps(maxErr, _mm_shuffle_ps(maxErr, maxErr, _MM_SHUFFLE(1, 0, 3, 2)));
+    maxErr = _mm_max_ps(maxErr, _mm_shuffle_ps(maxErr, maxErr, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtss_f32(maxErr);
+}
+
+inline void TransformPoint(const float* m, const float in[3], float out[3]) {
+    __m128 r = _mm_mul_ps(_mm_set1_ps(in[0]), _mm_loadu_ps(m));
+    r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(in[1]), _mm_loadu_ps(m + 4)));
+    r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(in[2]), _mm_loadu_ps(m + 8)));
+    r = _mm_add_ps(r, _mm_loadu_ps(m + 12));
+    alignas(16) float v[4];
+    _mm_store_ps(v, r);
+    out[0] = v[0]; out[1] = v[1]; out[2] = v[2];
+}
+
+inline void TransformDirection(const float* m, const float in[3], float out[3]) {
+    __m128 r = _mm_mul_ps(_mm_set1_ps(in[0]), _mm_loadu_ps(m));
+    r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(in[1]), _mm_loadu_ps(m + 4)));
+    r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(in[2]), _mm_loadu_ps(m + 8)));
+    alignas(16) float v[4];
+    _mm_store_ps(v, r);
+    out[0] = v[0]; out[1] = v[1]; out[2] = v[2];
+}
+
+#else
+
+inline void Multiply(const float* a, const float* b, float* out) { scalar::Multiply(a, b, out); }
+inline void MultiplyPair(const float* a0, const float* a1, const float* b, float* out0, float* out1) {
+    scalar::MultiplyPair(a0, a1, b, out0, out1);
+}
+inline void MultiplySharedLeft(const float* a, const float* b0, const float* b1, float* out0, float* out1) {
+    scalar::MultiplySharedLeft(a, b0, b1, out0, out1);
+}
+inline void Transpose(const float* m, float* out) { scalar::Transpose(m, out); }
+inline void InvertRigid(const float* m, float* out) { scalar::InvertRigid(m, out); }
+inline bool Invert4x4(const float* m, float* out, float* outDeterminant) {
+    return scalar::Invert4x4(m, out, outDeterminant);
+}
+inline float MaxAbsDiff(const float* a, const float* b) { return scalar::MaxAbsDiff(a, b); }
+inline void TransformPoint(const float* m, const float in[3], float out[3]) { scalar::TransformPoint(m, in, out); }
+inline void TransformDirection(const float* m, const float in[3], float out[3]) {
+    scalar::TransformDirection(m, in, out);
+}
+
+#endif
+
+// ─── Scalar-only kernels ─────────────────────────────────────────────────────
+
+// Inverse of an affine matrix (no projective column): 3x3 inverse plus
+// translation. Fails when |det| < 1e-8.
+inline bool InvertAffine(const float* m, float* out) {
+    const float det = m[0] * (m[5] * m[10] - m[6] * m[9]) -
+                      m[1] * (m[4] * m[10] - m[6] * m[8]) +
+                      m[2] * (m[4] * m[9] - m[5] * m[8]);
+    if (std::fabs(det) < 1e-8f) return false;
+    const float id = 1.0f / det;
+    float r[16];
+    r[0]  =  (m[5] * m[10] - m[6] * m[9]) * id;
+    r[1]  = -(m[1] * m[10] - m[2] * m[9]) * id;
+    r[2]  =  (m[1] * m[6]  - m[2] * m[5]) * id;
+    r[4]  = -(m[4] * m[10] - m[6] * m[8]) * id;
+    r[5]  =  (m[0] * m[10] - m[2] * m[8]) * id;
+    r[6]  = -(m[0] * m[6]  - m[2] * m[4]) * id;
+    r[8]  =  (m[4] * m[9]  - m[5] * m[8]) * id;
+    r[9]  = -(m[0] * m[9]  - m[1] * m[8]) * id;
+    r[10] =  (m[0] * m[5]  - m[1] * m[4]) * id;
+    r[3] = r[7] = r[11] = 0.0f; r[15] = 1.0f;
+    r[12] = -(m[12] * r[0] + m[13] * r[4] + m[14] * r[8]);
+    r[13] = -(m[12] * r[1] + m[13] * r[5] + m[14] * r[9]);
+    r[14] = -(m[12] * r[2] + m[13] * r[6] + m[14] * r[10]);
+    for (int i = 0; i < 16; ++i) out[i] = r[i];
+    return true;
+}
+
+// Gram-Schmidt on the first two rows, third row from their cross product, and the
+// original translation re-expressed in the new basis.
+inline void OrthonormalizeView(float* m) {
+    const float origTx = m[12];
+    const float origTy = m[13];
+    const float origTz = m[14];
+
+    float r0x = m[0], r0y = m[1], r0z = m[2];
+    float r1x = m[4], r1y = m[5], r1z = m[6];
+
+    const float len0 = std::sqrt(Dot3(r0x, r0y, r0z, r0x, r0y, r0z));
+    if (len0 > 1e-6f) {
+        r0x /= len0; r0y /= len0; r0z /= len0;
+    }
+
+    const float dot01 = Dot3(r1x, r1y, r1z, r0x, r0y, r0z);
+    r1x -= dot01 * r0x;
+    r1y -= dot01 * r0y;
+    r1z -= dot01 * r0z;
+
+    const float len1 = std::sqrt(Dot3(r1x, r1y, r1z, r1x, r1y, r1z));
+    if (len1 > 1e-6f) {
+        r1x /= len1; r1y /= len1; r1z /= len1;
+    }
+
+    const float r2x = r0y * r1z - r0z * r1y;
+    const float r2y = r0z * r1x - r0x * r1z;
+    const float r2z = r0x * r1y - r0y * r1x;
+
+    m[0] = r0x; m[1] = r0y; m[2]  = r0z; m[3]  = 0.0f;
+    m[4] = r1x; m[5] = r1y; m[6]  = r1z; m[7]  = 0.0f;
+    m[8] = r2x; m[9] = r2y; m[10] = r2z; m[11] = 0.0f;
+    m[12] = Dot3(origTx, origTy, origTz, m[0], m[1], m[2]);
+    m[13] = Dot3(origTx, origTy, origTz, m[4], m[5], m[6]);
+    m[14] = Dot3(origTx, origTy, origTz, m[8], m[9], m[10]);
+    m[15] = 1.0f;
+}
+
+} // namespace matrix_kernels
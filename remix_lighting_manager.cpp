@@ -1,4 +1,6 @@
     #include "remix_lighting_manager.h"
+#include "fast_hash.h"
+#include "matrix_kernels.h"
 #include "remix_api.h"
 #include "remix_logger.h"
 
@@ -107,51 +109,28 @@ float RemixLightingManager::ComputeIntensity(const float color[3]) const {
 
 bool RemixLightingManager::InvertMatrix(const D3DMATRIX& m, D3DMATRIX* out) const {
     if (!out) return false;
-    float det =
-        m._11*(m._22*m._33 - m._23*m._32) -
-        m._12*(m._21*m._33 - m._23*m._31) +
-        m._13*(m._21*m._32 - m._22*m._31);
-    if (std::fabs(det) < 1e-8f) return false;
-    float id = 1.0f / det;
-    out->_11 =  (m._22*m._33 - m._23*m._32) * id;
-    out->_12 = -(m._12*m._33 - m._13*m._32) * id;
-    out->_13 =  (m._12*m._23 - m._13*m._22) * id;
-    out->_21 = -(m._21*m._33 - m._23*m._31) * id;
-    out->_22 =  (m._11*m._33 - m._13*m._31) * id;
-    out->_23 = -(m._11*m._23 - m._13*m._21) * id;
-    out->_31 =  (m._21*m._32 - m._22*m._31) * id;
-    out->_32 = -(m._11*m._32 - m._12*m._31) * id;
-    out->_33 =  (m._11*m._22 - m._12*m._21) * id;
-    out->_14 = out->_24 = out->_34 = 0.0f; out->_44 = 1.0f;
-    out->_41 = -(m._41*out->_11 + m._42*out->_21 + m._43*out->_31);
-    out->_42 = -(m._41*out->_12 + m._42*out->_22 + m._43*out->_32);
-    out->_43 = -(m._41*out->_13 + m._42*out->_23 + m._43*out->_33);
-    return true;
+    return matrix_kernels::InvertAffine(&m._11, &out->_11);
 }
 
 void RemixLightingManager::TransformPosition(const D3DMATRIX& m, const float in[3], float out[3]) const {
-    out[0] = in[0]*m._11 + in[1]*m._21 + in[2]*m._31 + m._41;
-    out[1] = in[0]*m._12 + in[1]*m._22 + in[2]*m._32 + m._42;
-    out[2] = in[0]*m._13 + in[1]*m._23 + in[2]*m._33 + m._43;
+    matrix_kernels::TransformPoint(&m._11, in, out);
 }
 
 void RemixLightingManager::TransformDirection(const D3DMATRIX& m, const float in[3], float out[3]) const {
-    out[0] = in[0]*m._11 + in[1]*m._21 + in[2]*m._31;
-    out[1] = in[0]*m._12 + in[1]*m._22 + in[2]*m._32;
-    out[2] = in[0]*m._13 + in[1]*m._23 + in[2]*m._33;
+    matrix_kernels::TransformDirection(&m._11, in, out);
 }
 
 uint64_t RemixLightingManager::ComputeSignature(const ManagedLight& l) const {
     auto q = [](float v){ return static_cast<int64_t>(std::llround(v * 1000.0f)); };
-    uint64_t h = 1469598103934665603ull;
-    auto mix = [&](uint64_t x){ h ^= x; h *= 1099511628211ull; };
-    mix(static_cast<uint64_t>(l.type));
-    mix(static_cast<uint64_t>(q(l.position[0]))); mix(static_cast<uint64_t>(q(l.position[1]))); mix(static_cast<uint64_t>(q(l.position[2])));
-    mix(static_cast<uint64_t>(q(l.direction[0]))); mix(static_cast<uint64_t>(q(l.direction[1]))); mix(static_cast<uint64_t>(q(l.direction[2])));
-    mix(static_cast<uint64_t>(q(l.color[0]))); mix(static_cast<uint64_t>(q(l.color[1]))); mix(static_cast<uint64_t>(q(l.color[2])));
-    mix(static_cast<uint64_t>(q(l.intensity)));
-    mix(static_cast<uint64_t>(q(l.coneAngle)));
-    return h;
+    const int64_t fields[12] = {
+        static_cast<int64_t>(l.type),
+        q(l.position[0]), q(l.position[1]), q(l.position[2]),
+        q(l.direction[0]), q(l.direction[1]), q(l.direction[2]),
+        q(l.color[0]), q(l.color[1]), q(l.color[2]),
+        q(l.intensity),
+        q(l.coneAngle)
+    };
+    return FastHash64(fields, sizeof(fields));
 }
 
 void RemixLightingManager::FillRawRegisters(ManagedLight& light, int base, const float constants[][4]) {
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#include <emmintrin.h>
+#endif
+
+// ─── Seqlock ─────────────────────────────────────────────────────────────────
+//
+// Publishes a block of plain data from the render thread to readers on other
+// threads without ever blocking the writer on a reader. Writers serialize on a
+// mutex and hold the sequence odd while they write; readers copy without locking
+// and retry when the sequence was odd or moved during the copy. Header-only and
+// free of Windows/D3D9 dependencies so tools/seqlock_stress.cpp can exercise the
+// same code the proxy runs.
+
+class SeqLock {
+public:
+    template <typename WriteFn>
+    void Write(WriteFn&& write) {
+        std::lock_guard<std::mutex> lock(m_writeMutex);
+        const uint32_t sequence = m_sequence.load(std::memory_order_relaxed);
+        m_sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        write();
+        m_sequence.store(sequence + 2, std::memory_order_release);
+    }
+
+    // `read` may run several times and must only copy; its result is consistent
+    // once Read returns.
+    template <typename ReadFn>
+    void Read(ReadFn&& read) const {
+        for (;;) {
+            const uint32_t before = m_sequence.load(std::memory_order_acquire);
+            if (before & 1u) {
+                Pause();
+                continue;
+            }
+            read();
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (m_sequence.load(std::memory_order_relaxed) == before) {
+                return;
+            }
+        }
+    }
+
+private:
+    static void Pause() {
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+        _mm_pause();
+#else
+        std::this_thread::yield();
+#endif
+    }
+
+    std::mutex m_writeMutex;
+    std::atomic<uint32_t> m_sequence{0};
+};
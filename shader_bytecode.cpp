@@ -0,0 +1,447 @@
+#include "shader_bytecode.h"
+
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+
+// ─── token fields ────────────────────────────────────────────────────────────
+
+static constexpr uint32_t kOpcodeMask = 0x0000FFFFu;
+static constexpr uint32_t kControlShift = 16;
+static constexpr uint32_t kLengthShift = 24;
+static constexpr uint32_t kPredicatedBit = 0x10000000u;
+static constexpr uint32_t kCoissueBit = 0x40000000u;
+static constexpr uint32_t kParameterBit = 0x80000000u;
+static constexpr uint32_t kCommentLengthShift = 16;
+static constexpr uint32_t kRelativeBit = 0x00002000u;
+
+static uint8_t ParameterFile(uint32_t token) {
+    return static_cast<uint8_t>(((token >> 28) & 0x7u) | ((token >> 8) & 0x18u));
+}
+
+static bool IsConstFile(uint8_t file) {
+    return file == ShaderReg_Const || file == ShaderReg_Const2 ||
+           file == ShaderReg_Const3 || file == ShaderReg_Const4;
+}
+
+static void DecodeParameter(uint32_t token, bool isDst, ShaderOperand* out) {
+    out->file = ParameterFile(token);
+    out->index = static_cast<uint16_t>(token & 0x7FFu);
+    // c2048+ are encoded as separate files.
+    if (out->file == ShaderReg_Const2) out->index = static_cast<uint16_t>(out->index + 2048);
+    if (out->file == ShaderReg_Const3) out->index = static_cast<uint16_t>(out->index + 4096);
+    if (out->file == ShaderReg_Const4) out->index = static_cast<uint16_t>(out->index + 6144);
+    if (IsConstFile(out->file)) out->file = ShaderReg_Const;
+    out->relative = (token & kRelativeBit) != 0;
+    if (isDst) {
+        out->mask = static_cast<uint8_t>((token >> 16) & 0xFu);
+        out->modifier = static_cast<uint8_t>((token >> 20) & 0xFu);
+    } else {
+        out->mask = static_cast<uint8_t>((token >> 16) & 0xFFu);
+        out->modifier = static_cast<uint8_t>((token >> 24) & 0xFu);
+    }
+}
+
+static bool OpcodeHasDst(uint16_t opcode) {
+    switch (opcode) {
+    case ShaderOp_Nop:
+    case ShaderOp_Call:
+    case ShaderOp_CallNz:
+    case ShaderOp_Loop:
+    case ShaderOp_Ret:
+    case ShaderOp_EndLoop:
+    case ShaderOp_Label:
+    case ShaderOp_Rep:
+    case ShaderOp_EndRep:
+    case ShaderOp_If:
+    case ShaderOp_IfC:
+    case ShaderOp_Else:
+    case ShaderOp_EndIf:
+    case ShaderOp_Break:
+    case ShaderOp_BreakC:
+    case ShaderOp_BreakP:
+    case ShaderOp_Phase:
+        return false;
+    default:
+        return true;
+    }
+}
+
+// ─── decoder ─────────────────────────────────────────────────────────────────
+
+ShaderDecodeStatus DecodeShaderBytecode(const uint32_t* tokens, size_t tokenCount,
+                                        ShaderProgram* out, size_t* outErrorToken) {
+    if (!out) return ShaderDecode_Empty;
+    *out = ShaderProgram();
+    size_t pos = 0;
+    auto fail = [&](ShaderDecodeStatus status) {
+        if (outErrorToken) *outErrorToken = pos;
+        return status;
+    };
+    if (!tokens || tokenCount == 0) return fail(ShaderDecode_Empty);
+
+    const uint32_t version = tokens[0];
+    const uint32_t kind = version & 0xFFFF0000u;
+    if (kind != 0xFFFE0000u && kind != 0xFFFF0000u) return fail(ShaderDecode_BadVersion);
+    out->isPixelShader = kind == 0xFFFF0000u;
+    out->major = static_cast<uint8_t>((version >> 8) & 0xFFu);
+    out->minor = static_cast<uint8_t>(version & 0xFFu);
+    if (out->major < 1 || out->major > 3) return fail(ShaderDecode_BadVersion);
+    const bool sm2 = out->major >= 2;
+    out->instructions.reserve(tokenCount / 3);
+
+    pos = 1;
+    while (pos < tokenCount) {
+        const uint32_t token = tokens[pos];
+        const uint16_t opcode = static_cast<uint16_t>(token & kOpcodeMask);
+        if (opcode == ShaderOp_End) {
+            return ShaderDecode_Ok;
+        }
+        if (opcode == ShaderOp_Comment) {
+            const size_t length = (token >> kCommentLengthShift) & 0x7FFFu;
+            if (length > tokenCount - pos - 1) return fail(ShaderDecode_Truncated);
+            pos += 1 + length;
+            continue;
+        }
+
+        // Parameter tokens of this instruction: [pos + 1, end).
+        size_t end = pos + 1;
+        if (sm2) {
+            end += (token >> kLengthShift) & 0xFu;
+        } else if (opcode == ShaderOp_Def) {
+            end += 5;
+        } else {
+            while (end < tokenCount && (tokens[end] & kParameterBit)) ++end;
+        }
+        if (end > tokenCount) return fail(ShaderDecode_Truncated);
+
+        ShaderInstruction inst;
+        inst.opcode = opcode;
+        inst.control = static_cast<uint8_t>((token >> kControlShift) & 0xFFu);
+        inst.predicated = sm2 && (token & kPredicatedBit) != 0;
+        inst.coissue = !sm2 && (token & kCoissueBit) != 0;
+
+        size_t p = pos + 1;
+        if (opcode == ShaderOp_Dcl) {
+            if (p >= end) return fail(ShaderDecode_Malformed);
+            inst.extra[0] = tokens[p++];
+        }
+        if (OpcodeHasDst(opcode)) {
+            if (p >= end) return fail(ShaderDecode_Malformed);
+            inst.hasDst = true;
+            DecodeParameter(tokens[p++], true, &inst.dst);
+            if (inst.dst.relative && sm2 && p < end) {
+                const uint32_t rel = tokens[p++];
+                inst.dst.relativeFile = ParameterFile(rel);
+                inst.dst.relativeIndex = static_cast<uint16_t>(rel & 0x7FFu);
+                inst.dst.relativeComponent = static_cast<uint8_t>((rel >> 16) & 0x3u);
+            }
+        }
+        if (opcode == ShaderOp_Def || opcode == ShaderOp_DefI || opcode == ShaderOp_DefB) {
+            const size_t literals = opcode == ShaderOp_DefB ? 1u : 4u;
+            if (end - p < literals) return fail(ShaderDecode_Malformed);
+            for (size_t i = 0; i < literals; ++i) inst.extra[i] = tokens[p + i];
+            p = end;
+        }
+        if (inst.predicated && p < end) {
+            DecodeParameter(tokens[p++], false, &inst.predicate);
+        }
+        while (p < end) {
+            if (inst.srcCount >= kShaderMaxSources) return fail(ShaderDecode_Malformed);
+            ShaderOperand& src = inst.src[inst.srcCount++];
+            DecodeParameter(tokens[p++], false, &src);
+            if (src.relative) {
+                if (sm2) {
+                    if (p >= end) return fail(ShaderDecode_Malformed);
+                    const uint32_t rel = tokens[p++];
+                    src.relativeFile = ParameterFile(rel);
+                    src.relativeIndex = static_cast<uint16_t>(rel & 0x7FFu);
+                    src.relativeComponent = static_cast<uint8_t>((rel >> 16) & 0x3u);
+                } else {
+                    src.relativeFile = ShaderReg_Addr;
+                    src.relativeIndex = 0;
+                    src.relativeComponent = 0;
+                }
+            }
+        }
+        out->instructions.push_back(inst);
+        pos = end;
+    }
+    return fail(ShaderDecode_MissingEnd);
+}
+
+const char* ShaderDecodeStatusName(ShaderDecodeStatus status) {
+    switch (status) {
+    case ShaderDecode_Ok: return "ok";
+    case ShaderDecode_Empty: return "empty";
+    case ShaderDecode_BadVersion: return "bad version token";
+    case ShaderDecode_Truncated: return "truncated";
+    case ShaderDecode_Malformed: return "malformed instruction";
+    case ShaderDecode_MissingEnd: return "missing end token";
+    }
+    return "unknown";
+}
+
+// ─── text ────────────────────────────────────────────────────────────────────
+
+const char* ShaderOpcodeName(uint16_t opcode) {
+    switch (opcode) {
+    case ShaderOp_Nop: return "nop";
+    case ShaderOp_Mov: return "mov";
+    case ShaderOp_Add: return "add";
+    case ShaderOp_Sub: return "sub";
+    case ShaderOp_Mad: return "mad";
+    case ShaderOp_Mul: return "mul";
+    case ShaderOp_Rcp: return "rcp";
+    case ShaderOp_Rsq: return "rsq";
+    case ShaderOp_Dp3: return "dp3";
+    case ShaderOp_Dp4: return "dp4";
+    case ShaderOp_Min: return "min";
+    case ShaderOp_Max: return "max";
+    case ShaderOp_Slt: return "slt";
+    case ShaderOp_Sge: return "sge";
+    case ShaderOp_Exp: return "exp";
+    case ShaderOp_Log: return "log";
+    case ShaderOp_Lit: return "lit";
+    case ShaderOp_Dst: return "dst";
+    case ShaderOp_Lrp: return "lrp";
+    case ShaderOp_Frc: return "frc";
+    case ShaderOp_M4x4: return "m4x4";
+    case ShaderOp_M4x3: return "m4x3";
+    case ShaderOp_M3x4: return "m3x4";
+    case ShaderOp_M3x3: return "m3x3";
+    case ShaderOp_M3x2: return "m3x2";
+    case ShaderOp_Call: return "call";
+    case ShaderOp_CallNz: return "callnz";
+    case ShaderOp_Loop: return "loop";
+    case ShaderOp_Ret: return "ret";
+    case ShaderOp_EndLoop: return "endloop";
+    case ShaderOp_Label: return "label";
+    case ShaderOp_Dcl: return "dcl";
+    case ShaderOp_Pow: return "pow";
+    case ShaderOp_Crs: return "crs";
+    case ShaderOp_Sgn: return "sgn";
+    case ShaderOp_Abs: return "abs";
+    case ShaderOp_Nrm: return "nrm";
+    case ShaderOp_SinCos: return "sincos";
+    case ShaderOp_Rep: return "rep";
+    case ShaderOp_EndRep: return "endrep";
+    case ShaderOp_If: return "if";
+    case ShaderOp_IfC: return "if";
+    case ShaderOp_Else: return "else";
+    case ShaderOp_EndIf: return "endif";
+    case ShaderOp_Break: return "break";
+    case ShaderOp_BreakC: return "break";
+    case ShaderOp_Mova: return "mova";
+    case ShaderOp_DefB: return "defb";
+    case ShaderOp_DefI: return "defi";
+    case ShaderOp_TexCoord: return "texcoord";
+    case ShaderOp_TexKill: return "texkill";
+    case ShaderOp_Tex: return "texld";
+    case ShaderOp_TexBem: return "texbem";
+    case ShaderOp_TexBemL: return "texbeml";
+    case ShaderOp_TexReg2AR: return "texreg2ar";
+    case ShaderOp_TexReg2GB: return "texreg2gb";
+    case ShaderOp_TexM3x2Pad: return "texm3x2pad";
+    case ShaderOp_TexM3x2Tex: return "texm3x2tex";
+    case ShaderOp_TexM3x3Pad: return "texm3x3pad";
+    case ShaderOp_TexM3x3Tex: return "texm3x3tex";
+    case ShaderOp_TexM3x3Spec: return "texm3x3spec";
+    case ShaderOp_TexM3x3VSpec: return "texm3x3vspec";
+    case ShaderOp_ExpP: return "expp";
+    case ShaderOp_LogP: return "logp";
+    case ShaderOp_Cnd: return "cnd";
+    case ShaderOp_Def: return "def";
+    case ShaderOp_TexReg2Rgb: return "texreg2rgb";
+    case ShaderOp_TexDp3Tex: return "texdp3tex";
+    case ShaderOp_TexM3x2Depth: return "texm3x2depth";
+    case ShaderOp_TexDp3: return "texdp3";
+    case ShaderOp_TexM3x3: return "texm3x3";
+    case ShaderOp_TexDepth: return "texdepth";
+    case ShaderOp_Cmp: return "cmp";
+    case ShaderOp_Bem: return "bem";
+    case ShaderOp_Dp2Add: return "dp2add";
+    case ShaderOp_Dsx: return "dsx";
+    case ShaderOp_Dsy: return "dsy";
+    case ShaderOp_TexLdd: return "texldd";
+    case ShaderOp_SetP: return "setp";
+    case ShaderOp_TexLdl: return "texldl";
+    case ShaderOp_BreakP: return "breakp";
+    case ShaderOp_Phase: return "phase";
+    default: return nullptr;
+    }
+}
+
+static const char* kComparisonSuffix[8] = { "", "_gt", "_eq", "_ge", "_lt", "_ne", "_le", "" };
+static const char* kDeclUsageName[14] = {
+    "position", "blendweight", "blendindices", "normal", "psize", "texcoord", "tangent",
+    "binormal", "tessfactor", "positiont", "color", "fog", "depth", "sample"
+};
+static const char kComponentName[4] = { 'x', 'y', 'z', 'w' };
+
+// Bounded appender; output is silently truncated at outSize.
+struct TextCursor {
+    char* out;
+    size_t size;
+    size_t used;
+
+    void Append(const char* format, ...) {
+        if (used + 1 >= size) return;
+        va_list args;
+        va_start(args, format);
+        const int written = vsnprintf(out + used, size - used, format, args);
+        va_end(args);
+        if (written > 0) {
+            used += static_cast<size_t>(written);
+            if (used >= size) used = size - 1;
+        }
+    }
+};
+
+void FormatShaderModel(const ShaderProgram& program, char* out, size_t outSize) {
+    if (!out || outSize == 0) return;
+    const char* stage = program.isPixelShader ? "ps" : "vs";
+    if (program.minor == 0xFF) {
+        snprintf(out, outSize, "%s_%u_sw", stage, program.major);
+    } else if (program.major == 2 && program.minor == 1) {
+        snprintf(out, outSize, "%s_2_x", stage);
+    } else {
+        snprintf(out, outSize, "%s_%u_%u", stage, program.major, program.minor);
+    }
+}
+
+static void AppendRegisterName(const ShaderProgram& program, uint8_t file, uint16_t index, TextCursor* text) {
+    switch (file) {
+    case ShaderReg_Temp: text->Append("r%u", index); break;
+    case ShaderReg_Input: text->Append("v%u", index); break;
+    case ShaderReg_Const: text->Append("c%u", index); break;
+    case ShaderReg_Addr: text->Append(program.isPixelShader ? "t%u" : "a%u", index); break;
+    case ShaderReg_RastOut:
+        text->Append("%s", index == 0 ? "oPos" : (index == 1 ? "oFog" : "oPts"));
+        break;
+    case ShaderReg_AttrOut: text->Append("oD%u", index); break;
+    case ShaderReg_Output:
+        text->Append(program.major >= 3 ? "o%u" : "oT%u", index);
+        break;
+    case ShaderReg_ConstInt: text->Append("i%u", index); break;
+    case ShaderReg_ColorOut: text->Append("oC%u", index); break;
+    case ShaderReg_DepthOut: text->Append("oDepth"); break;
+    case ShaderReg_Sampler: text->Append("s%u", index); break;
+    case ShaderReg_ConstBool: text->Append("b%u", index); break;
+    case ShaderReg_Loop: text->Append("aL"); break;
+    case ShaderReg_MiscType: text->Append("%s", index == 0 ? "vPos" : "vFace"); break;
+    case ShaderReg_Label: text->Append("l%u", index); break;
+    case ShaderReg_Predicate: text->Append("p%u", index); break;
+    default: text->Append("?%u_%u", file, index); break;
+    }
+}
+
+static void AppendOperand(const ShaderProgram& program, const ShaderOperand& op, bool isDst, TextCursor* text) {
+    // Source modifiers, D3DSPSM_* >> 24.
+    enum { Neg = 1, Bias, BiasNeg, Sign, SignNeg, Comp, X2, X2Neg, Dz, Dw, Abs, AbsNeg, Not };
+    const int mod = isDst ? 0 : op.modifier;
+    if (mod == Neg || mod == BiasNeg || mod == SignNeg || mod == X2Neg || mod == AbsNeg) text->Append("-");
+    if (mod == Comp) text->Append("1 - ");
+    if (mod == Not) text->Append("!");
+
+    AppendRegisterName(program, op.file, op.index, text);
+    if (op.relative) {
+        text->Append("[");
+        AppendRegisterName(program, op.relativeFile, op.relativeIndex, text);
+        if (op.relativeFile != ShaderReg_Loop) text->Append(".%c", kComponentName[op.relativeComponent & 3]);
+        text->Append("]");
+    }
+
+    if (mod == Bias || mod == BiasNeg) text->Append("_bias");
+    if (mod == Sign || mod == SignNeg) text->Append("_bx2");
+    if (mod == X2 || mod == X2Neg) text->Append("_x2");
+    if (mod == Dz) text->Append("_dz");
+    if (mod == Dw) text->Append("_dw");
+    if (mod == Abs || mod == AbsNeg) text->Append("_abs");
+
+    if (isDst) {
+        if (op.mask != 0 && op.mask != 0xF) {
+            text->Append(".");
+            for (int i = 0; i < 4; ++i) {
+                if (op.mask & (1 << i)) text->Append("%c", kComponentName[i]);
+            }
+        }
+        return;
+    }
+    if (op.mask == kShaderSwizzleIdentity) return;
+    const int c[4] = { op.mask & 3, (op.mask >> 2) & 3, (op.mask >> 4) & 3, (op.mask >> 6) & 3 };
+    if (c[0] == c[1] && c[1] == c[2] && c[2] == c[3]) {
+        text->Append(".%c", kComponentName[c[0]]);
+    } else {
+        text->Append(".%c%c%c%c", kComponentName[c[0]], kComponentName[c[1]],
+                     kComponentName[c[2]], kComponentName[c[3]]);
+    }
+}
+
+void FormatShaderInstruction(const ShaderProgram& program, const ShaderInstruction& inst,
+                             char* out, size_t outSize) {
+    if (!out || outSize == 0) return;
+    out[0] = '\0';
+    TextCursor text = { out, outSize, 0 };
+
+    if (inst.coissue) text.Append("+");
+    if (inst.predicated) {
+        text.Append("(");
+        AppendOperand(program, inst.predicate, false, &text);
+        text.Append(") ");
+    }
+
+    const char* name = ShaderOpcodeName(inst.opcode);
+    if (inst.opcode == ShaderOp_Tex && program.isPixelShader && program.major == 1 && program.minor < 4) {
+        name = "tex";
+    }
+    if (name) {
+        text.Append("%s", name);
+    } else {
+        text.Append("op_%u", inst.opcode);
+    }
+    if (inst.opcode == ShaderOp_IfC || inst.opcode == ShaderOp_BreakC || inst.opcode == ShaderOp_SetP) {
+        text.Append("%s", kComparisonSuffix[inst.control & 7]);
+    }
+    if (inst.opcode == ShaderOp_Dcl) {
+        const uint32_t usage = inst.extra[0] & 0x1Fu;
+        const uint32_t usageIndex = (inst.extra[0] >> 16) & 0xFu;
+        if (inst.dst.file == ShaderReg_Sampler) {
+            static const char* kTextureType[5] = { "", "", "_2d", "_cube", "_volume" };
+            const uint32_t type = (inst.extra[0] >> 27) & 0xFu;
+            text.Append("%s", type < 5 ? kTextureType[type] : "");
+        } else if ((!program.isPixelShader || program.major >= 3) && usage < 14) {
+            text.Append("_%s", kDeclUsageName[usage]);
+            if (usageIndex != 0) text.Append("%u", usageIndex);
+        }
+    }
+    if (inst.hasDst) {
+        if (inst.dst.modifier & 1) text.Append("_sat");
+        if (inst.dst.modifier & 2) text.Append("_pp");
+        if (inst.dst.modifier & 4) text.Append("_centroid");
+        text.Append(" ");
+        AppendOperand(program, inst.dst, true, &text);
+    }
+
+    if (inst.opcode == ShaderOp_Def) {
+        for (int i = 0; i < 4; ++i) {
+            float value = 0.0f;
+            memcpy(&value, &inst.extra[i], sizeof(value));
+            text.Append(", %g", value);
+        }
+        return;
+    }
+    if (inst.opcode == ShaderOp_DefI) {
+        for (int i = 0; i < 4; ++i) text.Append(", %d", static_cast<int>(inst.extra[i]));
+        return;
+    }
+    if (inst.opcode == ShaderOp_DefB) {
+        text.Append(", %s", inst.extra[0] ? "true" : "false");
+        return;
+    }
+
+    for (int i = 0; i < inst.srcCount; ++i) {
+        text.Append(i == 0 && !inst.hasDst ? " " : ", ");
+        AppendOperand(program, inst.src[i], false, &text);
+    }
+}
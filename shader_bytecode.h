@@ -0,0 +1,200 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// ─── Shader model 1-3 token stream ───────────────────────────────────────────
+//
+// Decoder for D3D9 vs/ps 1.x-3.0 bytecode into a compact typed IR, replacing the
+// D3DDisassemble text round trip. It has no Windows, D3D9 or d3dcompiler
+// dependencies. Opcode and register file values are the D3DSIO_* / D3DSPR_*
+// encodings, so they can be compared with the SDK constants directly.
+//
+//   u32 version            0xFFFE0000 | major << 8 | minor for vs, 0xFFFF.... for ps
+//   instruction*           opcode token, then destination / source parameter tokens
+//   u32 end                0x0000FFFF
+//
+// SM2+ opcode tokens carry their parameter count in bits 24-27. SM1 parameters are
+// recognised by bit 31 instead, except def, whose four literals are raw floats.
+
+enum ShaderOpcode : uint16_t {
+    ShaderOp_Nop = 0,
+    ShaderOp_Mov = 1,
+    ShaderOp_Add = 2,
+    ShaderOp_Sub = 3,
+    ShaderOp_Mad = 4,
+    ShaderOp_Mul = 5,
+    ShaderOp_Rcp = 6,
+    ShaderOp_Rsq = 7,
+    ShaderOp_Dp3 = 8,
+    ShaderOp_Dp4 = 9,
+    ShaderOp_Min = 10,
+    ShaderOp_Max = 11,
+    ShaderOp_Slt = 12,
+    ShaderOp_Sge = 13,
+    ShaderOp_Exp = 14,
+    ShaderOp_Log = 15,
+    ShaderOp_Lit = 16,
+    ShaderOp_Dst = 17,
+    ShaderOp_Lrp = 18,
+    ShaderOp_Frc = 19,
+    ShaderOp_M4x4 = 20,
+    ShaderOp_M4x3 = 21,
+    ShaderOp_M3x4 = 22,
+    ShaderOp_M3x3 = 23,
+    ShaderOp_M3x2 = 24,
+    ShaderOp_Call = 25,
+    ShaderOp_CallNz = 26,
+    ShaderOp_Loop = 27,
+    ShaderOp_Ret = 28,
+    ShaderOp_EndLoop = 29,
+    ShaderOp_Label = 30,
+    ShaderOp_Dcl = 31,
+    ShaderOp_Pow = 32,
+    ShaderOp_Crs = 33,
+    ShaderOp_Sgn = 34,
+    ShaderOp_Abs = 35,
+    ShaderOp_Nrm = 36,
+    ShaderOp_SinCos = 37,
+    ShaderOp_Rep = 38,
+    ShaderOp_EndRep = 39,
+    ShaderOp_If = 40,
+    ShaderOp_IfC = 41,
+    ShaderOp_Else = 42,
+    ShaderOp_EndIf = 43,
+    ShaderOp_Break = 44,
+    ShaderOp_BreakC = 45,
+    ShaderOp_Mova = 46,
+    ShaderOp_DefB = 47,
+    ShaderOp_DefI = 48,
+    ShaderOp_TexCoord = 64,
+    ShaderOp_TexKill = 65,
+    ShaderOp_Tex = 66,
+    ShaderOp_TexBem = 67,
+    ShaderOp_TexBemL = 68,
+    ShaderOp_TexReg2AR = 69,
+    ShaderOp_TexReg2GB = 70,
+    ShaderOp_TexM3x2Pad = 71,
+    ShaderOp_TexM3x2Tex = 72,
+    ShaderOp_TexM3x3Pad = 73,
+    ShaderOp_TexM3x3Tex = 74,
+    ShaderOp_TexM3x3Spec = 76,
+    ShaderOp_TexM3x3VSpec = 77,
+    ShaderOp_ExpP = 78,
+    ShaderOp_LogP = 79,
+    ShaderOp_Cnd = 80,
+    ShaderOp_Def = 81,
+    ShaderOp_TexReg2Rgb = 82,
+    ShaderOp_TexDp3Tex = 83,
+    ShaderOp_TexM3x2Depth = 84,
+    ShaderOp_TexDp3 = 85,
+    ShaderOp_TexM3x3 = 86,
+    ShaderOp_TexDepth = 87,
+    ShaderOp_Cmp = 88,
+    ShaderOp_Bem = 89,
+    ShaderOp_Dp2Add = 90,
+    ShaderOp_Dsx = 91,
+    ShaderOp_Dsy = 92,
+    ShaderOp_TexLdd = 93,
+    ShaderOp_SetP = 94,
+    ShaderOp_TexLdl = 95,
+    ShaderOp_BreakP = 96,
+    ShaderOp_Phase = 0xFFFD,
+    ShaderOp_Comment = 0xFFFE,
+    ShaderOp_End = 0xFFFF
+};
+
+// Register files. Addr and Texture share an encoding: a0 in vertex shaders, tN in
+// pixel shaders. Const2-4 are folded into Const with the matching index offset.
+enum ShaderRegisterFile : uint8_t {
+    ShaderReg_Temp = 0,
+    ShaderReg_Input = 1,
+    ShaderReg_Const = 2,
+    ShaderReg_Addr = 3,
+    ShaderReg_Texture = 3,
+    ShaderReg_RastOut = 4,
+    ShaderReg_AttrOut = 5,
+    ShaderReg_Output = 6,
+    ShaderReg_ConstInt = 7,
+    ShaderReg_ColorOut = 8,
+    ShaderReg_DepthOut = 9,
+    ShaderReg_Sampler = 10,
+    ShaderReg_Const2 = 11,
+    ShaderReg_Const3 = 12,
+    ShaderReg_Const4 = 13,
+    ShaderReg_ConstBool = 14,
+    ShaderReg_Loop = 15,
+    ShaderReg_TempFloat16 = 16,
+    ShaderReg_MiscType = 17,
+    ShaderReg_Label = 18,
+    ShaderReg_Predicate = 19
+};
+
+// Index 0 of ShaderReg_RastOut.
+static constexpr uint16_t kShaderRastOutPosition = 0;
+// Swizzle byte for .xyzw; two bits per destination component, x in the low bits.
+static constexpr uint8_t kShaderSwizzleIdentity = 0xE4;
+static constexpr int kShaderMaxSources = 4;
+
+struct ShaderOperand {
+    uint8_t file = ShaderReg_Temp;
+    uint16_t index = 0;
+    // Destination: write mask, bit 0 = x. Source: swizzle, see kShaderSwizzleIdentity.
+    uint8_t mask = 0;
+    // D3DSPSM_* for sources, D3DSPDM_* (saturate, partial precision, centroid) for
+    // destinations.
+    uint8_t modifier = 0;
+    bool relative = false;
+    // Address register of a relative operand. SM1 sources always use a0.x.
+    uint8_t relativeFile = ShaderReg_Addr;
+    uint16_t relativeIndex = 0;
+    uint8_t relativeComponent = 0;
+};
+
+struct ShaderInstruction {
+    uint16_t opcode = ShaderOp_Nop;
+    // Bits 16-23 of the opcode token: comparison for ifc/breakc/setp, texld variant.
+    uint8_t control = 0;
+    bool predicated = false;
+    bool coissue = false;
+    bool hasDst = false;
+    uint8_t srcCount = 0;
+    ShaderOperand dst;
+    ShaderOperand src[kShaderMaxSources];
+    ShaderOperand predicate;
+    // dcl: usage token. def/defi/defb: literal bits, one word for defb.
+    uint32_t extra[4] = {};
+};
+
+struct ShaderProgram {
+    bool isPixelShader = false;
+    uint8_t major = 0;
+    uint8_t minor = 0;
+    std::vector<ShaderInstruction> instructions;
+};
+
+enum ShaderDecodeStatus {
+    ShaderDecode_Ok = 0,
+    ShaderDecode_Empty,
+    ShaderDecode_BadVersion,
+    // An instruction or comment runs past the last token.
+    ShaderDecode_Truncated,
+    // More operands than any opcode takes, or a missing destination.
+    ShaderDecode_Malformed,
+    ShaderDecode_MissingEnd
+};
+
+// Decodes one shader. On failure `out` keeps the instructions decoded so far and
+// `outErrorToken`, when given, receives the token index where decoding stopped.
+ShaderDecodeStatus DecodeShaderBytecode(const uint32_t* tokens, size_t tokenCount,
+                                        ShaderProgram* out, size_t* outErrorToken = nullptr);
+
+const char* ShaderDecodeStatusName(ShaderDecodeStatus status);
+// D3DDisassemble-style SM2+ mnemonic ("dp4", "texld"); nullptr when unknown.
+const char* ShaderOpcodeName(uint16_t opcode);
+// "vs_2_0", "ps_2_x", "vs_3_sw".
+void FormatShaderModel(const ShaderProgram& program, char* out, size_t outSize);
+// One line of D3DDisassemble-like text for inspection tools, without a newline.
+void FormatShaderInstruction(const ShaderProgram& program, const ShaderInstruction& inst,
+                             char* out, size_t outSize);
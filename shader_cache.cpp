@@ -0,0 +1,209 @@
+#include "shader_cache.h"
+#include "file_io.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// ─── helpers ─────────────────────────────────────────────────────────────────
+
+static bool EntryLess(const ShaderCacheEntry& a, const ShaderCacheEntry& b) {
+    return a.hash != b.hash ? a.hash < b.hash : a.tokenCount < b.tokenCount;
+}
+
+static bool SameEntryKey(const ShaderCacheEntry& a, const ShaderCacheEntry& b) {
+    return a.hash == b.hash && a.tokenCount == b.tokenCount;
+}
+
+// ─── mapping ─────────────────────────────────────────────────────────────────
+
+ShaderCache::~ShaderCache() {
+    Unmap();
+}
+
+bool ShaderCache::Open(const char* path, uint32_t analysisVersion) {
+    Close();
+    if (!path) return false;
+    m_path.assign(path, path + std::strlen(path) + 1);
+    m_analysisVersion = analysisVersion;
+    return Map();
+}
+
+void ShaderCache::Close() {
+    Unmap();
+    m_path.clear();
+}
+
+bool ShaderCache::Map() {
+    Unmap();
+    if (m_path.empty()) return false;
+#ifdef _WIN32
+    HANDLE file = CreateFileA(m_path.data(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER size = {};
+    if (!GetFileSizeEx(file, &size) || size.QuadPart < static_cast<LONGLONG>(sizeof(ShaderCacheHeader))) {
+        CloseHandle(file);
+        return false;
+    }
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    const void* view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (!view) {
+        if (mapping) CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+    m_file = file;
+    m_mapping = mapping;
+    m_data = static_cast<const uint8_t*>(view);
+    m_size = static_cast<size_t>(size.QuadPart);
+#else
+    const int fd = open(m_path.data(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st = {};
+    if (fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(ShaderCacheHeader))) {
+        close(fd);
+        return false;
+    }
+    void* view = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (view == MAP_FAILED) return false;
+    m_data = static_cast<const uint8_t*>(view);
+    m_size = static_cast<size_t>(st.st_size);
+#endif
+
+    ShaderCacheHeader header;
+    std::memcpy(&header, m_data, sizeof(header));
+    // Bound both counts by the payload before multiplying, so a corrupt header cannot wrap
+    // the byte sizes on a 32-bit size_t and pass the total-size check.
+    const size_t payloadBytes = m_size - sizeof(header);
+    if (header.magic != kShaderCacheMagic || header.version != kShaderCacheVersion ||
+        header.analysisVersion != m_analysisVersion ||
+        header.entryCount > payloadBytes / sizeof(ShaderCacheEntry) ||
+        header.layoutCount > payloadBytes / sizeof(ShaderCacheLayout)) {
+        Unmap();
+        return false;
+    }
+    const size_t entryBytes = static_cast<size_t>(header.entryCount) * sizeof(ShaderCacheEntry);
+    const size_t layoutBytes = static_cast<size_t>(header.layoutCount) * sizeof(ShaderCacheLayout);
+    if (payloadBytes != entryBytes + layoutBytes) {
+        Unmap();
+        return false;
+    }
+    m_entries = reinterpret_cast<const ShaderCacheEntry*>(m_data + sizeof(header));
+    m_entryCount = header.entryCount;
+    m_layouts = reinterpret_cast<const ShaderCacheLayout*>(m_data + sizeof(header) + entryBytes);
+    m_layoutCount = header.layoutCount;
+    // Find() binary-searches the mapping, so an unsorted file is as good as none.
+    for (size_t i = 1; i < m_entryCount; ++i) {
+        if (!EntryLess(m_entries[i - 1], m_entries[i])) {
+            Unmap();
+            return false;
+        }
+    }
+    return true;
+}
+
+void ShaderCache::Unmap() {
+#ifdef _WIN32
+    if (m_data) UnmapViewOfFile(m_data);
+    if (m_mapping) CloseHandle(static_cast<HANDLE>(m_mapping));
+    if (m_file) CloseHandle(static_cast<HANDLE>(m_file));
+#else
+    if (m_data) munmap(const_cast<uint8_t*>(m_data), m_size);
+#endif
+    m_data = nullptr;
+    m_size = 0;
+    m_file = nullptr;
+    m_mapping = nullptr;
+    m_entries = nullptr;
+    m_entryCount = 0;
+    m_layouts = nullptr;
+    m_layoutCount = 0;
+}
+
+// ─── lookup ──────────────────────────────────────────────────────────────────
+
+const ShaderCacheEntry* ShaderCache::Find(uint64_t hash, uint32_t tokenCount) const {
+    if (m_entryCount == 0) return nullptr;
+    ShaderCacheEntry key;
+    key.hash = hash;
+    key.tokenCount = tokenCount;
+    const ShaderCacheEntry* end = m_entries + m_entryCount;
+    const ShaderCacheEntry* it = std::lower_bound(m_entries, end, key, EntryLess);
+    return (it != end && SameEntryKey(*it, key)) ? it : nullptr;
+}
+
+const ShaderCacheEntry* ShaderCache::GetEntries(size_t* outCount) const {
+    if (outCount) *outCount = m_entryCount;
+    return m_entries;
+}
+
+const ShaderCacheLayout* ShaderCache::GetLayouts(size_t* outCount) const {
+    if (outCount) *outCount = m_layoutCount;
+    return m_layouts;
+}
+
+// ─── save ────────────────────────────────────────────────────────────────────
+
+bool ShaderCache::Save(std::vector<ShaderCacheEntry>* entries, std::vector<ShaderCacheLayout>* layouts) {
+    if (m_path.empty() || !entries || !layouts) return false;
+
+    // Stable sort keeps the first of equal keys; put the caller's entries first.
+    std::vector<ShaderCacheEntry> merged;
+    merged.reserve(entries->size() + m_entryCount);
+    merged.insert(merged.end(), entries->begin(), entries->end());
+    merged.insert(merged.end(), m_entries, m_entries + m_entryCount);
+    std::stable_sort(merged.begin(), merged.end(), EntryLess);
+    merged.erase(std::unique(merged.begin(), merged.end(), SameEntryKey), merged.end());
+    std::sort(layouts->begin(), layouts->end(),
+              [](const ShaderCacheLayout& a, const ShaderCacheLayout& b) { return a.key < b.key; });
+
+    ShaderCacheHeader header;
+    header.analysisVersion = m_analysisVersion;
+    header.entryCount = static_cast<uint32_t>(merged.size());
+    header.layoutCount = static_cast<uint32_t>(layouts->size());
+
+    std::vector<char> tempPath(m_path.begin(), m_path.end() - 1);
+    const char suffix[] = ".tmp";
+    tempPath.insert(tempPath.end(), suffix, suffix + sizeof(suffix));
+    FILE* file = OpenBinaryFile(tempPath.data(), "wb");
+    if (!file) return false;
+    bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1;
+    ok = ok && (merged.empty() ||
+                std::fwrite(merged.data(), sizeof(ShaderCacheEntry), merged.size(), file) == merged.size());
+    ok = ok && (layouts->empty() ||
+                std::fwrite(layouts->data(), sizeof(ShaderCacheLayout), layouts->size(), file) == layouts->size());
+    ok = (std::fclose(file) == 0) && ok;
+    if (!ok) {
+        std::remove(tempPath.data());
+        return false;
+    }
+
+    // The old file stays mapped until it is about to be replaced. The replace is a single
+    // call so a crash cannot leave the cache missing between delete and rename.
+    Unmap();
+#ifdef _WIN32
+    const bool replaced = MoveFileExA(tempPath.data(), m_path.data(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    const bool replaced = std::rename(tempPath.data(), m_path.data()) == 0;
+#endif
+    if (!replaced) {
+        std::remove(tempPath.data());
+        Map();
+        return false;
+    }
+    return Map();
+}
@@ -0,0 +1,168 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// ─── File format ─────────────────────────────────────────────────────────────
+//
+// A shader analysis cache keeps per-shader classification results and learned
+// register layouts across launches, so a warm start registers every shader with a
+// lookup instead of decoding it. The file is memory-mapped and searched in place.
+// Little-endian throughout.
+//
+//   ShaderCacheHeader
+//   ShaderCacheEntry  entry[entryCount]     sorted by (hash, tokenCount)
+//   ShaderCacheLayout layout[layoutCount]   sorted by key
+//
+// analysisVersion belongs to the caller and changes whenever its classifier does;
+// a file written under another analysis version is ignored and later replaced.
+
+static constexpr uint32_t kShaderCacheMagic = 0x43535043u; // "CPSC"
+static constexpr uint32_t kShaderCacheVersion = 4;
+static constexpr int kShaderCacheRegisters = 256;
+static constexpr int kShaderCacheMatrixUses = 8;
+
+struct ShaderCacheHeader {
+    uint32_t magic           = kShaderCacheMagic;
+    uint32_t version         = kShaderCacheVersion;
+    uint32_t analysisVersion = 0;
+    uint32_t entryCount      = 0;
+    uint32_t layoutCount     = 0;
+    uint32_t reserved        = 0;
+};
+
+enum ShaderCacheFlag : uint32_t {
+    ShaderCacheFlag_PixelShader        = 1u << 0,
+    ShaderCacheFlag_FFPTransform       = 1u << 1,
+    ShaderCacheFlag_FFPLighting        = 1u << 2,
+    ShaderCacheFlag_Skinning           = 1u << 3,
+    ShaderCacheFlag_FlowControl        = 1u << 4,
+    ShaderCacheFlag_RemixSafe          = 1u << 5,
+    ShaderCacheFlag_ConstantReadsKnown = 1u << 6
+};
+
+// Registers derived by the classifier, -1 = none.
+enum ShaderCacheRole {
+    ShaderCacheRole_TransformBase = 0,
+    ShaderCacheRole_LightingBase,
+    ShaderCacheRole_LightDirection,
+    ShaderCacheRole_LightColor,
+    ShaderCacheRole_MaterialColor,
+    ShaderCacheRole_Attenuation,
+    ShaderCacheRole_Position,
+    ShaderCacheRole_ConeAngle,
+    ShaderCacheRole_Count
+};
+
+// Lighting overrides entered in the shader browser, -1 = use the detected value.
+enum ShaderCacheOverride {
+    ShaderCacheOverride_LightDirection = 0,
+    ShaderCacheOverride_LightColor,
+    ShaderCacheOverride_MaterialColor,
+    ShaderCacheOverride_Position,
+    ShaderCacheOverride_Attenuation,
+    ShaderCacheOverride_ConeAngle,
+    ShaderCacheOverride_LightCount,
+    ShaderCacheOverride_Count
+};
+
+enum ShaderCacheTransformFlag : uint8_t {
+    ShaderCacheTransform_Complete       = 1u << 0,
+    ShaderCacheTransform_AmbiguousSplit = 1u << 1,
+    ShaderCacheTransform_Skinned        = 1u << 2
+};
+
+// One constant matrix of the position transform map; role and stage as in
+// shader_dataflow.h.
+struct ShaderCacheMatrixUse {
+    int16_t baseRegister = -1;
+    uint8_t rows = 0;
+    uint8_t role = 0;
+    int8_t stage = -1;
+    uint8_t relative = 0;
+    uint8_t transposed = 0;
+    uint8_t reserved = 0;
+};
+
+struct ShaderCacheEntry {
+    uint64_t hash = 0;
+    uint32_t tokenCount = 0;
+    uint32_t flags = 0;
+    uint32_t instructionCount = 0;
+    int16_t roles[ShaderCacheRole_Count] = { -1, -1, -1, -1, -1, -1, -1, -1 };
+    int16_t overrides[ShaderCacheOverride_Count] = { -1, -1, -1, -1, -1, -1, -1 };
+    // LightingSpace values; -1 = Auto.
+    int8_t lightSpace = 0;
+    int8_t lightSpaceOverride = -1;
+    char shaderModel[16] = {};
+    // Bit r = register cr. constantUsage also includes registers seen in uploads.
+    uint32_t constantUsage[kShaderCacheRegisters / 32] = {};
+    uint32_t constantReads[kShaderCacheRegisters / 32] = {};
+    uint32_t reserved = 0;
+    uint8_t transformFlags = 0;
+    uint8_t matrixUseCount = 0;
+    uint8_t stageCount = 0;
+    int8_t positionInput = -1;
+    int8_t worldTemp = -1;
+    int8_t viewTemp = -1;
+    uint16_t transformReserved = 0;
+    ShaderCacheMatrixUse matrixUses[kShaderCacheMatrixUses] = {};
+};
+static_assert(sizeof(ShaderCacheEntry) == 208, "ShaderCacheEntry is a file record");
+
+enum ShaderCacheSlotFlag : uint8_t {
+    ShaderCacheSlot_Valid      = 1u << 0,
+    ShaderCacheSlot_Transposed = 1u << 1,
+    ShaderCacheSlot_Inverted   = 1u << 2
+};
+
+struct ShaderCacheLayoutSlot {
+    int16_t baseRegister = -1;
+    uint8_t rows = 4;
+    uint8_t flags = 0;
+};
+
+// A locked World/View/Projection placement for one (shader hash, upload range) key.
+struct ShaderCacheLayout {
+    uint64_t key = 0;
+    ShaderCacheLayoutSlot slots[3] = {};
+    uint32_t reserved = 0;
+};
+static_assert(sizeof(ShaderCacheLayout) == 24, "ShaderCacheLayout is a file record");
+
+// ─── Cache ───────────────────────────────────────────────────────────────────
+
+class ShaderCache {
+public:
+    ~ShaderCache();
+
+    // Maps `path`. A missing, damaged or other-version file leaves the cache empty
+    // and returns false; Save() still writes to `path` afterwards.
+    bool Open(const char* path, uint32_t analysisVersion);
+    void Close();
+
+    const ShaderCacheEntry* Find(uint64_t hash, uint32_t tokenCount) const;
+    size_t GetEntryCount() const { return m_entryCount; }
+    const ShaderCacheEntry* GetEntries(size_t* outCount) const;
+    const ShaderCacheLayout* GetLayouts(size_t* outCount) const;
+
+    // Writes the mapped entries merged with `entries` (which win on equal keys) and
+    // exactly `layouts`, then maps the new file. `layouts` is sorted in place.
+    bool Save(std::vector<ShaderCacheEntry>* entries, std::vector<ShaderCacheLayout>* layouts);
+
+private:
+    bool Map();
+    void Unmap();
+
+    std::vector<char> m_path;
+    uint32_t m_analysisVersion = 0;
+    const uint8_t* m_data = nullptr;
+    size_t m_size = 0;
+    void* m_file = nullptr;
+    void* m_mapping = nullptr;
+    const ShaderCacheEntry* m_entries = nullptr;
+    size_t m_entryCount = 0;
+    const ShaderCacheLayout* m_layouts = nullptr;
+    size_t m_layoutCount = 0;
+};
@@ -0,0 +1,576 @@
+#include "shader_dataflow.h"
+
+#include <vector>
+
+// ─── symbolic values ─────────────────────────────────────────────────────────
+
+static constexpr int kTempRegisters = 32;
+static constexpr int kMaxNodes = 64;
+static constexpr int kTrackedConstants = 256;
+static constexpr int kMaxChain = 16;
+
+// A vector value the pass can name: a vertex input, a skinned position, a
+// temporary computed some other way (opaque), or a constant matrix applied to
+// another node.
+struct TransformNode {
+    int16_t parent = -1;
+    int16_t base = -1;
+    uint8_t rows = 0;
+    bool relative = false;
+    // Built by a mul/mad chain rather than dot products.
+    bool transposed = false;
+    bool skinned = false;
+    int8_t input = -1;
+    int8_t opaque = -1;
+    // First temporary the value was read back from as a whole vector.
+    int8_t temp = -1;
+};
+
+enum LaneKind : uint8_t {
+    Lane_Unknown = 0,
+    // Component `component` of `node`.
+    Lane_Component,
+    // dot(node, c[reg]).
+    Lane_Dot,
+    // Sum over k in termMask of node[k] * c[reg + k][component].
+    Lane_Accum,
+    // Bone-palette results scaled by weights and summed.
+    Lane_Blend
+};
+
+struct Lane {
+    uint8_t kind = Lane_Unknown;
+    uint8_t component = 0;
+    uint8_t termMask = 0;
+    bool relative = false;
+    int16_t node = -1;
+    int16_t reg = -1;
+};
+
+static int SwizzleComponent(uint8_t swizzle, int lane) {
+    return (swizzle >> (lane * 2)) & 3;
+}
+
+static bool IsBroadcast(uint8_t swizzle) {
+    const int c = swizzle & 3;
+    return SwizzleComponent(swizzle, 1) == c && SwizzleComponent(swizzle, 2) == c && SwizzleComponent(swizzle, 3) == c;
+}
+
+static bool SameAccumulation(const Lane& a, const Lane& b) {
+    return a.kind == Lane_Accum && b.kind == Lane_Accum && a.node == b.node && a.reg == b.reg &&
+           a.relative == b.relative && a.termMask == b.termMask;
+}
+
+// ─── analyser ────────────────────────────────────────────────────────────────
+
+class TransformAnalyser {
+public:
+    explicit TransformAnalyser(const ShaderProgram& program) : m_program(program) {}
+
+    void Run(ShaderTransformMap* out);
+
+private:
+    int AddNode(int parent, int base, int rows, bool relative, bool transposed);
+    int InputNode(int index);
+    int SkinnedNode();
+    int OpaqueNode(int temp);
+    bool ChainHasPalette(int node) const;
+
+    bool MatrixRow(const ShaderOperand& op) const;
+    bool ReadLanes(const ShaderOperand& op, Lane* out);
+    int ResolveLanes(const Lane* lanes, int temp);
+    int ResolveVector(const ShaderOperand& op);
+    bool ResolveBroadcast(const ShaderOperand& op, int* outNode, int* outComponent);
+    bool ProductTerm(const ShaderInstruction& inst, int* node, int* component, int* base, bool* relative);
+
+    bool DotLanes(const ShaderInstruction& inst, Lane* out);
+    bool MatrixMacroLanes(const ShaderInstruction& inst, int lanes, Lane* out);
+    bool ChainLanes(const ShaderInstruction& inst, Lane* out);
+    bool BlendLanes(const ShaderInstruction& inst, Lane* out);
+    void Write(const ShaderOperand& dst, const Lane* lanes);
+    void Step(const ShaderInstruction& inst);
+    void AddUse(ShaderTransformMap* out, int node, uint8_t role, int stage) const;
+
+    const ShaderProgram& m_program;
+    std::vector<TransformNode> m_nodes;
+    Lane m_temps[kTempRegisters][4];
+    Lane m_position[4];
+    bool m_defined[kTrackedConstants] = {};
+    int m_positionOutput = -1;
+    bool m_flowControl = false;
+};
+
+int TransformAnalyser::AddNode(int parent, int base, int rows, bool relative, bool transposed) {
+    for (size_t i = 0; i < m_nodes.size(); ++i) {
+        const TransformNode& n = m_nodes[i];
+        if (n.parent == parent && n.base == base && n.rows == rows && n.relative == relative &&
+            n.transposed == transposed && n.input < 0 && n.opaque < 0 && !n.skinned) {
+            return static_cast<int>(i);
+        }
+    }
+    if (m_nodes.size() >= static_cast<size_t>(kMaxNodes)) return -1;
+    TransformNode n;
+    n.parent = static_cast<int16_t>(parent);
+    n.base = static_cast<int16_t>(base);
+    n.rows = static_cast<uint8_t>(rows);
+    n.relative = relative;
+    n.transposed = transposed;
+    m_nodes.push_back(n);
+    return static_cast<int>(m_nodes.size() - 1);
+}
+
+int TransformAnalyser::InputNode(int index) {
+    for (size_t i = 0; i < m_nodes.size(); ++i) {
+        if (m_nodes[i].input == index) return static_cast<int>(i);
+    }
+    if (m_nodes.size() >= static_cast<size_t>(kMaxNodes)) return -1;
+    TransformNode n;
+    n.input = static_cast<int8_t>(index);
+    m_nodes.push_back(n);
+    return static_cast<int>(m_nodes.size() - 1);
+}
+
+int TransformAnalyser::SkinnedNode() {
+    for (size_t i = 0; i < m_nodes.size(); ++i) {
+        if (m_nodes[i].skinned) return static_cast<int>(i);
+    }
+    if (m_nodes.size() >= static_cast<size_t>(kMaxNodes)) return -1;
+    TransformNode n;
+    n.skinned = true;
+    m_nodes.push_back(n);
+    return static_cast<int>(m_nodes.size() - 1);
+}
+
+int TransformAnalyser::OpaqueNode(int temp) {
+    for (size_t i = 0; i < m_nodes.size(); ++i) {
+        if (m_nodes[i].opaque == temp) return static_cast<int>(i);
+    }
+    if (m_nodes.size() >= static_cast<size_t>(kMaxNodes)) return -1;
+    TransformNode n;
+    n.opaque = static_cast<int8_t>(temp);
+    m_nodes.push_back(n);
+    return static_cast<int>(m_nodes.size() - 1);
+}
+
+bool TransformAnalyser::ChainHasPalette(int node) const {
+    for (int depth = 0; node >= 0 && depth < kMaxChain; ++depth) {
+        if (m_nodes[node].relative || m_nodes[node].skinned) return true;
+        node = m_nodes[node].parent;
+    }
+    return false;
+}
+
+// A whole register of a constant matrix: c# or c#[a0.x], unswizzled, not a def literal.
+bool TransformAnalyser::MatrixRow(const ShaderOperand& op) const {
+    if (op.file != ShaderReg_Const || op.modifier != 0 || op.mask != kShaderSwizzleIdentity) return false;
+    if (op.relative) return true;
+    return op.index >= kTrackedConstants || !m_defined[op.index];
+}
+
+bool TransformAnalyser::ReadLanes(const ShaderOperand& op, Lane* out) {
+    for (int i = 0; i < 4; ++i) out[i] = Lane();
+    if (op.modifier != 0 || op.relative) return false;
+    if (op.file == ShaderReg_Temp && op.index < kTempRegisters) {
+        for (int i = 0; i < 4; ++i) out[i] = m_temps[op.index][SwizzleComponent(op.mask, i)];
+        return true;
+    }
+    if (op.file == ShaderReg_Input) {
+        const int node = InputNode(op.index);
+        if (node < 0) return false;
+        for (int i = 0; i < 4; ++i) {
+            out[i].kind = Lane_Component;
+            out[i].node = static_cast<int16_t>(node);
+            out[i].component = static_cast<uint8_t>(SwizzleComponent(op.mask, i));
+        }
+        return true;
+    }
+    return false;
+}
+
+// Names the vector held in `lanes`, creating the matrix node it implies. The w lane
+// may hold anything once x, y and z agree (m4x3 results usually get w from a literal).
+int TransformAnalyser::ResolveLanes(const Lane* lanes, int temp) {
+    int node = -1;
+    const Lane& x = lanes[0];
+    if (x.kind == Lane_Component) {
+        bool whole = true;
+        for (int i = 0; i < 4 && whole; ++i) {
+            whole = lanes[i].kind == Lane_Component && lanes[i].node == x.node && lanes[i].component == i;
+        }
+        node = whole ? x.node : -1;
+    } else if (x.kind == Lane_Dot) {
+        bool rows3 = true;
+        for (int i = 1; i < 3 && rows3; ++i) {
+            rows3 = lanes[i].kind == Lane_Dot && lanes[i].node == x.node && lanes[i].relative == x.relative &&
+                    lanes[i].reg == x.reg + i;
+        }
+        const bool rows4 = rows3 && lanes[3].kind == Lane_Dot && lanes[3].node == x.node &&
+                           lanes[3].relative == x.relative && lanes[3].reg == x.reg + 3;
+        if (rows3) node = AddNode(x.node, x.reg, rows4 ? 4 : 3, x.relative, false);
+    } else if (x.kind == Lane_Accum) {
+        bool same = x.component == 0;
+        for (int i = 1; i < 3 && same; ++i) {
+            same = SameAccumulation(lanes[i], x) && lanes[i].component == i;
+        }
+        if (same && (x.termMask == 0x7 || x.termMask == 0xF)) {
+            node = AddNode(x.node, x.reg, x.termMask == 0xF ? 4 : 3, x.relative, true);
+        }
+    } else if (x.kind == Lane_Blend) {
+        if (lanes[1].kind == Lane_Blend && lanes[2].kind == Lane_Blend) node = SkinnedNode();
+    }
+    if (node >= 0 && temp >= 0 && m_nodes[node].temp < 0) {
+        m_nodes[node].temp = static_cast<int8_t>(temp);
+    }
+    return node;
+}
+
+int TransformAnalyser::ResolveVector(const ShaderOperand& op) {
+    if (op.modifier != 0 || op.relative) return -1;
+    if (op.file == ShaderReg_Input) {
+        return op.mask == kShaderSwizzleIdentity ? InputNode(op.index) : -1;
+    }
+    Lane lanes[4];
+    if (!ReadLanes(op, lanes)) return -1;
+    const int node = ResolveLanes(lanes, op.mask == kShaderSwizzleIdentity ? op.index : -1);
+    // A whole temporary the pass cannot follow (a morph, a decompression) still roots
+    // the matrices applied to it.
+    if (node < 0 && op.file == ShaderReg_Temp && op.mask == kShaderSwizzleIdentity &&
+        lanes[0].kind == Lane_Unknown) {
+        return OpaqueNode(op.index);
+    }
+    return node;
+}
+
+// v0.x or r0.y: one component of a nameable vector.
+bool TransformAnalyser::ResolveBroadcast(const ShaderOperand& op, int* outNode, int* outComponent) {
+    if (op.modifier != 0 || op.relative || !IsBroadcast(op.mask)) return false;
+    int node = -1;
+    if (op.file == ShaderReg_Input) {
+        node = InputNode(op.index);
+    } else if (op.file == ShaderReg_Temp && op.index < kTempRegisters) {
+        node = ResolveLanes(m_temps[op.index], op.index);
+    }
+    if (node < 0) return false;
+    *outNode = node;
+    *outComponent = op.mask & 3;
+    return true;
+}
+
+// The node[k] * c[base + k] term of a mul or mad, in either operand order.
+bool TransformAnalyser::ProductTerm(const ShaderInstruction& inst, int* node, int* component, int* base,
+                                    bool* relative) {
+    for (int order = 0; order < 2; ++order) {
+        const ShaderOperand& vec = inst.src[order];
+        const ShaderOperand& row = inst.src[order ^ 1];
+        if (!MatrixRow(row) || !ResolveBroadcast(vec, node, component)) continue;
+        *base = static_cast<int>(row.index) - *component;
+        *relative = row.relative;
+        if (*base >= 0) return true;
+    }
+    return false;
+}
+
+bool TransformAnalyser::DotLanes(const ShaderInstruction& inst, Lane* out) {
+    if (inst.srcCount < 2) return false;
+    for (int order = 0; order < 2; ++order) {
+        const ShaderOperand& row = inst.src[order ^ 1];
+        if (!MatrixRow(row)) continue;
+        const int node = ResolveVector(inst.src[order]);
+        if (node < 0) continue;
+        Lane lane;
+        lane.kind = Lane_Dot;
+        lane.node = static_cast<int16_t>(node);
+        lane.reg = static_cast<int16_t>(row.index);
+        lane.relative = row.relative;
+        for (int i = 0; i < 4; ++i) out[i] = lane;
+        return true;
+    }
+    return false;
+}
+
+bool TransformAnalyser::MatrixMacroLanes(const ShaderInstruction& inst, int lanes, Lane* out) {
+    if (inst.srcCount < 2 || !MatrixRow(inst.src[1])) return false;
+    const int node = ResolveVector(inst.src[0]);
+    if (node < 0) return false;
+    for (int i = 0; i < lanes; ++i) {
+        out[i].kind = Lane_Dot;
+        out[i].node = static_cast<int16_t>(node);
+        out[i].reg = static_cast<int16_t>(inst.src[1].index + i);
+        out[i].relative = inst.src[1].relative;
+    }
+    return true;
+}
+
+// mul starts a column chain, mad adds a term, and add (or mad's addend) of the
+// fourth row folds in the translation for w = 1.
+bool TransformAnalyser::ChainLanes(const ShaderInstruction& inst, Lane* out) {
+    int node = -1, component = 0, base = 0;
+    bool relative = false;
+    uint8_t terms = 0;
+    const ShaderOperand* addend = nullptr;
+    if (inst.opcode == ShaderOp_Mul) {
+        if (inst.srcCount < 2 || !ProductTerm(inst, &node, &component, &base, &relative)) return false;
+        for (int i = 0; i < 4; ++i) {
+            out[i].kind = Lane_Accum;
+            out[i].node = static_cast<int16_t>(node);
+            out[i].reg = static_cast<int16_t>(base);
+            out[i].relative = relative;
+            out[i].termMask = static_cast<uint8_t>(1u << component);
+            out[i].component = static_cast<uint8_t>(i);
+        }
+        return true;
+    }
+    if (inst.opcode == ShaderOp_Mad) {
+        if (inst.srcCount < 3 || !ProductTerm(inst, &node, &component, &base, &relative)) return false;
+        terms = static_cast<uint8_t>(1u << component);
+        addend = &inst.src[2];
+    } else {
+        if (inst.srcCount < 2) return false;
+        terms = 0;
+        addend = nullptr;
+    }
+
+    // mad with a translation row as the addend: node[k] * c[base + k] + c[base + 3].
+    if (addend && MatrixRow(*addend) && addend->relative == relative && addend->index == base + 3 && component != 3) {
+        for (int i = 0; i < 4; ++i) {
+            out[i].kind = Lane_Accum;
+            out[i].node = static_cast<int16_t>(node);
+            out[i].reg = static_cast<int16_t>(base);
+            out[i].relative = relative;
+            out[i].termMask = static_cast<uint8_t>(terms | 0x8u);
+            out[i].component = static_cast<uint8_t>(i);
+        }
+        return true;
+    }
+
+    Lane acc[4];
+    const ShaderOperand* translation = nullptr;
+    if (addend) {
+        if (!ReadLanes(*addend, acc)) return false;
+    } else if (ReadLanes(inst.src[0], acc) && acc[0].kind == Lane_Accum) {
+        translation = &inst.src[1];
+    } else if (ReadLanes(inst.src[1], acc) && acc[0].kind == Lane_Accum) {
+        translation = &inst.src[0];
+    } else {
+        return false;
+    }
+    if (translation) {
+        if (!MatrixRow(*translation) || translation->relative != acc[0].relative ||
+            translation->index != acc[0].reg + 3) {
+            return false;
+        }
+        node = acc[0].node;
+        base = acc[0].reg;
+        relative = acc[0].relative;
+        terms = 0x8u;
+    }
+    for (int i = 0; i < 4; ++i) {
+        if (!(inst.dst.mask & (1u << i))) continue;
+        const Lane& a = acc[i];
+        if (a.kind != Lane_Accum || a.node != node || a.reg != base || a.relative != relative ||
+            a.component != i || (a.termMask & terms) != 0) {
+            return false;
+        }
+        out[i] = a;
+        out[i].termMask = static_cast<uint8_t>(a.termMask | terms);
+    }
+    return true;
+}
+
+// Arithmetic over palette-transformed values: the weighted bone blend.
+bool TransformAnalyser::BlendLanes(const ShaderInstruction& inst, Lane* out) {
+    bool palette = false;
+    for (int s = 0; s < inst.srcCount && !palette; ++s) {
+        Lane lanes[4];
+        if (ReadLanes(inst.src[s], lanes) && lanes[0].kind == Lane_Blend) {
+            palette = true;
+            continue;
+        }
+        const int node = ResolveVector(inst.src[s]);
+        palette = node >= 0 && ChainHasPalette(node);
+    }
+    if (!palette) return false;
+    for (int i = 0; i < 4; ++i) {
+        out[i] = Lane();
+        out[i].kind = Lane_Blend;
+    }
+    return true;
+}
+
+void TransformAnalyser::Write(const ShaderOperand& dst, const Lane* lanes) {
+    Lane* target = nullptr;
+    if (dst.file == ShaderReg_Temp && dst.index < kTempRegisters) {
+        target = m_temps[dst.index];
+    } else if (m_program.major < 3 && dst.file == ShaderReg_RastOut && dst.index == kShaderRastOutPosition) {
+        target = m_position;
+    } else if (m_program.major >= 3 && dst.file == ShaderReg_Output && dst.index == m_positionOutput) {
+        target = m_position;
+    }
+    if (!target) return;
+    for (int i = 0; i < 4; ++i) {
+        if (dst.mask & (1u << i)) target[i] = lanes[i];
+    }
+}
+
+void TransformAnalyser::Step(const ShaderInstruction& inst) {
+    switch (inst.opcode) {
+    case ShaderOp_Dcl:
+        // dcl_position o#: the vs_3_0 position output.
+        if (inst.dst.file == ShaderReg_Output && (inst.extra[0] & 0x1Fu) == 0 && ((inst.extra[0] >> 16) & 0xFu) == 0) {
+            m_positionOutput = inst.dst.index;
+        }
+        return;
+    case ShaderOp_Def:
+        if (inst.dst.file == ShaderReg_Const && inst.dst.index < kTrackedConstants) m_defined[inst.dst.index] = true;
+        return;
+    case ShaderOp_If:
+    case ShaderOp_IfC:
+    case ShaderOp_Loop:
+    case ShaderOp_Rep:
+    case ShaderOp_Call:
+    case ShaderOp_CallNz:
+    case ShaderOp_Label:
+        m_flowControl = true;
+        return;
+    default:
+        break;
+    }
+    if (!inst.hasDst) return;
+
+    Lane lanes[4];
+    // Predicated writes may not happen and saturation changes the value.
+    const bool exact = !inst.predicated && !inst.dst.relative && (inst.dst.modifier & 1u) == 0;
+    bool known = false;
+    if (exact) {
+        switch (inst.opcode) {
+        case ShaderOp_Mov: known = inst.srcCount >= 1 && ReadLanes(inst.src[0], lanes); break;
+        case ShaderOp_Dp3:
+        case ShaderOp_Dp4: known = DotLanes(inst, lanes); break;
+        case ShaderOp_M4x4:
+        case ShaderOp_M3x4: known = MatrixMacroLanes(inst, 4, lanes); break;
+        case ShaderOp_M4x3:
+        case ShaderOp_M3x3: known = MatrixMacroLanes(inst, 3, lanes); break;
+        case ShaderOp_Mul:
+        case ShaderOp_Mad:
+        case ShaderOp_Add: known = ChainLanes(inst, lanes) || BlendLanes(inst, lanes); break;
+        default: break;
+        }
+    }
+    if (!known) {
+        for (int i = 0; i < 4; ++i) lanes[i] = Lane();
+    }
+    Write(inst.dst, lanes);
+}
+
+void TransformAnalyser::AddUse(ShaderTransformMap* out, int node, uint8_t role, int stage) const {
+    const TransformNode& n = m_nodes[node];
+    for (int i = 0; i < out->useCount; ++i) {
+        ShaderMatrixUse& use = out->uses[i];
+        if (use.baseRegister == n.base && use.relative == n.relative) {
+            if (n.rows > use.rows) use.rows = n.rows;
+            return;
+        }
+    }
+    if (out->useCount >= kShaderMaxMatrixUses) return;
+    ShaderMatrixUse& use = out->uses[out->useCount++];
+    use.baseRegister = n.base;
+    use.rows = n.rows;
+    use.relative = n.relative;
+    use.transposed = n.transposed;
+    use.role = n.relative ? static_cast<uint8_t>(ShaderMatrixRole_BonePalette) : role;
+    use.stage = static_cast<int8_t>(stage);
+}
+
+void TransformAnalyser::Run(ShaderTransformMap* out) {
+    *out = ShaderTransformMap();
+    if (m_program.isPixelShader) return;
+    for (const ShaderInstruction& inst : m_program.instructions) Step(inst);
+
+    // Position chain, vertex input first.
+    int chain[kMaxChain];
+    int chainLength = 0;
+    int node = ResolveLanes(m_position, -1);
+    while (node >= 0 && chainLength < kMaxChain) {
+        chain[chainLength++] = node;
+        node = m_nodes[node].parent;
+    }
+    const bool rooted = chainLength > 0 && node < 0;
+    uint8_t roles[kMaxChain] = {};
+    int stages[kMaxChain];
+    int stageCount = 0;
+    if (rooted) {
+        const TransformNode& root = m_nodes[chain[chainLength - 1]];
+        out->positionInput = root.input;
+        for (int i = chainLength - 2; i >= 0; --i) stages[stageCount++] = chain[i];
+
+        int lastPalette = -1;
+        for (int i = 0; i < stageCount; ++i) {
+            if (m_nodes[stages[i]].relative) lastPalette = i;
+        }
+        out->skinned = root.skinned || lastPalette >= 0;
+        const int first = lastPalette + 1;
+        const int fixed = stageCount - first;
+        uint8_t* r = roles + first;
+        if (fixed == 1) {
+            r[0] = out->skinned ? ShaderMatrixRole_ViewProjection : ShaderMatrixRole_WorldViewProjection;
+        } else if (fixed == 2 && out->skinned) {
+            r[0] = ShaderMatrixRole_View;
+            r[1] = ShaderMatrixRole_Projection;
+        } else if (fixed == 2) {
+            r[0] = ShaderMatrixRole_World;
+            r[1] = ShaderMatrixRole_ViewProjection;
+            out->ambiguousSplit = true;
+        } else if (fixed == 3) {
+            r[0] = ShaderMatrixRole_World;
+            r[1] = ShaderMatrixRole_View;
+            r[2] = ShaderMatrixRole_Projection;
+        }
+        out->complete = !m_flowControl && root.opaque < 0 && fixed >= 1 && fixed <= 3;
+        out->stageCount = static_cast<uint8_t>(stageCount);
+
+        // The value leaving the palette (or the World stage) is the world-space position.
+        if (out->skinned) {
+            const int worldNode = lastPalette >= 0 ? stages[lastPalette] : chain[chainLength - 1];
+            out->worldTemp = m_nodes[worldNode].temp;
+        }
+        for (int i = first; i < stageCount; ++i) {
+            if (roles[i] == ShaderMatrixRole_World) out->worldTemp = m_nodes[stages[i]].temp;
+            if (roles[i] == ShaderMatrixRole_View) out->viewTemp = m_nodes[stages[i]].temp;
+        }
+        for (int i = 0; i < stageCount; ++i) AddUse(out, stages[i], roles[i], i);
+    }
+    for (size_t i = 0; i < m_nodes.size(); ++i) {
+        const TransformNode& n = m_nodes[i];
+        if (n.input < 0 && n.opaque < 0 && !n.skinned) AddUse(out, static_cast<int>(i), ShaderMatrixRole_Other, -1);
+    }
+}
+
+// ─── public ──────────────────────────────────────────────────────────────────
+
+bool AnalyseShaderTransforms(const ShaderProgram& program, ShaderTransformMap* out) {
+    if (!out) return false;
+    TransformAnalyser analyser(program);
+    analyser.Run(out);
+    return out->complete;
+}
+
+const ShaderMatrixUse* FindShaderMatrixUse(const ShaderTransformMap& map, int baseRegister) {
+    for (int i = 0; i < map.useCount; ++i) {
+        if (!map.uses[i].relative && map.uses[i].baseRegister == baseRegister) return &map.uses[i];
+    }
+    return nullptr;
+}
+
+const char* ShaderMatrixRoleName(uint8_t role) {
+    switch (role) {
+    case ShaderMatrixRole_Other: return "Other";
+    case ShaderMatrixRole_World: return "World";
+    case ShaderMatrixRole_View: return "View";
+    case ShaderMatrixRole_Projection: return "Projection";
+    case ShaderMatrixRole_ViewProjection: return "ViewProjection";
+    case ShaderMatrixRole_WorldView: return "WorldView";
+    case ShaderMatrixRole_WorldViewProjection: return "WorldViewProjection";
+    case ShaderMatrixRole_BonePalette: return "BonePalette";
+    default: return "unknown";
+    }
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "shader_bytecode.h"
+
+#include <cstdint>
+
+// ─── Position dataflow ───────────────────────────────────────────────────────
+//
+// Def-use pass over a decoded vertex shader. It follows the position output back
+// through temporaries to the vertex input, and records every constant-register
+// matrix it passes along the way. Recognised matrix products:
+//
+//   dp4/dp3 groups        dp4 r0.x, v0, c4 / dp4 r0.y, v0, c5 / ...
+//   matrix macros         m4x4, m4x3, m3x4, m3x3
+//   mul/mad column chains mul r0, v0.x, c4 / mad r0, v0.y, c5, r0 / ... (add c7 for w = 1)
+//
+// a0-relative rows are bone palettes. A product that blends palette results by
+// vertex weights yields a skinned position, which the chain continues from. Any
+// other computed temporary ends the chain as an opaque root.
+// The pass is straight-line: flow control or an opaque root leaves the map
+// incomplete, but the roles and matrices it found are still reported.
+
+enum ShaderMatrixRole : uint8_t {
+    // A constant matrix that does not feed the position (normals, texture coordinates).
+    ShaderMatrixRole_Other = 0,
+    ShaderMatrixRole_World,
+    ShaderMatrixRole_View,
+    ShaderMatrixRole_Projection,
+    ShaderMatrixRole_ViewProjection,
+    ShaderMatrixRole_WorldView,
+    ShaderMatrixRole_WorldViewProjection,
+    ShaderMatrixRole_BonePalette,
+    ShaderMatrixRole_Count
+};
+
+static constexpr int kShaderMaxMatrixUses = 8;
+
+struct ShaderMatrixUse {
+    // For relative uses, the constant offset added to the address register.
+    int16_t baseRegister = -1;
+    // Consecutive constant registers read, 3 or 4.
+    uint8_t rows = 0;
+    uint8_t role = ShaderMatrixRole_Other;
+    bool relative = false;
+    // Read by a mul/mad column chain: each register holds a column of what a dp4 or
+    // m4x4 reads as a row, so the matrix is the transpose of the dp4 reading.
+    bool transposed = false;
+    // Position on the position chain counted from the vertex input, -1 when off it.
+    int8_t stage = -1;
+};
+
+struct ShaderTransformMap {
+    // The position resolved to vertex input (or a skinned blend of it) times one to
+    // three fixed constant matrices, with no flow control.
+    bool complete = false;
+    // Two fixed stages read as World then ViewProjection; WorldView then Projection
+    // is equally possible from the bytecode alone.
+    bool ambiguousSplit = false;
+    bool skinned = false;
+    int8_t positionInput = -1;
+    // Temporaries holding the world- and view-space position, -1 when not materialised.
+    int8_t worldTemp = -1;
+    int8_t viewTemp = -1;
+    uint8_t stageCount = 0;
+    uint8_t useCount = 0;
+    // Position-chain matrices first, in stage order.
+    ShaderMatrixUse uses[kShaderMaxMatrixUses];
+};
+
+// Fills `out` from a vertex shader's IR and returns out->complete. Pixel shaders
+// and programs without a position write give an empty, incomplete map.
+bool AnalyseShaderTransforms(const ShaderProgram& program, ShaderTransformMap* out);
+
+// Non-relative use starting at `baseRegister`, or nullptr.
+const ShaderMatrixUse* FindShaderMatrixUse(const ShaderTransformMap& map, int baseRegister);
+
+// "World", "ViewProjection", "BonePalette", ...
+const char* ShaderMatrixRoleName(uint8_t role);
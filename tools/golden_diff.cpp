@@ -0,0 +1,141 @@
+// Compares two .cpgd golden runs draw by draw.
+//
+// Build (Linux):
+//   g++ -std=c++17 -O2 -I. tools/golden_diff.cpp golden_output.cpp -o golden_diff
+//
+// Usage:
+//   golden_diff <expected.cpgd> <actual.cpgd> [--tolerance T]
+//
+// A draw diverges when the two runs bind different slots or when any bound matrix
+// element differs by more than T (default 0: bit-for-bit, NaNs compared by bits).
+// Exit code is 0 when the runs match, 1 on divergence and 2 on usage or I/O errors.
+
+#include "../golden_output.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+static bool ElementsMatch(float a, float b, float tolerance) {
+    if (tolerance <= 0.0f) {
+        return std::memcmp(&a, &b, sizeof(float)) == 0;
+    }
+    if (std::isnan(a) || std::isnan(b)) {
+        return std::isnan(a) && std::isnan(b);
+    }
+    return std::fabs(a - b) <= tolerance;
+}
+
+// Also reports the largest element difference, for the summary line.
+static bool MatricesMatch(const float* a, const float* b, float tolerance, float* outMaxDiff) {
+    bool match = true;
+    float maxDiff = 0.0f;
+    for (int i = 0; i < 16; ++i) {
+        if (!ElementsMatch(a[i], b[i], tolerance)) {
+            match = false;
+        }
+        const float diff = std::fabs(a[i] - b[i]);
+        if (diff > maxDiff || std::isnan(diff)) {
+            maxDiff = diff;
+        }
+    }
+    *outMaxDiff = maxDiff;
+    return match;
+}
+
+static void PrintMatrix(const char* label, const float* m) {
+    std::printf("  %s\n", label);
+    for (int row = 0; row < 4; ++row) {
+        std::printf("    % .7g % .7g % .7g % .7g\n", m[row * 4 + 0], m[row * 4 + 1], m[row * 4 + 2], m[row * 4 + 3]);
+    }
+}
+
+static void PrintDivergence(size_t index, int slot, const GoldenDraw& expected, const GoldenDraw& actual,
+                            float maxDiff) {
+    std::printf("first divergence at draw %llu (frame %u)\n", static_cast<unsigned long long>(index), expected.frame);
+    std::printf("  slot:            %s\n", GoldenSlotName(slot));
+    std::printf("  shader hash:     expected 0x%08X, actual 0x%08X\n", expected.shaderHash, actual.shaderHash);
+    std::printf("  source register: expected c%d, actual c%d\n",
+                expected.sourceRegister[slot], actual.sourceRegister[slot]);
+    if (expected.bound[slot] != actual.bound[slot]) {
+        std::printf("  bound:           expected %s, actual %s\n",
+                    expected.bound[slot] ? "yes" : "no", actual.bound[slot] ? "yes" : "no");
+    } else {
+        std::printf("  max |diff|:      %.9g\n", maxDiff);
+    }
+    if (expected.bound[slot]) PrintMatrix("expected:", expected.matrices[slot]);
+    if (actual.bound[slot]) PrintMatrix("actual:", actual.matrices[slot]);
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        std::fprintf(stderr, "usage: %s <expected.cpgd> <actual.cpgd> [--tolerance T]\n", argv[0]);
+        return 2;
+    }
+    float tolerance = 0.0f;
+    for (int i = 3; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc) {
+            tolerance = static_cast<float>(std::atof(argv[++i]));
+        } else {
+            std::fprintf(stderr, "error: unknown argument '%s'\n", argv[i]);
+            return 2;
+        }
+    }
+
+    GoldenReader expected;
+    GoldenReader actual;
+    if (!expected.Load(argv[1])) {
+        std::fprintf(stderr, "error: cannot read %s\n", argv[1]);
+        return 2;
+    }
+    if (!actual.Load(argv[2])) {
+        std::fprintf(stderr, "error: cannot read %s\n", argv[2]);
+        return 2;
+    }
+
+    const uint64_t expectedDraws = expected.GetDrawCount();
+    const uint64_t actualDraws = actual.GetDrawCount();
+    const uint64_t commonDraws = expectedDraws < actualDraws ? expectedDraws : actualDraws;
+    uint64_t divergentDraws = 0;
+    float worstDiff = 0.0f;
+    bool reported = false;
+    GoldenDraw a;
+    GoldenDraw b;
+    for (uint64_t i = 0; i < commonDraws; ++i) {
+        expected.GetDraw(static_cast<size_t>(i), &a);
+        actual.GetDraw(static_cast<size_t>(i), &b);
+        bool drawDiverged = false;
+        for (int slot = 0; slot < kGoldenSlotCount; ++slot) {
+            float maxDiff = 0.0f;
+            bool slotDiverged = a.bound[slot] != b.bound[slot];
+            if (!slotDiverged && a.bound[slot]) {
+                slotDiverged = !MatricesMatch(a.matrices[slot], b.matrices[slot], tolerance, &maxDiff);
+                if (maxDiff > worstDiff || std::isnan(maxDiff)) {
+                    worstDiff = maxDiff;
+                }
+            }
+            if (slotDiverged && !reported) {
+                PrintDivergence(static_cast<size_t>(i), slot, a, b, maxDiff);
+                reported = true;
+            }
+            drawDiverged = drawDiverged || slotDiverged;
+        }
+        if (drawDiverged) {
+            divergentDraws++;
+        }
+    }
+
+    std::printf("draws:            %llu expected, %llu actual\n",
+                static_cast<unsigned long long>(expectedDraws), static_cast<unsigned long long>(actualDraws));
+    std::printf("divergent draws:  %llu of %llu compared (tolerance %g)\n",
+                static_cast<unsigned long long>(divergentDraws), static_cast<unsigned long long>(commonDraws),
+                static_cast<double>(tolerance));
+    std::printf("max |diff|:       %.9g\n", static_cast<double>(worstDiff));
+    if (expectedDraws != actualDraws) {
+        std::printf("draw counts differ; runs are not from the same capture or one was cut short\n");
+    }
+    const bool match = divergentDraws == 0 && expectedDraws == actualDraws;
+    std::printf("%s\n", match ? "MATCH" : "DIVERGED");
+    return match ? 0 : 1;
+}
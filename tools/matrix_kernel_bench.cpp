@@ -0,0 +1,583 @@
+// Benchmark and equivalence check for matrix_kernels.h.
+//
+// Build (Linux):
+//   g++ -std=c++17 -O2 -I. tools/matrix_kernel_bench.cpp matrix_engine.cpp -o matrix_kernel_bench
+//   g++ -std=c++17 -O2 -I. -DCAMERA_PROXY_DETERMINISTIC_MATH=1 tools/matrix_kernel_bench.cpp matrix_engine.cpp
+//       -o matrix_kernel_bench
+//
+// Usage:
+//   matrix_kernel_bench [--verify] [--count N] [--min-time SECONDS]
+//
+// The default mode times every dispatching kernel against its scalar reference, then
+// the per-window register gather of the classification loop: the runtime-branched
+// gather it used to call, the GatherMatrix variant picked once per loop from the
+// dispatch table, and the variant instantiated directly into the loop. Last, it times
+// a structural scan of generated uploads with and without the SSE2 window prefilter.
+// --verify instead runs each kernel over a generated set of rigid, perspective,
+// view-projection, random and degenerate matrices and compares it bit for bit with
+// the scalar reference (any NaN matches any NaN), and checks that the prefilter never
+// rejects a window ClassifyStructuralWindow gives a class. Exit code is 0 when
+// everything matches and 1 otherwise.
+
+#include "../matrix_engine.h"
+#include "../matrix_kernels.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+namespace mk = matrix_kernels;
+
+struct Mat {
+    float m[16];
+};
+
+// ─── Input generation ────────────────────────────────────────────────────────
+
+struct Lcg {
+    uint32_t state;
+    float Next(float lo, float hi) {
+        state = state * 1664525u + 1013904223u;
+        return lo + (hi - lo) * static_cast<float>(state >> 8) * (1.0f / 16777216.0f);
+    }
+};
+
+static Mat Rigid(Lcg& rng, float scale) {
+    const float yaw = rng.Next(-3.14f, 3.14f), pitch = rng.Next(-1.5f, 1.5f);
+    const float cy = std::cos(yaw), sy = std::sin(yaw);
+    const float cp = std::cos(pitch), sp = std::sin(pitch);
+    Mat r = {{
+        cy * scale,      0.0f,        -sy * scale,     0.0f,
+        sy * sp * scale, cp * scale,  cy * sp * scale, 0.0f,
+        sy * cp * scale, -sp * scale, cy * cp * scale, 0.0f,
+        rng.Next(-500.0f, 500.0f), rng.Next(-500.0f, 500.0f), rng.Next(-500.0f, 500.0f), 1.0f
+    }};
+    return r;
+}
+
+static Mat Perspective(Lcg& rng) {
+    const float ys = 1.0f / std::tan(rng.Next(0.5f, 1.8f) * 0.5f);
+    const float zn = rng.Next(0.01f, 1.0f), zf = rng.Next(100.0f, 10000.0f);
+    Mat r = {};
+    r.m[0] = ys / rng.Next(1.0f, 2.4f);
+    r.m[5] = ys;
+    r.m[10] = zf / (zf - zn);
+    r.m[11] = 1.0f;
+    r.m[14] = -zn * zf / (zf - zn);
+    return r;
+}
+
+static Mat Random(Lcg& rng) {
+    Mat r;
+    for (float& v : r.m) v = rng.Next(-10.0f, 10.0f);
+    return r;
+}
+
+// The benchmark times the realistic inputs only; --verify also covers random and
+// degenerate matrices.
+static void BuildInputs(size_t count, std::vector<Mat>* realistic, std::vector<Mat>* all) {
+    Lcg rng = { 12345u };
+    for (size_t i = 0; i < count; ++i) {
+        switch (i % 4) {
+        case 0: realistic->push_back(Rigid(rng, 1.0f)); break;
+        case 1: realistic->push_back(Rigid(rng, rng.Next(0.1f, 10.0f))); break;
+        case 2: realistic->push_back(Perspective(rng)); break;
+        default: {
+            Mat v = Rigid(rng, 1.0f);
+            Mat p = Perspective(rng);
+            Mat vp;
+            mk::scalar::Multiply(v.m, p.m, vp.m);
+            realistic->push_back(vp);
+            break;
+        }
+        }
+    }
+    *all = *realistic;
+    for (size_t i = 0; i < count; ++i) {
+        all->push_back(Random(rng));
+    }
+
+    const float nan = std::numeric_limits<float>::quiet_NaN();
+    const float inf = std::numeric_limits<float>::infinity();
+    Mat zero = {};
+    Mat negZero;
+    for (float& v : negZero.m) v = -0.0f;
+    Mat singular = Random(rng);
+    for (int c = 0; c < 4; ++c) singular.m[12 + c] = singular.m[c];
+    Mat withNan = Rigid(rng, 1.0f);
+    withNan.m[5] = nan;
+    Mat withInf = Rigid(rng, 1.0f);
+    withInf.m[13] = inf;
+    Mat tiny = Rigid(rng, 1e-3f);
+    Mat denormal = Rigid(rng, 1.0f);
+    denormal.m[1] = 1e-40f;
+    const Mat edges[] = { zero, negZero, singular, withNan, withInf, tiny, denormal };
+    all->insert(all->end(), edges, edges + sizeof(edges) / sizeof(edges[0]));
+}
+
+// ─── Verification ────────────────────────────────────────────────────────────
+
+static int g_failures = 0;
+
+// NaNs match any NaN: which operand's NaN propagates depends on the compiler's
+// operand order, not on the kernel.
+static bool SameBits(const float* a, const float* b, int count) {
+    for (int i = 0; i < count; ++i) {
+        if (std::memcmp(a + i, b + i, sizeof(float)) != 0 && !(std::isnan(a[i]) && std::isnan(b[i]))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void ReportMismatch(const char* kernel, size_t index, const float* expected, const float* actual, int count) {
+    if (g_failures++ >= 10) {
+        return;
+    }
+    std::printf("  %s: input %llu differs\n", kernel, static_cast<unsigned long long>(index));
+    for (int i = 0; i < count; ++i) {
+        if (!SameBits(expected + i, actual + i, 1)) {
+            std::printf("    [%2d] expected %.9g (0x%08X), actual %.9g\n", i, expected[i],
+                        *reinterpret_cast<const uint32_t*>(expected + i), actual[i]);
+        }
+    }
+}
+
+static void CheckExact(const char* kernel, size_t index, const float* expected, const float* actual, int count) {
+    if (!SameBits(expected, actual, count)) {
+        ReportMismatch(kernel, index, expected, actual, count);
+    }
+}
+
+static void VerifyExactKernels(const std::vector<Mat>& inputs) {
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        const float* a = inputs[i].m;
+        const float* b = inputs[(i * 7 + 3) % inputs.size()].m;
+        float expected[16], actual[16];
+
+        mk::scalar::Multiply(a, b, expected);
+        mk::Multiply(a, b, actual);
+        CheckExact("Multiply", i, expected, actual, 16);
+
+        // The paired products must match two single Multiply calls exactly.
+        const float* c = inputs[(i * 5 + 1) % inputs.size()].m;
+        float expected1[16], actual1[16];
+        mk::scalar::Multiply(a, b, expected);
+        mk::scalar::Multiply(c, b, expected1);
+        mk::MultiplyPair(a, c, b, actual, actual1);
+        CheckExact("MultiplyPair", i, expected, actual, 16);
+        CheckExact("MultiplyPair", i, expected1, actual1, 16);
+
+        mk::scalar::Multiply(a, b, expected);
+        mk::scalar::Multiply(a, c, expected1);
+        mk::MultiplySharedLeft(a, b, c, actual, actual1);
+        CheckExact("MultiplySharedLeft", i, expected, actual, 16);
+        CheckExact("MultiplySharedLeft", i, expected1, actual1, 16);
+
+        mk::scalar::Transpose(a, expected);
+        mk::Transpose(a, actual);
+        CheckExact("Transpose", i, expected, actual, 16);
+
+        mk::scalar::InvertRigid(a, expected);
+        mk::InvertRigid(a, actual);
+        CheckExact("InvertRigid", i, expected, actual, 16);
+
+        expected[0] = mk::scalar::MaxAbsDiff(a, b);
+        actual[0] = mk::MaxAbsDiff(a, b);
+        CheckExact("MaxAbsDiff", i, expected, actual, 1);
+
+        mk::scalar::TransformPoint(a, b + 12, expected);
+        mk::TransformPoint(a, b + 12, actual);
+        CheckExact("TransformPoint", i, expected, actual, 3);
+
+        mk::scalar::TransformDirection(a, b + 12, expected);
+        mk::TransformDirection(a, b + 12, actual);
+        CheckExact("TransformDirection", i, expected, actual, 3);
+
+        // Output aliasing the input, as RemixLightingManager does.
+        float inPlace[3] = { b[12], b[13], b[14] };
+        mk::TransformPoint(a, inPlace, inPlace);
+        mk::scalar::TransformPoint(a, b + 12, expected);
+        CheckExact("TransformPoint (in place)", i, expected, inPlace, 3);
+    }
+}
+
+static void VerifyInvert(const std::vector<Mat>& inputs) {
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        float expected[16] = {}, actual[16] = {};
+        float expectedDet = 0.0f, actualDet = 0.0f;
+        const bool expectedOk = mk::scalar::Invert4x4(inputs[i].m, expected, &expectedDet);
+        const bool actualOk = mk::Invert4x4(inputs[i].m, actual, &actualDet);
+        if (expectedOk != actualOk) {
+            if (g_failures++ < 10) {
+                std::printf("  Invert4x4: input %llu returned %d, reference %d\n",
+                            static_cast<unsigned long long>(i), actualOk, expectedOk);
+            }
+            continue;
+        }
+        CheckExact("Invert4x4 determinant", i, &expectedDet, &actualDet, 1);
+        CheckExact("Invert4x4", i, expected, actual, 16);
+    }
+}
+
+// ─── Register gather ─────────────────────────────────────────────────────────
+
+struct GatherShape {
+    const char* name;
+    int rows;
+    bool transposed;
+};
+
+static const GatherShape kGatherShapes[] = {
+    { "Gather 4 rows", 4, false },
+    { "Gather 4 transposed", 4, true },
+    { "Gather 3 rows", 3, false },
+    { "Gather 3 transposed", 3, true },
+};
+
+static const uint32_t kGatherRegisters = 256;
+
+// The gather TryBuildMatrixFromConstantUpdate and the proxy's snapshot/global
+// register builders each used before GatherMatrix, branching on rows and layout.
+static void GatherBranched(const float* m, int rows, bool transposed, EngineMatrix* outMatrix) {
+    EngineMatrix out = {};
+    if (!transposed) {
+        out._11 = m[0]; out._12 = m[1]; out._13 = m[2]; out._14 = m[3];
+        out._21 = m[4]; out._22 = m[5]; out._23 = m[6]; out._24 = m[7];
+        out._31 = m[8]; out._32 = m[9]; out._33 = m[10]; out._34 = m[11];
+        if (rows == 4) {
+            out._41 = m[12]; out._42 = m[13]; out._43 = m[14]; out._44 = m[15];
+        } else {
+            out._41 = 0.0f; out._42 = 0.0f; out._43 = 0.0f; out._44 = 1.0f;
+        }
+    } else {
+        out._11 = m[0]; out._21 = m[1]; out._31 = m[2]; out._41 = m[3];
+        out._12 = m[4]; out._22 = m[5]; out._32 = m[6]; out._42 = m[7];
+        out._13 = m[8]; out._23 = m[9]; out._33 = m[10]; out._43 = m[11];
+        if (rows == 4) {
+            out._14 = m[12]; out._24 = m[13]; out._34 = m[14]; out._44 = m[15];
+        } else {
+            out._14 = 0.0f; out._24 = 0.0f; out._34 = 0.0f; out._44 = 1.0f;
+        }
+    }
+    *outMatrix = out;
+}
+
+static std::vector<float> BuildGatherUpload() {
+    Lcg rng = { 777u };
+    std::vector<float> upload(kGatherRegisters * 4);
+    for (float& v : upload) v = rng.Next(-100.0f, 100.0f);
+    return upload;
+}
+
+static void VerifyGather() {
+    const std::vector<float> upload = BuildGatherUpload();
+    for (const GatherShape& shape : kGatherShapes) {
+        const matrix_engine::MatrixGatherFn gather = matrix_engine::SelectMatrixGather(shape.rows, shape.transposed);
+        const uint32_t rows = static_cast<uint32_t>(shape.rows);
+        for (uint32_t offset = 0; offset + rows <= kGatherRegisters; ++offset) {
+            const float* m = upload.data() + offset * 4;
+            EngineMatrix expected, actual, built;
+            GatherBranched(m, shape.rows, shape.transposed, &expected);
+            gather(m, m + 4, m + 8, m + 12, &actual);
+            CheckExact(shape.name, offset, &expected._11, &actual._11, 16);
+            // Register-relative entry point, with the upload starting at c0.
+            if (!matrix_engine::TryBuildMatrixFromConstantUpdate(upload.data(), 0, kGatherRegisters,
+                                                                 static_cast<int>(offset), shape.rows,
+                                                                 shape.transposed, &built)) {
+                std::printf("  %s: TryBuildMatrixFromConstantUpdate rejected c%u\n", shape.name, offset);
+                g_failures++;
+                continue;
+            }
+            CheckExact(shape.name, offset, &expected._11, &built._11, 16);
+        }
+    }
+}
+
+// ─── Structural prefilter ────────────────────────────────────────────────────
+
+struct PrefilterUpload {
+    uint32_t startRegister;
+    std::vector<float> registers;
+};
+
+static void AppendRows(const Mat& m, int rows, bool transposed, std::vector<float>* out) {
+    Mat src = m;
+    if (transposed) mk::scalar::Transpose(m.m, src.m);
+    out->insert(out->end(), src.m, src.m + rows * 4);
+}
+
+// Uploads shaped like real constant files: camera blocks, bone palettes, 3-row
+// world matrices, lighting vectors and noise, with the degenerate matrices spliced in.
+// Sizes cover partial 4-lane blocks, and a few start mid-matrix.
+static void BuildPrefilterUploads(const std::vector<Mat>& realistic, const std::vector<Mat>& all,
+                                  std::vector<PrefilterUpload>* uploads) {
+    Lcg rng = { 4242u };
+    size_t next = 0;
+    const size_t uploadCount = (std::max)(static_cast<size_t>(64), realistic.size() / 8);
+    for (size_t u = 0; u < uploadCount; ++u) {
+        PrefilterUpload upload;
+        upload.startRegister = static_cast<uint32_t>(rng.Next(0.0f, 32.0f));
+        const uint32_t targetRegisters = 3u + static_cast<uint32_t>(rng.Next(0.0f, 254.0f));
+        const int kind = static_cast<int>(u % 5);
+        while (upload.registers.size() < targetRegisters * 4) {
+            const float pick = rng.Next(0.0f, 1.0f);
+            const Mat& m = all[next++ % all.size()];
+            if (kind == 0 || pick < 0.15f) {
+                AppendRows(Rigid(rng, rng.Next(0.5f, 1.5f)), 3, true, &upload.registers);
+            } else if (kind == 1 && pick < 0.6f) {
+                AppendRows(Rigid(rng, 1.0f), 4, false, &upload.registers);
+            } else if (pick < 0.7f) {
+                AppendRows(m, 4, pick < 0.45f, &upload.registers);
+            } else if (pick < 0.85f) {
+                AppendRows(m, 3, pick < 0.78f, &upload.registers);
+            } else {
+                for (int i = 0; i < 4; ++i) upload.registers.push_back(rng.Next(-2.0f, 2.0f));
+            }
+        }
+        upload.registers.resize(targetRegisters * 4);
+        if (u % 7 == 3 && upload.registers.size() > 8) {
+            upload.registers.erase(upload.registers.begin(), upload.registers.begin() + 8);
+        }
+        uploads->push_back(upload);
+    }
+}
+
+static const StructuralProbeOptions kProbeVariants[] = {
+    { true, true }, { true, false }, { false, true }, { false, false }
+};
+
+// The scan only reads finalClass, and the palette pass directClass, from a rejected
+// window, so both must be None wherever the mask rejects.
+static void VerifyStructuralPrefilter(const std::vector<PrefilterUpload>& uploads) {
+    uint64_t windows = 0;
+    uint64_t rejected = 0;
+    bool candidates[256];
+    for (const StructuralProbeOptions& probes : kProbeVariants) {
+        for (size_t u = 0; u < uploads.size(); ++u) {
+            const PrefilterUpload& upload = uploads[u];
+            const uint32_t vectorCount = static_cast<uint32_t>(upload.registers.size() / 4);
+            for (uint32_t rows : {4u, 3u}) {
+                if (vectorCount < rows) continue;
+                matrix_engine::BuildStructuralCandidateMask(upload.registers.data(), vectorCount, rows, probes, candidates);
+                for (uint32_t offset = 0; offset + rows <= vectorCount; ++offset) {
+                    windows++;
+                    if (candidates[offset]) continue;
+                    rejected++;
+                    const StructuralWindowResult scalar = matrix_engine::ClassifyStructuralWindow(
+                        upload.registers.data(), upload.startRegister, vectorCount, offset, rows, probes);
+                    if (scalar.finalClass != MatrixClass_None || scalar.directClass != MatrixClass_None) {
+                        std::printf("  prefilter rejected upload %zu c%u rows=%u (probes %d%d): scalar class %d/%d\n",
+                                    u, upload.startRegister + offset, rows, probes.transposedLayouts ? 1 : 0,
+                                    probes.inverseView ? 1 : 0, scalar.finalClass, scalar.directClass);
+                        g_failures++;
+                    }
+                }
+            }
+        }
+    }
+    std::printf("structural prefilter: %llu windows, %llu rejected\n",
+                static_cast<unsigned long long>(windows), static_cast<unsigned long long>(rejected));
+}
+
+// ─── Benchmark ───────────────────────────────────────────────────────────────
+
+static volatile float g_sink = 0.0f;
+
+template <typename Fn>
+static double TimeKernel(size_t opsPerPass, double minSeconds, Fn fn) {
+    using Clock = std::chrono::steady_clock;
+    double seconds = 0.0;
+    uint64_t passes = 0;
+    fn();
+    while (seconds < minSeconds || passes == 0) {
+        const Clock::time_point start = Clock::now();
+        fn();
+        seconds += std::chrono::duration<double>(Clock::now() - start).count();
+        passes++;
+    }
+    return seconds * 1e9 / (static_cast<double>(passes) * static_cast<double>(opsPerPass));
+}
+
+#define BENCH_MATRIX_KERNEL(name, body)                                                          \
+    do {                                                                                        \
+        std::vector<Mat> out(inputs.size());                                                    \
+        const size_t n = inputs.size();                                                         \
+        const double scalarNs = TimeKernel(n, minSeconds, [&] {                                 \
+            namespace impl = mk::scalar;                                                        \
+            for (size_t i = 0; i < n; ++i) { body; }                                            \
+            g_sink = g_sink + out[n / 2].m[0];                                                  \
+        });                                                                                     \
+        const double dispatchNs = TimeKernel(n, minSeconds, [&] {                               \
+            namespace impl = mk;                                                                \
+            for (size_t i = 0; i < n; ++i) { body; }                                            \
+            g_sink = g_sink + out[n / 2].m[0];                                                  \
+        });                                                                                     \
+        std::printf("%-20s %10.2f ns %10.2f ns %8.2fx\n", name, scalarNs, dispatchNs,           \
+                    dispatchNs > 0.0 ? scalarNs / dispatchNs : 0.0);                            \
+    } while (0)
+
+static void RunBenchmarks(const std::vector<Mat>& inputs, double minSeconds) {
+    std::printf("%-20s %13s %13s %9s\n", "Kernel", "scalar/op", "dispatch/op", "speedup");
+    std::printf("-----------------------------------------------------------\n");
+    const size_t m = inputs.size();
+    BENCH_MATRIX_KERNEL("Multiply", impl::Multiply(inputs[i].m, inputs[(i + 1) % m].m, out[i].m));
+    BENCH_MATRIX_KERNEL("MultiplyPair", impl::MultiplyPair(inputs[i].m, inputs[(i + 1) % m].m, inputs[(i + 2) % m].m,
+                                                           out[i].m, out[(i + 1) % m].m));
+    BENCH_MATRIX_KERNEL("MultiplySharedLeft",
+                        impl::MultiplySharedLeft(inputs[i].m, inputs[(i + 1) % m].m, inputs[(i + 2) % m].m,
+                                                 out[i].m, out[(i + 1) % m].m));
+    BENCH_MATRIX_KERNEL("Transpose", impl::Transpose(inputs[i].m, out[i].m));
+    BENCH_MATRIX_KERNEL("InvertRigid", impl::InvertRigid(inputs[i].m, out[i].m));
+    BENCH_MATRIX_KERNEL("Invert4x4", impl::Invert4x4(inputs[i].m, out[i].m, nullptr));
+    BENCH_MATRIX_KERNEL("MaxAbsDiff", out[i].m[0] = impl::MaxAbsDiff(inputs[i].m, inputs[(i + 1) % m].m));
+    BENCH_MATRIX_KERNEL("TransformPoint", impl::TransformPoint(inputs[i].m, inputs[(i + 1) % m].m + 12, out[i].m));
+    BENCH_MATRIX_KERNEL("TransformDirection",
+                        impl::TransformDirection(inputs[i].m, inputs[(i + 1) % m].m + 12, out[i].m));
+}
+
+template <int Rows, bool Transposed>
+static void GatherAllWindows(const float* upload, EngineMatrix* out) {
+    for (uint32_t offset = 0; offset + Rows <= kGatherRegisters; ++offset) {
+        const float* m = upload + offset * 4;
+        matrix_engine::GatherMatrix<Rows, Transposed>(m, m + 4, m + 8, m + 12, &out[offset]);
+    }
+}
+
+// Every window of a 256-register upload, per shape, as the classification loop
+// visits them. The shape is read through a volatile so the branched reference keeps
+// its runtime branches rather than being specialised by the compiler.
+static void RunGatherBenchmarks(double minSeconds) {
+    const std::vector<float> upload = BuildGatherUpload();
+    std::printf("\n%-20s %13s %13s %13s\n", "Window gather", "branched/win", "table/win", "template/win");
+    std::printf("---------------------------------------------------------------\n");
+    for (const GatherShape& shape : kGatherShapes) {
+        volatile int volatileRows = shape.rows;
+        volatile bool volatileTransposed = shape.transposed;
+        const uint32_t rows = static_cast<uint32_t>(shape.rows);
+        const size_t windows = kGatherRegisters - rows + 1;
+        std::vector<EngineMatrix> out(windows);
+        const double branchedNs = TimeKernel(windows, minSeconds, [&] {
+            const int r = volatileRows;
+            const bool t = volatileTransposed;
+            for (uint32_t offset = 0; offset + rows <= kGatherRegisters; ++offset) {
+                GatherBranched(upload.data() + offset * 4, r, t, &out[offset]);
+            }
+            g_sink = g_sink + out[windows / 2]._11;
+        });
+        const double dispatchNs = TimeKernel(windows, minSeconds, [&] {
+            const matrix_engine::MatrixGatherFn gather = matrix_engine::SelectMatrixGather(volatileRows, volatileTransposed);
+            for (uint32_t offset = 0; offset + rows <= kGatherRegisters; ++offset) {
+                const float* m = upload.data() + offset * 4;
+                gather(m, m + 4, m + 8, m + 12, &out[offset]);
+            }
+            g_sink = g_sink + out[windows / 2]._11;
+        });
+        const double inlinedNs = TimeKernel(windows, minSeconds, [&] {
+            switch (volatileRows * 2 + (volatileTransposed ? 1 : 0)) {
+            case 6: GatherAllWindows<3, false>(upload.data(), out.data()); break;
+            case 7: GatherAllWindows<3, true>(upload.data(), out.data()); break;
+            case 8: GatherAllWindows<4, false>(upload.data(), out.data()); break;
+            default: GatherAllWindows<4, true>(upload.data(), out.data()); break;
+            }
+            g_sink = g_sink + out[windows / 2]._11;
+        });
+        std::printf("%-20s %10.2f ns %10.2f ns %10.2f ns\n", shape.name, branchedNs, dispatchNs, inlinedNs);
+    }
+}
+
+// Every 4- and 3-row window of each upload, classified outright and behind the mask,
+// with the default probes.
+static void RunPrefilterBenchmarks(const std::vector<PrefilterUpload>& uploads, double minSeconds) {
+    const StructuralProbeOptions probes;
+    size_t windows = 0;
+    for (const PrefilterUpload& upload : uploads) {
+        const size_t vectorCount = upload.registers.size() / 4;
+        windows += (vectorCount >= 4 ? vectorCount - 3 : 0) + (vectorCount - 2);
+    }
+    bool candidates[256];
+    size_t candidateWindows = 0;
+    const double scalarNs = TimeKernel(windows, minSeconds, [&] {
+        int classes = 0;
+        for (const PrefilterUpload& upload : uploads) {
+            const uint32_t vectorCount = static_cast<uint32_t>(upload.registers.size() / 4);
+            for (uint32_t rows : {4u, 3u}) {
+                for (uint32_t offset = 0; offset + rows <= vectorCount; ++offset) {
+                    classes += matrix_engine::ClassifyStructuralWindow(upload.registers.data(), upload.startRegister,
+                                                                       vectorCount, offset, rows, probes).finalClass;
+                }
+            }
+        }
+        g_sink = g_sink + static_cast<float>(classes);
+    });
+    const double prefilteredNs = TimeKernel(windows, minSeconds, [&] {
+        int classes = 0;
+        candidateWindows = 0;
+        for (const PrefilterUpload& upload : uploads) {
+            const uint32_t vectorCount = static_cast<uint32_t>(upload.registers.size() / 4);
+            for (uint32_t rows : {4u, 3u}) {
+                if (vectorCount < rows) continue;
+                matrix_engine::BuildStructuralCandidateMask(upload.registers.data(), vectorCount, rows, probes, candidates);
+                for (uint32_t offset = 0; offset + rows <= vectorCount; ++offset) {
+                    if (!candidates[offset]) continue;
+                    candidateWindows++;
+                    classes += matrix_engine::ClassifyStructuralWindow(upload.registers.data(), upload.startRegister,
+                                                                       vectorCount, offset, rows, probes).finalClass;
+                }
+            }
+        }
+        g_sink = g_sink + static_cast<float>(classes);
+    });
+    std::printf("\n%-20s %13s %13s %9s %9s\n", "Structural scan", "scalar/win", "masked/win", "speedup", "rejected");
+    std::printf("---------------------------------------------------------------------\n");
+    std::printf("%-20s %10.2f ns %10.2f ns %8.2fx %8.1f%%\n", "All windows", scalarNs, prefilteredNs,
+                prefilteredNs > 0.0 ? scalarNs / prefilteredNs : 0.0,
+                windows > 0 ? 100.0 * static_cast<double>(windows - candidateWindows) / static_cast<double>(windows) : 0.0);
+}
+
+int main(int argc, char** argv) {
+    bool verify = false;
+    size_t count = 4096;
+    double minSeconds = 0.25;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--verify") == 0) {
+            verify = true;
+        } else if (std::strcmp(argv[i], "--count") == 0 && i + 1 < argc) {
+            count = static_cast<size_t>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (std::strcmp(argv[i], "--min-time") == 0 && i + 1 < argc) {
+            minSeconds = std::atof(argv[++i]);
+        } else {
+            std::fprintf(stderr, "usage: %s [--verify] [--count N] [--min-time SECONDS]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (count == 0) count = 1;
+
+    std::vector<Mat> realistic;
+    std::vector<Mat> all;
+    BuildInputs(count, &realistic, &all);
+    std::vector<PrefilterUpload> uploads;
+    BuildPrefilterUploads(realistic, all, &uploads);
+    std::printf("matrix kernels: %s, %llu inputs\n",
+                MATRIX_KERNELS_SSE2 ? "SSE2" : "scalar (deterministic)",
+                static_cast<unsigned long long>(all.size()));
+
+    if (verify) {
+        VerifyExactKernels(all);
+        VerifyInvert(all);
+        VerifyGather();
+        VerifyStructuralPrefilter(uploads);
+        std::printf("%s (%d mismatches)\n", g_failures == 0 ? "PASS" : "FAIL", g_failures);
+        return g_failures == 0 ? 0 : 1;
+    }
+    RunBenchmarks(realistic, minSeconds);
+    RunGatherBenchmarks(minSeconds);
+    RunPrefilterBenchmarks(uploads, minSeconds);
+    return 0;
+}
@@ -0,0 +1,191 @@
+#pragma once
+
+// Flat in-memory op stream shared by the offline tools: trace_replay loads it from
+// a .cpat file, workload_bench generates it. The timed loops do no decoding or
+// allocation.
+
+#include "../api_trace.h"
+#include "../golden_output.h"
+#include "../matrix_engine.h"
+
+#include <cctype>
+#include <cstdio>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+enum ReplayOpKind {
+    ReplayOp_SetVertexShader,
+    ReplayOp_VertexConstants,
+    ReplayOp_GameSetTransform,
+    ReplayOp_Draw,
+    ReplayOp_Present,
+    ReplayOp_BeginScene
+};
+
+struct ReplayOp {
+    ReplayOpKind kind;
+    uint32_t a;       // shader id, start register or transform slot
+    uint32_t count;   // vector count
+    size_t offset;    // into ReplayTrace::constants
+};
+
+struct ReplayTrace {
+    std::vector<ReplayOp> ops;
+    std::vector<float> constants;
+    std::unordered_map<uint32_t, uint32_t> shaderHashes; // shader id -> bytecode hash
+    uint64_t records = 0;
+    uint64_t uploads = 0;
+    uint64_t draws = 0;
+    uint64_t frames = 0;
+
+    void AddSetVertexShader(uint32_t shaderId) {
+        ops.push_back({ ReplayOp_SetVertexShader, shaderId, 0, 0 });
+    }
+    void AddConstants(uint32_t startRegister, const float* data, uint32_t vectorCount) {
+        ops.push_back({ ReplayOp_VertexConstants, startRegister, vectorCount, constants.size() });
+        constants.insert(constants.end(), data, data + vectorCount * 4);
+        uploads++;
+    }
+    void AddGameSetTransform(EngineTransformSlot slot, const float matrix[16]) {
+        ops.push_back({ ReplayOp_GameSetTransform, static_cast<uint32_t>(slot), 4, constants.size() });
+        constants.insert(constants.end(), matrix, matrix + 16);
+    }
+    void AddDraw() {
+        ops.push_back({ ReplayOp_Draw, 0, 0, 0 });
+        draws++;
+    }
+    void AddPresent() {
+        ops.push_back({ ReplayOp_Present, 0, 0, 0 });
+        frames++;
+    }
+    void AddBeginScene() {
+        ops.push_back({ ReplayOp_BeginScene, 0, 0, 0 });
+    }
+};
+
+// D3DTRANSFORMSTATETYPE values recorded by SetTransform.
+static constexpr uint32_t kTransformStateView = 2;
+static constexpr uint32_t kTransformStateProjection = 3;
+static constexpr uint32_t kTransformStateWorld = 256;
+
+// Loads a .cpat trace recorded by the proxy. Tools that call this also link
+// api_trace.cpp and golden_output.cpp.
+inline bool LoadReplayTrace(const char* path, ReplayTrace* trace) {
+    ApiTraceReader reader;
+    if (!reader.Open(path)) {
+        std::fprintf(stderr, "error: cannot open %s or it is not a version 1-%u trace\n", path, kApiTraceVersion);
+        return false;
+    }
+    ApiTraceEvent event;
+    while (reader.Next(&event)) {
+        trace->records++;
+        switch (event.type) {
+        case ApiTraceRecordType::CreateVertexShader:
+            trace->shaderHashes[event.shaderId] = GoldenShaderHash(event.tokens, event.tokenCount);
+            break;
+        case ApiTraceRecordType::SetVertexShader:
+            trace->AddSetVertexShader(event.shaderId);
+            break;
+        case ApiTraceRecordType::VertexConstantsDelta:
+        case ApiTraceRecordType::VertexConstantsRef:
+            trace->AddConstants(event.startRegister, event.constants, event.vectorCount);
+            break;
+        case ApiTraceRecordType::SetTransform:
+            if (event.transformState == kTransformStateWorld) {
+                trace->AddGameSetTransform(EngineTransform_World, event.matrix);
+            } else if (event.transformState == kTransformStateView) {
+                trace->AddGameSetTransform(EngineTransform_View, event.matrix);
+            } else if (event.transformState == kTransformStateProjection) {
+                trace->AddGameSetTransform(EngineTransform_Projection, event.matrix);
+            }
+            break;
+        case ApiTraceRecordType::Draw:
+            trace->AddDraw();
+            break;
+        case ApiTraceRecordType::Present:
+            trace->AddPresent();
+            break;
+        case ApiTraceRecordType::BeginScene:
+            trace->AddBeginScene();
+            break;
+        default:
+            break;
+        }
+    }
+    if (reader.HadError()) {
+        std::fprintf(stderr, "warning: %s is truncated or malformed; replaying the %llu records before the damage\n",
+                     path, static_cast<unsigned long long>(trace->records));
+    }
+    return true;
+}
+
+// The caches the proxy shares between its devices. A run attaches a cleared set to
+// its engine so every run learns layouts from scratch, as a fresh process would.
+struct ReplayEngineCaches {
+    LearnedLayoutMap layouts;
+    StructuralWindowCache windows;
+
+    void Attach(MatrixEngine& engine) {
+        layouts.clear();
+        windows.Clear();
+        engine.SetLayoutTable(&layouts);
+        engine.SetWindowCache(&windows);
+    }
+};
+
+inline void ApplyReplayOp(MatrixEngine& engine, const ReplayTrace& trace, const ReplayOp& op,
+                          EngineDrawTransforms* drawOut = nullptr) {
+    switch (op.kind) {
+    case ReplayOp_SetVertexShader: {
+        // Bytecode analysis is not recorded, so only the layout-learning hash is known.
+        EngineShaderInfo info;
+        auto it = trace.shaderHashes.find(op.a);
+        info.hash = it != trace.shaderHashes.end() ? it->second : 0;
+        engine.OnSetVertexShader(op.a, info);
+        break;
+    }
+    case ReplayOp_VertexConstants:
+        engine.OnVertexShaderConstants(op.a, trace.constants.data() + op.offset, op.count);
+        break;
+    case ReplayOp_GameSetTransform:
+        engine.OnGameSetTransform(static_cast<EngineTransformSlot>(op.a),
+                                  reinterpret_cast<const EngineMatrix*>(trace.constants.data() + op.offset));
+        break;
+    case ReplayOp_Draw:
+        engine.FlushDeferredClassification();
+        engine.OnDraw(drawOut);
+        break;
+    case ReplayOp_Present:
+        engine.OnPresent();
+        break;
+    case ReplayOp_BeginScene:
+        engine.OnBeginScene();
+        break;
+    }
+}
+
+inline bool ReplayEqualsIgnoreCase(const char* a, const char* b) {
+    for (; *a && *b; ++a, ++b) {
+        if (std::tolower(static_cast<unsigned char>(*a)) != std::tolower(static_cast<unsigned char>(*b))) {
+            return false;
+        }
+    }
+    return *a == *b;
+}
+
+inline bool ParseReplayProfile(const char* name, GameProfileKind* out) {
+    if (ReplayEqualsIgnoreCase(name, "None")) {
+        *out = GameProfile_None;
+    } else if (ReplayEqualsIgnoreCase(name, "MGR") || ReplayEqualsIgnoreCase(name, "MetalGearRising")) {
+        *out = GameProfile_MetalGearRising;
+    } else if (ReplayEqualsIgnoreCase(name, "DMC4") || ReplayEqualsIgnoreCase(name, "DevilMayCry4")) {
+        *out = GameProfile_DevilMayCry4;
+    } else if (ReplayEqualsIgnoreCase(name, "Barnyard")) {
+        *out = GameProfile_Barnyard;
+    } else {
+        return false;
+    }
+    return true;
+}
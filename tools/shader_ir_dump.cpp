@@ -0,0 +1,508 @@
+// Prints the typed IR that shader_bytecode.h decodes from D3D9 shader bytecode, and
+// the position transform map shader_dataflow.h derives from it.
+//
+// Build (Linux):
+//   g++ -std=c++17 -O2 -I. tools/shader_ir_dump.cpp shader_bytecode.cpp shader_dataflow.cpp shader_cache.cpp -o shader_ir_dump
+//
+// Usage:
+//   shader_ir_dump [--time] <file.bytecode.bin>...
+//   shader_ir_dump --cache <camera_proxy_shaders.cache>
+//   shader_ir_dump --self-test
+//
+// Input files are raw token streams, as written by "Dump bytecode" in the shader
+// browser (Shader_dump/<hash>.bytecode.bin). --time additionally decodes every file
+// repeatedly and reports the average decode time.
+// --cache lists the analysis results and locked layouts stored in a shader cache.
+// --self-test decodes a set of hand-assembled vs_1_1 / vs_2_0 / vs_3_0 / ps_1_1 /
+// ps_2_0 programs plus broken streams and checks the decoded fields and formatted
+// text, then checks the transform maps of dp4, m4x4, mul/mad and skinned vertex
+// shaders. Exit code is 0 when everything matches and 1 otherwise.
+
+#include "../shader_bytecode.h"
+#include "../shader_cache.h"
+#include "../shader_dataflow.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+// ─── Token assembly ──────────────────────────────────────────────────────────
+
+static constexpr uint32_t kParam = 0x80000000u;
+
+static uint32_t FileBits(uint32_t file) {
+    return ((file & 0x7u) << 28) | ((file & 0x18u) << 8);
+}
+
+static uint32_t Dst(uint32_t file, uint32_t index, uint32_t mask = 0xF, uint32_t modifier = 0) {
+    return kParam | FileBits(file) | (mask << 16) | (modifier << 20) | index;
+}
+
+static uint32_t Src(uint32_t file, uint32_t index, uint32_t swizzle = kShaderSwizzleIdentity,
+                    uint32_t modifier = 0, bool relative = false) {
+    return kParam | FileBits(file) | (swizzle << 16) | (modifier << 24) | (relative ? 0x2000u : 0u) | index;
+}
+
+// SM2+ opcode token; SM1 streams pass length 0.
+static uint32_t Op(uint32_t opcode, uint32_t length = 0, uint32_t control = 0) {
+    return opcode | (control << 16) | (length << 24);
+}
+
+static uint32_t FloatBits(float value) {
+    uint32_t bits = 0;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+static constexpr uint32_t kSwizzleX = 0x00;
+static constexpr uint32_t kSwizzleY = 0x55;
+static constexpr uint32_t kSwizzleZ = 0xAA;
+static constexpr uint32_t kSwizzleW = 0xFF;
+
+static void FormatMatrixUse(const ShaderMatrixUse& use, char* out, size_t outSize) {
+    snprintf(out, outSize, "c%d%s/%u%s:%s", use.baseRegister, use.relative ? "[a]" : "", use.rows,
+             use.transposed ? "T" : "", ShaderMatrixRoleName(use.role));
+}
+
+// ─── Self-test ───────────────────────────────────────────────────────────────
+
+struct SelfTest {
+    int failures = 0;
+
+    void Check(bool ok, const char* program, const char* what) {
+        if (!ok) {
+            ++failures;
+            printf("FAIL %s: %s\n", program, what);
+        }
+    }
+
+    // Decodes `tokens` and compares the model string and every formatted line.
+    bool Expect(const char* name, const std::vector<uint32_t>& tokens, const char* model,
+                const std::vector<const char*>& lines, ShaderProgram* out) {
+        size_t errorToken = 0;
+        const ShaderDecodeStatus status = DecodeShaderBytecode(tokens.data(), tokens.size(), out, &errorToken);
+        if (status != ShaderDecode_Ok) {
+            ++failures;
+            printf("FAIL %s: %s at token %zu\n", name, ShaderDecodeStatusName(status), errorToken);
+            return false;
+        }
+        char text[256];
+        FormatShaderModel(*out, text, sizeof(text));
+        if (strcmp(text, model) != 0) {
+            ++failures;
+            printf("FAIL %s: model '%s', expected '%s'\n", name, text, model);
+        }
+        if (out->instructions.size() != lines.size()) {
+            ++failures;
+            printf("FAIL %s: %zu instructions, expected %zu\n", name, out->instructions.size(), lines.size());
+            return false;
+        }
+        for (size_t i = 0; i < lines.size(); ++i) {
+            FormatShaderInstruction(*out, out->instructions[i], text, sizeof(text));
+            if (strcmp(text, lines[i]) != 0) {
+                ++failures;
+                printf("FAIL %s: line %zu '%s', expected '%s'\n", name, i, text, lines[i]);
+            }
+        }
+        return true;
+    }
+
+    // Decodes `tokens` and compares the transform map with "c<base>/<rows>:<role>" uses
+    // in map order, relative uses written "c<base>[a]/<rows>:<role>" and mul/mad column
+    // chains "c<base>/<rows>T:<role>".
+    void ExpectMap(const char* name, const std::vector<uint32_t>& tokens, bool complete,
+                   const std::vector<const char*>& uses, ShaderTransformMap* out) {
+        ShaderProgram program;
+        if (DecodeShaderBytecode(tokens.data(), tokens.size(), &program) != ShaderDecode_Ok) {
+            ++failures;
+            printf("FAIL %s: does not decode\n", name);
+            return;
+        }
+        AnalyseShaderTransforms(program, out);
+        Check(out->complete == complete, name, complete ? "map incomplete" : "map unexpectedly complete");
+        if (out->useCount != uses.size()) {
+            ++failures;
+            printf("FAIL %s: %u matrix uses, expected %zu\n", name, out->useCount, uses.size());
+            return;
+        }
+        for (size_t i = 0; i < uses.size(); ++i) {
+            char text[64];
+            FormatMatrixUse(out->uses[i], text, sizeof(text));
+            if (strcmp(text, uses[i]) != 0) {
+                ++failures;
+                printf("FAIL %s: use %zu '%s', expected '%s'\n", name, i, text, uses[i]);
+            }
+        }
+    }
+
+    void ExpectStatus(const char* name, const std::vector<uint32_t>& tokens,
+                      ShaderDecodeStatus expected, size_t expectedToken) {
+        ShaderProgram program;
+        size_t errorToken = 0;
+        const ShaderDecodeStatus status = DecodeShaderBytecode(tokens.data(), tokens.size(), &program, &errorToken);
+        if (status != expected || errorToken != expectedToken) {
+            ++failures;
+            printf("FAIL %s: %s at token %zu, expected %s at token %zu\n", name,
+                   ShaderDecodeStatusName(status), errorToken, ShaderDecodeStatusName(expected), expectedToken);
+        }
+    }
+};
+
+static int RunSelfTest() {
+    SelfTest t;
+    ShaderProgram p;
+
+    // vs_1_1: FFP-style position transform and an a0-indexed palette read.
+    if (t.Expect("vs_1_1", {
+            0xFFFE0101u,
+            Op(ShaderOp_Dcl), kParam | 0u, Dst(ShaderReg_Input, 0),
+            Op(ShaderOp_Dp4), Dst(ShaderReg_RastOut, 0, 0x1), Src(ShaderReg_Input, 0), Src(ShaderReg_Const, 0),
+            Op(ShaderOp_Dp4), Dst(ShaderReg_RastOut, 0, 0x2), Src(ShaderReg_Input, 0), Src(ShaderReg_Const, 1),
+            Op(ShaderOp_Dp4), Dst(ShaderReg_RastOut, 0, 0x4), Src(ShaderReg_Input, 0), Src(ShaderReg_Const, 2),
+            Op(ShaderOp_Dp4), Dst(ShaderReg_RastOut, 0, 0x8), Src(ShaderReg_Input, 0), Src(ShaderReg_Const, 3),
+            Op(ShaderOp_Mov), Dst(ShaderReg_Addr, 0, 0x1), Src(ShaderReg_Input, 1, kSwizzleX),
+            Op(ShaderOp_Mov), Dst(ShaderReg_AttrOut, 0), Src(ShaderReg_Const, 4, kShaderSwizzleIdentity, 0, true),
+            0x0000FFFFu },
+            "vs_1_1",
+            { "dcl_position v0", "dp4 oPos.x, v0, c0", "dp4 oPos.y, v0, c1", "dp4 oPos.z, v0, c2",
+              "dp4 oPos.w, v0, c3", "mov a0.x, v1.x", "mov oD0, c4[a0.x]" }, &p)) {
+        const ShaderInstruction& dp4 = p.instructions[4];
+        t.Check(dp4.opcode == ShaderOp_Dp4 && dp4.hasDst && dp4.srcCount == 2, "vs_1_1", "dp4 shape");
+        t.Check(dp4.dst.file == ShaderReg_RastOut && dp4.dst.index == kShaderRastOutPosition && dp4.dst.mask == 0x8,
+                "vs_1_1", "dp4 destination");
+        t.Check(dp4.src[1].file == ShaderReg_Const && dp4.src[1].index == 3, "vs_1_1", "dp4 constant");
+        const ShaderOperand& palette = p.instructions[6].src[0];
+        t.Check(palette.relative && palette.relativeFile == ShaderReg_Addr && palette.index == 4,
+                "vs_1_1", "implicit a0.x relative source");
+        t.Check(!p.isPixelShader, "vs_1_1", "stage");
+    }
+
+    // vs_2_0: comment block, def literals, rep, modifiers and an explicit relative token.
+    if (t.Expect("vs_2_0", {
+            0xFFFE0200u,
+            0x0002FFFEu, 0x42424242u, 0x43434343u,
+            Op(ShaderOp_Def, 5), Dst(ShaderReg_Const, 10),
+            FloatBits(1.0f), FloatBits(0.0f), FloatBits(0.5f), FloatBits(2.0f),
+            Op(ShaderOp_Mova, 2), Dst(ShaderReg_Addr, 0, 0x8), Src(ShaderReg_Input, 2, kSwizzleW),
+            Op(ShaderOp_Rep, 1), Src(ShaderReg_ConstInt, 0),
+            Op(ShaderOp_Mov, 3), Dst(ShaderReg_Temp, 1),
+            Src(ShaderReg_Const, 2, kShaderSwizzleIdentity, 0, true), Src(ShaderReg_Addr, 0, kSwizzleW),
+            Op(ShaderOp_EndRep),
+            Op(ShaderOp_Max, 3), Dst(ShaderReg_Temp, 0, 0xF, 1), Src(ShaderReg_Temp, 1, 0x1B, 1),
+            Src(ShaderReg_Const, 0, kSwizzleX),
+            0x0000FFFFu },
+            "vs_2_0",
+            { "def c10, 1, 0, 0.5, 2", "mova a0.w, v2.w", "rep i0", "mov r1, c2[a0.w]", "endrep",
+              "max_sat r0, -r1.wzyx, c0.x" }, &p)) {
+        float literal = 0.0f;
+        memcpy(&literal, &p.instructions[0].extra[2], sizeof(literal));
+        t.Check(literal == 0.5f, "vs_2_0", "def literal");
+        t.Check(!p.instructions[2].hasDst && p.instructions[2].srcCount == 1, "vs_2_0", "rep has no destination");
+        const ShaderOperand& rel = p.instructions[3].src[0];
+        t.Check(p.instructions[3].srcCount == 1 && rel.relativeComponent == 3, "vs_2_0", "relative token consumed");
+        const ShaderOperand& clamp = p.instructions[5].src[1];
+        t.Check(clamp.file == ShaderReg_Const && clamp.index == 0 && clamp.mask == 0x00 && clamp.modifier == 0,
+                "vs_2_0", "max c0.x operand");
+    }
+
+    // vs_3_0: output declarations, setp/predication and aL-relative constants.
+    if (t.Expect("vs_3_0", {
+            0xFFFE0300u,
+            Op(ShaderOp_Dcl, 2), kParam | 5u | (1u << 16), Dst(ShaderReg_Output, 3, 0x3),
+            Op(ShaderOp_SetP, 3, 1), Dst(ShaderReg_Predicate, 0), Src(ShaderReg_Temp, 0), Src(ShaderReg_Const, 0),
+            Op(ShaderOp_Add, 4) | 0x10000000u, Dst(ShaderReg_Temp, 1), Src(ShaderReg_Predicate, 0),
+            Src(ShaderReg_Temp, 1), Src(ShaderReg_Const, 1),
+            Op(ShaderOp_Mov, 3), Dst(ShaderReg_Output, 3, 0x3),
+            Src(ShaderReg_Const, 8, kShaderSwizzleIdentity, 0, true), Src(ShaderReg_Loop, 0, kSwizzleX),
+            0x0000FFFFu },
+            "vs_3_0",
+            { "dcl_texcoord1 o3.xy", "setp_gt p0, r0, c0", "(p0) add r1, r1, c1", "mov o3.xy, c8[aL]" }, &p)) {
+        const ShaderInstruction& add = p.instructions[2];
+        t.Check(add.predicated && add.predicate.file == ShaderReg_Predicate && add.srcCount == 2,
+                "vs_3_0", "predicate split from sources");
+        t.Check(p.instructions[3].src[0].relativeFile == ShaderReg_Loop, "vs_3_0", "aL relative file");
+    }
+
+    // ps_1_1: SM1 def (raw literals), tex, and a co-issued instruction.
+    if (t.Expect("ps_1_1", {
+            0xFFFF0101u,
+            Op(ShaderOp_Def), Dst(ShaderReg_Const, 0), FloatBits(1.0f), FloatBits(1.0f), FloatBits(1.0f),
+            FloatBits(-0.25f),
+            Op(ShaderOp_Tex), Dst(ShaderReg_Texture, 0),
+            Op(ShaderOp_Mul), Dst(ShaderReg_Temp, 0, 0x7), Src(ShaderReg_Texture, 0), Src(ShaderReg_Input, 0),
+            Op(ShaderOp_Mov) | 0x40000000u, Dst(ShaderReg_Temp, 0, 0x8), Src(ShaderReg_Const, 0, kSwizzleW),
+            0x0000FFFFu },
+            "ps_1_1",
+            { "def c0, 1, 1, 1, -0.25", "tex t0", "mul r0.xyz, t0, v0", "+mov r0.w, c0.w" }, &p)) {
+        t.Check(p.isPixelShader, "ps_1_1", "stage");
+        t.Check(p.instructions[3].coissue, "ps_1_1", "co-issue flag");
+    }
+
+    // ps_2_0: sampler and texture declarations, texld, source negate.
+    t.Expect("ps_2_0", {
+            0xFFFF0200u,
+            Op(ShaderOp_Dcl, 2), kParam | (2u << 27), Dst(ShaderReg_Sampler, 0),
+            Op(ShaderOp_Dcl, 2), kParam, Dst(ShaderReg_Texture, 0, 0x3),
+            Op(ShaderOp_Tex, 3), Dst(ShaderReg_Temp, 0), Src(ShaderReg_Texture, 0), Src(ShaderReg_Sampler, 0),
+            Op(ShaderOp_Mul, 3), Dst(ShaderReg_Temp, 0, 0xF, 2), Src(ShaderReg_Temp, 0), Src(ShaderReg_Const, 0, kShaderSwizzleIdentity, 1),
+            Op(ShaderOp_Mov, 2), Dst(ShaderReg_ColorOut, 0), Src(ShaderReg_Temp, 0),
+            0x0000FFFFu },
+            "ps_2_0",
+            { "dcl_2d s0", "dcl t0.xy", "texld r0, t0, s0", "mul_pp r0, r0, -c0", "mov oC0, r0" }, &p);
+
+    // Broken streams report where decoding stopped.
+    t.ExpectStatus("empty", {}, ShaderDecode_Empty, 0);
+    t.ExpectStatus("bad version", { 0x12340101u, 0x0000FFFFu }, ShaderDecode_BadVersion, 0);
+    t.ExpectStatus("truncated", { 0xFFFE0200u, Op(ShaderOp_Mov, 2), Dst(ShaderReg_Temp, 0) },
+                   ShaderDecode_Truncated, 1);
+    t.ExpectStatus("truncated comment", { 0xFFFE0200u, 0x0004FFFEu, 0u }, ShaderDecode_Truncated, 1);
+    t.ExpectStatus("missing end", { 0xFFFE0200u, Op(ShaderOp_Mov, 2), Dst(ShaderReg_Temp, 0), Src(ShaderReg_Temp, 1) },
+                   ShaderDecode_MissingEnd, 4);
+    t.ExpectStatus("too many sources", { 0xFFFE0200u, Op(ShaderOp_Mov, 6), Dst(ShaderReg_Temp, 0),
+                                         Src(ShaderReg_Temp, 1), Src(ShaderReg_Temp, 1), Src(ShaderReg_Temp, 1),
+                                         Src(ShaderReg_Temp, 1), Src(ShaderReg_Temp, 1), 0x0000FFFFu },
+                   ShaderDecode_Malformed, 1);
+
+    // Transform maps. The vs_1_1 program above: one dp4 group straight to oPos.
+    ShaderTransformMap map;
+    t.ExpectMap("map dp4", {
+            0xFFFE0101u,
+            Op(ShaderOp_Dp4), Dst(ShaderReg_RastOut, 0, 0x1), Src(ShaderReg_Input, 0), Src(ShaderReg_Const, 0),
+            Op(ShaderOp_Dp4), Dst(ShaderReg_RastOut, 0, 0x2), Src(ShaderReg_Input, 0), Src(ShaderReg_Const, 1),
+            Op(ShaderOp_Dp4), Dst(ShaderReg_RastOut, 0, 0x4), Src(ShaderReg_Input, 0), Src(ShaderReg_Const, 2),
+            Op(ShaderOp_Dp4), Dst(ShaderReg_RastOut, 0, 0x8), Src(ShaderReg_Input, 0), Src(ShaderReg_Const, 3),
+            0x0000FFFFu }, true, { "c0/4:WorldViewProjection" }, &map);
+    t.Check(map.positionInput == 0 && map.stageCount == 1 && !map.skinned, "map dp4", "chain shape");
+
+    // World, View and Projection through temporaries, plus a normal through the world rows.
+    t.ExpectMap("map m4x4", {
+            0xFFFE0200u,
+            Op(ShaderOp_M4x3, 3), Dst(ShaderReg_Temp, 0, 0x7), Src(ShaderReg_Input, 0), Src(ShaderReg_Const, 0),
+            Op(ShaderOp_Mov, 2), Dst(ShaderReg_Temp, 0, 0x8), Src(ShaderReg_Input, 0, kSwizzleW),
+            Op(ShaderOp_M4x4, 3), Dst(ShaderReg_Temp, 1), Src(ShaderReg_Temp, 0), Src(ShaderReg_Const, 4),
+            Op(ShaderOp_M4x4, 3), Dst(ShaderReg_RastOut, 0), Src(ShaderReg_Temp, 1), Src(ShaderReg_Const, 8),
+            Op(ShaderOp_M3x3, 3), Dst(ShaderReg_Temp, 2, 0x7), Src(ShaderReg_Input, 3), Src(ShaderReg_Const, 0),
+            Op(ShaderOp_Mov, 2), Dst(ShaderReg_Output, 0), Src(ShaderReg_Temp, 2),
+            0x0000FFFFu }, true, { "c0/3:World", "c4/4:View", "c8/4:Projection" }, &map);
+    t.Check(map.worldTemp == 0 && map.viewTemp == 1 && !map.ambiguousSplit, "map m4x4", "world/view temporaries");
+
+    // mul/mad column chain for World, then a dp4 group for the rest.
+    t.ExpectMap("map mul/mad", {
+            0xFFFE0200u,
+            Op(ShaderOp_Mul, 3), Dst(ShaderReg_Temp, 0), Src(ShaderReg_Input, 0, kSwizzleX), Src(ShaderReg_Const, 20),
+            Op(ShaderOp_Mad, 4), Dst(ShaderReg_Temp, 0), Src(ShaderReg_Input, 0, kSwizzleY), Src(ShaderReg_Const, 21),
+            Src(ShaderReg_Temp, 0),
+            Op(ShaderOp_Mad, 4), Dst(ShaderReg_Temp, 0), Src(ShaderReg_Input, 0, kSwizzleZ), Src(ShaderReg_Const, 22),
+            Src(ShaderReg_Temp, 0),
+            Op(ShaderOp_Add, 3), Dst(ShaderReg_Temp, 0), Src(ShaderReg_Temp, 0), Src(ShaderReg_Const, 23),
+            Op(ShaderOp_Dp4, 3), Dst(ShaderReg_RastOut, 0, 0x1), Src(ShaderReg_Temp, 0), Src(ShaderReg_Const, 4),
+            Op(ShaderOp_Dp4, 3), Dst(ShaderReg_RastOut, 0, 0x2), Src(ShaderReg_Temp, 0), Src(ShaderReg_Const, 5),
+            Op(ShaderOp_Dp4, 3), Dst(ShaderReg_RastOut, 0, 0x4), Src(ShaderReg_Temp, 0), Src(ShaderReg_Const, 6),
+            Op(ShaderOp_Dp4, 3), Dst(ShaderReg_RastOut, 0, 0x8), Src(ShaderReg_Temp, 0), Src(ShaderReg_Const, 7),
+            0x0000FFFFu }, true, { "c20/4T:World", "c4/4:ViewProjection" }, &map);
+    t.Check(map.ambiguousSplit && map.worldTemp == 0, "map mul/mad", "two-stage split");
+
+    // vs_3_0 skinning: a weighted palette blend, then ViewProjection into the
+    // dcl_position output. The def literal is not a matrix.
+    t.ExpectMap("map skinned", {
+            0xFFFE0300u,
+            Op(ShaderOp_Dcl, 2), kParam | 0u, Dst(ShaderReg_Output, 0),
+            Op(ShaderOp_Def, 5), Dst(ShaderReg_Const, 95),
+            FloatBits(1.0f), FloatBits(0.0f), FloatBits(0.0f), FloatBits(0.0f),
+            Op(ShaderOp_Mova, 2), Dst(ShaderReg_Addr, 0, 0x1), Src(ShaderReg_Input, 1, kSwizzleX),
+            Op(ShaderOp_M4x3, 4), Dst(ShaderReg_Temp, 0, 0x7), Src(ShaderReg_Input, 0),
+            Src(ShaderReg_Const, 20, kShaderSwizzleIdentity, 0, true), Src(ShaderReg_Addr, 0, kSwizzleX),
+            Op(ShaderOp_Mul, 3), Dst(ShaderReg_Temp, 1, 0x7), Src(ShaderReg_Temp, 0), Src(ShaderReg_Input, 2, kSwizzleX),
+            Op(ShaderOp_Mov, 2), Dst(ShaderReg_Temp, 1, 0x8), Src(ShaderReg_Const, 95, kSwizzleX),
+            Op(ShaderOp_M4x4, 3), Dst(ShaderReg_Output, 0), Src(ShaderReg_Temp, 1), Src(ShaderReg_Const, 0),
+            0x0000FFFFu }, true, { "c0/4:ViewProjection", "c20[a]/3:BonePalette" }, &map);
+    t.Check(map.skinned && map.worldTemp == 1, "map skinned", "skinned world-space temporary");
+
+    // A morphed position is an opaque root: the role stands, the map is not complete.
+    t.ExpectMap("map morph", {
+            0xFFFE0200u,
+            Op(ShaderOp_Add, 3), Dst(ShaderReg_Temp, 0), Src(ShaderReg_Input, 0), Src(ShaderReg_Input, 4),
+            Op(ShaderOp_M4x4, 3), Dst(ShaderReg_RastOut, 0), Src(ShaderReg_Temp, 0), Src(ShaderReg_Const, 0),
+            0x0000FFFFu }, false, { "c0/4:WorldViewProjection" }, &map);
+    t.Check(map.positionInput == -1 && map.stageCount == 1, "map morph", "opaque root");
+
+    // Flow control keeps the matrices but not the guarantee.
+    t.ExpectMap("map flow control", {
+            0xFFFE0200u,
+            Op(ShaderOp_Rep, 1), Src(ShaderReg_ConstInt, 0),
+            Op(ShaderOp_EndRep),
+            Op(ShaderOp_M4x4, 3), Dst(ShaderReg_RastOut, 0), Src(ShaderReg_Input, 0), Src(ShaderReg_Const, 0),
+            0x0000FFFFu }, false, { "c0/4:WorldViewProjection" }, &map);
+
+    if (t.failures == 0) {
+        printf("self-test: all programs decode and format as expected\n");
+        return 0;
+    }
+    printf("self-test: %d failure(s)\n", t.failures);
+    return 1;
+}
+
+// ─── File dump ───────────────────────────────────────────────────────────────
+
+static bool ReadTokens(const char* path, std::vector<uint32_t>* out) {
+    FILE* f = nullptr;
+#ifdef _MSC_VER
+    if (fopen_s(&f, path, "rb") != 0) f = nullptr;
+#else
+    f = fopen(path, "rb");
+#endif
+    if (!f) return false;
+    std::vector<uint8_t> bytes;
+    uint8_t chunk[4096];
+    size_t n = 0;
+    while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) bytes.insert(bytes.end(), chunk, chunk + n);
+    fclose(f);
+    out->assign(bytes.size() / sizeof(uint32_t), 0);
+    if (!out->empty()) memcpy(out->data(), bytes.data(), out->size() * sizeof(uint32_t));
+    return true;
+}
+
+static bool DumpFile(const char* path, bool timeDecode) {
+    std::vector<uint32_t> tokens;
+    if (!ReadTokens(path, &tokens)) {
+        fprintf(stderr, "%s: cannot read\n", path);
+        return false;
+    }
+    ShaderProgram program;
+    size_t errorToken = 0;
+    const ShaderDecodeStatus status = DecodeShaderBytecode(tokens.data(), tokens.size(), &program, &errorToken);
+    char text[256];
+    FormatShaderModel(program, text, sizeof(text));
+    printf("// %s: %s, %zu tokens, %zu instructions\n", path, program.major ? text : "unknown",
+           tokens.size(), program.instructions.size());
+    for (const ShaderInstruction& inst : program.instructions) {
+        FormatShaderInstruction(program, inst, text, sizeof(text));
+        printf("    %s\n", text);
+    }
+    if (status != ShaderDecode_Ok) {
+        printf("// decode failed: %s at token %zu\n", ShaderDecodeStatusName(status), errorToken);
+    } else if (!program.isPixelShader) {
+        ShaderTransformMap map;
+        AnalyseShaderTransforms(program, &map);
+        printf("// transform map: %s%s%s, world r%d, view r%d\n", map.complete ? "complete" : "incomplete",
+               map.skinned ? ", skinned" : "", map.ambiguousSplit ? ", World/WorldView ambiguous" : "",
+               map.worldTemp, map.viewTemp);
+        for (int i = 0; i < map.useCount; ++i) {
+            FormatMatrixUse(map.uses[i], text, sizeof(text));
+            printf("//   %s", text);
+            if (map.uses[i].stage >= 0) printf(" (stage %d)", map.uses[i].stage);
+            printf("\n");
+        }
+    }
+    if (timeDecode) {
+        const int iterations = 2000;
+        ShaderProgram scratch;
+        const auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; ++i) {
+            DecodeShaderBytecode(tokens.data(), tokens.size(), &scratch);
+        }
+        const double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+        printf("// decode: %.2f us per shader\n", us / iterations);
+    }
+    return status == ShaderDecode_Ok;
+}
+
+// ─── Cache listing ───────────────────────────────────────────────────────────
+
+static int DumpCache(const char* path) {
+    ShaderCacheHeader header;
+    FILE* f = nullptr;
+#ifdef _MSC_VER
+    if (fopen_s(&f, path, "rb") != 0) f = nullptr;
+#else
+    f = fopen(path, "rb");
+#endif
+    const bool haveHeader = f && fread(&header, sizeof(header), 1, f) == 1;
+    if (f) fclose(f);
+    ShaderCache cache;
+    if (!haveHeader || !cache.Open(path, header.analysisVersion)) {
+        fprintf(stderr, "%s: not a readable shader cache\n", path);
+        return 1;
+    }
+    size_t entryCount = 0;
+    const ShaderCacheEntry* entries = cache.GetEntries(&entryCount);
+    size_t layoutCount = 0;
+    const ShaderCacheLayout* layouts = cache.GetLayouts(&layoutCount);
+    printf("// %s: analysis version %u, %zu shaders, %zu locked layouts\n", path, header.analysisVersion,
+           entryCount, layoutCount);
+    for (size_t i = 0; i < entryCount; ++i) {
+        const ShaderCacheEntry& e = entries[i];
+        char model[sizeof(e.shaderModel) + 1] = {};
+        memcpy(model, e.shaderModel, sizeof(e.shaderModel));
+        int reads = 0;
+        for (uint32_t word : e.constantReads) {
+            for (; word; word &= word - 1) ++reads;
+        }
+        printf("shader %08llX %-8s tokens:%u inst:%u%s%s%s%s", static_cast<unsigned long long>(e.hash), model,
+               e.tokenCount, e.instructionCount,
+               (e.flags & ShaderCacheFlag_FFPTransform) ? " ffp-transform" : "",
+               (e.flags & ShaderCacheFlag_FFPLighting) ? " ffp-lighting" : "",
+               (e.flags & ShaderCacheFlag_Skinning) ? " skinning" : "",
+               (e.flags & ShaderCacheFlag_FlowControl) ? " flow-control" : "");
+        if (e.roles[ShaderCacheRole_TransformBase] >= 0) printf(" transform:c%d", e.roles[ShaderCacheRole_TransformBase]);
+        for (int u = 0; u < e.matrixUseCount && u < kShaderCacheMatrixUses; ++u) {
+            ShaderMatrixUse use;
+            use.baseRegister = e.matrixUses[u].baseRegister;
+            use.rows = e.matrixUses[u].rows;
+            use.role = e.matrixUses[u].role;
+            use.relative = e.matrixUses[u].relative != 0;
+            use.transposed = e.matrixUses[u].transposed != 0;
+            char text[64];
+            FormatMatrixUse(use, text, sizeof(text));
+            printf("%s%s", u == 0 ? ((e.transformFlags & ShaderCacheTransform_Complete) ? " map:" : " partial-map:") : ",",
+                   text);
+        }
+        if (e.flags & ShaderCacheFlag_ConstantReadsKnown) {
+            printf(" reads:%d\n", reads);
+        } else {
+            printf(" reads:unknown\n");
+        }
+    }
+    for (size_t i = 0; i < layoutCount; ++i) {
+        const ShaderCacheLayout& layout = layouts[i];
+        printf("layout %08X c%u (+%u):", static_cast<uint32_t>(layout.key >> 32),
+               static_cast<unsigned>((layout.key >> 16) & 0xFFFFu), static_cast<unsigned>(layout.key & 0xFFFFu));
+        static const char* kSlotName[3] = { "World", "View", "Projection" };
+        for (int slot = 0; slot < 3; ++slot) {
+            const ShaderCacheLayoutSlot& s = layout.slots[slot];
+            if (!(s.flags & ShaderCacheSlot_Valid)) continue;
+            printf(" %s=c%d/%d%s%s", kSlotName[slot], s.baseRegister, s.rows,
+                   (s.flags & ShaderCacheSlot_Transposed) ? "T" : "", (s.flags & ShaderCacheSlot_Inverted) ? "I" : "");
+        }
+        printf("\n");
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    bool timeDecode = false;
+    std::vector<const char*> files;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--self-test") == 0) return RunSelfTest();
+        if (strcmp(argv[i], "--cache") == 0 && i + 1 < argc) return DumpCache(argv[i + 1]);
+        if (strcmp(argv[i], "--time") == 0) {
+            timeDecode = true;
+        } else if (argv[i][0] == '-') {
+            fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 2;
+        } else {
+            files.push_back(argv[i]);
+        }
+    }
+    if (files.empty()) {
+        fprintf(stderr, "usage: shader_ir_dump [--time] <file.bytecode.bin>...\n"
+                        "       shader_ir_dump --cache <camera_proxy_shaders.cache>\n"
+                        "       shader_ir_dump --self-test\n");
+        return 2;
+    }
+    bool ok = true;
+    for (const char* path : files) ok = DumpFile(path, timeDecode) && ok;
+    return ok ? 0 : 1;
+}
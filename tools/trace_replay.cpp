@@ -0,0 +1,246 @@
+// Headless replay of a .cpat API trace through the matrix extraction engine.
+//
+// Build (Linux):
+//   g++ -std=c++17 -O2 -I. tools/trace_replay.cpp matrix_engine.cpp api_trace.cpp golden_output.cpp -pthread -o trace_replay
+//
+// Usage:
+//   trace_replay <trace.cpat> [--profile None|MGR|DMC4|Barnyard] [--iterations N]
+//                [--no-decomposition] [--no-suppress-redundant] [--barnyard-world-c0]
+//                [--golden out.cpgd] [--check-golden proxy.cpgd]
+//
+// --golden runs one extra, untimed pass that writes the World/View/Projection bound
+// by every draw; compare two such files with golden_diff. --check-golden compares
+// that pass bit for bit against the golden the proxy wrote while recording the same
+// trace and exits with 1 on the first difference.
+
+#include "../golden_output.h"
+#include "../matrix_engine.h"
+#include "replay_stream.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+
+// Bit-exact, unlike golden_diff's tolerance: a proxy golden and the replay of its own
+// trace must agree on every field. Returns the first differing field, or nullptr.
+static const char* GoldenDrawMismatch(const GoldenDraw& expected, const GoldenDraw& actual, int* outSlot) {
+    *outSlot = -1;
+    if (expected.frame != actual.frame) {
+        return "frame";
+    }
+    if (expected.shaderHash != actual.shaderHash) {
+        return "shader hash";
+    }
+    for (int slot = 0; slot < kGoldenSlotCount; ++slot) {
+        *outSlot = slot;
+        if (expected.bound[slot] != actual.bound[slot]) {
+            return "bound";
+        }
+        if (!expected.bound[slot]) {
+            continue;
+        }
+        if (expected.sourceRegister[slot] != actual.sourceRegister[slot]) {
+            return "source register";
+        }
+        if (std::memcmp(expected.matrices[slot], actual.matrices[slot], sizeof(expected.matrices[slot])) != 0) {
+            return "matrix";
+        }
+    }
+    return nullptr;
+}
+
+// One untimed pass that records what every draw bound. Writes it to `writePath` and/or
+// compares it against `expected` (a proxy golden of the same session), either may be null.
+static bool RunGoldenPass(const ReplayTrace& trace, const MatrixEngineConfig& config, const char* writePath,
+                          const GoldenReader* expected, const char* expectedPath) {
+    GoldenWriter writer;
+    if (writePath && !writer.Open(writePath, static_cast<size_t>(trace.draws))) {
+        std::fprintf(stderr, "error: cannot create %s\n", writePath);
+        return false;
+    }
+    MatrixEngine engine(config);
+    std::unique_ptr<ReplayEngineCaches> caches(new ReplayEngineCaches());
+    caches->Attach(engine);
+    GoldenDraw golden;
+    GoldenDraw recorded;
+    uint64_t drawIndex = 0;
+    bool diverged = false;
+    uint32_t frame = 0;
+    uint32_t shaderHash = 0;
+    EngineDrawTransforms transforms;
+    for (const ReplayOp& op : trace.ops) {
+        ApplyReplayOp(engine, trace, op, &transforms);
+        switch (op.kind) {
+        case ReplayOp_SetVertexShader: {
+            auto it = trace.shaderHashes.find(op.a);
+            shaderHash = it != trace.shaderHashes.end() ? it->second : 0;
+            break;
+        }
+        case ReplayOp_Draw: {
+            golden = GoldenDraw();
+            golden.frame = frame;
+            golden.shaderHash = shaderHash;
+            for (int slot = 0; slot < EngineTransform_Count; ++slot) {
+                golden.bound[slot] = transforms.bound[slot];
+                golden.sourceRegister[slot] = transforms.sourceRegister[slot];
+                std::memcpy(golden.matrices[slot], &transforms.matrices[slot], sizeof(golden.matrices[slot]));
+            }
+            if (writePath) {
+                writer.Append(golden);
+            }
+            if (expected && !diverged && drawIndex < expected->GetDrawCount()) {
+                expected->GetDraw(static_cast<size_t>(drawIndex), &recorded);
+                int slot = -1;
+                if (const char* field = GoldenDrawMismatch(recorded, golden, &slot)) {
+                    std::printf("check:        %s diverges at draw %llu (frame %u): %s%s%s\n", expectedPath,
+                                static_cast<unsigned long long>(drawIndex), recorded.frame, field,
+                                slot >= 0 ? " of " : "", slot >= 0 ? GoldenSlotName(slot) : "");
+                    diverged = true;
+                }
+            }
+            drawIndex++;
+            break;
+        }
+        case ReplayOp_Present:
+            frame++;
+            break;
+        default:
+            break;
+        }
+    }
+    if (writePath) {
+        const uint64_t draws = writer.GetDrawCount();
+        if (!writer.Close()) {
+            std::fprintf(stderr, "error: failed writing %s\n", writePath);
+            return false;
+        }
+        std::printf("golden:       %s (%llu draws)\n", writePath, static_cast<unsigned long long>(draws));
+    }
+    if (expected) {
+        if (!diverged && expected->GetDrawCount() != drawIndex) {
+            std::printf("check:        %s has %llu draws, the replay %llu\n", expectedPath,
+                        static_cast<unsigned long long>(expected->GetDrawCount()),
+                        static_cast<unsigned long long>(drawIndex));
+            diverged = true;
+        }
+        if (!diverged) {
+            std::printf("check:        %s MATCH (%llu draws)\n", expectedPath, static_cast<unsigned long long>(drawIndex));
+        }
+    }
+    return !diverged;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::fprintf(stderr,
+                     "usage: %s <trace.cpat> [--profile None|MGR|DMC4|Barnyard] [--iterations N]\n"
+                     "          [--no-decomposition] [--no-suppress-redundant] [--barnyard-world-c0]\n"
+                     "          [--golden out.cpgd] [--check-golden proxy.cpgd]\n",
+                     argv[0]);
+        return 2;
+    }
+
+    MatrixEngineConfig config;
+    int iterations = 1;
+    const char* goldenPath = nullptr;
+    const char* checkGoldenPath = nullptr;
+    for (int i = 2; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--profile") == 0 && i + 1 < argc) {
+            if (!ParseReplayProfile(argv[++i], &config.profile)) {
+                std::fprintf(stderr, "error: unknown profile '%s'\n", argv[i]);
+                return 2;
+            }
+        } else if (std::strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+            iterations = std::atoi(argv[++i]);
+            if (iterations < 1) iterations = 1;
+        } else if (std::strcmp(argv[i], "--no-decomposition") == 0) {
+            config.enableCombinedDecomposition = false;
+        } else if (std::strcmp(argv[i], "--no-suppress-redundant") == 0) {
+            config.suppressRedundantTransforms = false;
+        } else if (std::strcmp(argv[i], "--barnyard-world-c0") == 0) {
+            config.barnyardForceWorldFromC0 = true;
+        } else if (std::strcmp(argv[i], "--golden") == 0 && i + 1 < argc) {
+            goldenPath = argv[++i];
+        } else if (std::strcmp(argv[i], "--check-golden") == 0 && i + 1 < argc) {
+            checkGoldenPath = argv[++i];
+        } else {
+            std::fprintf(stderr, "error: unknown argument '%s'\n", argv[i]);
+            return 2;
+        }
+    }
+
+    ReplayTrace trace;
+    if (!LoadReplayTrace(argv[1], &trace)) {
+        return 1;
+    }
+    GoldenReader proxyGolden;
+    if (checkGoldenPath && !proxyGolden.Load(checkGoldenPath)) {
+        std::fprintf(stderr, "error: cannot read %s\n", checkGoldenPath);
+        return 2;
+    }
+    if ((goldenPath || checkGoldenPath) &&
+        !RunGoldenPass(trace, config, goldenPath, checkGoldenPath ? &proxyGolden : nullptr, checkGoldenPath)) {
+        return 1;
+    }
+
+    using Clock = std::chrono::steady_clock;
+    long long uploadNs = 0;
+    long long drawNs = 0;
+    long long totalNs = 0;
+    MatrixEngineStats stats;
+    std::unique_ptr<ReplayEngineCaches> caches(new ReplayEngineCaches());
+    for (int iteration = 0; iteration < iterations; ++iteration) {
+        MatrixEngine engine(config);
+        caches->Attach(engine);
+        const Clock::time_point runStart = Clock::now();
+        for (const ReplayOp& op : trace.ops) {
+            switch (op.kind) {
+            case ReplayOp_VertexConstants: {
+                const Clock::time_point start = Clock::now();
+                ApplyReplayOp(engine, trace, op);
+                uploadNs += std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+                break;
+            }
+            case ReplayOp_Draw: {
+                const Clock::time_point start = Clock::now();
+                ApplyReplayOp(engine, trace, op);
+                drawNs += std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+                break;
+            }
+            default:
+                ApplyReplayOp(engine, trace, op);
+                break;
+            }
+        }
+        totalNs += std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - runStart).count();
+        stats = engine.GetStats();
+    }
+
+    const double runs = static_cast<double>(iterations);
+    const double uploads = static_cast<double>(trace.uploads) * runs;
+    const double draws = static_cast<double>(trace.draws) * runs;
+    const double seconds = totalNs > 0 ? static_cast<double>(totalNs) * 1e-9 : 1e-9;
+    std::printf("trace:        %s\n", argv[1]);
+    std::printf("records:      %llu (%llu uploads, %llu draws, %llu frames)\n",
+                static_cast<unsigned long long>(trace.records),
+                static_cast<unsigned long long>(trace.uploads),
+                static_cast<unsigned long long>(trace.draws),
+                static_cast<unsigned long long>(trace.frames));
+    std::printf("iterations:   %d\n", iterations);
+    std::printf("ns/upload:    %.1f\n", uploads > 0 ? static_cast<double>(uploadNs) / uploads : 0.0);
+    std::printf("ns/draw:      %.1f\n", draws > 0 ? static_cast<double>(drawNs) / draws : 0.0);
+    std::printf("total:        %.3f ms per iteration\n", static_cast<double>(totalNs) * 1e-6 / runs);
+    std::printf("throughput:   %.0f uploads/s, %.0f draws/s, %.1f frames/s\n",
+                uploads / seconds, draws / seconds, static_cast<double>(trace.frames) * runs / seconds);
+    std::printf("engine:       %llu structural matches, %llu decompositions, %llu transforms emitted, %llu suppressed\n",
+                static_cast<unsigned long long>(stats.structuralMatches),
+                static_cast<unsigned long long>(stats.decompositionRuns),
+                static_cast<unsigned long long>(stats.transformsEmitted),
+                static_cast<unsigned long long>(stats.transformsSuppressed));
+    std::printf("derivations:  %llu cache hits, %llu misses\n",
+                static_cast<unsigned long long>(stats.derivationHits),
+                static_cast<unsigned long long>(stats.derivationMisses));
+    return 0;
+}
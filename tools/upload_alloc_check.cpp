@@ -0,0 +1,115 @@
+// Checks that the steady-state upload and draw path of the matrix engine does not
+// touch the heap. A counting global operator new replaces the default one; each trace
+// is replayed once to fill the layout table and window memo, then again through the
+// same engine with every allocation counted by op kind.
+//
+// Build (Linux):
+//   g++ -std=c++17 -O2 -I. tools/upload_alloc_check.cpp matrix_engine.cpp api_trace.cpp golden_output.cpp -pthread -o upload_alloc_check
+//
+// Usage:
+//   upload_alloc_check <trace.cpat>... [--profile None|MGR|DMC4|Barnyard] [--defer]
+//
+// Exit code is 0 when no counted op allocated, 1 otherwise and 2 on usage or I/O errors.
+
+#include "../matrix_engine.h"
+#include "replay_stream.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <vector>
+
+static unsigned long long g_heapAllocations = 0;
+
+void* operator new(std::size_t size) {
+    ++g_heapAllocations;
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+struct AllocationCounts {
+    unsigned long long uploads = 0;
+    unsigned long long uploadAllocations = 0;
+    unsigned long long draws = 0;
+    unsigned long long drawAllocations = 0;
+    unsigned long long otherAllocations = 0;
+};
+
+static AllocationCounts CountSteadyStateAllocations(const ReplayTrace& trace, const MatrixEngineConfig& config) {
+    std::unique_ptr<MatrixEngine> engine(new MatrixEngine(config));
+    std::unique_ptr<ReplayEngineCaches> caches(new ReplayEngineCaches());
+    caches->Attach(*engine);
+    EngineDrawTransforms transforms;
+    for (const ReplayOp& op : trace.ops) {
+        ApplyReplayOp(*engine, trace, op, &transforms);
+    }
+
+    AllocationCounts counts;
+    for (const ReplayOp& op : trace.ops) {
+        const unsigned long long before = g_heapAllocations;
+        ApplyReplayOp(*engine, trace, op, &transforms);
+        const unsigned long long allocations = g_heapAllocations - before;
+        if (op.kind == ReplayOp_VertexConstants) {
+            counts.uploads++;
+            counts.uploadAllocations += allocations;
+        } else if (op.kind == ReplayOp_Draw) {
+            counts.draws++;
+            counts.drawAllocations += allocations;
+        } else {
+            counts.otherAllocations += allocations;
+        }
+    }
+    return counts;
+}
+
+int main(int argc, char** argv) {
+    MatrixEngineConfig config;
+    std::vector<const char*> tracePaths;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--profile") == 0 && i + 1 < argc) {
+            if (!ParseReplayProfile(argv[++i], &config.profile)) {
+                std::fprintf(stderr, "error: unknown profile '%s'\n", argv[i]);
+                return 2;
+            }
+        } else if (std::strcmp(argv[i], "--defer") == 0) {
+            config.deferConstantClassification = true;
+        } else if (argv[i][0] == '-') {
+            std::fprintf(stderr, "error: unknown argument '%s'\n", argv[i]);
+            return 2;
+        } else {
+            tracePaths.push_back(argv[i]);
+        }
+    }
+    if (tracePaths.empty()) {
+        std::fprintf(stderr, "usage: %s <trace.cpat>... [--profile None|MGR|DMC4|Barnyard] [--defer]\n", argv[0]);
+        return 2;
+    }
+
+    bool clean = true;
+    for (const char* path : tracePaths) {
+        ReplayTrace trace;
+        if (!LoadReplayTrace(path, &trace)) {
+            return 2;
+        }
+        const AllocationCounts counts = CountSteadyStateAllocations(trace, config);
+        const bool traceClean = counts.uploadAllocations == 0 && counts.drawAllocations == 0 &&
+                                counts.otherAllocations == 0;
+        std::printf("%-40s %llu uploads: %llu allocations, %llu draws: %llu allocations, other ops: %llu  %s\n",
+                    path, counts.uploads, counts.uploadAllocations, counts.draws, counts.drawAllocations,
+                    counts.otherAllocations, traceClean ? "OK" : "ALLOCATES");
+        clean = clean && traceClean;
+    }
+    return clean ? 0 : 1;
+}
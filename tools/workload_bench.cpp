@@ -0,0 +1,422 @@
+// Synthetic constant-upload workloads and a benchmark harness for the matrix engine.
+//
+// Build (Linux):
+//   g++ -std=c++17 -O2 -I. tools/workload_bench.cpp matrix_engine.cpp api_trace.cpp -pthread -o workload_bench
+//
+// Usage:
+//   workload_bench [--draws N] [--frames N] [--min-time SECONDS] [--filter SUBSTRING]
+//                  [--write-traces DIR] [--list]
+//
+// Every scenario is generated once, then replayed through a fresh MatrixEngine until
+// --min-time has elapsed. --write-traces also saves each scenario as a .cpat file so
+// it can be fed to trace_replay and compared with golden_diff.
+
+#include "../api_trace.h"
+#include "../matrix_engine.h"
+#include "replay_stream.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+
+using namespace matrix_engine;
+
+struct WorkloadParams {
+    uint32_t drawsPerFrame = 500;
+    uint32_t frames = 60;
+};
+
+// ─── Matrix helpers ──────────────────────────────────────────────────────────
+
+static EngineMatrix RigidTransform(float yaw, float pitch, float x, float y, float z, float scale = 1.0f) {
+    const float cy = std::cos(yaw), sy = std::sin(yaw);
+    const float cp = std::cos(pitch), sp = std::sin(pitch);
+    EngineMatrix m = IdentityMatrix();
+    m._11 = cy * scale;       m._12 = 0.0f;         m._13 = -sy * scale;
+    m._21 = sy * sp * scale;  m._22 = cp * scale;   m._23 = cy * sp * scale;
+    m._31 = sy * cp * scale;  m._32 = -sp * scale;  m._33 = cy * cp * scale;
+    m._41 = x;                m._42 = y;            m._43 = z;
+    return m;
+}
+
+// D3DXMatrixPerspectiveFovLH layout.
+static EngineMatrix PerspectiveFovLH(float fovY, float aspect, float zn, float zf) {
+    const float ys = 1.0f / std::tan(fovY * 0.5f);
+    EngineMatrix m = {};
+    m._11 = ys / aspect;
+    m._22 = ys;
+    m._33 = zf / (zf - zn);
+    m._34 = 1.0f;
+    m._43 = -zn * zf / (zf - zn);
+    return m;
+}
+
+static EngineMatrix CameraForFrame(uint32_t frame) {
+    const float t = static_cast<float>(frame) * 0.016f;
+    return RigidTransform(t * 0.4f, 0.15f * std::sin(t), 10.0f * std::sin(t * 0.2f), 3.0f, -20.0f + t);
+}
+
+static EngineMatrix WorldForDraw(uint32_t frame, uint32_t draw) {
+    const float d = static_cast<float>(draw);
+    const float t = static_cast<float>(frame) * 0.016f;
+    return RigidTransform(d * 0.37f + t, 0.0f, std::fmod(d * 1.7f, 80.0f) - 40.0f, 0.0f,
+                          std::fmod(d * 2.3f, 120.0f), 1.0f + 0.25f * static_cast<float>(draw % 3));
+}
+
+static EngineMatrix BoneForDraw(uint32_t frame, uint32_t draw, uint32_t bone) {
+    const float t = static_cast<float>(frame) * 0.016f + static_cast<float>(draw) * 0.1f;
+    const float b = static_cast<float>(bone);
+    return RigidTransform(0.3f * std::sin(t + b), 0.2f * std::cos(t * 1.3f + b), 0.0f, b * 0.1f, 0.0f);
+}
+
+static void AppendMatrix(std::vector<float>& out, const EngineMatrix& m, int rows, bool transposed) {
+    const EngineMatrix source = transposed ? TransposeMatrix(m) : m;
+    const float* f = &source._11;
+    out.insert(out.end(), f, f + rows * 4);
+}
+
+static void AddMatrixUpload(ReplayTrace* trace, uint32_t startRegister, const EngineMatrix& m, bool transposed) {
+    std::vector<float> data;
+    AppendMatrix(data, m, 4, transposed);
+    trace->AddConstants(startRegister, data.data(), 4);
+}
+
+static const EngineMatrix& SceneProjection() {
+    static const EngineMatrix projection = PerspectiveFovLH(1.0472f, 16.0f / 9.0f, 0.1f, 1000.0f);
+    return projection;
+}
+
+// Four materials per scene, so shader ids change as often as a typical draw list.
+static uint32_t ShaderForDraw(uint32_t draw) {
+    return 1 + (draw % 4);
+}
+
+// ─── Scenarios ───────────────────────────────────────────────────────────────
+
+// View and projection once per frame in c0-c7, world per draw in c8-c11.
+static void BuildWorldPerDraw(const WorkloadParams& params, bool transposed, ReplayTrace* trace) {
+    for (uint32_t frame = 0; frame < params.frames; ++frame) {
+        const EngineMatrix view = InvertSimpleRigidView(CameraForFrame(frame));
+        std::vector<float> viewProj;
+        AppendMatrix(viewProj, view, 4, transposed);
+        AppendMatrix(viewProj, SceneProjection(), 4, transposed);
+        trace->AddSetVertexShader(ShaderForDraw(0));
+        trace->AddConstants(0, viewProj.data(), 8);
+        for (uint32_t draw = 0; draw < params.drawsPerFrame; ++draw) {
+            trace->AddSetVertexShader(ShaderForDraw(draw));
+            AddMatrixUpload(trace, 8, WorldForDraw(frame, draw), transposed);
+            trace->AddDraw();
+        }
+        trace->AddPresent();
+    }
+}
+
+static void BuildWorldPerDrawDirect(const WorkloadParams& params, ReplayTrace* trace) {
+    BuildWorldPerDraw(params, false, trace);
+}
+
+static void BuildWorldPerDrawTransposed(const WorkloadParams& params, ReplayTrace* trace) {
+    BuildWorldPerDraw(params, true, trace);
+}
+
+// Per draw: world in c8-c11, then a 60-bone palette from c12 in 4x4 or 4x3 rows.
+// 4x3 bones are stored as the first three rows of the transposed matrix, as HLSL
+// float4x3 palettes are.
+static void BuildSkinning(const WorkloadParams& params, int boneRows, ReplayTrace* trace) {
+    static constexpr uint32_t kBones = 60;
+    std::vector<float> palette;
+    palette.reserve(kBones * 16);
+    for (uint32_t frame = 0; frame < params.frames; ++frame) {
+        const EngineMatrix view = InvertSimpleRigidView(CameraForFrame(frame));
+        std::vector<float> viewProj;
+        AppendMatrix(viewProj, view, 4, false);
+        AppendMatrix(viewProj, SceneProjection(), 4, false);
+        trace->AddSetVertexShader(ShaderForDraw(0));
+        trace->AddConstants(0, viewProj.data(), 8);
+        for (uint32_t draw = 0; draw < params.drawsPerFrame; ++draw) {
+            trace->AddSetVertexShader(ShaderForDraw(draw));
+            AddMatrixUpload(trace, 8, WorldForDraw(frame, draw), false);
+            palette.clear();
+            for (uint32_t bone = 0; bone < kBones; ++bone) {
+                AppendMatrix(palette, BoneForDraw(frame, draw, bone), boneRows, boneRows == 3);
+            }
+            trace->AddConstants(12, palette.data(), kBones * static_cast<uint32_t>(boneRows));
+            trace->AddDraw();
+        }
+        trace->AddPresent();
+    }
+}
+
+static void BuildSkinning4x4(const WorkloadParams& params, ReplayTrace* trace) {
+    BuildSkinning(params, 4, trace);
+}
+
+static void BuildSkinning4x3(const WorkloadParams& params, ReplayTrace* trace) {
+    BuildSkinning(params, 3, trace);
+}
+
+// Engines that only upload World*View*Projection, in c0-c3.
+static void BuildCombinedMvpOnly(const WorkloadParams& params, ReplayTrace* trace) {
+    for (uint32_t frame = 0; frame < params.frames; ++frame) {
+        const EngineMatrix viewProj =
+            MultiplyMatrix(InvertSimpleRigidView(CameraForFrame(frame)), SceneProjection());
+        for (uint32_t draw = 0; draw < params.drawsPerFrame; ++draw) {
+            trace->AddSetVertexShader(ShaderForDraw(draw));
+            AddMatrixUpload(trace, 0, MultiplyMatrix(WorldForDraw(frame, draw), viewProj), false);
+            trace->AddDraw();
+        }
+        trace->AddPresent();
+    }
+}
+
+// Metal Gear Rising register map: projection and view-projection once per frame,
+// world per draw.
+static void BuildMetalGearRising(const WorkloadParams& params, ReplayTrace* trace) {
+    const RegisterLayoutProfile layout = BuildProfileRegisterLayout(GameProfile_MetalGearRising);
+    for (uint32_t frame = 0; frame < params.frames; ++frame) {
+        const EngineMatrix view = InvertSimpleRigidView(CameraForFrame(frame));
+        trace->AddSetVertexShader(ShaderForDraw(0));
+        AddMatrixUpload(trace, static_cast<uint32_t>(layout.projectionBase), SceneProjection(), false);
+        AddMatrixUpload(trace, static_cast<uint32_t>(layout.viewProjectionBase),
+                        MultiplyMatrix(view, SceneProjection()), false);
+        for (uint32_t draw = 0; draw < params.drawsPerFrame; ++draw) {
+            trace->AddSetVertexShader(ShaderForDraw(draw));
+            AddMatrixUpload(trace, static_cast<uint32_t>(layout.worldBase), WorldForDraw(frame, draw), false);
+            trace->AddDraw();
+        }
+        trace->AddPresent();
+    }
+}
+
+// Devil May Cry 4 register map: view inverse and projection once per frame,
+// combined MVP per draw.
+static void BuildDevilMayCry4(const WorkloadParams& params, ReplayTrace* trace) {
+    const RegisterLayoutProfile layout = BuildProfileRegisterLayout(GameProfile_DevilMayCry4);
+    for (uint32_t frame = 0; frame < params.frames; ++frame) {
+        const EngineMatrix camera = CameraForFrame(frame);
+        const EngineMatrix viewProj = MultiplyMatrix(InvertSimpleRigidView(camera), SceneProjection());
+        trace->AddSetVertexShader(ShaderForDraw(0));
+        AddMatrixUpload(trace, static_cast<uint32_t>(layout.viewInverseBase), camera, false);
+        AddMatrixUpload(trace, static_cast<uint32_t>(layout.projectionBase), SceneProjection(), false);
+        for (uint32_t draw = 0; draw < params.drawsPerFrame; ++draw) {
+            trace->AddSetVertexShader(ShaderForDraw(draw));
+            AddMatrixUpload(trace, static_cast<uint32_t>(layout.combinedMvpBase),
+                            MultiplyMatrix(WorldForDraw(frame, draw), viewProj), false);
+            trace->AddDraw();
+        }
+        trace->AddPresent();
+    }
+}
+
+// Barnyard: view and projection through game SetTransform, world per draw in c0-c3.
+static void BuildBarnyard(const WorkloadParams& params, ReplayTrace* trace) {
+    for (uint32_t frame = 0; frame < params.frames; ++frame) {
+        const EngineMatrix view = InvertSimpleRigidView(CameraForFrame(frame));
+        trace->AddGameSetTransform(EngineTransform_View, &view._11);
+        trace->AddGameSetTransform(EngineTransform_Projection, &SceneProjection()._11);
+        for (uint32_t draw = 0; draw < params.drawsPerFrame; ++draw) {
+            trace->AddSetVertexShader(ShaderForDraw(draw));
+            AddMatrixUpload(trace, 0, WorldForDraw(frame, draw), false);
+            trace->AddDraw();
+        }
+        trace->AddPresent();
+    }
+}
+
+struct Scenario {
+    const char* name;
+    GameProfileKind profile;
+    void (*build)(const WorkloadParams&, ReplayTrace*);
+};
+
+static const Scenario kScenarios[] = {
+    { "world_per_draw",        GameProfile_None,            BuildWorldPerDrawDirect },
+    { "world_per_draw_transp", GameProfile_None,            BuildWorldPerDrawTransposed },
+    { "skinning_60_4x4",       GameProfile_None,            BuildSkinning4x4 },
+    { "skinning_60_4x3",       GameProfile_None,            BuildSkinning4x3 },
+    { "combined_mvp_only",     GameProfile_None,            BuildCombinedMvpOnly },
+    { "profile_mgr",           GameProfile_MetalGearRising, BuildMetalGearRising },
+    { "profile_dmc4",          GameProfile_DevilMayCry4,    BuildDevilMayCry4 },
+    { "profile_barnyard",      GameProfile_Barnyard,        BuildBarnyard },
+};
+
+static MatrixEngineConfig ConfigForScenario(const Scenario& scenario) {
+    MatrixEngineConfig config;
+    config.profile = scenario.profile;
+    config.autoDetectMatrices = true;
+    config.barnyardForceWorldFromC0 = scenario.profile == GameProfile_Barnyard;
+    return config;
+}
+
+// ─── Trace export ────────────────────────────────────────────────────────────
+
+// D3DTRANSFORMSTATETYPE values for the exported SetTransform records.
+static constexpr uint32_t kTransformStates[EngineTransform_Count] = { 256, 2, 3 };
+static constexpr uint32_t kTriangleList = 4;
+
+static bool WriteScenarioTrace(const ReplayTrace& trace, const char* path) {
+    ApiTraceRecorder recorder;
+    if (!recorder.Start(path)) {
+        return false;
+    }
+    uint32_t frame = 0;
+    for (const ReplayOp& op : trace.ops) {
+        const float* data = trace.constants.data() + op.offset;
+        switch (op.kind) {
+        case ReplayOp_SetVertexShader:
+            recorder.RecordSetShader(ApiTraceStage::Vertex, op.a);
+            break;
+        case ReplayOp_VertexConstants:
+            recorder.RecordShaderConstantsF(ApiTraceStage::Vertex, op.a, data, op.count);
+            break;
+        case ReplayOp_GameSetTransform:
+            recorder.RecordSetTransform(kTransformStates[op.a], data);
+            break;
+        case ReplayOp_Draw:
+            recorder.RecordDraw(ApiTraceDrawKind::DrawIndexedPrimitive, kTriangleList, 64);
+            break;
+        case ReplayOp_Present:
+            recorder.RecordPresent(frame++);
+            break;
+        case ReplayOp_BeginScene:
+            recorder.RecordBeginScene();
+            break;
+        }
+    }
+    recorder.Stop();
+    return true;
+}
+
+// ─── Harness ─────────────────────────────────────────────────────────────────
+
+struct BenchmarkResult {
+    uint64_t iterations = 0;
+    double seconds = 0.0;
+    bool resolved[EngineTransform_Count] = {};
+};
+
+static BenchmarkResult RunScenario(const Scenario& scenario, const ReplayTrace& trace, double minSeconds) {
+    using Clock = std::chrono::steady_clock;
+    const MatrixEngineConfig config = ConfigForScenario(scenario);
+    BenchmarkResult result;
+    std::unique_ptr<ReplayEngineCaches> caches(new ReplayEngineCaches());
+
+    // One untimed warm-up pass, which also records what the engine resolved.
+    {
+        MatrixEngine engine(config);
+        caches->Attach(engine);
+        for (const ReplayOp& op : trace.ops) {
+            ApplyReplayOp(engine, trace, op);
+        }
+        for (int slot = 0; slot < EngineTransform_Count; ++slot) {
+            result.resolved[slot] = engine.EverHad(static_cast<EngineTransformSlot>(slot));
+        }
+    }
+
+    while (result.seconds < minSeconds || result.iterations == 0) {
+        MatrixEngine engine(config);
+        caches->Attach(engine);
+        const Clock::time_point start = Clock::now();
+        for (const ReplayOp& op : trace.ops) {
+            ApplyReplayOp(engine, trace, op);
+        }
+        result.seconds += std::chrono::duration<double>(Clock::now() - start).count();
+        result.iterations++;
+    }
+    return result;
+}
+
+static void PrintRule() {
+    std::printf("-----------------------------------------------------------------------------------------\n");
+}
+
+int main(int argc, char** argv) {
+    WorkloadParams params;
+    double minSeconds = 0.5;
+    const char* filter = nullptr;
+    const char* traceDir = nullptr;
+    bool listOnly = false;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--draws") == 0 && i + 1 < argc) {
+            params.drawsPerFrame = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (std::strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            params.frames = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (std::strcmp(argv[i], "--min-time") == 0 && i + 1 < argc) {
+            minSeconds = std::atof(argv[++i]);
+        } else if (std::strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+            filter = argv[++i];
+        } else if (std::strcmp(argv[i], "--write-traces") == 0 && i + 1 < argc) {
+            traceDir = argv[++i];
+        } else if (std::strcmp(argv[i], "--list") == 0) {
+            listOnly = true;
+        } else {
+            std::fprintf(stderr,
+                         "usage: %s [--draws N] [--frames N] [--min-time SECONDS] [--filter SUBSTRING]\n"
+                         "          [--write-traces DIR] [--list]\n",
+                         argv[0]);
+            return 2;
+        }
+    }
+    if (params.drawsPerFrame == 0) params.drawsPerFrame = 1;
+    if (params.frames == 0) params.frames = 1;
+
+    if (listOnly) {
+        for (const Scenario& scenario : kScenarios) {
+            std::printf("%s\n", scenario.name);
+        }
+        return 0;
+    }
+
+    std::printf("%u draws/frame x %u frames, min time %.2f s per scenario\n",
+                params.drawsPerFrame, params.frames, minSeconds);
+    PrintRule();
+    // Time/draw is wall time per draw including that draw's uploads. WVP shows which
+    // slots the engine resolved, so a scenario that silently stops matching is visible.
+    std::printf("%-24s %12s %12s %12s %12s %10s %5s\n",
+                "Benchmark", "Time/draw", "Iterations", "draws/s", "uploads/s", "MB/s", "WVP");
+    PrintRule();
+    int ran = 0;
+    for (const Scenario& scenario : kScenarios) {
+        if (filter && !std::strstr(scenario.name, filter)) {
+            continue;
+        }
+        ReplayTrace trace;
+        scenario.build(params, &trace);
+        if (traceDir) {
+            const std::string path = std::string(traceDir) + "/" + scenario.name + ".cpat";
+            if (!WriteScenarioTrace(trace, path.c_str())) {
+                std::fprintf(stderr, "error: cannot write %s\n", path.c_str());
+                return 1;
+            }
+        }
+
+        const BenchmarkResult result = RunScenario(scenario, trace, minSeconds);
+        const double runs = static_cast<double>(result.iterations);
+        const double seconds = result.seconds > 0.0 ? result.seconds : 1e-9;
+        const double draws = static_cast<double>(trace.draws) * runs;
+        const double uploads = static_cast<double>(trace.uploads) * runs;
+        const double megabytes = static_cast<double>(trace.constants.size() * sizeof(float)) * runs / (1024.0 * 1024.0);
+        char resolved[EngineTransform_Count + 1] = {};
+        for (int slot = 0; slot < EngineTransform_Count; ++slot) {
+            resolved[slot] = result.resolved[slot] ? "WVP"[slot] : '-';
+        }
+        std::printf("%-24s %9.1f ns %12llu %11.2fM %11.2fM %10.1f %5s\n",
+                    scenario.name,
+                    draws > 0 ? seconds * 1e9 / draws : 0.0,
+                    static_cast<unsigned long long>(result.iterations),
+                    draws / seconds * 1e-6,
+                    uploads / seconds * 1e-6,
+                    megabytes / seconds,
+                    resolved);
+        ran++;
+    }
+    if (ran == 0) {
+        std::fprintf(stderr, "error: no scenario matches '%s'\n", filter ? filter : "");
+        return 2;
+    }
+    return 0;
+}